@@ -39,6 +39,17 @@ public:
    */
   ~Ttv() = default;
 
+  /*
+   * @brief reset an ttv object with a new tag, type and value, the value
+   * buffer is reused if its capacity is large enough
+   * @param tag     tag id of ttv object
+   * @param type    the type of ttv object
+   * @param length  the length of ttv object
+   * @param value   the value of ttv object
+   */
+  void assign(const uint8_t tag, const uint8_t type, const uint32_t length = 0,
+              const void *value = nullptr);
+
   /*
    * @brief get the tag of an ttv object
    */
@@ -73,7 +84,14 @@ private:
   /* the buffer length of ttv object */
   uint32_t mLength;
 
-  /* the pointer which points to the value of ttv object */
+  /* the capacity of the heap buffer mValue */
+  uint32_t mCapacity = 0;
+
+  /* the storage of values no longer than 8 bytes, i.e. all the basic types */
+  uint8_t mInlineValue[sizeof(uint64_t)];
+
+  /* the pointer which points to the value of ttv object if it doesn't fit in
+   * mInlineValue */
   std::unique_ptr<uint8_t[]> mValue;
 };
 
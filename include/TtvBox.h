@@ -7,14 +7,47 @@
 #pragma once
 
 #include "include/Ttv.h"
+#include "include/TtvHash.h"
+#include "include/TtvHeader.h"
+#include "include/TtvRecord.h"
+#include "include/TtvRepeated.h"
+#include "include/TtvSchema.h"
+#include "include/TtvTensor.h"
+#include "include/TtvVarint.h"
 #include "include/common.h"
-#include <map>
+#include <array>
+#include <bitset>
+#include <limits>
+#include <memory>
+#include <string.h>
 #include <string>
 #include <vector>
 
 namespace ttv {
 
 class Ttv;
+class TtvThreadPool;
+
+/* the tags of a patch box created by TtvBox::diff() */
+enum TtvPatchTag {
+  PATCH_UPSERT_TAG = 0x01, // TTV_T, the packed records changed or added
+  PATCH_REMOVE_TAG = 0x02, // BYTES_T, the tags removed
+};
+
+/* a set of tags, the bit of a tag is set if the tag is selected */
+typedef std::bitset<256> TtvTagMask;
+
+/*
+ * a numberical value decoded into host order, so that reading it takes no
+ * byte swap. type is the stored type of the value, or START_TYPE if the value
+ * isn't numberical
+ */
+struct TtvValueSlot {
+  // the value as a T of the type, or the decoded varint of VARUINT_T and
+  // VARINT_T, at the beginning of the bits
+  uint64_t bits = 0;
+  uint8_t type = START_TYPE;
+};
 
 /* TTV box class */
 class TTV_PUBLIC TtvBox {
@@ -33,6 +66,49 @@ public:
    */
   ~TtvBox();
 
+  /*
+   * @brief move construct an ttv box object, the fields and the packed buffer
+   * are taken over in O(1) and the source box is left empty
+   * @param other   the ttv box to be moved from
+   * @return none
+   */
+  TtvBox(TtvBox &&other) noexcept;
+
+  /*
+   * @brief move assign an ttv box object, the current contents are released
+   * and the fields and the packed buffer of other are taken over in O(1)
+   * @param other   the ttv box to be moved from
+   * @return reference to this ttv box
+   */
+  TtvBox &operator=(TtvBox &&other) noexcept;
+
+  /*
+   * @brief create a read-only view of this ttv box which shares the packed
+   * buffer and the decoded fields by reference counting, no value is copied
+   * the shared box stays valid even if this box is destroyed or repacked
+   * @param none
+   * @return the ttv box sharing the contents of this box
+   */
+  TtvBox share() const;
+
+  /*
+   * @brief remove all the values and the packed contents from the ttv box,
+   * the allocated ttv objects and the packed buffer are kept so that the box
+   * can be refilled and repacked without allocating memory again
+   * @param none
+   * @return none
+   */
+  void clear();
+
+  /*
+   * @brief presize the ttv box so that it can hold the given number of values
+   * and packed bytes without allocating memory
+   * @param fields  the number of values including the start and end tags
+   * @param bytes   the number of packed bytes
+   * @return none
+   */
+  void reserve(const uint32_t fields, const uint32_t bytes);
+
   /*
    * @brief put the start or end tag to the ttv box indicating the begining and
    * end of ttv box object
@@ -66,7 +142,9 @@ public:
 
   /*
    * @brief put another ttv box into this tv box,
-   * please note put the start/end tag to the another ttv box
+   * please note put the start/end tag to the another ttv box.
+   * the nested box is stored in the compact layout, a box of the aligned
+   * layout is packed again in the compact layout
    * @param tag     tag id of ttv object
    * @param type    the type of ttv object
    * @param value   the pointer which points to another ttv object
@@ -74,22 +152,172 @@ public:
    */
   bool putTtvValue(const uint8_t tag, const uint8_t type, const TtvBox *value);
 
+  /*
+   * @brief put a tensor into the ttv box, see TtvTensor.h for its layout
+   * @param tag     tag id of ttv object
+   * @param dtype   the type of elements, one of the basic types
+   * @param rank    the number of dimensions, TENSOR_MAX_RANK at most
+   * @param shape   the size of each dimension
+   * @param data    the elements in the host byte order and row-major order
+   * @return true if putting sucessfully, false otherwise
+   */
+  bool putTensor(const uint8_t tag, const uint8_t dtype, const uint8_t rank,
+                 const uint32_t *shape, const void *data);
+
+  /*
+   * @brief put a list of ttv boxes into the ttv box, see TtvRepeated.h for
+   * its layout. the elements are stored in the compact layout as the box of
+   * putTtvValue()
+   * @param tag     tag id of ttv object
+   * @param values  the ttv boxes, which should be packed
+   * @param count   the number of ttv boxes
+   * @return true if putting sucessfully, false otherwise
+   */
+  bool putRepeatedTtvValue(const uint8_t tag, const TtvBox *values,
+                           const uint32_t count);
+
+  /*
+   * @brief update a numberical value which has been put into the ttv box,
+   * support bool/uint8/int8/uint16/int16/uint32/int32/uint64/int64/float/double
+   * if the box is packed, the value is patched in the packed buffer directly
+   * and the box stays packed
+   * @param tag     tag id of ttv object
+   * @param value   the new value of ttv object, its size must match the type
+   * of the value put before
+   * @return true if updating sucessfully, false otherwise
+   */
+  template <typename T>
+  bool setNumbericalValue(const uint8_t tag, const T value);
+
+  /*
+   * @brief update a non numberical value which has been put into the ttv box,
+   * support string/array defined using char *
+   * if the box is packed and the length doesn't change, the value is patched
+   * in the packed buffer directly, otherwise the box has to be packed again
+   * @param tag     tag id of ttv object
+   * @param length  the new length of ttv object
+   * @param value   the new value of ttv object
+   * @return true if updating sucessfully, false otherwise
+   */
+  bool setNonNumbericalValue(const uint8_t tag, const uint32_t length,
+                             const void *value);
+
+  /*
+   * @brief check whether the packed buffer is out of date
+   * @param none
+   * @return true if values have been put or resized since the last pack or
+   * unpack, false otherwise
+   */
+  bool isDirty() const;
+
+  /*
+   * @brief set the layout used by pack() and unpack()
+   * with the aligned layout, every value is padded to its natural alignment
+   * and large values to the cache line, relative to the beginning of the
+   * packed buffer which is aligned to the cache line in memory
+   * @param layout  LAYOUT_COMPACT (default) or LAYOUT_ALIGNED
+   * @return none
+   */
+  void setLayout(const uint8_t layout);
+
+  /*
+   * @brief get the layout used by pack() and unpack()
+   * @param none
+   * @return LAYOUT_COMPACT or LAYOUT_ALIGNED
+   */
+  uint8_t getLayout() const;
+
   /*
    * @brief pack a ttv box after putting all the wanted values
    * after packing, an value with the basic data type is stored as ttv (tag +
    * type + value),\ an value with other data type is stored as ttv(tag + length
    * + value) the start tag and the end tag is used to indicate the beginning
    * and the end of the output buffer
+   * packing a box which is not dirty returns immediately
    * @param none
    * @return true if packing sucessfully, false otherwise
    */
   bool pack();
 
+  /*
+   * @brief pack a ttv box like pack(), the values are copied concurrently by
+   * the threads of a pool, for the boxes of many MB
+   * @param pool    the thread pool
+   * @return true if packing sucessfully, false otherwise
+   */
+  bool pack(TtvThreadPool &pool);
+
+  /*
+   * @brief pack a ttv box into a buffer owned by the caller, e.g. a slot of a
+   * TtvRing, the box itself is not changed
+   * @param buffer    the pointer which points to the buffer
+   * @param capacity  the size of the buffer
+   * @param bytes     the length of the packed buffer, or the length needed
+   * if the buffer is too small
+   * @return true if packing sucessfully, false if the buffer is too small
+   */
+  bool pack(uint8_t *buffer, const uint32_t capacity, uint32_t &bytes) const;
+
+  /*
+   * @brief compute the length of the packed buffer with the current values
+   * and layout without packing them
+   * @param none
+   * @return the length of the packed buffer
+   */
+  uint32_t computePackedBytes() const;
+
+  /*
+   * @brief check whether the box holds a VARUINT_T or VARINT_T value, itself
+   * or in a nested box. the files and the transports across processes flag
+   * such boxes so that the readers unaware of varints reject them up front.
+   * it is tracked as the values are put or unpacked and stays set until the
+   * box is cleared
+   * @param none
+   * @return true if a varint is found, false otherwise
+   */
+  bool hasVarint() const;
+
+  /*
+   * @brief check whether a packed box holds a VARUINT_T or VARINT_T value,
+   * itself or in a nested box, see hasVarint()
+   * @param buffer      the pointer which points to the packed box
+   * @param buffersize  the size of the packed box
+   * @param layout      the layout of the packed box
+   * @return true if a varint is found, false otherwise
+   */
+  static bool hasVarint(const uint8_t *buffer, const uint32_t buffersize,
+                        const uint8_t layout);
+
+  /*
+   * @brief hash the content of a ttv box. the hash is computed over the
+   * canonical encoding, i.e. the compact layout with the records in the order
+   * of tags, the shortest varints and a single NaN, down to the nested boxes
+   * and the elements of the tensors, so equal content gives an equal hash
+   * whatever the layout and the writer are. a packed box in the compact layout
+   * is hashed directly over its packed buffer unless a value which may differ
+   * from its canonical encoding was put or unpacked, e.g. an overlong varint,
+   * a tensor of floating point or a nested box
+   * @param seed    the seed of the hash
+   * @return the 64-bit hash, i.e. XXH64 of the canonical encoding
+   */
+  uint64_t hash(const uint64_t seed = 0) const;
+
+  /*
+   * @brief hash the content of a ttv box to 128 bits in one pass, see hash(),
+   * the lower half is hash() and the upper half hash() of another seed
+   * @param none
+   * @return the 128-bit hash
+   */
+  TtvHash128 hash128() const;
+
   /*
    * @brief parse the input file and put all the value into a ttv box,
    * the contents of the input file should be given in the format splitted by
    * space like: tag_id data_type value for example: 1 uint8 224 2 uint8 224 3
    * float 127.0 4 double 0.128 5 int8 -127
+   * the value of the data type tensor is the path of a text file relative to
+   * the input file, which gives the shape in the first line and then the
+   * float elements, for example: 8 tensor ./mean.txt
    * @param file  the pure text file for parsing
    * @return true if parsing sucessfully, false otherwise
    */
@@ -102,6 +330,18 @@ public:
    */
   uint8_t *getPackedBuffer() const;
 
+  /*
+   * @brief  get the pointer of a value inside the packed buffer without
+   * copying it, with the aligned layout the pointer is aligned as well
+   * @param tag     tag id of ttv object
+   * @param value   the pointer which points to the value
+   * @param length  the length of the value
+   * @return true if getting sucessfully, false if the tag is not found or the
+   * box is not packed
+   */
+  bool getPackedValue(const uint8_t tag, const uint8_t **value,
+                      uint32_t &length) const;
+
   /*
    * @brief  get the length of packed buffer (net length excluding the header
    * size)
@@ -125,6 +365,14 @@ public:
    */
   uint8_t getTagList(std::vector<uint8_t> &list) const;
 
+  /*
+   * @brief  get the type of a value
+   * @param tag     tag id of ttv object
+   * @param type    the type of ttv object
+   * @return true if the tag is found, false otherwise
+   */
+  bool getType(const uint8_t tag, uint8_t &type) const;
+
   /*
    * @brief  print all the tags in the ttv box
    * @param  void
@@ -134,13 +382,28 @@ public:
 
   /*
    * @brief  unpack a ttv box
-   * after unpacking, all the tags are stored into the map mTtvMap so we can get
-   * their values by the function get_xx_value()
+   * after unpacking, all the tags are stored into the ttv objects so we can get
+   * their values by the function get_xx_value(), the values of unknown types
+   * are kept as they are and packed again unchanged
    * @param buffer      the pointer which points to a buffer contains ttv box
    * @param buffer      the size of the ttv box
-   * @return true if unpacking sucessfully, false otherwise
+   * @return true if unpacking sucessfully, false if the buffer is malformed
+   * or holds a tag twice, the box is cleared in that case
    */
   bool unpack(const uint8_t *buffer, const uint32_t buffersize);
+  /*
+   * @brief  unpack the selected tags of a ttv box
+   * the other tags are skipped by their length without being copied, so the
+   * cost depends on the selected values only. the box holds the selected tags
+   * only and is dirty after unpacking, i.e. pack() writes the selected tags
+   * @param buffer      the pointer which points to a buffer contains ttv box
+   * @param buffersize  the size of the ttv box
+   * @param tags        the tags to unpack
+   * @return true if unpacking sucessfully, false if the buffer is malformed,
+   * the box is cleared in that case
+   */
+  bool unpack(const uint8_t *buffer, const uint32_t buffersize,
+              const TtvTagMask &tags);
 
   /*
    * @brief  get the values of all tags from the minimum tag to the maximum tag
@@ -151,7 +414,9 @@ public:
 
   /*
    * @brief get a numberical value from the ttv box,
-   * support bool/uint8/int8/uint16/int16/uint32/int32/uint64/int64/float/double
+   * support bool/uint8/int8/uint16/int16/uint32/int32/uint64/int64/float/double,
+   * T must match the stored type, e.g. uint16_t for UINT16_T, and any integer
+   * wide enough for the value of VARUINT_T and VARINT_T
    * @param tag     tag id of ttv object
    * @param value   the value of ttv object
    * @return true if getting sucessfully, false otherwise
@@ -178,7 +443,19 @@ public:
   bool getBytesValue(const uint8_t tag, char **value) const;
 
   /*
-   * @brief get another ttv box from the tv box
+   * @brief get a tensor from the ttv box without copying its elements,
+   * if the box is packed the view references the packed buffer, so the
+   * elements are aligned to the cache line with the aligned layout
+   * the view is valid until the box is modified, packed or destroyed
+   * @param tag     tag id of ttv object
+   * @param view    the tensor referencing the elements
+   * @return true if getting sucessfully, false otherwise
+   */
+  bool getTensorView(const uint8_t tag, TtvTensorView &view) const;
+
+  /*
+   * @brief get another ttv box from the tv box, the nested box is stored
+   * in the compact layout, see putTtvValue(), and value is unpacked in it
    * @param tag     tag id of ttv object
    * @param type    the type of ttv object
    * @param value   the pointer which points to another ttv object
@@ -187,11 +464,104 @@ public:
   bool getTtvValue(const uint8_t tag, TtvBox &value) const;
 
   /*
-   * @brief write the contents of the ttv box to a file
-   * @param file    file name
+   * @brief get a list of ttv boxes from the ttv box without copying them,
+   * the elements are reached by getRepeatedElement() in O(1)
+   * the view is valid until the box is modified, packed or destroyed
+   * @param tag     tag id of ttv object
+   * @param view    the list referencing the elements
+   * @return true if getting sucessfully, false otherwise
+   */
+  bool getRepeatedView(const uint8_t tag, TtvRepeatedView &view) const;
+
+  /*
+   * @brief get an element of a list of ttv boxes, the other elements are
+   * not decoded. the elements are stored in the compact layout, see
+   * putRepeatedTtvValue(), and value is unpacked in it
+   * @param tag     tag id of ttv object
+   * @param index   the index of the element
+   * @param value   the ttv box unpacked from the element
+   * @return true if getting sucessfully, false otherwise
+   */
+  bool getRepeatedTtvValue(const uint8_t tag, const uint32_t index,
+                           TtvBox &value) const;
+
+  /*
+   * @brief set the names of the tags, e.g. to look up the boxes unpacked
+   * from the buffers without an embedded schema. parse() sets the names in
+   * the fourth column of the file, and unpack() sets the names embedded at
+   * SCHEMA_TAG. the schema is kept by clear()
+   * @param schema  the names of the tags, which should be built
+   * @return none
+   */
+  void setSchema(const std::shared_ptr<const TtvSchema> &schema);
+
+  /*
+   * @brief get the names of the tags
+   * @param none
+   * @return the names of the tags, nullptr if there is no schema
+   */
+  std::shared_ptr<const TtvSchema> getSchema() const;
+
+  /*
+   * @brief embed the names of the tags into the box as a BYTES_T value with
+   * the tag SCHEMA_TAG, so that the readers can look up the values by name
+   * @param none
+   * @return true if embedding sucessfully, false if there is no schema or the
+   * tag SCHEMA_TAG is used by another value
+   */
+  bool embedSchema();
+
+  /*
+   * @brief look up the tag of a name through the perfect hash of the schema
+   * @param name    the name of the tag
+   * @param tag     tag id of ttv object
+   * @return true if the name is found, false otherwise
+   */
+  bool getTag(const char *name, uint8_t &tag) const;
+
+  /*
+   * @brief get a value by the name of its tag, e.g. get("input_h", value)
+   * numbers, std::string and TtvTensorView are supported. the name is hashed
+   * and compared on every call, a few times the cost of getting by tag, so
+   * the hot loops should look up the tag once with getTag()
+   * @param name    the name of the tag
+   * @param value   the value of ttv object
+   * @return true if getting sucessfully, false otherwise
+   */
+  template <typename T> bool get(const char *name, T &value) const;
+
+  /*
+   * @brief compute the difference between two packed ttv boxes
+   * the packed buffers are walked in the ascending order of tags without
+   * unpacking them, the patch box holds the records which are changed or
+   * added in the new box and the tags which are removed from the old box
+   * @param oldBox  the old ttv box, it must be packed
+   * @param newBox  the new ttv box, it must be packed
+   * @param patch   the packed patch box, see enum::TtvPatchTag
+   * @return true if diffing sucessfully, false otherwise
+   */
+  static bool diff(const TtvBox &oldBox, const TtvBox &newBox, TtvBox &patch);
+
+  /*
+   * @brief apply a patch box created by diff() to this ttv box
+   * the packed buffer is merged with the records of the patch in the
+   * ascending order of tags, only the values of the patch are decoded and the
+   * other values keep their ttv objects
+   * @param patch   the patch box, either packed or unpacked
+   * @return true if applying sucessfully, false otherwise
+   */
+  bool apply(const TtvBox &patch);
+
+  /*
+   * @brief write the contents of the ttv box to a file with an extended
+   * header, see TtvHeader.h. the readers still accept the legacy header.
+   * the box has to be packed, writing fails if it is modified after packing
+   * @param file      file name
+   * @param checksum  if true, the header carries the crc32c of the packed
+   * buffer
    * @return true if writing sucessfully, false otherwise
    */
-  bool write(const std::string &file);
+  bool write(const std::string &file, const bool checksum = false);
   /*
    * @brief read the contents of the ttv box frome a file
    * @param file    file name
@@ -200,129 +570,222 @@ public:
   bool read(const std::string &file);
   /*
    * @brief read the contents of the ttv box frome a file
+   * the crc32c of the packed buffer is verified if the header carries it
    * @param file    file stream object
-   * @return none
+   * @return true if reading sucessfully, false if the file is truncated or
+   * corrupted
    */
-  void read(std::ifstream &file);
+  bool read(std::ifstream &file);
   /*
    * @brief read the contents of the ttv box frome a buffer
+   * the crc32c of the packed buffer is verified if the header carries it
    * @param buffer pointer that points to the begining of contents of the file
-   * @return none
+   * @return true if reading sucessfully, false if the buffer is corrupted
    */
-  void read(const void *buffer);
+  bool read(const void *buffer);
+  /*
+   * @brief read the contents of the ttv box frome a buffer of known size
+   * the crc32c of the packed buffer is verified if the header carries it
+   * @param buffer      pointer that points to the begining of the header
+   * @param buffersize  the size of the buffer
+   * @return true if reading sucessfully, false if the buffer is corrupted or
+   * the header describes more bytes than the buffer holds
+   */
+  bool read(const void *buffer, const size_t buffersize);
 
 public:
   TtvBox(const TtvBox &) = delete;
-  TtvBox(const TtvBox &&) = delete;
   TtvBox &operator=(const TtvBox &) = delete;
-  TtvBox &operator=(const TtvBox &&) = delete;
 
 private:
-  bool putValue(const Ttv *value);
+  bool putValue(const uint8_t tag, const uint8_t type, const uint32_t length,
+                const void *value);
+  bool putPackedValue(const uint8_t tag, const uint8_t type,
+                      const uint32_t length, const uint32_t offset);
+  bool setValue(const uint8_t tag, const uint32_t length, const void *value);
+  static TtvValueSlot decodeSlot(const uint8_t type, const uint32_t length,
+                                 const void *value);
+  bool parseTensor(const uint8_t tag, const std::string &file);
+  const Ttv *findTtv(const uint8_t tag) const;
   void freeMem();
+  void allocPackedBuffer(const uint32_t bytes);
+  void layoutPackedBuffer();
+  void detachPackedBuffer();
+  bool verifyPackedBuffer(const TtvHeader &header);
+  bool updateSchema();
+  template <typename T> bool getValueByTag(const uint8_t tag, T &value) const;
+  bool getValueByTag(const uint8_t tag, std::string &value) const;
+  bool getValueByTag(const uint8_t tag, TtvTensorView &value) const;
+  template <typename H> void updateHash(H &hasher) const;
+
+  template <typename T>
+  static uint32_t encodeNumbericalValue(const T value, uint8_t *buffer);
 
 private:
-  // store pairs of tag and ttv object
-  std::map<uint8_t, const Ttv *> mTtvMap;
-  // pointer which points to the ttv box object
-  std::unique_ptr<uint8_t[]> mPackedBuffer;
+  // ttv objects sorted by tag, the first mNumTtvs are in use and the rest are
+  // kept for reuse. they are shared with the boxes created by share()
+  std::vector<std::shared_ptr<Ttv>> mTtvPool;
+  // number of ttv objects in use
+  uint32_t mNumTtvs = 0;
+  // position of each tag in mTtvPool, -1 if the tag is absent
+  std::array<int16_t, 256> mTagIndex;
+  // pointer which points to the ttv box object, shared with the boxes created
+  // by share()
+  std::shared_ptr<uint8_t> mPackedBuffer;
+  // offset of the value of each ttv object in mPackedBuffer, indexed by the
+  // position in mTtvPool and valid only if the box is not dirty
+  std::vector<uint32_t> mValueOffsets;
+  // numberical value of each ttv object decoded into host order, indexed by
+  // the position in mTtvPool
+  std::vector<TtvValueSlot> mSlots;
+  // allocated size of mPackedBuffer
+  uint32_t mPackedCapacity = 0;
   // total length of ttv box object
   uint32_t mPackedBytes = 0;
+  // layout of mPackedBuffer, see TtvLayoutDefinition
+  uint8_t mLayout = LAYOUT_COMPACT;
+  // true if mPackedBuffer doesn't match the ttv objects
+  bool mDirty = true;
+  // true if a value put since the last clear is a varint or holds one, see
+  // hasVarint()
+  bool mHasVarint = false;
+  // true if a value put since the last clear may differ from its canonical
+  // encoding or was put out of the order of tags, so that hash() cannot use
+  // mPackedBuffer as it is
+  bool mNonCanonical = false;
+  // names of the tags, shared with the boxes created by share()
+  std::shared_ptr<const TtvSchema> mSchema;
+  // the embedded value which mSchema is decoded from, empty if mSchema is set
+  // by parse() or setSchema()
+  std::vector<uint8_t> mSchemaBytes;
 };
 
 template <typename T>
-bool TtvBox::putNumbericalValue(const uint8_t tag, const uint8_t type,
-                                const T value) {
+uint32_t TtvBox::encodeNumbericalValue(const T value, uint8_t *buffer) {
   if ((std::is_same<typename std::decay<T>::type,
                     typename std::decay<bool>::type>::value) ||
       (std::is_same<typename std::decay<T>::type,
                     typename std::decay<uint8_t>::type>::value) ||
       (std::is_same<typename std::decay<T>::type,
                     typename std::decay<int8_t>::type>::value)) {
-    // TTV_LOGD("tag = %d, type = %d, value = %d\n", tag, type, value);
-    return putValue(new Ttv(tag, type, sizeof(uint8_t), &value));
+    ::memcpy(buffer, &value, sizeof(uint8_t));
+    return sizeof(uint8_t);
   } else if ((std::is_same<typename std::decay<T>::type,
                            typename std::decay<uint16_t>::type>::value) ||
              (std::is_same<typename std::decay<T>::type,
                            typename std::decay<int16_t>::type>::value)) {
     uint16_t newvalue = htons(value);
-    return putValue(new Ttv(tag, type, sizeof(uint16_t), &newvalue));
+    ::memcpy(buffer, &newvalue, sizeof(uint16_t));
+    return sizeof(uint16_t);
   } else if ((std::is_same<typename std::decay<T>::type,
                            typename std::decay<uint32_t>::type>::value) ||
              (std::is_same<typename std::decay<T>::type,
                            typename std::decay<int32_t>::type>::value)) {
     uint32_t newvalue = htonl(value);
-    return putValue(new Ttv(tag, type, sizeof(uint32_t), &newvalue));
+    ::memcpy(buffer, &newvalue, sizeof(uint32_t));
+    return sizeof(uint32_t);
   } else if ((std::is_same<typename std::decay<T>::type,
                            typename std::decay<uint64_t>::type>::value) ||
              (std::is_same<typename std::decay<T>::type,
                            typename std::decay<int64_t>::type>::value)) {
     uint64_t newvalue = htobe64(value);
-    return putValue(new Ttv(tag, type, sizeof(uint64_t), &newvalue));
+    ::memcpy(buffer, &newvalue, sizeof(uint64_t));
+    return sizeof(uint64_t);
   } else if ((std::is_same<typename std::decay<T>::type,
                            typename std::decay<float>::type>::value)) {
-    float newvalue = swapFloat(value);
-    return putValue(new Ttv(tag, type, sizeof(float), &newvalue));
+    // all the NaNs are stored as the same NaN to keep the encoding canonical
+    float newvalue = (value != value) ? std::numeric_limits<float>::quiet_NaN()
+                                      : value;
+    newvalue = swapFloat(newvalue);
+    ::memcpy(buffer, &newvalue, sizeof(float));
+    return sizeof(float);
   } else if ((std::is_same<typename std::decay<T>::type,
                            typename std::decay<double>::type>::value)) {
-    double newvalue = swapDouble(value);
-    return putValue(new Ttv(tag, type, sizeof(double), &newvalue));
-  } else {
+    double newvalue = (value != value)
+                          ? std::numeric_limits<double>::quiet_NaN()
+                          : value;
+    newvalue = swapDouble(newvalue);
+    ::memcpy(buffer, &newvalue, sizeof(double));
+    return sizeof(double);
+  }
+  return 0;
+}
+
+template <typename T>
+bool TtvBox::putNumbericalValue(const uint8_t tag, const uint8_t type,
+                                const T value) {
+  uint8_t buffer[VARINT_MAX_BYTES];
+  const uint32_t length = isVarintType(type)
+                              ? encodeVarintValue(type, value, buffer)
+                              : encodeNumbericalValue(value, buffer);
+  if (0 == length) {
+    TTV_LOGE("Error: unsupported data type.");
+    return false;
+  }
+  return putValue(tag, type, length, buffer);
+}
+
+template <typename T>
+bool TtvBox::setNumbericalValue(const uint8_t tag, const T value) {
+  const Ttv *ttv = findTtv(tag);
+  if (nullptr == ttv) {
+    TTV_LOGE("Error: tag = %d is not found.", tag);
+    return false;
+  }
+
+  // a varint may change its length, which makes the box dirty
+  uint8_t buffer[VARINT_MAX_BYTES];
+  const bool isVarint = isVarintType(ttv->getType());
+  const uint32_t length = isVarint
+                              ? encodeVarintValue(ttv->getType(), value, buffer)
+                              : encodeNumbericalValue(value, buffer);
+  if (0 == length) {
     TTV_LOGE("Error: unsupported data type.");
     return false;
   }
-  return true;
+  if (!isVarint &&
+      ((ttv->getType() > BASIC_TYPE_MAX) || (ttv->getLength() != length))) {
+    TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
+    return false;
+  }
+  return setValue(tag, length, buffer);
 }
 
 template <typename T>
 bool TtvBox::getNumbericalValue(const uint8_t tag, T &value) const {
-  auto iter = mTtvMap.find(tag);
-  if (iter != mTtvMap.end()) {
-    if ((std::is_same<typename std::decay<T>::type,
-                      typename std::decay<bool>::type>::value) ||
-        (std::is_same<typename std::decay<T>::type,
-                      typename std::decay<uint8_t>::type>::value) ||
-        (std::is_same<typename std::decay<T>::type,
-                      typename std::decay<int8_t>::type>::value)) {
-      value = (*reinterpret_cast<T *>(iter->second->getValue()));
-      return true;
-    } else if ((std::is_same<typename std::decay<T>::type,
-                             typename std::decay<uint16_t>::type>::value) ||
-               (std::is_same<typename std::decay<T>::type,
-                             typename std::decay<int16_t>::type>::value)) {
-      value = ntohs(*reinterpret_cast<uint16_t *>(iter->second->getValue()));
-      return true;
-    } else if ((std::is_same<typename std::decay<T>::type,
-                             typename std::decay<uint32_t>::type>::value) ||
-               (std::is_same<typename std::decay<T>::type,
-                             typename std::decay<int32_t>::type>::value)) {
-      value = (uint32_t)ntohl(
-          *reinterpret_cast<uint32_t *>(iter->second->getValue()));
-      return true;
-    } else if ((std::is_same<typename std::decay<T>::type,
-                             typename std::decay<uint64_t>::type>::value) ||
-               (std::is_same<typename std::decay<T>::type,
-                             typename std::decay<int64_t>::type>::value)) {
-      value = be64toh(*reinterpret_cast<uint64_t *>(iter->second->getValue()));
-      return true;
-    } else if ((std::is_same<typename std::decay<T>::type,
-                             typename std::decay<float>::type>::value)) {
-      value = swapFloat(*reinterpret_cast<float *>(iter->second->getValue()));
-      return true;
-    } else if ((std::is_same<typename std::decay<T>::type,
-                             typename std::decay<double>::type>::value)) {
-      value = swapDouble(*reinterpret_cast<double *>(iter->second->getValue()));
-      return true;
-    } else {
-      TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
-      return false;
-    }
-  } else {
+  const int16_t index = mTagIndex[tag];
+  if (index < 0) {
     TTV_LOGE("Error: tag = %d is not found.", tag);
     return false;
   }
 
-  return true;
+  // the value has been decoded when it was put or unpacked
+  const TtvValueSlot &slot = mSlots[index];
+  const uint8_t type = TtvNumbericalType<typename std::decay<T>::type>::value;
+  if ((START_TYPE != type) && (type == slot.type)) {
+    ::memcpy(&value, &slot.bits, sizeof(T));
+    return true;
+  }
+  if (isVarintType(slot.type) &&
+      convertVarintValue(slot.type, slot.bits, value)) {
+    return true;
+  }
+  TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
+  return false;
+}
+
+template <typename T>
+bool TtvBox::getValueByTag(const uint8_t tag, T &value) const {
+  return getNumbericalValue(tag, value);
+}
+
+template <typename T> bool TtvBox::get(const char *name, T &value) const {
+  uint8_t tag = 0;
+  if (!getTag(name, tag)) {
+    TTV_LOGE("Error: name = %s is not found.", name);
+    return false;
+  }
+  return getValueByTag(tag, value);
 }
 
 } // namespace ttv
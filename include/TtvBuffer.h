@@ -20,23 +20,25 @@ public:
    * @brief encode a ttv box and write it to file
    * @param file      file name
    * @param ttvbox    the ttv box to be encoded
+   * @param checksum  if true, protect the ttv box by crc32c
    * @return true if encoding sucessfully, false otherwise
    */
-  bool serialize(const std::string &file, TtvBox &ttvbox);
+  bool serialize(const std::string &file, TtvBox &ttvbox,
+                 const bool checksum = false);
 
   /*
    * @brief decode a ttv box from file (already open) and write it to a ttv box
    * @param file       file stream object
    * @param ttvbox     the ttv box to be decoded
-   * @return true if encoding sucessfully, false otherwise
+   * @return true if decoding sucessfully, false otherwise
    */
-  void deserialize(std::ifstream &file, TtvBox &ttvbox);
+  bool deserialize(std::ifstream &file, TtvBox &ttvbox);
 
   /*
    * @brief decode a ttv box from file (not open yet) and write it to a ttv box
    * @param file       file name
    * @param ttvbox     the ttv box to be decoded
-   * @return none
+   * @return true if decoding sucessfully, false otherwise
    */
   bool deserialize(const std::string &file, TtvBox &ttvbox);
 
@@ -45,9 +47,9 @@ public:
    * @param buffer     pointer that points to the begining of contents of the
    * file
    * @param ttvbox     the ttv box to be decoded
-   * @return none
+   * @return true if decoding sucessfully, false otherwise
    */
-  void deserialize(const void *buffer, TtvBox &ttvbox);
+  bool deserialize(const void *buffer, TtvBox &ttvbox);
 };
 
 } // namespace ttv
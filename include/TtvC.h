@@ -0,0 +1,187 @@
+/*
+ *  @file     TtvC.h
+ *  @brief    TTV C API, a stable C interface over ttv boxes for FFI consumers
+ *  such as ctypes or cffi, exported by libTTV_C
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define TTV_C_API __declspec(dllexport)
+#else
+#define TTV_C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the status returned by the functions, no exception escapes them */
+enum ttv_status {
+  TTV_OK = 0,     // succeeded
+  TTV_ERROR = -1, // failed, the reason is logged
+};
+
+/* an opaque handle of a ttv box */
+typedef struct ttv_box ttv_box;
+
+/*
+ * @brief create an empty ttv box
+ * @param none
+ * @return the handle of the box, NULL if out of memory
+ */
+TTV_C_API ttv_box *ttv_box_create(void);
+
+/*
+ * @brief destroy a ttv box, the borrowed pointers become invalid
+ * @param box     the handle of the box, may be NULL
+ * @return none
+ */
+TTV_C_API void ttv_box_destroy(ttv_box *box);
+
+/*
+ * @brief remove all the values of a ttv box, the memory is kept for reuse
+ * @param box     the handle of the box
+ * @return none
+ */
+TTV_C_API void ttv_box_clear(ttv_box *box);
+
+/*
+ * @brief put the start or the end tag
+ * @param box     the handle of the box
+ * @param tag     START_TAG or END_TAG
+ * @param type    START_TYPE or END_TYPE
+ * @return TTV_OK if putting sucessfully, TTV_ERROR otherwise
+ */
+TTV_C_API int ttv_box_put_start_end(ttv_box *box, uint8_t tag, uint8_t type);
+
+/*
+ * @brief put a value with a basic data type
+ * @param box     the handle of the box
+ * @param tag     tag id of ttv object
+ * @param type    BOOL_T ~ VARINT_T
+ * @param value   the pointer which points to the value in host order, e.g.
+ * a float for FLOAT_T, a uint64_t for VARUINT_T and an int64_t for VARINT_T
+ * @return TTV_OK if putting sucessfully, TTV_ERROR otherwise
+ */
+TTV_C_API int ttv_box_put_number(ttv_box *box, uint8_t tag, uint8_t type,
+                                 const void *value);
+
+/*
+ * @brief put a value with a non basic data type, the value is copied
+ * @param box     the handle of the box
+ * @param tag     tag id of ttv object
+ * @param type    STRING_T, BYTES_T, TTV_T or TENSOR_T
+ * @param value   the pointer which points to the value
+ * @param length  the length of the value
+ * @return TTV_OK if putting sucessfully, TTV_ERROR otherwise
+ */
+TTV_C_API int ttv_box_put_bytes(ttv_box *box, uint8_t tag, uint8_t type,
+                                const void *value, uint32_t length);
+
+/*
+ * @brief pack the values into the packed buffer
+ * @param box     the handle of the box
+ * @return TTV_OK if packing sucessfully, TTV_ERROR otherwise
+ */
+TTV_C_API int ttv_box_pack(ttv_box *box);
+
+/*
+ * @brief borrow the packed buffer without copying it
+ * the pointer is valid until the box is modified, unpacked or destroyed
+ * @param box     the handle of the box
+ * @param data    the pointer which points to the packed buffer
+ * @param size    the size of the packed buffer
+ * @return TTV_OK if the box is packed, TTV_ERROR otherwise
+ */
+TTV_C_API int ttv_box_get_packed_buffer(const ttv_box *box,
+                                        const uint8_t **data, uint32_t *size);
+
+/*
+ * @brief copy a packed buffer into the box and unpack it
+ * @param box     the handle of the box
+ * @param data    the pointer which points to the packed buffer
+ * @param size    the size of the packed buffer
+ * @return TTV_OK if unpacking sucessfully, TTV_ERROR if the buffer is
+ * malformed
+ */
+TTV_C_API int ttv_box_unpack(ttv_box *box, const uint8_t *data, uint32_t size);
+
+/*
+ * @brief get the tags of the box in ascending order
+ * @param box       the handle of the box
+ * @param tags      the array to store the tags, may be NULL
+ * @param capacity  the number of tags the array can hold
+ * @return the number of tags in the box, which may exceed the capacity
+ */
+TTV_C_API uint32_t ttv_box_get_tags(const ttv_box *box, uint8_t *tags,
+                                    uint32_t capacity);
+
+/*
+ * @brief get the type of a value
+ * @param box     the handle of the box
+ * @param tag     tag id of ttv object
+ * @param type    the type of ttv object
+ * @return TTV_OK if the tag is found, TTV_ERROR otherwise
+ */
+TTV_C_API int ttv_box_get_type(const ttv_box *box, uint8_t tag, uint8_t *type);
+
+/*
+ * @brief get a value with a basic data type
+ * @param box     the handle of the box
+ * @param tag     tag id of ttv object
+ * @param type    the expected type, BOOL_T ~ VARINT_T
+ * @param value   the pointer which points to the value in host order
+ * @return TTV_OK if getting sucessfully, TTV_ERROR if the tag is not found or
+ * its type mismatches
+ */
+TTV_C_API int ttv_box_get_number(const ttv_box *box, uint8_t tag, uint8_t type,
+                                 void *value);
+
+/*
+ * @brief borrow a value inside the packed buffer without copying it, the
+ * values with basic data types are big-endian
+ * the pointer is valid until the box is modified, unpacked or destroyed
+ * @param box     the handle of the box
+ * @param tag     tag id of ttv object
+ * @param value   the pointer which points to the value
+ * @param length  the length of the value
+ * @return TTV_OK if getting sucessfully, TTV_ERROR if the tag is not found or
+ * the box is not packed
+ */
+TTV_C_API int ttv_box_get_packed_value(const ttv_box *box, uint8_t tag,
+                                       const uint8_t **value,
+                                       uint32_t *length);
+
+/*
+ * @brief parse a configuration file, see TtvBox::parse()
+ * @param box     the handle of the box
+ * @param file    the path of the file
+ * @return TTV_OK if parsing sucessfully, TTV_ERROR otherwise
+ */
+TTV_C_API int ttv_box_parse(ttv_box *box, const char *file);
+
+/*
+ * @brief write the packed buffer to a file, the box has to be packed, see
+ * TtvBox::write()
+ * @param box       the handle of the box
+ * @param file      the path of the file
+ * @param checksum  nonzero to protect the packed buffer with crc32c
+ * @return TTV_OK if writing sucessfully, TTV_ERROR otherwise
+ */
+TTV_C_API int ttv_box_write(ttv_box *box, const char *file, int checksum);
+
+/*
+ * @brief read a file and unpack it
+ * @param box     the handle of the box
+ * @param file    the path of the file
+ * @return TTV_OK if reading sucessfully, TTV_ERROR otherwise
+ */
+TTV_C_API int ttv_box_read(ttv_box *box, const char *file);
+
+#ifdef __cplusplus
+}
+#endif
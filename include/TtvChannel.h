@@ -0,0 +1,161 @@
+/*
+ *  @file     TtvChannel.h
+ *  @brief    TTV channel class, frames packed ttv boxes over a file descriptor
+ *  such as a pipe or a unix domain socket, many small frames are coalesced
+ *  into one system call on both sides
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/TtvBox.h"
+#include "include/TtvView.h"
+#include "include/common.h"
+#include <stdint.h>
+#include <sys/uio.h>
+#include <vector>
+
+namespace ttv {
+
+/* the definition of the frames of channels */
+enum TtvChannelDefinition {
+  CHANNEL_FRAME_HEADER_BYTES = 8, // length (u32) | layout | flags | 2 reserved
+  CHANNEL_DEFAULT_BUFFER_BYTES = 65536, // the pending bytes flushed at once
+  CHANNEL_COPY_BYTES = 4096,      // larger buffers are sent without copying
+  CHANNEL_MAX_FRAME_BYTES = 1 << 28,    // larger frames are rejected
+  CHANNEL_FLAG_VARINT = 0x01,     // the frame contains varint types
+  CHANNEL_FLAGS_SUPPORTED = CHANNEL_FLAG_VARINT, // the flags known to readers
+};
+
+/*
+ * TTV channel class
+ * each frame is an 8-byte header, i.e. the big-endian length of the packed
+ * box, its layout, its flags and 2 zero bytes, followed by the packed box. a
+ * reader rejects the flags it doesn't know since they change the decoding
+ * the channel doesn't own the file descriptor, a blocking one is expected and
+ * a non-blocking one is waited by poll()
+ */
+class TTV_PUBLIC TtvChannel {
+public:
+  /*
+   * @brief construct a channel over a file descriptor
+   * @param fd           the file descriptor, e.g. one end of a socketpair
+   * @param bufferBytes  the pending bytes which trigger a flush, and the
+   * initial size of the receive buffer
+   * @return none
+   */
+  explicit TtvChannel(const int fd,
+                      const uint32_t bufferBytes = CHANNEL_DEFAULT_BUFFER_BYTES);
+
+  /*
+   * @brief destruct a channel, the pending frames are not flushed
+   * @param none
+   * @return none
+   */
+  ~TtvChannel() = default;
+
+  TtvChannel(const TtvChannel &) = delete;
+  TtvChannel &operator=(const TtvChannel &) = delete;
+
+  /*
+   * @brief get the file descriptor
+   * @param none
+   * @return the file descriptor
+   */
+  int getFd() const;
+
+  /*
+   * @brief pack a box into the send buffer, the pending frames are flushed
+   * once they exceed the buffer size
+   * @param box     the ttv box
+   * @return true if writing sucessfully, false otherwise
+   */
+  bool write(const TtvBox &box);
+
+  /*
+   * @brief frame a packed buffer, a small one is copied into the send buffer
+   * and a large one is sent right away together with the pending frames
+   * without copying it
+   * @param buffer      the pointer which points to the packed buffer
+   * @param buffersize  the size of the packed buffer
+   * @param layout      the layout of the packed buffer
+   * @param flags       the flags of the frame, CHANNEL_FLAG_VARINT if the
+   * buffer contains varint types, see TtvBox::hasVarint()
+   * @return true if writing sucessfully, false otherwise
+   */
+  bool write(const uint8_t *buffer, const uint32_t buffersize,
+             const uint8_t layout = LAYOUT_COMPACT, const uint8_t flags = 0);
+
+  /*
+   * @brief send all the pending frames
+   * @param none
+   * @return true if sending sucessfully, false otherwise
+   */
+  bool flush();
+
+  /*
+   * @brief get the number of bytes waiting to be sent
+   * @param none
+   * @return the number of pending bytes
+   */
+  uint32_t getPendingBytes() const;
+
+  /*
+   * @brief read the next frame in place without walking its records, e.g. to
+   * forward it or to index it later by a view only if it is needed. the
+   * frames already received are returned without a system call
+   * @param buffer      the packed box, valid until the next read()
+   * @param buffersize  the size of the packed box
+   * @param layout      the layout of the packed box
+   * @param flags       the flags of the frame, e.g. to forward it
+   * @return true if reading sucessfully, false at the end of the stream or if
+   * the stream is malformed, see isEof()
+   */
+  bool read(const uint8_t **buffer, uint32_t &buffersize, uint8_t &layout,
+            uint8_t &flags);
+
+  /*
+   * @brief read the next frame in place and index its records, the frames
+   * already received are returned without a system call. the view is valid
+   * until the next read()
+   * @param view    the view over the frame
+   * @return true if reading sucessfully, false at the end of the stream or if
+   * the stream is malformed, see isEof()
+   */
+  bool read(TtvView &view);
+
+  /*
+   * @brief read the next frame and unpack it into a box
+   * @param box     the ttv box, its layout is set to the one of the frame
+   * @return true if reading sucessfully, false otherwise
+   */
+  bool read(TtvBox &box);
+
+  /*
+   * @brief check whether the peer has closed the stream at a frame boundary
+   * @param none
+   * @return true if the stream ends, false otherwise
+   */
+  bool isEof() const;
+
+private:
+  uint8_t *reserve(const uint32_t bytes);
+  bool sendAll(struct iovec *iov, int count);
+  int parseFrame(uint32_t &length, uint8_t &layout, uint8_t &flags) const;
+  bool receive();
+
+private:
+  int mFd = -1;
+  // true if mFd is a socket, which is written by sendmsg() without SIGPIPE
+  bool mIsSocket = false;
+  bool mEof = false;
+  uint32_t mBufferBytes = 0;
+  // the pending frames, the first mSendBytes bytes of mSendBuffer
+  std::vector<uint8_t> mSendBuffer;
+  uint32_t mSendBytes = 0;
+  // the received bytes, the unread ones are [mRecvBegin, mRecvEnd)
+  std::vector<uint8_t> mRecvBuffer;
+  uint32_t mRecvBegin = 0;
+  uint32_t mRecvEnd = 0;
+};
+
+} // namespace ttv
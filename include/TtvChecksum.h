@@ -0,0 +1,37 @@
+/*
+ *  @file     TtvChecksum.h
+ *  @brief    CRC32C (Castagnoli) checksum of ttv payloads
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ttv {
+
+/*
+ * @brief compute the CRC32C checksum of a buffer incrementally, i.e.
+ * crc32c(crc32c(0, a, m), b, n) equals the checksum of a followed by b
+ * the SSE4.2 or ARMv8 crc instructions are used if the cpu supports them
+ * @param crc     the checksum of the preceding data, 0 for the first buffer
+ * @param data    the pointer which points to the data
+ * @param length  the length of the data
+ * @return the checksum of all the data so far
+ */
+TTV_PUBLIC uint32_t crc32c(const uint32_t crc, const void *data,
+                           const size_t length);
+
+/*
+ * @brief compute the CRC32C checksum of a buffer incrementally with the
+ * portable table-driven implementation, the result equals crc32c()
+ * @param crc     the checksum of the preceding data, 0 for the first buffer
+ * @param data    the pointer which points to the data
+ * @param length  the length of the data
+ * @return the checksum of all the data so far
+ */
+TTV_PUBLIC uint32_t crc32cSoftware(const uint32_t crc, const void *data,
+                                   const size_t length);
+
+} // namespace ttv
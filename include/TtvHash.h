@@ -0,0 +1,116 @@
+/*
+ *  @file     TtvHash.h
+ *  @brief    TTV hash, a fast non-cryptographic hash (XXH64) of byte streams
+ *  to key caches by the content of ttv boxes
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ttv {
+
+/* a 128-bit hash */
+struct TtvHash128 {
+  uint64_t low = 0;
+  uint64_t high = 0;
+
+  bool operator==(const TtvHash128 &other) const {
+    return (low == other.low) && (high == other.high);
+  }
+  bool operator!=(const TtvHash128 &other) const { return !(*this == other); }
+};
+
+/*
+ * TTV hasher class
+ * hashes a stream of bytes in pieces, the hash of the pieces equals the hash
+ * of the bytes concatenated, see hashBytes()
+ */
+class TTV_PUBLIC TtvHasher {
+public:
+  /*
+   * @brief construct a hasher
+   * @param seed    the seed of the hash
+   * @return none
+   */
+  explicit TtvHasher(const uint64_t seed = 0);
+
+  /*
+   * @brief hash more bytes
+   * @param data    the pointer which points to the bytes
+   * @param size    the number of bytes
+   * @return none
+   */
+  void update(const void *data, const size_t size);
+
+  /*
+   * @brief get the hash of the bytes so far, more bytes can be hashed after
+   * @param none
+   * @return the 64-bit hash
+   */
+  uint64_t digest() const;
+
+private:
+  // the four accumulators of the 32-byte stripes
+  uint64_t mLanes[4];
+  uint64_t mSeed = 0;
+  uint64_t mTotalBytes = 0;
+  // the bytes of a stripe not complete yet
+  uint8_t mStripe[32];
+  uint32_t mStripeBytes = 0;
+};
+
+/*
+ * TTV 128-bit hasher class
+ * hashes a stream of bytes by two XXH64 of different seeds in one pass, each
+ * word is loaded once for both, so the halves equal hashBytes() with the
+ * seeds
+ */
+class TTV_PUBLIC TtvHasher128 {
+public:
+  /*
+   * @brief construct a hasher
+   * @param lowSeed   the seed of the lower half
+   * @param highSeed  the seed of the upper half
+   * @return none
+   */
+  TtvHasher128(const uint64_t lowSeed, const uint64_t highSeed);
+
+  /*
+   * @brief hash more bytes
+   * @param data    the pointer which points to the bytes
+   * @param size    the number of bytes
+   * @return none
+   */
+  void update(const void *data, const size_t size);
+
+  /*
+   * @brief get the hash of the bytes so far, more bytes can be hashed after
+   * @param none
+   * @return the 128-bit hash
+   */
+  TtvHash128 digest() const;
+
+private:
+  // the four accumulators of the 32-byte stripes of each half
+  uint64_t mLanes[2][4];
+  uint64_t mSeeds[2];
+  uint64_t mTotalBytes = 0;
+  // the bytes of a stripe not complete yet
+  uint8_t mStripe[32];
+  uint32_t mStripeBytes = 0;
+};
+
+/*
+ * @brief hash a buffer in one call
+ * @param data    the pointer which points to the bytes
+ * @param size    the number of bytes
+ * @param seed    the seed of the hash
+ * @return the 64-bit hash, which equals XXH64 of the bytes
+ */
+TTV_PUBLIC uint64_t hashBytes(const void *data, const size_t size,
+                              const uint64_t seed = 0);
+
+} // namespace ttv
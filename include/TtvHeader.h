@@ -0,0 +1,97 @@
+/*
+ *  @file     TtvHeader.h
+ *  @brief    TTV header, the header written in front of a packed ttv box
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stdint.h>
+
+namespace ttv {
+
+/* the definition of the ttv header
+   a legacy header is the big-endian length of the payload (4 bytes)
+   an extended header (16 bytes) is stored in the following order:
+   magic (4 bytes) + version (1 byte) + header size (1 byte) + flags (2 bytes)
+   + length of the payload (4 bytes) + crc32c of the payload (4 bytes)
+   the version is bumped on incompatible changes only, new fields are appended
+   to the header and skipped by older readers through the header size, and a
+   reader rejects the flags it doesn't know since they change the decoding
+*/
+enum TtvHeaderDefinition {
+  LEGACY_HEADER_BYTES = 4,      // size of the legacy header
+  EXTENDED_HEADER_BYTES = 16,   // size of the extended header
+  HEADER_VERSION = 1,           // version of the extended header
+  HEADER_FLAG_CRC32C = 0x0001,  // the payload is protected by crc32c
+  HEADER_FLAG_ALIGNED = 0x0002, // the payload uses the aligned layout
+  HEADER_FLAG_VARINT = 0x0004,  // the payload contains varint types
+  HEADER_FLAG_STREAM = 0x0008,  // the payload is a stream of records of an
+                                // unknown length, see TtvStream.h
+  HEADER_FLAGS_SUPPORTED =      // the flags known to the box readers
+  HEADER_FLAG_CRC32C | HEADER_FLAG_ALIGNED | HEADER_FLAG_VARINT,
+};
+
+/* the first byte is above 0x7F so that the magic read as a legacy header
+   is a length larger than 2GB */
+static const uint8_t TTV_HEADER_MAGIC[4] = {0x89, 'T', 'T', 'V'};
+
+/* the fields of an extended header */
+struct TtvHeader {
+  /* the version of the header */
+  uint8_t version = HEADER_VERSION;
+
+  /* the size of the header, at least EXTENDED_HEADER_BYTES */
+  uint8_t headerBytes = EXTENDED_HEADER_BYTES;
+
+  /* the feature flags, see enum::TtvHeaderDefinition */
+  uint16_t flags = 0;
+
+  /* the length of the payload, i.e. the packed buffer */
+  uint32_t payloadBytes = 0;
+
+  /* the crc32c of the payload if HEADER_FLAG_CRC32C is set */
+  uint32_t checksum = 0;
+};
+
+/*
+ * @brief check whether a buffer starts with an extended header
+ * @param buffer  the pointer which points to at least 4 bytes
+ * @return true if the buffer starts with the header magic, false otherwise
+ */
+TTV_PUBLIC bool isExtendedHeader(const uint8_t *buffer);
+
+/*
+ * @brief encode an extended header
+ * @param header  the fields of the header
+ * @param buffer  the pointer which points to EXTENDED_HEADER_BYTES bytes
+ * @return none
+ */
+TTV_PUBLIC void encodeHeader(const TtvHeader &header, uint8_t *buffer);
+
+/*
+ * @brief decode an extended header, the fields after EXTENDED_HEADER_BYTES
+ * are not decoded and should be skipped with header.headerBytes
+ * @param buffer  the pointer which points to EXTENDED_HEADER_BYTES bytes
+ * @param header  the fields of the header
+ * @param supportedFlags  the flags known to the reader
+ * @return true if the header is valid and supported, false otherwise
+ */
+TTV_PUBLIC bool decodeHeader(const uint8_t *buffer, TtvHeader &header,
+                             const uint16_t supportedFlags =
+                                 HEADER_FLAGS_SUPPORTED);
+
+/*
+ * @brief locate the first ttv box with an extended header inside a larger
+ * buffer, e.g. a model file with an embedded ttv section
+ * @param buffer      the pointer which points to the buffer
+ * @param buffersize  the size of the buffer
+ * @param offset      the offset of the header if found
+ * @param header      the fields of the header if found
+ * @return true if a valid header whose payload fits in the buffer is found,
+ * false otherwise
+ */
+TTV_PUBLIC bool locateHeader(const uint8_t *buffer, const size_t buffersize,
+                             size_t &offset, TtvHeader &header);
+
+} // namespace ttv
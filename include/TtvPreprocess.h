@@ -0,0 +1,187 @@
+/*
+ *  @file     TtvPreprocess.h
+ *  @brief    TTV preprocessing, converts batches of images into the input of
+ *  a model as described by a preprocessing config box, see
+ *  demo/modelPreCfg.yaml
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/TtvBox.h"
+#include "include/common.h"
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ttv {
+
+class TtvThreadPool;
+
+/* the tags of the preprocessing config, see demo/modelPreCfg.txt */
+enum TtvPreprocessTag {
+  PREPROCESS_TAG_INPUT_CHANNEL = 1, // uint32, the number of channels
+  PREPROCESS_TAG_INPUT_H = 2,       // uint32, the height of the images
+  PREPROCESS_TAG_INPUT_W = 3,       // uint32, the width of the images
+  PREPROCESS_TAG_MEAN_TYPE = 4,     // uint32, see TtvMeanType
+  PREPROCESS_TAG_MEAN_VALUE_R = 5,  // float, the mean of the 1st channel
+  PREPROCESS_TAG_MEAN_VALUE_G = 6,  // float, the mean of the 2nd channel
+  PREPROCESS_TAG_MEAN_VALUE_B = 7,  // float, the mean of the 3rd channel
+  PREPROCESS_TAG_MEAN_MAP = 8,      // tensor, or string of a text file
+  PREPROCESS_TAG_SCALE_VALUE = 9,   // float, the scale factor
+};
+
+/* the types of the mean subtracted from the images */
+enum TtvMeanType {
+  MEAN_TYPE_NONE = 0,  // no mean
+  MEAN_TYPE_VALUE = 1, // a mean value per channel
+  MEAN_TYPE_MAP = 2,   // a mean per channel and pixel
+};
+
+/*
+ * TTV preprocessing plan class
+ * a plan decodes and checks a config once, then converts uint8 HWC images
+ * into float CHW tensors, output = (input - mean) * scale, in a single pass
+ * with the AVX2 or NEON instructions if the cpu supports them
+ */
+class TTV_PUBLIC TtvPreprocessPlan {
+public:
+  TtvPreprocessPlan() = default;
+
+  /*
+   * @brief decode a preprocessing config, the mean map is a float tensor of
+   * the shape channel x height x width, or the path of a text file of the
+   * same floats in the CHW order
+   * @param config  the config box, see TtvPreprocessTag
+   * @return true if the config is valid, false otherwise
+   */
+  bool build(const TtvBox &config);
+
+  /*
+   * @brief convert a batch of images
+   * @param images  the uint8 images in the HWC order, one after another
+   * @param batch   the number of images
+   * @param output  the float tensors in the CHW order, one after another
+   * @return true if converting sucessfully, false if the plan is not built
+   */
+  bool run(const uint8_t *images, const uint32_t batch, float *output) const;
+
+  /*
+   * @brief convert a batch of images, one image per task of a thread pool
+   * @param images  the uint8 images in the HWC order, one after another
+   * @param batch   the number of images
+   * @param output  the float tensors in the CHW order, one after another
+   * @param pool    the thread pool
+   * @return true if converting sucessfully, false if the plan is not built
+   */
+  bool run(const uint8_t *images, const uint32_t batch, float *output,
+           TtvThreadPool &pool) const;
+
+  /*
+   * @brief convert a batch of images with the portable implementation, the
+   * result equals run()
+   * @param images  the uint8 images in the HWC order, one after another
+   * @param batch   the number of images
+   * @param output  the float tensors in the CHW order, one after another
+   * @return true if converting sucessfully, false if the plan is not built
+   */
+  bool runScalar(const uint8_t *images, const uint32_t batch,
+                 float *output) const;
+
+  /*
+   * @brief get the shape of the images
+   * @param none
+   * @return the number of channels, the height or the width
+   */
+  uint32_t getChannels() const;
+  uint32_t getHeight() const;
+  uint32_t getWidth() const;
+
+  /*
+   * @brief get the type of the mean
+   * @param none
+   * @return the mean type, see TtvMeanType
+   */
+  uint32_t getMeanType() const;
+
+  /*
+   * @brief get the size of an image
+   * @param none
+   * @return the number of bytes of an input image
+   */
+  uint32_t getInputBytes() const;
+
+  /*
+   * @brief get the size of a converted image
+   * @param none
+   * @return the number of floats of an output tensor
+   */
+  uint32_t getOutputSize() const;
+
+private:
+  bool copyMeanMap(const TtvBox &config, const uint32_t channels);
+  bool loadMeanMap(const std::string &file, const size_t size);
+
+private:
+  uint32_t mChannels = 0;
+  uint32_t mHeight = 0;
+  uint32_t mWidth = 0;
+  uint32_t mMeanType = MEAN_TYPE_NONE;
+  float mScale = 1.0f;
+  // the mean of each channel, 0 without the mean values
+  std::vector<float> mMean;
+  // the means in the CHW order with MEAN_TYPE_MAP, empty otherwise
+  std::vector<float> mMeanMap;
+};
+
+/*
+ * TTV preprocessing cache class
+ * the plans are keyed by the hash of their config, see TtvBox::hash(), and
+ * the config of a plan is compared on a hit since two configs may share a
+ * hash, so a config is decoded and its mean map loaded once. a mean map
+ * given as a tensor is part of the config, a plan is not rebuilt when only
+ * the file of a mean map given by its path changes, clear() the cache in
+ * that case
+ */
+class TTV_PUBLIC TtvPreprocessCache {
+public:
+  TtvPreprocessCache() = default;
+
+  TtvPreprocessCache(const TtvPreprocessCache &) = delete;
+  TtvPreprocessCache &operator=(const TtvPreprocessCache &) = delete;
+
+  /*
+   * @brief get the plan of a config, building it on the first call
+   * @param config  the config box
+   * @return the plan, nullptr if the config is invalid
+   */
+  std::shared_ptr<const TtvPreprocessPlan> get(const TtvBox &config);
+
+  /*
+   * @brief get the number of plans in the cache
+   * @param none
+   * @return the number of plans
+   */
+  uint32_t size() const;
+
+  /*
+   * @brief remove all the plans, the plans still in use stay valid
+   * @param none
+   * @return none
+   */
+  void clear();
+
+private:
+  // a plan and the packed config in the compact layout it is built from
+  struct Entry {
+    std::vector<uint8_t> config;
+    std::shared_ptr<const TtvPreprocessPlan> plan;
+  };
+
+  mutable std::mutex mMutex;
+  std::unordered_map<uint64_t, Entry> mPlans;
+};
+
+} // namespace ttv
@@ -0,0 +1,153 @@
+/*
+ *  @file     TtvRecord.h
+ *  @brief    TTV record, the layout of a ttv object inside a packed ttv box
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stdint.h>
+
+namespace ttv {
+
+/* the definition of the layouts of packed buffers */
+enum TtvLayoutDefinition {
+  LAYOUT_COMPACT = 0,         // values are stored right after tag and type
+  LAYOUT_ALIGNED = 1,         // values are padded to their natural alignment
+  VALUE_ALIGNMENT = 8,        // alignment of the non basic values
+  LARGE_VALUE_BYTES = 64,     // non basic values of at least this length are
+  LARGE_VALUE_ALIGNMENT = 64, // aligned to the cache line
+};
+
+/* the type of the values stored from a T, START_TYPE if T isn't numberical */
+template <typename T> struct TtvNumbericalType {
+  static const uint8_t value = START_TYPE;
+};
+template <> struct TtvNumbericalType<bool> {
+  static const uint8_t value = BOOL_T;
+};
+template <> struct TtvNumbericalType<uint8_t> {
+  static const uint8_t value = UINT8_T;
+};
+template <> struct TtvNumbericalType<int8_t> {
+  static const uint8_t value = INT8_T;
+};
+template <> struct TtvNumbericalType<uint16_t> {
+  static const uint8_t value = UINT16_T;
+};
+template <> struct TtvNumbericalType<int16_t> {
+  static const uint8_t value = INT16_T;
+};
+template <> struct TtvNumbericalType<uint32_t> {
+  static const uint8_t value = UINT32_T;
+};
+template <> struct TtvNumbericalType<int32_t> {
+  static const uint8_t value = INT32_T;
+};
+template <> struct TtvNumbericalType<uint64_t> {
+  static const uint8_t value = UINT64_T;
+};
+template <> struct TtvNumbericalType<int64_t> {
+  static const uint8_t value = INT64_T;
+};
+template <> struct TtvNumbericalType<float> {
+  static const uint8_t value = FLOAT_T;
+};
+template <> struct TtvNumbericalType<double> {
+  static const uint8_t value = DOUBLE_T;
+};
+
+/* the location of a ttv object inside a packed buffer */
+struct TtvRecord {
+  /* the tag id of ttv object */
+  uint8_t tag = 0;
+
+  /* the type of ttv object */
+  uint8_t type = 0;
+
+  /* the length of the value of ttv object */
+  uint32_t length = 0;
+
+  /* the offset of the record, i.e. the offset of the tag */
+  uint32_t offset = 0;
+
+  /* the offset of the value of ttv object */
+  uint32_t valueOffset = 0;
+
+  /* the number of bytes of the whole record */
+  uint32_t size = 0;
+};
+
+/*
+ * @brief get the length of the value with a basic data type
+ * @param type    the type of ttv object
+ * @return the length of the value, 0 if the type is not a basic type
+ */
+TTV_PUBLIC uint32_t getBasicTypeSize(const uint8_t type);
+
+/*
+ * @brief get the alignment of the value of a ttv object in a packed buffer
+ * @param type    the type of ttv object
+ * @param length  the length of the value
+ * @param layout  the layout of the packed buffer, see TtvLayoutDefinition
+ * @return the alignment of the value, 1 for the compact layout
+ */
+TTV_PUBLIC uint32_t getValueAlignment(const uint8_t type, const uint32_t length,
+                                      const uint8_t layout);
+
+/*
+ * @brief compute the location of a ttv object to be stored at the given
+ * offset of a packed buffer
+ * @param offset  the offset of the record
+ * @param tag     tag id of ttv object
+ * @param type    the type of ttv object
+ * @param length  the length of the value
+ * @param layout  the layout of the packed buffer, see TtvLayoutDefinition
+ * @param record  the location of the record
+ * @return none
+ */
+TTV_PUBLIC void layoutRecord(const uint32_t offset, const uint8_t tag,
+                             const uint8_t type, const uint32_t length,
+                             const uint8_t layout, TtvRecord &record);
+
+/*
+ * @brief write the tag, the type and the length of a record located by
+ * layoutRecord() to a packed buffer, the padding bytes are zeroed and the
+ * value is left to the caller
+ * @param buffer  the pointer which points to the packed buffer
+ * @param record  the location of the record
+ * @param layout  the layout of the packed buffer, see TtvLayoutDefinition
+ * @return none
+ */
+TTV_PUBLIC void writeRecordHeader(uint8_t *buffer, const TtvRecord &record,
+                                  const uint8_t layout);
+
+/*
+ * @brief write a record located by layoutRecord() to a packed buffer, the
+ * padding bytes are zeroed
+ * @param buffer  the pointer which points to the packed buffer
+ * @param record  the location of the record
+ * @param value   the value of ttv object
+ * @param layout  the layout of the packed buffer, see TtvLayoutDefinition
+ * @return none
+ */
+TTV_PUBLIC void writeRecord(uint8_t *buffer, const TtvRecord &record,
+                            const void *value, const uint8_t layout);
+
+/*
+ * @brief read the record starting at the given offset of a packed buffer
+ * without copying the value, the records of unknown types above
+ * FIXED_TYPE_MAX are read as well so that they can be skipped
+ * @param buffer      the pointer which points to the packed buffer
+ * @param buffersize  the size of the packed buffer
+ * @param offset      the offset of the record
+ * @param record      the record read from the buffer
+ * @param layout      the layout of the packed buffer, see TtvLayoutDefinition
+ * @return true if a complete record is read, false if the size of the type is
+ * unknown or the record exceeds the buffer
+ */
+TTV_PUBLIC bool readRecord(const uint8_t *buffer, const uint32_t buffersize,
+                           const uint32_t offset, TtvRecord &record,
+                           const uint8_t layout = LAYOUT_COMPACT);
+
+} // namespace ttv
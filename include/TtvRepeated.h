@@ -0,0 +1,84 @@
+/*
+ *  @file     TtvRepeated.h
+ *  @brief    TTV repeated, the value of a ttv object with the type
+ *  REPEATED_TTV_T, i.e. a list of packed ttv boxes
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stdint.h>
+
+namespace ttv {
+
+/* the definition of the repeated value
+   a repeated value is stored in the following order:
+   count (4 bytes) + offsets (4 bytes for each of count + 1 offsets) +
+   elements, all numbers are big-endian. the element i is the packed buffer
+   of a ttv box, which starts at offsets[i] and ends at offsets[i + 1]
+   relative to the beginning of the value, so that any element is reached
+   without decoding the others
+*/
+enum TtvRepeatedDefinition {
+  REPEATED_COUNT_BYTES = 4,  // size of the count
+  REPEATED_OFFSET_BYTES = 4, // size of an offset
+};
+
+/* a list of packed ttv boxes which references the value inside a ttv box */
+struct TtvRepeatedView {
+  /* the number of elements */
+  uint32_t count = 0;
+
+  /* the pointer which points to the repeated value */
+  const uint8_t *value = nullptr;
+
+  /* the length of the repeated value */
+  uint32_t length = 0;
+};
+
+/*
+ * @brief get the length of a repeated value
+ * @param count    the number of elements
+ * @param lengths  the length of each element
+ * @return the length of the repeated value
+ */
+TTV_PUBLIC uint64_t getRepeatedBytes(const uint32_t count,
+                                     const uint32_t *lengths);
+
+/*
+ * @brief encode a repeated value
+ * @param count     the number of elements
+ * @param elements  the packed buffer of each element
+ * @param lengths   the length of each element
+ * @param buffer    the pointer which points to getRepeatedBytes() bytes
+ * @return none
+ */
+TTV_PUBLIC void encodeRepeated(const uint32_t count,
+                               const uint8_t *const *elements,
+                               const uint32_t *lengths, uint8_t *buffer);
+
+/*
+ * @brief decode a repeated value without copying the elements, the offsets
+ * are checked when the elements are accessed
+ * @param value   the pointer which points to the repeated value
+ * @param length  the length of the repeated value
+ * @param view    the list referencing the elements in value
+ * @return true if decoding sucessfully, false if the value is malformed
+ */
+TTV_PUBLIC bool decodeRepeated(const uint8_t *value, const uint32_t length,
+                               TtvRepeatedView &view);
+
+/*
+ * @brief get an element of a repeated value in O(1)
+ * @param view     the list referencing the elements
+ * @param index    the index of the element
+ * @param element  the pointer which points to the packed buffer of the element
+ * @param length   the length of the element
+ * @return true if getting sucessfully, false if the index is out of range or
+ * the offsets are malformed
+ */
+TTV_PUBLIC bool getRepeatedElement(const TtvRepeatedView &view,
+                                   const uint32_t index,
+                                   const uint8_t **element, uint32_t &length);
+
+} // namespace ttv
@@ -0,0 +1,199 @@
+/*
+ *  @file     TtvRing.h
+ *  @brief    TTV ring class, a lock-free ring of preallocated slots which
+ *  hands packed ttv boxes between threads without copying them twice
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/TtvBox.h"
+#include "include/TtvView.h"
+#include "include/common.h"
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+namespace ttv {
+
+/* the definition of the modes of rings */
+enum TtvRingDefinition {
+  RING_SPSC = 0,              // one producer thread and one consumer thread
+  RING_MPMC = 1,              // any number of producers and consumers
+  RING_CACHE_LINE_BYTES = 64, // the slots and the counters are aligned to it
+};
+
+/* a slot claimed from a ring, see TtvRing */
+struct TtvRingSlot {
+  /* the pointer which points to the packed buffer in the slot */
+  uint8_t *data = nullptr;
+
+  /* the size of the buffer in the slot */
+  uint32_t capacity = 0;
+
+  /* the length of the packed buffer, set by the producer */
+  uint32_t bytes = 0;
+
+  /* the layout of the packed buffer, set by the producer */
+  uint8_t layout = LAYOUT_COMPACT;
+
+  /* the position of the slot in the ring, used by publish() and release() */
+  uint64_t position = 0;
+};
+
+/*
+ * TTV ring class
+ * a producer claims an empty slot, packs a box into it and publishes it, a
+ * consumer takes a published slot, reads it in place and releases it:
+ *
+ *   TtvRingSlot slot;
+ *   if (ring.tryClaim(slot)) {
+ *     box.pack(slot.data, slot.capacity, slot.bytes);
+ *     ring.publish(slot);
+ *   }
+ *   if (ring.tryConsume(slot)) {
+ *     view.reset(slot.data, slot.bytes, slot.layout);
+ *     ...
+ *     ring.release(slot);
+ *   }
+ *
+ * with RING_SPSC each side holds at most one slot at a time, with RING_MPMC
+ * a thread may hold several slots and the slots are published and released
+ * in any order
+ */
+class TTV_PUBLIC TtvRing {
+public:
+  /*
+   * @brief construct a ring and preallocate all of its slots
+   * @param slots      the number of slots, rounded up to a power of two
+   * @param slotBytes  the size of the packed buffer a slot can hold
+   * @param mode       RING_SPSC or RING_MPMC
+   * @return none
+   */
+  TtvRing(const uint32_t slots, const uint32_t slotBytes,
+          const uint8_t mode = RING_SPSC);
+
+  /*
+   * @brief destruct a ring, the slots must not be in use
+   * @param none
+   * @return none
+   */
+  ~TtvRing();
+
+  TtvRing(const TtvRing &) = delete;
+  TtvRing &operator=(const TtvRing &) = delete;
+
+  /*
+   * @brief get the number of slots
+   * @param none
+   * @return the number of slots
+   */
+  uint32_t getSlotCount() const;
+
+  /*
+   * @brief get the size of the packed buffer a slot can hold
+   * @param none
+   * @return the size of the buffer in a slot
+   */
+  uint32_t getSlotBytes() const;
+
+  /*
+   * @brief get the mode of the ring
+   * @param none
+   * @return RING_SPSC or RING_MPMC
+   */
+  uint8_t getMode() const;
+
+  /*
+   * @brief claim an empty slot to write, called by producers
+   * @param slot    the slot claimed
+   * @return true if a slot is claimed, false if the ring is full
+   */
+  bool tryClaim(TtvRingSlot &slot);
+
+  /*
+   * @brief publish a claimed slot to the consumers
+   * @param slot    the slot claimed by tryClaim(), with bytes and layout set
+   * @return none
+   */
+  void publish(const TtvRingSlot &slot);
+
+  /*
+   * @brief take a published slot to read, called by consumers
+   * @param slot    the slot taken
+   * @return true if a slot is taken, false if the ring is empty
+   */
+  bool tryConsume(TtvRingSlot &slot);
+
+  /*
+   * @brief release a slot taken by tryConsume() so that it can be reused
+   * @param slot    the slot taken
+   * @return none
+   */
+  void release(const TtvRingSlot &slot);
+
+  /*
+   * @brief pack a box into an empty slot and publish it
+   * @param box     the ttv box
+   * @return true if pushing sucessfully, false if the ring is full or the
+   * packed box exceeds the slot
+   */
+  bool tryPush(const TtvBox &box);
+
+  /*
+   * @brief copy a packed buffer into an empty slot and publish it
+   * @param buffer      the pointer which points to the packed buffer
+   * @param buffersize  the size of the packed buffer
+   * @param layout      the layout of the packed buffer
+   * @return true if pushing sucessfully, false if the ring is full or the
+   * buffer exceeds the slot
+   */
+  bool tryPush(const uint8_t *buffer, const uint32_t buffersize,
+               const uint8_t layout = LAYOUT_COMPACT);
+
+  /*
+   * @brief take a published slot and view it in place, the slot must be
+   * released after reading the view
+   * @param view    the view over the slot
+   * @param slot    the slot taken
+   * @return true if popping sucessfully, false if the ring is empty or the
+   * slot is malformed, which is released then
+   */
+  bool tryPop(TtvView &view, TtvRingSlot &slot);
+
+  /*
+   * @brief take a published slot, unpack it into a box and release it
+   * @param box     the ttv box, its layout is set to the one of the slot
+   * @return true if popping sucessfully, false if the ring is empty or the
+   * slot is malformed
+   */
+  bool tryPop(TtvBox &box);
+
+private:
+  struct SlotHeader;
+
+  SlotHeader *getHeader(const uint64_t position) const;
+
+private:
+  // the producer counter, i.e. the position of the next slot to claim, and
+  // the last consumer counter seen by the producer of a RING_SPSC ring
+  std::atomic<uint64_t> mHead;
+  uint64_t mCachedTail = 0;
+  uint8_t mHeadPadding[RING_CACHE_LINE_BYTES - sizeof(std::atomic<uint64_t>) -
+                       sizeof(uint64_t)];
+  // the consumer counter, i.e. the position of the next slot to take, and the
+  // last producer counter seen by the consumer of a RING_SPSC ring
+  std::atomic<uint64_t> mTail;
+  uint64_t mCachedHead = 0;
+  uint8_t mTailPadding[RING_CACHE_LINE_BYTES - sizeof(std::atomic<uint64_t>) -
+                       sizeof(uint64_t)];
+  // the slots, each one is a cache line of header followed by the buffer
+  std::unique_ptr<uint8_t[]> mStorage;
+  uint8_t *mSlots = nullptr;
+  // the distance between two slots
+  uint32_t mStride = 0;
+  uint32_t mSlotBytes = 0;
+  uint32_t mMask = 0;
+  uint8_t mMode = RING_SPSC;
+};
+
+} // namespace ttv
@@ -0,0 +1,116 @@
+/*
+ *  @file     TtvSchema.h
+ *  @brief    TTV schema, the names of the tags of a ttv box
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ttv {
+
+/* the definition of the schema
+   the names can be embedded in a ttv box as a BYTES_T value with the tag
+   SCHEMA_TAG, which is stored in the following order:
+   magic (4 bytes) + for each name: tag (1 byte) + length of the name (1 byte)
+   + name
+   the boxes written before the schema may hold any value at SCHEMA_TAG, the
+   value is read as a schema only if it starts with the magic
+*/
+enum TtvSchemaDefinition {
+  SCHEMA_TAG = 0xFE,           // the tag of the embedded schema
+  SCHEMA_MAGIC_BYTES = 4,      // size of the magic
+  SCHEMA_MAX_NAME_BYTES = 255, // the maximum length of a name
+};
+
+/* the magic in front of the embedded names */
+static const uint8_t TTV_SCHEMA_MAGIC[SCHEMA_MAGIC_BYTES] = {0x89, 'T', 'N',
+                                                             'M'};
+
+/*
+ * @brief check whether a value of SCHEMA_TAG is an embedded schema
+ * @param type    the type of the value
+ * @param value   the pointer which points to the value
+ * @param length  the length of the value
+ * @return true if the value is a BYTES_T value starting with the magic,
+ * false otherwise
+ */
+TTV_PUBLIC bool isSchemaValue(const uint8_t type, const uint8_t *value,
+                              const uint32_t length);
+
+/* a table of the names of tags, the names are looked up by a perfect hash
+   built at runtime once the names are added, i.e. when a configuration file
+   is parsed or an embedded schema is decoded */
+class TTV_PUBLIC TtvSchema {
+public:
+  /*
+   * @brief add the name of a tag, call build() after adding all the names
+   * @param tag     tag id of ttv object
+   * @param name    the name of the tag, SCHEMA_MAX_NAME_BYTES at most
+   * @return true if adding sucessfully, false if the tag or the name has been
+   * added before, the tag is reserved or the name is too long
+   */
+  bool addName(const uint8_t tag, const std::string &name);
+
+  /*
+   * @brief build the perfect hash of the names, i.e. search a seed of the
+   * hash function which maps the names to distinct slots
+   * @param none
+   * @return true if building sucessfully, false otherwise
+   */
+  bool build();
+
+  /*
+   * @brief look up the tag of a name with a hash and a comparison
+   * @param name    the name of the tag
+   * @param length  the length of the name
+   * @param tag     tag id of ttv object
+   * @return true if the name is found, false otherwise
+   */
+  bool findTag(const char *name, const size_t length, uint8_t &tag) const;
+
+  /*
+   * @brief get the name of a tag
+   * @param tag     tag id of ttv object
+   * @return the name of the tag, nullptr if the tag has no name
+   */
+  const std::string *getName(const uint8_t tag) const;
+
+  /*
+   * @brief get the number of names
+   * @param none
+   * @return the number of names
+   */
+  uint32_t size() const;
+
+  /*
+   * @brief encode the names as the value of SCHEMA_TAG
+   * @param value   the encoded names
+   * @return none
+   */
+  void encode(std::vector<uint8_t> &value) const;
+
+  /*
+   * @brief decode the value of SCHEMA_TAG and build the perfect hash
+   * @param value   the pointer which points to the encoded names
+   * @param length  the length of the encoded names
+   * @return true if decoding sucessfully, false if the magic is missing or
+   * the value is malformed
+   */
+  bool decode(const uint8_t *value, const uint32_t length);
+
+private:
+  // the names and their tags in the order of adding
+  std::vector<std::string> mNames;
+  std::vector<uint8_t> mTags;
+  // the index of the name in each slot of the hash table, -1 if empty
+  std::vector<int16_t> mSlots;
+  // the seed of the hash function and the mask of the slot
+  uint64_t mSeed = 0;
+  uint32_t mMask = 0;
+};
+
+} // namespace ttv
@@ -0,0 +1,182 @@
+/*
+ *  @file     TtvShm.h
+ *  @brief    TTV shared memory, publishes a packed ttv box in a POSIX shared
+ *  memory segment so that the processes on the host read it in place
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/TtvBox.h"
+#include "include/TtvView.h"
+#include "include/common.h"
+#include <stdint.h>
+#include <string>
+
+namespace ttv {
+
+/* the definition of the shared memory segments */
+enum TtvShmDefinition {
+  SHM_MAGIC = 0x53565454,    // "TTVS" in little-endian
+  SHM_FORMAT_VERSION = 1,    // the layout of the segment
+  SHM_HEADER_BYTES = 256,    // the control block before the two buffers
+  SHM_BUFFER_ALIGNMENT = 64, // the buffers are aligned to the cache line
+  SHM_FLAG_VARINT = 0x01,    // a published box contains varint types
+  SHM_FLAGS_SUPPORTED = SHM_FLAG_VARINT, // the flags known to the readers
+};
+
+struct TtvShmControl;
+
+/* a consistent read of a shared memory segment, see TtvShmReader */
+struct TtvShmSnapshot {
+  /* the number of publications when the snapshot is taken */
+  uint64_t sequence = 0;
+
+  /* the version given by the publisher */
+  uint64_t version = 0;
+
+  /* the buffer read and its seqlock counter, used by validate() */
+  uint32_t buffer = 0;
+  uint64_t lock = 0;
+};
+
+/*
+ * TTV shared memory publisher class
+ * the segment holds two buffers, each one guarded by a seqlock: a box is
+ * packed into the buffer which is not read by the latest snapshot and then
+ * made current, so the readers retry only if two boxes are published during
+ * one read. a segment has a single publisher. the flags of the segment
+ * record the features used by any box published so far, a reader rejects the
+ * flags it doesn't know since they change the decoding
+ */
+class TTV_PUBLIC TtvShmPublisher {
+public:
+  TtvShmPublisher() = default;
+
+  /*
+   * @brief unmap the segment, the segment itself is kept for the readers
+   * @param none
+   * @return none
+   */
+  ~TtvShmPublisher();
+
+  TtvShmPublisher(const TtvShmPublisher &) = delete;
+  TtvShmPublisher &operator=(const TtvShmPublisher &) = delete;
+
+  /*
+   * @brief create or reuse a shared memory segment and map it, a segment
+   * reused after a publisher crashed inside a write is made writable again
+   * @param name      the name of the segment, e.g. "/ttv_model_cfg"
+   * @param capacity  the largest packed box to publish
+   * @return true if creating sucessfully, false otherwise
+   */
+  bool create(const std::string &name, const uint32_t capacity);
+
+  /*
+   * @brief pack a box into the segment and make it current
+   * @param box       the ttv box
+   * @param version   the version of the box, e.g. the version of the config
+   * @return true if publishing sucessfully, false if the box exceeds the
+   * capacity
+   */
+  bool publish(const TtvBox &box, const uint64_t version);
+
+  /*
+   * @brief copy a packed buffer into the segment and make it current
+   * @param buffer      the pointer which points to the packed buffer
+   * @param buffersize  the size of the packed buffer
+   * @param layout      the layout of the packed buffer
+   * @param version     the version of the box
+   * @return true if publishing sucessfully, false if the buffer exceeds the
+   * capacity. the buffer is walked once to flag its varints
+   */
+  bool publish(const uint8_t *buffer, const uint32_t buffersize,
+               const uint8_t layout, const uint64_t version);
+
+  /*
+   * @brief remove the name of a segment, the mapped segments stay valid
+   * @param name    the name of the segment
+   * @return true if removing sucessfully, false otherwise
+   */
+  static bool unlink(const std::string &name);
+
+private:
+  uint8_t *beginWrite(uint32_t &buffer);
+  void endWrite(const uint32_t buffer, const uint32_t bytes,
+                const uint8_t layout, const uint32_t flags,
+                const uint64_t version);
+
+private:
+  TtvShmControl *mControl = nullptr;
+  size_t mMappedBytes = 0;
+};
+
+/*
+ * TTV shared memory reader class
+ * reading a snapshot takes no system call:
+ *
+ *   TtvShmSnapshot snapshot;
+ *   do {
+ *     if (!reader.read(view, snapshot)) { ... }
+ *     ... read the values from the view ...
+ *   } while (!reader.validate(snapshot));
+ */
+class TTV_PUBLIC TtvShmReader {
+public:
+  TtvShmReader() = default;
+
+  /*
+   * @brief unmap the segment
+   * @param none
+   * @return none
+   */
+  ~TtvShmReader();
+
+  TtvShmReader(const TtvShmReader &) = delete;
+  TtvShmReader &operator=(const TtvShmReader &) = delete;
+
+  /*
+   * @brief map a segment created by a publisher read-only
+   * @param name    the name of the segment
+   * @return true if opening sucessfully, false if the segment doesn't exist,
+   * isn't initialized yet or uses the flags unknown to the reader
+   */
+  bool open(const std::string &name);
+
+  /*
+   * @brief get the number of publications, to poll for a new box cheaply
+   * @param none
+   * @return the number of publications, 0 if nothing is published
+   */
+  uint64_t getSequence() const;
+
+  /*
+   * @brief view the current box in place, the values read from the view are
+   * consistent only if validate() returns true afterwards
+   * @param view      the view over the current box
+   * @param snapshot  the snapshot to validate
+   * @return true if a box is viewed, false if nothing is published or the
+   * segment uses the flags unknown to the reader
+   */
+  bool read(TtvView &view, TtvShmSnapshot &snapshot) const;
+
+  /*
+   * @brief check that the buffer of a snapshot hasn't been overwritten
+   * @param snapshot  the snapshot taken by read()
+   * @return true if the values read since the snapshot are consistent
+   */
+  bool validate(const TtvShmSnapshot &snapshot) const;
+
+  /*
+   * @brief copy the current box out of the segment and unpack it
+   * @param box       the ttv box
+   * @param snapshot  the snapshot of the copy
+   * @return true if copying sucessfully, false if nothing is published
+   */
+  bool copy(TtvBox &box, TtvShmSnapshot &snapshot) const;
+
+private:
+  const TtvShmControl *mControl = nullptr;
+  size_t mMappedBytes = 0;
+};
+
+} // namespace ttv
@@ -0,0 +1,234 @@
+/*
+ *  @file     TtvStatic.h
+ *  @brief    TTV static box, encodes a packed ttv box at compile time for the
+ *  configs which never change after build, e.g. the default preprocessing
+ *  parameters, so that they are read by TtvView without any work at startup
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/TtvRecord.h"
+#include "include/TtvVarint.h"
+#include "include/common.h"
+#include <array>
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+namespace ttv {
+
+/*
+ * TTV static box class
+ * the records are encoded by constexpr functions and concatenated by pack()
+ * into a std::array in the compact layout, the same bytes TtvBox::pack()
+ * writes:
+ *
+ *   static constexpr auto kConfig = TtvStaticBox::pack(
+ *       TtvStaticBox::startEndTag(START_TAG, START_TYPE),
+ *       TtvStaticBox::numbericalValue<uint32_t>(1, 224),
+ *       TtvStaticBox::numbericalValue<float>(2, 0.017f),
+ *       TtvStaticBox::stringValue(8, "./mean.txt"),
+ *       TtvStaticBox::startEndTag(END_TAG, END_TYPE));
+ *
+ *   TtvView view;
+ *   view.reset(kConfig.data(), kConfig.size());
+ */
+class TTV_PUBLIC TtvStaticBox {
+public:
+  /*
+   * @brief encode the start or the end
+   * @param tag     START_TAG or END_TAG
+   * @param type    START_TYPE or END_TYPE
+   * @return the record
+   */
+  static constexpr std::array<uint8_t, 2> startEndTag(const uint8_t tag,
+                                                      const uint8_t type) {
+    return {{tag, type}};
+  }
+
+  /*
+   * @brief encode a numberical value, the type is the type of T, e.g.
+   * UINT32_T for uint32_t. -0.0 is encoded as 0.0 since the sign of a zero
+   * can't be read by a constant expression
+   * @param tag     tag id of ttv object
+   * @param value   the value of ttv object
+   * @return the record
+   */
+  template <typename T>
+  static constexpr std::array<uint8_t, 2 + sizeof(T)>
+  numbericalValue(const uint8_t tag, const T value) {
+    static_assert(START_TYPE != TtvNumbericalType<T>::value,
+                  "unsupported data type");
+    return makeRecord<sizeof(T)>(tag, TtvNumbericalType<T>::value,
+                                 encodeBits(value),
+                                 std::make_index_sequence<sizeof(T)>());
+  }
+
+  /*
+   * @brief encode a VARUINT_T value, the value is a template argument since
+   * it sets the length of the record
+   * @param tag     tag id of ttv object
+   * @return the record
+   */
+  template <uint64_t V>
+  static constexpr std::array<uint8_t, 2 + getVarintSize(V)>
+  varuintValue(const uint8_t tag) {
+    return makeVarintRecord<V>(tag, VARUINT_T,
+                               std::make_index_sequence<getVarintSize(V)>());
+  }
+
+  /*
+   * @brief encode a VARINT_T value
+   * @param tag     tag id of ttv object
+   * @return the record
+   */
+  template <int64_t V>
+  static constexpr std::array<uint8_t, 2 + getVarintSize(encodeZigzag(V))>
+  varintValue(const uint8_t tag) {
+    return makeVarintRecord<encodeZigzag(V)>(
+        tag, VARINT_T,
+        std::make_index_sequence<getVarintSize(encodeZigzag(V))>());
+  }
+
+  /*
+   * @brief encode a STRING_T value, the terminating null is not stored
+   * @param tag     tag id of ttv object
+   * @param value   the string literal
+   * @return the record
+   */
+  template <size_t N>
+  static constexpr std::array<uint8_t, 6 + N - 1>
+  stringValue(const uint8_t tag, const char (&value)[N]) {
+    return makeBytesRecord(tag, STRING_T, value,
+                           std::make_index_sequence<N - 1>());
+  }
+
+  /*
+   * @brief encode a BYTES_T value
+   * @param tag     tag id of ttv object
+   * @param value   the bytes
+   * @return the record
+   */
+  template <size_t N>
+  static constexpr std::array<uint8_t, 6 + N>
+  bytesValue(const uint8_t tag, const uint8_t (&value)[N]) {
+    return makeBytesRecord(tag, BYTES_T, value,
+                           std::make_index_sequence<N>());
+  }
+
+  /*
+   * @brief concatenate the records into a packed ttv box, the records must be
+   * in ascending order of tags like the ones packed by TtvBox
+   * @param records   the records
+   * @return the packed buffer
+   */
+  template <size_t N>
+  static constexpr std::array<uint8_t, N>
+  pack(const std::array<uint8_t, N> &record) {
+    return record;
+  }
+
+  template <size_t N1, size_t N2, size_t... Ns>
+  static constexpr auto pack(const std::array<uint8_t, N1> &first,
+                             const std::array<uint8_t, N2> &second,
+                             const std::array<uint8_t, Ns> &... records) {
+    return pack(concat(first, second, std::make_index_sequence<N1>(),
+                       std::make_index_sequence<N2>()),
+                records...);
+  }
+
+private:
+  template <typename T> static constexpr uint64_t encodeBits(const T value) {
+    return static_cast<uint64_t>(value);
+  }
+
+  static constexpr uint64_t encodeBits(const float value) {
+    return encodeFloatingBits(value);
+  }
+
+  static constexpr uint64_t encodeBits(const double value) {
+    return encodeFloatingBits(value);
+  }
+
+  // the IEEE 754 bits of a floating point value, computed by exact scaling by
+  // powers of two since the bits can't be copied in a constant expression
+  template <typename F>
+  static constexpr uint64_t encodeFloatingBits(const F value) {
+    const int mantissaBits = std::numeric_limits<F>::digits - 1;
+    const int bias = std::numeric_limits<F>::max_exponent - 1;
+    const uint64_t exponentMax = 2 * bias + 1;
+    const uint64_t sign = (value < 0) ? (1ULL << (sizeof(F) * 8 - 1)) : 0;
+    if (value != value) {
+      // the canonical quiet NaN, like TtvBox
+      return (exponentMax << mantissaBits) | (1ULL << (mantissaBits - 1));
+    }
+    F magnitude = (value < 0) ? -value : value;
+    if (magnitude > std::numeric_limits<F>::max()) {
+      return sign | (exponentMax << mantissaBits);
+    }
+    if (0 == magnitude) {
+      return 0;
+    }
+
+    int exponent = 0;
+    while (magnitude >= 2) {
+      magnitude /= 2;
+      exponent++;
+    }
+    while ((magnitude < 1) && (exponent > 1 - bias)) {
+      magnitude *= 2;
+      exponent--;
+    }
+    F scale = 1;
+    for (int ii = 0; ii < mantissaBits; ii++) {
+      scale *= 2;
+    }
+    if (magnitude < 1) {
+      // subnormal
+      return sign | static_cast<uint64_t>(magnitude * scale);
+    }
+    return sign | (static_cast<uint64_t>(exponent + bias) << mantissaBits) |
+           static_cast<uint64_t>((magnitude - 1) * scale);
+  }
+
+  template <size_t N, size_t... I>
+  static constexpr std::array<uint8_t, 2 + N>
+  makeRecord(const uint8_t tag, const uint8_t type, const uint64_t bits,
+             std::index_sequence<I...>) {
+    // big-endian
+    return {{tag, type, static_cast<uint8_t>(bits >> (8 * (N - 1 - I)))...}};
+  }
+
+  template <uint64_t V, size_t... I>
+  static constexpr std::array<uint8_t, 2 + sizeof...(I)>
+  makeVarintRecord(const uint8_t tag, const uint8_t type,
+                   std::index_sequence<I...>) {
+    return {{tag, type,
+             static_cast<uint8_t>(((V >> (7 * I)) & 0x7F) |
+                                  ((I + 1 < sizeof...(I)) ? 0x80 : 0))...}};
+  }
+
+  template <typename C, size_t... I>
+  static constexpr std::array<uint8_t, 6 + sizeof...(I)>
+  makeBytesRecord(const uint8_t tag, const uint8_t type, const C *value,
+                  std::index_sequence<I...>) {
+    // the big-endian length follows the type in the compact layout
+    return {{tag, type, static_cast<uint8_t>(sizeof...(I) >> 24),
+             static_cast<uint8_t>(sizeof...(I) >> 16),
+             static_cast<uint8_t>(sizeof...(I) >> 8),
+             static_cast<uint8_t>(sizeof...(I)),
+             static_cast<uint8_t>(value[I])...}};
+  }
+
+  template <size_t N1, size_t N2, size_t... I1, size_t... I2>
+  static constexpr std::array<uint8_t, N1 + N2>
+  concat(const std::array<uint8_t, N1> &first,
+         const std::array<uint8_t, N2> &second, std::index_sequence<I1...>,
+         std::index_sequence<I2...>) {
+    return {{first[I1]..., second[I2]...}};
+  }
+};
+
+} // namespace ttv
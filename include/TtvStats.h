@@ -0,0 +1,132 @@
+/*
+ *  @file     TtvStats.h
+ *  @brief    TTV stats, the runtime counters of ttv operations
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stdint.h>
+
+namespace ttv {
+
+/* the operations counted by the stats */
+enum TtvStatsOperation {
+  STATS_PACK = 0,      // TtvBox::pack()
+  STATS_UNPACK,        // TtvBox::unpack()
+  STATS_READ,          // TtvBox::read()
+  STATS_WRITE,         // TtvBox::write()
+  STATS_PARSE,         // TtvBox::parse()
+  STATS_OPERATION_MAX, // number of the operations
+};
+
+/* the bucket i of a latency histogram counts the calls which take
+   [2^i, 2^(i+1)) nanoseconds, the last bucket counts the slower calls too */
+enum TtvStatsDefinition {
+  STATS_HISTOGRAM_BUCKETS = 32,
+};
+
+/* the counters of an operation */
+struct TtvOperationStats {
+  /* the number of calls */
+  uint64_t calls = 0;
+
+  /* the number of bytes packed, unpacked, read or written */
+  uint64_t bytes = 0;
+
+  /* the number of ttv objects processed */
+  uint64_t fields = 0;
+
+  /* the number of heap allocations made by TTV during the calls */
+  uint64_t allocations = 0;
+
+  /* the cumulative time of the calls */
+  uint64_t nanoseconds = 0;
+
+  /* the latency histogram of the calls */
+  uint64_t histogram[STATS_HISTOGRAM_BUCKETS] = {};
+};
+
+/* a snapshot of the counters of all threads */
+struct TtvStats {
+  /* false if the stats are compiled out, the counters are zero then */
+  bool enabled = false;
+
+  /* the number of heap allocations made by TTV, including the ones outside
+     of the operations, e.g. when putting values */
+  uint64_t allocations = 0;
+
+  /* the counters of each operation, see TtvStatsOperation */
+  TtvOperationStats operations[STATS_OPERATION_MAX];
+};
+
+/*
+ * @brief take a snapshot of the counters, the counters of each thread are
+ * merged, including the threads which have exited
+ * @param none
+ * @return the counters since the last resetStats()
+ */
+TTV_PUBLIC TtvStats stats();
+
+/*
+ * @brief start counting from zero, the counters of the running threads are
+ * not modified so it's safe to call at any time
+ * @param none
+ * @return none
+ */
+TTV_PUBLIC void resetStats();
+
+/*
+ * @brief get the name of an operation
+ * @param operation  see TtvStatsOperation
+ * @return the name of the operation, "unknown" if it's out of range
+ */
+TTV_PUBLIC const char *getStatsOperationName(const uint8_t operation);
+
+#ifdef TTV_ENABLE_STATS
+
+/* count an operation from its construction to its destruction, the heap
+   allocations counted in between are attributed to the operation */
+class TTV_PUBLIC TtvStatsScope {
+public:
+  explicit TtvStatsScope(const uint8_t operation);
+  ~TtvStatsScope();
+
+  /*
+   * @brief count the bytes and the ttv objects processed by the operation
+   * @param bytes   number of bytes
+   * @param fields  number of ttv objects
+   * @return none
+   */
+  void add(const uint64_t bytes, const uint64_t fields);
+
+  TtvStatsScope(const TtvStatsScope &) = delete;
+  TtvStatsScope &operator=(const TtvStatsScope &) = delete;
+
+private:
+  uint8_t mOperation;
+  uint8_t mOuterOperation;
+  int64_t mStart;
+};
+
+/*
+ * @brief count a heap allocation made by TTV
+ * @param none
+ * @return none
+ */
+TTV_PUBLIC void countStatsAllocation();
+
+#define TTV_STATS_SCOPE(name, operation) ttv::TtvStatsScope name(operation)
+#define TTV_STATS_ADD(name, bytes, fields) name.add(bytes, fields)
+#define TTV_STATS_ALLOCATION() ttv::countStatsAllocation()
+
+#else
+
+// the stats are compiled out
+#define TTV_STATS_SCOPE(name, operation)
+#define TTV_STATS_ADD(name, bytes, fields)
+#define TTV_STATS_ALLOCATION()
+
+#endif
+
+} // namespace ttv
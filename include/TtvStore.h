@@ -0,0 +1,166 @@
+/*
+ *  @file     TtvStore.h
+ *  @brief    TTV store, an in-memory cache of packed ttv boxes keyed by
+ *  string, e.g. the configs of tens of thousands of models, bounded by a
+ *  memory budget
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/TtvBox.h"
+#include "include/TtvView.h"
+#include "include/common.h"
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+namespace ttv {
+
+/* the definition of the stores */
+enum TtvStoreDefinition {
+  STORE_DEFAULT_SHARDS = 16, // the number of shards by default
+  // the bookkeeping of an entry charged to the budget besides its key and
+  // its packed buffer, i.e. the nodes of the hash table and of the lru list
+  // and the control block of the buffer
+  STORE_ENTRY_OVERHEAD_BYTES = 128,
+};
+
+struct TtvStoreShard;
+
+/*
+ * TTV store view class
+ * a box read from a store, which keeps its packed buffer alive even if the
+ * box is evicted, replaced or removed from the store. a view reused for
+ * many gets keeps its index and doesn't allocate
+ */
+class TTV_PUBLIC TtvStoreView {
+public:
+  TtvStoreView() = default;
+
+  TtvStoreView(const TtvStoreView &) = delete;
+  TtvStoreView &operator=(const TtvStoreView &) = delete;
+
+  /*
+   * @brief get the view over the packed buffer
+   * @param none
+   * @return the view, valid until the next get() or clear()
+   */
+  const TtvView &getView() const;
+
+  /*
+   * @brief release the packed buffer
+   * @param none
+   * @return none
+   */
+  void clear();
+
+private:
+  friend class TtvStore;
+
+  std::shared_ptr<const uint8_t> mBuffer;
+  TtvView mView;
+};
+
+/*
+ * TTV store class
+ * the boxes are kept packed, a few hundred bytes for a config instead of the
+ * ttv objects and the heap allocations of a decoded TtvBox. the keys are
+ * spread over shards, each one with its own lock, hash table and lru list,
+ * and the least recently used boxes of a shard are evicted when the shard
+ * exceeds its share of the budget
+ */
+class TTV_PUBLIC TtvStore {
+public:
+  /*
+   * @brief create an empty store
+   * @param budget     the bytes of the boxes, keys and bookkeeping kept at
+   * most, see STORE_ENTRY_OVERHEAD_BYTES
+   * @param numShards  the number of shards, each one holding budget /
+   * numShards bytes at most
+   * @return none
+   */
+  explicit TtvStore(const uint64_t budget,
+                    const uint32_t numShards = STORE_DEFAULT_SHARDS);
+  ~TtvStore();
+
+  TtvStore(const TtvStore &) = delete;
+  TtvStore &operator=(const TtvStore &) = delete;
+
+  /*
+   * @brief pack a box into the store, replacing the box of the same key
+   * @param key     the key, e.g. the id of a model
+   * @param box     the ttv box
+   * @return true if putting sucessfully, false if the box exceeds the budget
+   * of a shard
+   */
+  bool put(const std::string &key, const TtvBox &box);
+
+  /*
+   * @brief copy a packed buffer into the store, replacing the box of the
+   * same key
+   * @param key         the key, e.g. the id of a model
+   * @param buffer      the pointer which points to the packed buffer
+   * @param buffersize  the size of the packed buffer
+   * @param layout      the layout of the packed buffer
+   * @return true if putting sucessfully, false if the buffer is malformed or
+   * exceeds the budget of a shard
+   */
+  bool put(const std::string &key, const uint8_t *buffer,
+           const uint32_t buffersize, const uint8_t layout = LAYOUT_COMPACT);
+
+  /*
+   * @brief read a box without copying it and mark it as recently used
+   * @param key     the key
+   * @param view    the view of the box
+   * @return true if the key is found, false otherwise and the view is cleared
+   */
+  bool get(const std::string &key, TtvStoreView &view);
+
+  /*
+   * @brief remove a box, the views of the box stay valid
+   * @param key     the key
+   * @return true if the key is found, false otherwise
+   */
+  bool remove(const std::string &key);
+
+  /*
+   * @brief remove all the boxes, the views of the boxes stay valid
+   * @param none
+   * @return none
+   */
+  void clear();
+
+  /*
+   * @brief get the number of boxes
+   * @param none
+   * @return the number of boxes
+   */
+  uint32_t getCount() const;
+
+  /*
+   * @brief get the bytes charged to the budget
+   * @param none
+   * @return the bytes of the boxes, keys and bookkeeping
+   */
+  uint64_t getBytes() const;
+
+  /*
+   * @brief get the number of boxes evicted to stay within the budget
+   * @param none
+   * @return the number of evictions
+   */
+  uint64_t getEvictions() const;
+
+private:
+  TtvStoreShard &getShard(const std::string &key) const;
+  bool insert(const std::string &key, std::shared_ptr<const uint8_t> buffer,
+              const uint32_t buffersize, const uint8_t layout,
+              const uint64_t bytes);
+
+private:
+  std::unique_ptr<TtvStoreShard[]> mShards;
+  uint32_t mNumShards;
+  uint64_t mShardBudget;
+};
+
+} // namespace ttv
@@ -0,0 +1,200 @@
+/*
+ *  @file     TtvStream.h
+ *  @brief    TTV stream, writes and reads a file of ttv records whose large
+ *  values are streamed in chunks, so that a value of any size, e.g. the
+ *  weights of a model, is never held in memory as a whole
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/TtvBox.h"
+#include "include/common.h"
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ttv {
+
+/* the definition of the ttv streams
+   a stream is an extended header with HEADER_FLAG_STREAM followed by records
+   in the compact layout up to the end of the file. a CHUNKED_T record is
+   tag + type + chunks, each chunk being its big-endian length (4 bytes) and
+   its bytes, and the chunk of length 0 ends the value, so the length of the
+   value is only limited by the 64-bit counters
+*/
+enum TtvStreamDefinition {
+  STREAM_CHUNK_HEADER_BYTES = 4, // the length in front of each chunk
+};
+
+/*
+ * TTV stream writer class
+ *
+ *   writer.open("model.ttv");
+ *   writer.write(box);              // the small values, packed as usual
+ *   writer.beginValue(20);          // a large value, chunk by chunk
+ *   while (...) { writer.writeChunk(data, size); }
+ *   writer.endValue();
+ *   writer.close();
+ */
+class TTV_PUBLIC TtvStreamWriter {
+public:
+  TtvStreamWriter() = default;
+
+  TtvStreamWriter(const TtvStreamWriter &) = delete;
+  TtvStreamWriter &operator=(const TtvStreamWriter &) = delete;
+
+  /*
+   * @brief create a stream file and write its header
+   * @param file    the name of the file
+   * @return true if opening sucessfully, false otherwise
+   */
+  bool open(const std::string &file);
+
+  /*
+   * @brief write the records of a box, a box with the aligned layout is
+   * rejected since its padding depends on its own offsets
+   * @param box     the ttv box with the compact layout
+   * @return true if writing sucessfully, false otherwise
+   */
+  bool write(const TtvBox &box);
+
+  /*
+   * @brief start a CHUNKED_T value
+   * @param tag     tag id of ttv object
+   * @return true if starting sucessfully, false if a value is not ended
+   */
+  bool beginValue(const uint8_t tag);
+
+  /*
+   * @brief append a chunk to the current value, the empty chunks are skipped
+   * @param data    the pointer which points to the bytes
+   * @param size    the number of bytes
+   * @return true if writing sucessfully, false otherwise
+   */
+  bool writeChunk(const void *data, const uint32_t size);
+
+  /*
+   * @brief end the current value
+   * @param none
+   * @return true if ending sucessfully, false otherwise
+   */
+  bool endValue();
+
+  /*
+   * @brief flush and close the file
+   * @param none
+   * @return true if closing sucessfully, false if a value is not ended or
+   * the file fails to be written
+   */
+  bool close();
+
+  /*
+   * @brief get the number of bytes written after the header
+   * @param none
+   * @return the number of bytes
+   */
+  uint64_t getBytes() const;
+
+  /*
+   * @brief get the number of bytes of the current or the last value
+   * @param none
+   * @return the number of bytes
+   */
+  uint64_t getValueBytes() const;
+
+private:
+  bool writeBytes(const void *data, const size_t size);
+
+private:
+  std::ofstream mFile;
+  // the records of the boxes packed before being written
+  std::vector<uint8_t> mBuffer;
+  uint64_t mBytes = 0;
+  uint64_t mValueBytes = 0;
+  bool mInValue = false;
+};
+
+/*
+ * TTV stream reader class
+ *
+ *   reader.open("model.ttv");
+ *   reader.read(box);               // the records up to the large value
+ *   reader.beginValue(tag);
+ *   do { reader.readChunk(buffer, capacity, bytes); ... } while (bytes > 0);
+ */
+class TTV_PUBLIC TtvStreamReader {
+public:
+  TtvStreamReader() = default;
+
+  TtvStreamReader(const TtvStreamReader &) = delete;
+  TtvStreamReader &operator=(const TtvStreamReader &) = delete;
+
+  /*
+   * @brief open a stream file and check its header
+   * @param file    the name of the file
+   * @return true if opening sucessfully, false otherwise
+   */
+  bool open(const std::string &file);
+
+  /*
+   * @brief read the records up to the end of a box, the next CHUNKED_T value
+   * or the end of the stream and unpack them into a box
+   * @param box     the ttv box, left with the compact layout
+   * @return true if reading sucessfully, false if the stream is malformed
+   */
+  bool read(TtvBox &box);
+
+  /*
+   * @brief start reading the next CHUNKED_T value
+   * @param tag     tag id of the value
+   * @return true if a value is started, false if the next record is not a
+   * CHUNKED_T value
+   */
+  bool beginValue(uint8_t &tag);
+
+  /*
+   * @brief read the next bytes of the current value, at most one chunk at a
+   * time
+   * @param buffer    the pointer which points to the buffer
+   * @param capacity  the size of the buffer
+   * @param bytes     the number of bytes read, 0 at the end of the value
+   * @return true if reading sucessfully, false if the stream is malformed
+   */
+  bool readChunk(void *buffer, const uint32_t capacity, uint32_t &bytes);
+
+  /*
+   * @brief check whether the whole stream has been read
+   * @param none
+   * @return true at the end of the stream, false otherwise
+   */
+  bool isEof();
+
+  /*
+   * @brief get the number of bytes read of the current or the last value
+   * @param none
+   * @return the number of bytes
+   */
+  uint64_t getValueBytes() const;
+
+private:
+  bool peekRecord();
+  bool readBytes(void *data, const size_t size);
+
+private:
+  std::ifstream mFile;
+  // the records read by read() before being unpacked
+  std::vector<uint8_t> mBuffer;
+  // the tag and the type of the next record if mPeeked is true
+  uint8_t mTag = 0;
+  uint8_t mType = 0;
+  bool mPeeked = false;
+  bool mInValue = false;
+  // true once the stream is found malformed
+  bool mFailed = false;
+  // the bytes of the current chunk not read yet
+  uint32_t mChunkBytes = 0;
+  uint64_t mValueBytes = 0;
+};
+
+} // namespace ttv
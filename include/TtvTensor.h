@@ -0,0 +1,80 @@
+/*
+ *  @file     TtvTensor.h
+ *  @brief    TTV tensor, the value of a ttv object with the type TENSOR_T
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stdint.h>
+
+namespace ttv {
+
+/* the definition of the tensor value
+   a tensor value is stored in the following order:
+   dtype (1 byte) + rank (1 byte) + reserved (6 bytes) + shape (4 bytes of
+   big-endian for each dimension) + padding up to TENSOR_HEADER_BYTES + data
+   the dtype is one of the basic types, and the data is stored densely in
+   row-major order and little-endian so that it can be used in place.
+   with the aligned layout the data is aligned to the cache line
+*/
+enum TtvTensorDefinition {
+  TENSOR_MAX_RANK = 8,      // the maximum number of dimensions
+  TENSOR_HEADER_BYTES = 64, // the size of the tensor header
+};
+
+/* a tensor which references the data inside a ttv box */
+struct TtvTensorView {
+  /* the type of elements, one of the basic types */
+  uint8_t dtype = 0;
+
+  /* the number of dimensions */
+  uint8_t rank = 0;
+
+  /* the size of each dimension */
+  uint32_t shape[TENSOR_MAX_RANK] = {0};
+
+  /* the pointer which points to the elements */
+  const void *data = nullptr;
+
+  /* the number of elements */
+  uint64_t numElements = 0;
+
+  /* the number of bytes of the elements */
+  uint64_t bytes = 0;
+};
+
+/*
+ * @brief get the length of a tensor value
+ * @param dtype   the type of elements, one of the basic types
+ * @param rank    the number of dimensions
+ * @param shape   the size of each dimension
+ * @return the length of the tensor value, 0 if the tensor is invalid
+ */
+TTV_PUBLIC uint64_t getTensorBytes(const uint8_t dtype, const uint8_t rank,
+                                   const uint32_t *shape);
+
+/*
+ * @brief encode a tensor value
+ * @param dtype   the type of elements, one of the basic types
+ * @param rank    the number of dimensions
+ * @param shape   the size of each dimension
+ * @param data    the elements in the host byte order
+ * @param buffer  the pointer which points to getTensorBytes() bytes
+ * @return none
+ */
+TTV_PUBLIC void encodeTensor(const uint8_t dtype, const uint8_t rank,
+                             const uint32_t *shape, const void *data,
+                             uint8_t *buffer);
+
+/*
+ * @brief decode a tensor value without copying the elements
+ * @param value   the pointer which points to the tensor value
+ * @param length  the length of the tensor value
+ * @param view    the tensor referencing the elements in value
+ * @return true if decoding sucessfully, false if the value is malformed
+ */
+TTV_PUBLIC bool decodeTensor(const uint8_t *value, const uint64_t length,
+                             TtvTensorView &view);
+
+} // namespace ttv
@@ -0,0 +1,86 @@
+/*
+ *  @file     TtvThreadPool.h
+ *  @brief    TTV thread pool, runs the pieces of a large job, e.g. packing a
+ *  box of hundreds of MB, on a fixed set of threads
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace ttv {
+
+/*
+ * TTV thread pool class
+ * run() hands out the indices of a job to the worker threads and the calling
+ * thread, which takes part as well, and returns when all of them are done.
+ * the jobs of concurrent callers are run one after another
+ */
+class TTV_PUBLIC TtvThreadPool {
+public:
+  /*
+   * @brief start the worker threads
+   * @param numThreads  the number of threads running a job including the
+   * calling thread, 0 for the number of cores
+   * @return none
+   */
+  explicit TtvThreadPool(const uint32_t numThreads = 0);
+
+  /*
+   * @brief stop and join the worker threads
+   * @param none
+   * @return none
+   */
+  ~TtvThreadPool();
+
+  TtvThreadPool(const TtvThreadPool &) = delete;
+  TtvThreadPool &operator=(const TtvThreadPool &) = delete;
+
+  /*
+   * @brief get the number of threads running a job
+   * @param none
+   * @return the number of worker threads plus the calling thread
+   */
+  uint32_t getNumThreads() const;
+
+  /*
+   * @brief run task(index) for every index in [0, count) and wait for them,
+   * the indices are run in no particular order
+   * @param count   the number of indices
+   * @param task    the task, called concurrently by the threads
+   * @return none
+   */
+  void run(const uint32_t count, const std::function<void(uint32_t)> &task);
+
+private:
+  void work();
+  void execute();
+
+private:
+  std::vector<std::thread> mWorkers;
+  // serializes the jobs of concurrent callers
+  std::mutex mRunMutex;
+  // guards the fields of the current job below
+  std::mutex mMutex;
+  std::condition_variable mWakeup;
+  std::condition_variable mDone;
+  // the current job, nullptr between the jobs
+  const std::function<void(uint32_t)> *mTask = nullptr;
+  uint32_t mCount = 0;
+  // the next index to run
+  std::atomic<uint32_t> mNext;
+  // incremented by each job so that the workers wake up once per job
+  uint64_t mGeneration = 0;
+  // the number of workers running the current job
+  uint32_t mActive = 0;
+  bool mStopping = false;
+};
+
+} // namespace ttv
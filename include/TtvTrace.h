@@ -0,0 +1,101 @@
+/*
+ *  @file     TtvTrace.h
+ *  @brief    TTV trace, the timeline of ttv operations in the Chrome trace
+ *  event format, which chrome://tracing and Perfetto display
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ttv {
+
+/* each thread keeps its latest TRACE_THREAD_EVENTS spans, the older ones
+   are overwritten */
+enum TtvTraceDefinition {
+  TRACE_THREAD_EVENTS = 4096,
+};
+
+/* a span of a thread */
+struct TtvTraceEvent {
+  /* the name of the span, e.g. "TtvBox::pack" */
+  const char *name = nullptr;
+
+  /* the id of the thread in the operating system */
+  uint32_t tid = 0;
+
+  /* the start of the span on std::chrono::steady_clock */
+  int64_t start = 0;
+
+  /* the duration of the span */
+  int64_t nanoseconds = 0;
+};
+
+/*
+ * @brief take a snapshot of the spans, the spans of each thread are merged,
+ * including the threads which have exited
+ * @param none
+ * @return the spans recorded since the last clearTrace(), in no particular
+ * order, none if the trace is compiled out
+ */
+TTV_PUBLIC std::vector<TtvTraceEvent> traceEvents();
+
+/*
+ * @brief export the spans as a Chrome trace, i.e. complete ("X") events
+ * whose timestamps are the microseconds of std::chrono::steady_clock
+ * @param none
+ * @return the json of the trace
+ */
+TTV_PUBLIC std::string exportTrace();
+
+/*
+ * @brief export the spans as a Chrome trace to a file
+ * @param file    the name of the file
+ * @return true if writing sucessfully, false otherwise
+ */
+TTV_PUBLIC bool exportTrace(const std::string &file);
+
+/*
+ * @brief drop the spans recorded so far, the buffers of the running threads
+ * are not modified so it's safe to call at any time
+ * @param none
+ * @return none
+ */
+TTV_PUBLIC void clearTrace();
+
+#ifdef TTV_ENABLE_TRACE
+
+/* record a span from its construction to its destruction into the buffer of
+   the calling thread, without a lock */
+class TTV_PUBLIC TtvTraceScope {
+public:
+  /*
+   * @brief start a span
+   * @param name    the name of the span, a string literal since only the
+   * pointer is kept
+   * @return none
+   */
+  explicit TtvTraceScope(const char *name);
+  ~TtvTraceScope();
+
+  TtvTraceScope(const TtvTraceScope &) = delete;
+  TtvTraceScope &operator=(const TtvTraceScope &) = delete;
+
+private:
+  const char *mName;
+  int64_t mStart;
+};
+
+#define TTV_TRACE_SCOPE(name) ttv::TtvTraceScope ttvTraceScope(name)
+
+#else
+
+// the trace is compiled out
+#define TTV_TRACE_SCOPE(name)
+
+#endif
+
+} // namespace ttv
@@ -0,0 +1,213 @@
+/*
+ *  @file     TtvVarint.h
+ *  @brief    TTV varint, the values of ttv objects with the types VARUINT_T
+ *  and VARINT_T
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/common.h"
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+namespace ttv {
+
+/* the definition of the varint values
+   an integer is stored as LEB128, i.e. 7 bits per byte from the least
+   significant bits and the most significant bit of a byte is set if more
+   bytes follow. a signed integer is zigzag encoded first so that small
+   negative values are short as well
+*/
+enum TtvVarintDefinition {
+  VARINT_MAX_BYTES = 10, // the maximum size of a 64-bit varint
+};
+
+/*
+ * @brief check whether a type stores its values as varints
+ * @param type    the type of ttv object
+ * @return true for VARUINT_T and VARINT_T, false otherwise
+ */
+inline bool isVarintType(const uint8_t type) {
+  return (VARUINT_T == type) || (VARINT_T == type);
+}
+
+/*
+ * @brief map a signed integer to an unsigned one, small magnitudes to small
+ * values: 0 -> 0, -1 -> 1, 1 -> 2, -2 -> 3 ...
+ * @param value   the signed integer
+ * @return the zigzag encoded integer
+ */
+constexpr uint64_t encodeZigzag(const int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+/*
+ * @brief the inverse of encodeZigzag()
+ * @param value   the zigzag encoded integer
+ * @return the signed integer
+ */
+constexpr int64_t decodeZigzag(const uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/*
+ * @brief get the size of the varint of an unsigned integer
+ * @param value   the unsigned integer
+ * @return the size of the varint, 1 to VARINT_MAX_BYTES
+ */
+constexpr uint32_t getVarintSize(const uint64_t value) {
+  // a single return so that the header stays valid C++11
+  return (value < 0x80) ? 1 : 1 + getVarintSize(value >> 7);
+}
+
+/*
+ * @brief encode an unsigned integer as a varint
+ * @param value   the unsigned integer
+ * @param buffer  the pointer which points to VARINT_MAX_BYTES bytes
+ * @return the size of the varint
+ */
+TTV_PUBLIC uint32_t encodeVarint(const uint64_t value, uint8_t *buffer);
+
+/*
+ * @brief decode a varint byte by byte, used by decodeVarint() for the
+ * varints longer than 8 bytes or near the end of the buffer
+ * @param buffer  the pointer which points to the varint
+ * @param size    the number of bytes which can be read from the buffer
+ * @param value   the unsigned integer
+ * @return the size of the varint, 0 if it is truncated or overlong
+ */
+TTV_PUBLIC uint32_t decodeVarintSlow(const uint8_t *buffer, const size_t size,
+                                     uint64_t &value);
+
+/*
+ * @brief decode a varint, the varints of one or two bytes are decoded
+ * directly and the ones up to 8 bytes without a loop if 8 bytes can be read
+ * from the buffer
+ * @param buffer  the pointer which points to the varint
+ * @param size    the number of bytes which can be read from the buffer
+ * @param value   the unsigned integer
+ * @return the size of the varint, 0 if it is truncated or overlong
+ */
+inline uint32_t decodeVarint(const uint8_t *buffer, const size_t size,
+                             uint64_t &value) {
+  // most counters and ids fit in one or two bytes, their size is known from
+  // a compare so that the next varint is found without waiting for the mask
+  if ((size > 0) && (buffer[0] < 0x80)) {
+    value = buffer[0];
+    return 1;
+  }
+  if ((size > 1) && (buffer[1] < 0x80)) {
+    value = (buffer[0] & 0x7F) | (static_cast<uint64_t>(buffer[1]) << 7);
+    return 2;
+  }
+  // the most significant bit of each byte, clear in the last byte
+  const uint64_t continuationBits = 0x8080808080808080ULL;
+  if (size < sizeof(uint64_t)) {
+    return decodeVarintSlow(buffer, size, value);
+  }
+  uint64_t word = 0;
+  ::memcpy(&word, buffer, sizeof(uint64_t));
+  word = le64toh(word);
+  const uint64_t stops = ~word & continuationBits;
+  if (0 == stops) {
+    return decodeVarintSlow(buffer, size, value);
+  }
+  // keep the bytes up to the first one without the continuation bit, then
+  // squeeze the 7-bit groups together: 8 x 7 -> 4 x 14 -> 2 x 28 -> 56 bits
+  uint64_t result = word & (stops ^ (stops - 1)) & ~continuationBits;
+  result = ((result & 0x7F007F007F007F00ULL) >> 1) |
+           (result & 0x007F007F007F007FULL);
+  result = ((result & 0x3FFF00003FFF0000ULL) >> 2) |
+           (result & 0x00003FFF00003FFFULL);
+  result = ((result & 0x0FFFFFFF00000000ULL) >> 4) |
+           (result & 0x000000000FFFFFFFULL);
+  value = result;
+  return (__builtin_ctzll(stops) >> 3) + 1;
+}
+
+/*
+ * @brief encode an integer as the value of a VARUINT_T or VARINT_T object
+ * @param type    VARUINT_T or VARINT_T
+ * @param value   the integer
+ * @param buffer  the pointer which points to VARINT_MAX_BYTES bytes
+ * @return the size of the varint, 0 if T is not an integer, a negative
+ * value is stored as VARUINT_T or a value above INT64_MAX as VARINT_T
+ */
+template <typename T>
+uint32_t encodeVarintValue(const uint8_t type, const T value,
+                           uint8_t *buffer) {
+  if (!std::is_integral<T>::value) {
+    return 0;
+  }
+  if (VARINT_T == type) {
+    // an unsigned value above INT64_MAX would be stored as a negative one
+    if (!std::is_signed<T>::value &&
+        (static_cast<uint64_t>(value) >
+         static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))) {
+      return 0;
+    }
+    return encodeVarint(encodeZigzag(static_cast<int64_t>(value)), buffer);
+  }
+  if (std::is_signed<T>::value && (static_cast<int64_t>(value) < 0)) {
+    return 0;
+  }
+  return encodeVarint(static_cast<uint64_t>(value), buffer);
+}
+
+/*
+ * @brief convert a decoded varint to the integer of a VARUINT_T or VARINT_T
+ * object
+ * @param type    VARUINT_T or VARINT_T
+ * @param bits    the decoded varint, zigzag encoded for VARINT_T
+ * @param value   the integer
+ * @return true if converting sucessfully, false if the integer doesn't fit in
+ * T
+ */
+template <typename T>
+bool convertVarintValue(const uint8_t type, const uint64_t bits, T &value) {
+  if (!std::is_integral<T>::value) {
+    return false;
+  }
+  if (VARINT_T == type) {
+    const int64_t number = decodeZigzag(bits);
+    const T result = static_cast<T>(number);
+    if ((static_cast<int64_t>(result) != number) ||
+        (!std::is_signed<T>::value && (number < 0))) {
+      return false;
+    }
+    value = result;
+    return true;
+  }
+  const T result = static_cast<T>(bits);
+  if ((static_cast<uint64_t>(result) != bits) ||
+      (std::is_signed<T>::value && (static_cast<int64_t>(result) < 0))) {
+    return false;
+  }
+  value = result;
+  return true;
+}
+
+/*
+ * @brief decode the value of a VARUINT_T or VARINT_T object
+ * @param type    VARUINT_T or VARINT_T
+ * @param buffer  the pointer which points to the varint
+ * @param size    the length of the value
+ * @param value   the integer
+ * @return true if decoding sucessfully, false if the varint is malformed or
+ * the integer doesn't fit in T
+ */
+template <typename T>
+bool decodeVarintValue(const uint8_t type, const uint8_t *buffer,
+                       const size_t size, T &value) {
+  uint64_t bits = 0;
+  if (decodeVarint(buffer, size, bits) != size) {
+    return false;
+  }
+  return convertVarintValue(type, bits, value);
+}
+
+} // namespace ttv
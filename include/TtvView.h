@@ -0,0 +1,238 @@
+/*
+ *  @file     TtvView.h
+ *  @brief    TTV view class, a read-only view over a packed ttv box which
+ *  reads the values in place without copying them
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+#pragma once
+
+#include "include/TtvRecord.h"
+#include "include/TtvVarint.h"
+#include "include/common.h"
+#include <array>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace ttv {
+
+/* TTV view class */
+class TTV_PUBLIC TtvView {
+public:
+  /*
+   * @brief construct an empty ttv view
+   * @param none
+   * @return none
+   */
+  TtvView();
+
+  /*
+   * @brief index the records of a packed buffer, the buffer is not copied
+   * and must outlive the view or the next reset()
+   * @param buffer      the pointer which points to the packed buffer
+   * @param buffersize  the size of the packed buffer
+   * @param layout      the layout of the packed buffer, see TtvLayoutDefinition
+   * @return true if the buffer is well formed, false otherwise and the view is
+   * left empty
+   */
+  bool reset(const uint8_t *buffer, const uint32_t buffersize,
+             const uint8_t layout = LAYOUT_COMPACT);
+
+  /*
+   * @brief detach the view from its buffer
+   * @param none
+   * @return none
+   */
+  void clear();
+
+  /*
+   * @brief get the packed buffer of the view
+   * @param none
+   * @return the pointer which points to the packed buffer
+   */
+  const uint8_t *getBuffer() const;
+
+  /*
+   * @brief get the size of the packed buffer of the view
+   * @param none
+   * @return the size of the packed buffer
+   */
+  uint32_t getSize() const;
+
+  /*
+   * @brief get the layout of the packed buffer of the view
+   * @param none
+   * @return LAYOUT_COMPACT or LAYOUT_ALIGNED
+   */
+  uint8_t getLayout() const;
+
+  /*
+   * @brief get the number of records including the start and the end
+   * @param none
+   * @return the number of records
+   */
+  uint32_t getCount() const;
+
+  /*
+   * @brief check whether a tag is present
+   * @param tag     tag id of ttv object
+   * @return true if the tag is present, false otherwise
+   */
+  bool hasTag(const uint8_t tag) const;
+
+  /*
+   * @brief get the type of a value
+   * @param tag     tag id of ttv object
+   * @param type    the type of ttv object
+   * @return true if the tag is found, false otherwise
+   */
+  bool getType(const uint8_t tag, uint8_t &type) const;
+
+  /*
+   * @brief borrow a value inside the packed buffer, the values with basic
+   * data types are big-endian
+   * @param tag     tag id of ttv object
+   * @param value   the pointer which points to the value
+   * @param length  the length of the value
+   * @return true if the tag is found, false otherwise
+   */
+  bool getPackedValue(const uint8_t tag, const uint8_t **value,
+                      uint32_t &length) const;
+
+  /*
+   * @brief get a value with a basic data type, T has to match the stored
+   * type as with TtvBox::getNumbericalValue(), a varint is converted to any
+   * integer type which holds its value
+   * @param tag     tag id of ttv object
+   * @param value   the value of ttv object in host order
+   * @return true if getting sucessfully, false if the tag is not found or the
+   * stored type mismatches T
+   */
+  template <typename T>
+  bool getNumbericalValue(const uint8_t tag, T &value) const;
+
+  /*
+   * @brief get a value with the type STRING_T or BYTES_T
+   * @param tag     tag id of ttv object
+   * @param value   the value of ttv object
+   * @return true if getting sucessfully, false otherwise
+   */
+  bool getStringValue(const uint8_t tag, std::string &value) const;
+
+private:
+  const TtvRecord *findRecord(const uint8_t tag) const;
+
+  template <typename U> static U loadBigEndian(const uint8_t *buffer);
+
+private:
+  // the packed buffer, not owned by the view
+  const uint8_t *mBuffer = nullptr;
+  // size of mBuffer
+  uint32_t mBufferSize = 0;
+  // layout of mBuffer, see TtvLayoutDefinition
+  uint8_t mLayout = LAYOUT_COMPACT;
+  // records of mBuffer in order, the capacity is kept for reuse
+  std::vector<TtvRecord> mRecords;
+  // position of each tag in mRecords, -1 if the tag is absent
+  std::array<int16_t, 256> mTagIndex;
+};
+
+template <typename U> U TtvView::loadBigEndian(const uint8_t *buffer) {
+  U value;
+  ::memcpy(&value, buffer, sizeof(U));
+  return value;
+}
+
+template <> inline uint16_t TtvView::loadBigEndian(const uint8_t *buffer) {
+  uint16_t value;
+  ::memcpy(&value, buffer, sizeof(uint16_t));
+  return ntohs(value);
+}
+
+template <> inline uint32_t TtvView::loadBigEndian(const uint8_t *buffer) {
+  uint32_t value;
+  ::memcpy(&value, buffer, sizeof(uint32_t));
+  return ntohl(value);
+}
+
+template <> inline uint64_t TtvView::loadBigEndian(const uint8_t *buffer) {
+  uint64_t value;
+  ::memcpy(&value, buffer, sizeof(uint64_t));
+  return be64toh(value);
+}
+
+template <> inline float TtvView::loadBigEndian(const uint8_t *buffer) {
+  float value;
+  ::memcpy(&value, buffer, sizeof(float));
+  return swapFloat(value);
+}
+
+template <> inline double TtvView::loadBigEndian(const uint8_t *buffer) {
+  double value;
+  ::memcpy(&value, buffer, sizeof(double));
+  return swapDouble(value);
+}
+
+template <typename T>
+bool TtvView::getNumbericalValue(const uint8_t tag, T &value) const {
+  const TtvRecord *record = findRecord(tag);
+  if (nullptr == record) {
+    TTV_LOGE("Error: tag = %d is not found.", tag);
+    return false;
+  }
+
+  // the values are not converted between the types, which could truncate
+  // them silently, except the varints which are range-checked below
+  const uint8_t type = TtvNumbericalType<typename std::decay<T>::type>::value;
+  if (!isVarintType(record->type) &&
+      ((START_TYPE == type) || (type != record->type))) {
+    TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
+    return false;
+  }
+
+  const uint8_t *src = mBuffer + record->valueOffset;
+  switch (record->type) {
+  case BOOL_T:
+  case UINT8_T:
+    value = static_cast<T>(src[0]);
+    return true;
+  case INT8_T:
+    value = static_cast<T>(static_cast<int8_t>(src[0]));
+    return true;
+  case UINT16_T:
+    value = static_cast<T>(loadBigEndian<uint16_t>(src));
+    return true;
+  case INT16_T:
+    value = static_cast<T>(static_cast<int16_t>(loadBigEndian<uint16_t>(src)));
+    return true;
+  case UINT32_T:
+    value = static_cast<T>(loadBigEndian<uint32_t>(src));
+    return true;
+  case INT32_T:
+    value = static_cast<T>(static_cast<int32_t>(loadBigEndian<uint32_t>(src)));
+    return true;
+  case UINT64_T:
+    value = static_cast<T>(loadBigEndian<uint64_t>(src));
+    return true;
+  case INT64_T:
+    value = static_cast<T>(static_cast<int64_t>(loadBigEndian<uint64_t>(src)));
+    return true;
+  case FLOAT_T:
+    value = static_cast<T>(loadBigEndian<float>(src));
+    return true;
+  case DOUBLE_T:
+    value = static_cast<T>(loadBigEndian<double>(src));
+    return true;
+  case VARUINT_T:
+  case VARINT_T:
+    if (decodeVarintValue(record->type, src, record->length, value)) {
+      return true;
+    }
+  // fall through
+  default:
+    TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
+    return false;
+  }
+}
+
+} // namespace ttv
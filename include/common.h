@@ -2,6 +2,8 @@
 
 #include <arpa/inet.h>
 #include <endian.h>
+#include <stdint.h>
+#include <stdio.h>
 
 /* universal logging interface, use different font colors to display different types of information */
 #define TTV_PRINT        printf
@@ -83,12 +85,19 @@ enum TlvTypeDefinition {
     INT64_T,                     // int64_t
     FLOAT_T,                     // float
     DOUBLE_T,                    // double
+    VARUINT_T,                   // unsigned integer as varint, see TtvVarint.h
+    VARINT_T,                    // signed integer as zigzag varint
     STRING_T         = 0x20,     // string
     BYTES_T,                     // char* str
     TTV_T,                       // ttv object
+    TENSOR_T,                    // tensor, see TtvTensor.h
+    REPEATED_TTV_T,              // list of ttv objects, see TtvRepeated.h
+    CHUNKED_T,                   // value streamed in chunks, in the streams of
+                                 // TtvStream.h only, never in a packed box
 
     BASIC_TYPE_MAX   = DOUBLE_T, // uplimit of the basic type
-    COMPLEX_TYPE_MAX = TTV_T,    // uplimit of the complex type
+    FIXED_TYPE_MAX   = 0x1F,     // uplimit of the types stored without a length
+    COMPLEX_TYPE_MAX = REPEATED_TTV_T, // uplimit of the complex type
 
     END_TYPE  = 0xFF,            // reserved, the definition of end type
     START_TAG = START_TYPE,      // the definition of start tag
@@ -4,7 +4,8 @@
  *  Author:   Simon (dewen.wu@gmail.com)
  */
 
-#include "include/ttv.h"
+#include "include/Ttv.h"
+#include "include/TtvStats.h"
 #include <string.h>
 
 namespace ttv {
@@ -20,10 +21,25 @@ Ttv::Ttv(const uint8_t tag, const uint8_t type, const Ttv &value)
   initialize(value.getValue(), (uint32_t)value.getLength());
 }
 
+void Ttv::assign(const uint8_t tag, const uint8_t type, const uint32_t length,
+                 const void *value) {
+  mTag = tag;
+  mType = type;
+  initialize(value, length);
+}
+
 void Ttv::initialize(const void *value, const uint32_t length) {
   mLength = length;
-  mValue.reset(new uint8_t[length]);
-  ::memcpy(mValue.get(), value, static_cast<size_t>(length));
+  // small values are kept inline and large ones reuse the heap buffer, so
+  // reassigning an ttv object of the same size never allocates
+  if ((length > sizeof(mInlineValue)) && (length > mCapacity)) {
+    mValue.reset(new uint8_t[length]);
+    mCapacity = length;
+    TTV_STATS_ALLOCATION();
+  }
+  if ((nullptr != value) && (length > 0)) {
+    ::memcpy(getValue(), value, static_cast<size_t>(length));
+  }
 }
 
 uint8_t Ttv::getTag() const { return mTag; }
@@ -32,6 +48,9 @@ uint8_t Ttv::getType() const { return mType; }
 
 uint32_t Ttv::getLength() const { return mLength; }
 
-uint8_t *Ttv::getValue() const { return mValue.get(); }
+uint8_t *Ttv::getValue() const {
+  return (mLength > sizeof(mInlineValue)) ? mValue.get()
+                                          : const_cast<uint8_t *>(mInlineValue);
+}
 
 } // namespace ttv
@@ -5,47 +5,650 @@
  */
 
 #include "include/TtvBox.h"
+#include "include/TtvChecksum.h"
+#include "include/TtvRecord.h"
+#include "include/TtvStats.h"
+#include "include/TtvThreadPool.h"
+#include "include/TtvTrace.h"
 #include "include/common.h"
 #include "string.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <utility>
 
 namespace ttv {
 
-TtvBox::TtvBox() : mPackedBuffer(nullptr), mPackedBytes(0) {}
+namespace {
+
+template <typename... Args> std::shared_ptr<Ttv> makeTtv(Args &&... args) {
+  TTV_STATS_ALLOCATION();
+  return std::make_shared<Ttv>(std::forward<Args>(args)...);
+}
+
+// the bytes copied by each task of a parallel pack, large enough to amortize
+// handing out a task and small enough to balance the threads
+const size_t kPackChunkBytes = 1 << 20;
+
+// a piece of a value copied by a parallel pack
+struct PackCopy {
+  uint8_t *dst;
+  const uint8_t *src;
+  size_t bytes;
+};
+
+// the largest header and padding of a record
+const uint64_t kRecordOverheadBytes =
+    sizeof(uint8_t) + sizeof(uint8_t) + sizeof(uint32_t) + LARGE_VALUE_ALIGNMENT;
+
+// check that a box still fits in the 32-bit lengths of a packed buffer, the
+// larger values are streamed by TtvStreamWriter
+bool fitsPackedBuffer(const uint32_t packedBytes, const uint32_t length) {
+  if (packedBytes + kRecordOverheadBytes + length >
+      std::numeric_limits<uint32_t>::max()) {
+    TTV_LOGE("Error: the ttv box would exceed 4GB, please stream the value "
+             "of %u bytes with TtvStreamWriter.",
+             length);
+    return false;
+  }
+  return true;
+}
+
+// the seed of the upper half of the 128-bit hash
+const uint64_t kHashHighSeed = 0x9E3779B97F4A7C15ULL;
+
+// get the canonical encoding of a value if the stored one differs from it,
+// e.g. a value written by another writer with an overlong varint or a NaN
+// with a payload
+bool getCanonicalValue(const uint8_t type, const uint8_t *value,
+                       const uint32_t length, uint8_t *buffer,
+                       uint32_t &canonicalLength) {
+  if (isVarintType(type)) {
+    // the shortest encoding of a value is the only one of its length
+    uint64_t bits = 0;
+    if (decodeVarint(value, length, bits) != length) {
+      return false;
+    }
+    canonicalLength = encodeVarint(bits, buffer);
+    return canonicalLength != length;
+  }
+  if ((FLOAT_T == type) && (sizeof(uint32_t) == length)) {
+    uint32_t bits = 0;
+    ::memcpy(&bits, value, sizeof(uint32_t));
+    bits = ntohl(bits);
+    const uint32_t nan = htonl(0x7FC00000u);
+    if (((bits & 0x7F800000u) == 0x7F800000u) && (bits & 0x007FFFFFu) &&
+        (0 != ::memcmp(value, &nan, sizeof(uint32_t)))) {
+      ::memcpy(buffer, &nan, sizeof(uint32_t));
+      canonicalLength = sizeof(uint32_t);
+      return true;
+    }
+  } else if ((DOUBLE_T == type) && (sizeof(uint64_t) == length)) {
+    uint64_t bits = 0;
+    ::memcpy(&bits, value, sizeof(uint64_t));
+    bits = be64toh(bits);
+    const uint64_t nan = htobe64(0x7FF8000000000000ULL);
+    if (((bits & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL) &&
+        (bits & 0x000FFFFFFFFFFFFFULL) &&
+        (0 != ::memcmp(value, &nan, sizeof(uint64_t)))) {
+      ::memcpy(buffer, &nan, sizeof(uint64_t));
+      canonicalLength = sizeof(uint64_t);
+      return true;
+    }
+  }
+  return false;
+}
+
+// the nesting of ttv boxes inspected at most, so that a crafted value cannot
+// exhaust the stack
+const uint32_t kMaxNestingDepth = 64;
+
+bool hasVarintRecord(const uint8_t *buffer, const uint32_t buffersize,
+                     const uint8_t layout, const uint32_t depth);
+
+// check whether a value is a varint or a box nested in it holds one
+bool hasVarintValue(const uint8_t type, const uint8_t *value,
+                    const uint32_t length, const uint32_t depth) {
+  if (isVarintType(type)) {
+    return true;
+  }
+  if (depth >= kMaxNestingDepth) {
+    return false;
+  }
+  if (TTV_T == type) {
+    return hasVarintRecord(value, length, LAYOUT_COMPACT, depth + 1);
+  }
+  TtvRepeatedView view;
+  if ((REPEATED_TTV_T != type) || !decodeRepeated(value, length, view)) {
+    return false;
+  }
+  for (uint32_t ii = 0; ii < view.count; ii++) {
+    const uint8_t *element = nullptr;
+    uint32_t elementLength = 0;
+    if (getRepeatedElement(view, ii, &element, elementLength) &&
+        hasVarintRecord(element, elementLength, LAYOUT_COMPACT, depth + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// check the records of a packed box, the nested boxes are packed in the
+// compact layout
+bool hasVarintRecord(const uint8_t *buffer, const uint32_t buffersize,
+                     const uint8_t layout, const uint32_t depth) {
+  bool found = false;
+  uint32_t offset = 0;
+  TtvRecord record;
+  while (readRecord(buffer, buffersize, offset, record, layout)) {
+    found = found || hasVarintValue(record.type, buffer + record.valueOffset,
+                                    record.length, depth);
+    offset += record.size;
+  }
+  return found && (offset == buffersize);
+}
+
+// write the header of a record of the compact layout, i.e. the tag, the type
+// and the length unless the type has a fixed size
+uint32_t encodeCanonicalHeader(const uint8_t tag, const uint8_t type,
+                               const uint32_t length, uint8_t *header) {
+  TtvRecord record;
+  layoutRecord(0, tag, type, length, LAYOUT_COMPACT, record);
+  header[0] = tag;
+  header[1] = type;
+  if (record.valueOffset > sizeof(uint8_t) + sizeof(uint8_t)) {
+    const uint32_t bigEndian = htonl(record.length);
+    ::memcpy(header + sizeof(uint8_t) + sizeof(uint8_t), &bigEndian,
+             sizeof(uint32_t));
+  }
+  return record.valueOffset;
+}
+
+// replace the NaNs with a payload among the little-endian elements of a
+// tensor by the single NaN, the elements are changed only if out isn't null
+template <typename T>
+bool canonicalizeNaNs(const uint8_t *data, const uint64_t numElements,
+                      const T exponent, const T mantissa, const T nan,
+                      uint8_t *out) {
+  bool changed = false;
+  for (uint64_t ii = 0; ii < numElements; ii++) {
+    T bits = 0;
+    ::memcpy(&bits, data + ii * sizeof(T), sizeof(T));
+    if (((bits & exponent) == exponent) && (bits & mantissa) && (bits != nan)) {
+      changed = true;
+      if (nullptr == out) {
+        return true;
+      }
+      ::memcpy(out + ii * sizeof(T), &nan, sizeof(T));
+    }
+  }
+  return changed;
+}
+
+bool canonicalizeRecords(const uint8_t *buffer, const uint32_t buffersize,
+                         const uint32_t depth, std::vector<uint8_t> *out);
+
+// get the canonical encoding of a value, i.e. the one of getCanonicalValue()
+// and the boxes nested in it in the compact layout, and the single NaN in
+// the tensors. it is appended to out unless out is null, and the return is
+// whether it differs from the stored value
+bool canonicalizeValue(const uint8_t type, const uint8_t *value,
+                       const uint32_t length, const uint32_t depth,
+                       std::vector<uint8_t> *out) {
+  if (type <= FIXED_TYPE_MAX) {
+    uint8_t canonical[VARINT_MAX_BYTES];
+    uint32_t canonicalLength = 0;
+    const bool changed =
+        getCanonicalValue(type, value, length, canonical, canonicalLength);
+    if (nullptr != out) {
+      const uint8_t *bytes = changed ? canonical : value;
+      out->insert(out->end(), bytes,
+                  bytes + (changed ? canonicalLength : length));
+    }
+    return changed;
+  }
+  if ((TTV_T == type) && (depth < kMaxNestingDepth)) {
+    return canonicalizeRecords(value, length, depth + 1, out);
+  }
+
+  TtvTensorView tensor;
+  if ((TENSOR_T == type) && decodeTensor(value, length, tensor) &&
+      ((FLOAT_T == tensor.dtype) || (DOUBLE_T == tensor.dtype))) {
+    const uint8_t *data = static_cast<const uint8_t *>(tensor.data);
+    uint8_t *dst = nullptr;
+    if (nullptr != out) {
+      out->insert(out->end(), value, value + length);
+      dst = out->data() + out->size() - tensor.bytes;
+    }
+    return (FLOAT_T == tensor.dtype)
+               ? canonicalizeNaNs<uint32_t>(data, tensor.numElements,
+                                            0x7F800000u, 0x007FFFFFu,
+                                            0x7FC00000u, dst)
+               : canonicalizeNaNs<uint64_t>(
+                     data, tensor.numElements, 0x7FF0000000000000ULL,
+                     0x000FFFFFFFFFFFFFULL, 0x7FF8000000000000ULL, dst);
+  }
+
+  TtvRepeatedView view;
+  bool changed = false;
+  if ((REPEATED_TTV_T == type) && (depth < kMaxNestingDepth) &&
+      decodeRepeated(value, length, view)) {
+    for (uint32_t ii = 0; !changed && (ii < view.count); ii++) {
+      const uint8_t *element = nullptr;
+      uint32_t elementLength = 0;
+      changed = getRepeatedElement(view, ii, &element, elementLength) &&
+                canonicalizeRecords(element, elementLength, depth + 1, nullptr);
+    }
+  }
+  if (!changed) {
+    if (nullptr != out) {
+      out->insert(out->end(), value, value + length);
+    }
+    return false;
+  }
+  if (nullptr != out) {
+    // the offsets follow the lengths of the canonical elements
+    std::vector<std::vector<uint8_t>> elements(view.count);
+    std::vector<const uint8_t *> pointers(view.count);
+    std::vector<uint32_t> lengths(view.count);
+    for (uint32_t ii = 0; ii < view.count; ii++) {
+      const uint8_t *element = nullptr;
+      uint32_t elementLength = 0;
+      getRepeatedElement(view, ii, &element, elementLength);
+      canonicalizeRecords(element, elementLength, depth + 1, &elements[ii]);
+      pointers[ii] = elements[ii].data();
+      lengths[ii] = static_cast<uint32_t>(elements[ii].size());
+    }
+    const size_t begin = out->size();
+    out->resize(begin + getRepeatedBytes(view.count, lengths.data()));
+    encodeRepeated(view.count, pointers.data(), lengths.data(),
+                   out->data() + begin);
+  }
+  return true;
+}
+
+// check whether a value may differ from its canonical encoding, see
+// canonicalizeValue(). the scalars are checked exactly while the tensors of
+// floating point and the nested boxes are assumed to, so that a put doesn't
+// scan them
+bool mayBeNonCanonical(const uint8_t type, const uint8_t *value,
+                       const uint32_t length) {
+  if (type <= FIXED_TYPE_MAX) {
+    uint8_t canonical[VARINT_MAX_BYTES];
+    uint32_t canonicalLength = 0;
+    return getCanonicalValue(type, value, length, canonical, canonicalLength);
+  }
+  if ((TTV_T == type) || (REPEATED_TTV_T == type)) {
+    return true;
+  }
+  TtvTensorView tensor;
+  return (TENSOR_T == type) && decodeTensor(value, length, tensor) &&
+         ((FLOAT_T == tensor.dtype) || (DOUBLE_T == tensor.dtype));
+}
+
+// get the canonical encoding of the records of a nested box, which is packed
+// in the compact layout, see canonicalizeValue(). a value which isn't a box
+// is kept as it is
+bool canonicalizeRecords(const uint8_t *buffer, const uint32_t buffersize,
+                         const uint32_t depth, std::vector<uint8_t> *out) {
+  bool changed = false;
+  uint32_t offset = 0;
+  TtvRecord record;
+  while (readRecord(buffer, buffersize, offset, record, LAYOUT_COMPACT)) {
+    changed = changed || canonicalizeValue(record.type,
+                                           buffer + record.valueOffset,
+                                           record.length, depth, nullptr);
+    offset += record.size;
+  }
+  if ((offset != buffersize) || !changed) {
+    if (nullptr != out) {
+      out->insert(out->end(), buffer, buffer + buffersize);
+    }
+    return false;
+  }
+  if (nullptr == out) {
+    return true;
+  }
+  uint8_t header[sizeof(uint8_t) + sizeof(uint8_t) + sizeof(uint32_t)];
+  std::vector<uint8_t> value;
+  offset = 0;
+  while (readRecord(buffer, buffersize, offset, record, LAYOUT_COMPACT)) {
+    value.clear();
+    canonicalizeValue(record.type, buffer + record.valueOffset, record.length,
+                      depth, &value);
+    const uint32_t headerBytes = encodeCanonicalHeader(
+        record.tag, record.type, static_cast<uint32_t>(value.size()), header);
+    out->insert(out->end(), header, header + headerBytes);
+    out->insert(out->end(), value.begin(), value.end());
+    offset += record.size;
+  }
+  return true;
+}
+
+// nested boxes are stored in the compact layout, which the getters unpack
+// them with, so a box of the aligned layout is packed again in that layout
+bool getCompactBox(const TtvBox &box, TtvBox &compact) {
+  compact.setLayout(box.getLayout());
+  if (!compact.unpack(box.getPackedBuffer(), box.getPackedBytes())) {
+    return false;
+  }
+  compact.setLayout(LAYOUT_COMPACT);
+  return compact.pack();
+}
+
+} // namespace
+
+TtvBox::TtvBox() : mPackedBuffer(nullptr), mPackedBytes(0) {
+  mTagIndex.fill(-1);
+}
 
 TtvBox::~TtvBox() { freeMem(); }
 
+TtvBox::TtvBox(TtvBox &&other) noexcept
+    : mTtvPool(std::move(other.mTtvPool)), mNumTtvs(other.mNumTtvs),
+      mTagIndex(other.mTagIndex), mPackedBuffer(std::move(other.mPackedBuffer)),
+      mValueOffsets(std::move(other.mValueOffsets)),
+      mSlots(std::move(other.mSlots)),
+      mPackedCapacity(other.mPackedCapacity), mPackedBytes(other.mPackedBytes),
+      mLayout(other.mLayout), mDirty(other.mDirty),
+      mHasVarint(other.mHasVarint), mNonCanonical(other.mNonCanonical),
+      mSchema(std::move(other.mSchema)),
+      mSchemaBytes(std::move(other.mSchemaBytes)) {
+  other.mTtvPool.clear();
+  other.mNumTtvs = 0;
+  other.mTagIndex.fill(-1);
+  other.mValueOffsets.clear();
+  other.mSlots.clear();
+  other.mPackedCapacity = 0;
+  other.mPackedBytes = 0;
+  other.mDirty = true;
+}
+
+TtvBox &TtvBox::operator=(TtvBox &&other) noexcept {
+  if (this != &other) {
+    mTtvPool = std::move(other.mTtvPool);
+    mNumTtvs = other.mNumTtvs;
+    mTagIndex = other.mTagIndex;
+    mPackedBuffer = std::move(other.mPackedBuffer);
+    mValueOffsets = std::move(other.mValueOffsets);
+    mSlots = std::move(other.mSlots);
+    mPackedCapacity = other.mPackedCapacity;
+    mPackedBytes = other.mPackedBytes;
+    mLayout = other.mLayout;
+    mDirty = other.mDirty;
+    mHasVarint = other.mHasVarint;
+    mNonCanonical = other.mNonCanonical;
+    mSchema = std::move(other.mSchema);
+    mSchemaBytes = std::move(other.mSchemaBytes);
+    other.mTtvPool.clear();
+    other.mNumTtvs = 0;
+    other.mTagIndex.fill(-1);
+    other.mValueOffsets.clear();
+    other.mSlots.clear();
+    other.mPackedCapacity = 0;
+    other.mPackedBytes = 0;
+    other.mDirty = true;
+  }
+  return *this;
+}
+
+TtvBox TtvBox::share() const {
+  TtvBox box;
+  // the ttv objects are not modified while they are shared, so the shared box
+  // can reference them directly instead of copying their values
+  box.mTtvPool.assign(mTtvPool.begin(), mTtvPool.begin() + mNumTtvs);
+  box.mNumTtvs = mNumTtvs;
+  box.mTagIndex = mTagIndex;
+  box.mPackedBuffer = mPackedBuffer;
+  box.mValueOffsets = mValueOffsets;
+  box.mSlots.assign(mSlots.begin(), mSlots.begin() + mNumTtvs);
+  box.mPackedCapacity = mPackedCapacity;
+  box.mPackedBytes = mPackedBytes;
+  box.mLayout = mLayout;
+  box.mDirty = mDirty;
+  box.mHasVarint = mHasVarint;
+  box.mNonCanonical = mNonCanonical;
+  box.mSchema = mSchema;
+  box.mSchemaBytes = mSchemaBytes;
+  return box;
+}
+
+void TtvBox::clear() {
+  freeMem();
+  mPackedBytes = 0;
+  mDirty = true;
+}
+
+void TtvBox::reserve(const uint32_t fields, const uint32_t bytes) {
+  mTtvPool.reserve(fields);
+  while (mTtvPool.size() < fields) {
+    mTtvPool.push_back(makeTtv(START_TAG, START_TYPE));
+  }
+  if (mValueOffsets.size() < fields) {
+    mValueOffsets.resize(fields);
+  }
+  if (mSlots.size() < fields) {
+    mSlots.resize(fields);
+  }
+
+  if (bytes > mPackedCapacity) {
+    std::shared_ptr<uint8_t> buffer = mPackedBuffer;
+    allocPackedBuffer(bytes);
+    if (buffer) {
+      ::memcpy(mPackedBuffer.get(), buffer.get(),
+               static_cast<size_t>(mPackedBytes));
+    }
+  }
+}
+
 void TtvBox::freeMem() {
-  for (auto &ttvmap : mTtvMap) {
-    delete ttvmap.second;
-    ttvmap.second = nullptr;
+  // keep the ttv objects in the pool so that they can be reused
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    mTagIndex[mTtvPool[ii]->getTag()] = -1;
+  }
+  mNumTtvs = 0;
+  mHasVarint = false;
+  mNonCanonical = false;
+}
+
+void TtvBox::allocPackedBuffer(const uint32_t bytes) {
+  // align the packed buffer to the cache line so that the values of the
+  // aligned layout are aligned in memory as well, the padding is added in
+  // size_t so that a length near 4 GB doesn't wrap around
+  std::shared_ptr<uint8_t> buffer(
+      new uint8_t[static_cast<size_t>(bytes) + LARGE_VALUE_ALIGNMENT],
+      std::default_delete<uint8_t[]>());
+  TTV_STATS_ALLOCATION();
+  const uintptr_t address = reinterpret_cast<uintptr_t>(buffer.get());
+  const uintptr_t padding =
+      (LARGE_VALUE_ALIGNMENT - address % LARGE_VALUE_ALIGNMENT) %
+      LARGE_VALUE_ALIGNMENT;
+  mPackedBuffer = std::shared_ptr<uint8_t>(buffer, buffer.get() + padding);
+  mPackedCapacity = bytes;
+}
+
+void TtvBox::setLayout(const uint8_t layout) {
+  if (layout != mLayout) {
+    mLayout = layout;
+    mDirty = true;
   }
+}
+
+uint8_t TtvBox::getLayout() const { return mLayout; }
+
+bool TtvBox::getPackedValue(const uint8_t tag, const uint8_t **value,
+                            uint32_t &length) const {
+  const int16_t index = mTagIndex[tag];
+  if (index < 0) {
+    TTV_LOGE("Error: tag = %d is not found.", tag);
+    return false;
+  }
+  if (mDirty || !mPackedBuffer) {
+    TTV_LOGE("Error: please pack the ttv box first.");
+    return false;
+  }
+  *value = mPackedBuffer.get() + mValueOffsets[index];
+  length = mTtvPool[index]->getLength();
+  return true;
+}
+
+void TtvBox::detachPackedBuffer() {
+  // the packed buffer is read only while it is shared with other boxes, so
+  // copy it before modifying
+  if (mPackedBuffer.use_count() > 1) {
+    std::shared_ptr<uint8_t> buffer = mPackedBuffer;
+    allocPackedBuffer(mPackedBytes);
+    ::memcpy(mPackedBuffer.get(), buffer.get(),
+             static_cast<size_t>(mPackedBytes));
+  }
+}
 
-  mTtvMap.clear();
+bool TtvBox::isDirty() const { return mDirty; }
+
+bool TtvBox::setValue(const uint8_t tag, const uint32_t length,
+                      const void *value) {
+  const int16_t index = mTagIndex[tag];
+  std::shared_ptr<Ttv> &ttv = mTtvPool[index];
+  const uint32_t oldLength = ttv->getLength();
+  if ((length > oldLength) &&
+      !fitsPackedBuffer(computePackedBytes() - oldLength, length)) {
+    return false;
+  }
+  if (ttv.use_count() > 1) {
+    // the ttv object is still referenced by a shared box
+    ttv = makeTtv(tag, ttv->getType(), length, value);
+  } else {
+    ttv->assign(tag, ttv->getType(), length, value);
+  }
+  mSlots[index] = decodeSlot(ttv->getType(), length, value);
+  mHasVarint = mHasVarint ||
+               hasVarintValue(ttv->getType(),
+                              static_cast<const uint8_t *>(value), length, 0);
+  mNonCanonical =
+      mNonCanonical ||
+      mayBeNonCanonical(ttv->getType(), static_cast<const uint8_t *>(value),
+                        length);
+
+  if (length != oldLength) {
+    // the packed buffer and its length stay as they are until the next pack
+    mDirty = true;
+  } else if (!mDirty && mPackedBuffer) {
+    // the layout doesn't change, patch the value in the packed buffer
+    detachPackedBuffer();
+    ::memcpy(mPackedBuffer.get() + mValueOffsets[index], value,
+             static_cast<size_t>(length));
+  }
+
+  return true;
+}
+
+bool TtvBox::setNonNumbericalValue(const uint8_t tag, const uint32_t length,
+                                   const void *value) {
+  const Ttv *ttv = findTtv(tag);
+  if (nullptr == ttv) {
+    TTV_LOGE("Error: tag = %d is not found.", tag);
+    return false;
+  }
+  if ((ttv->getType() <= FIXED_TYPE_MAX) ||
+      (ttv->getType() > COMPLEX_TYPE_MAX)) {
+    TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
+    return false;
+  }
+  return setValue(tag, length, value);
+}
+
+const Ttv *TtvBox::findTtv(const uint8_t tag) const {
+  const int16_t index = mTagIndex[tag];
+  return (index < 0) ? nullptr : mTtvPool[index].get();
 }
 
 bool TtvBox::putNonNumbericalValue(const uint8_t tag, const uint8_t type,
                                    const uint32_t length, const void *value) {
-  if ((type > BASIC_TYPE_MAX) && (type <= COMPLEX_TYPE_MAX)) {
-    putValue(new Ttv(tag, type, length, value));
-  } else {
-    TTV_LOGE("Error: unsupported data type.");
+  if ((type > FIXED_TYPE_MAX) && (type <= COMPLEX_TYPE_MAX)) {
+    return putValue(tag, type, length, value);
+  }
+  TTV_LOGE("Error: unsupported data type.");
+  return false;
+}
+
+bool TtvBox::putTensor(const uint8_t tag, const uint8_t dtype,
+                       const uint8_t rank, const uint32_t *shape,
+                       const void *data) {
+  const uint64_t length = getTensorBytes(dtype, rank, shape);
+  if ((0 == length) || (length > UINT32_MAX)) {
+    TTV_LOGE("Error: invalid tensor of tag %d.", tag);
+    return false;
+  }
+  std::unique_ptr<uint8_t[]> value(new uint8_t[length]);
+  encodeTensor(dtype, rank, shape, data, value.get());
+  return putValue(tag, TENSOR_T, static_cast<uint32_t>(length), value.get());
+}
+
+bool TtvBox::putRepeatedTtvValue(const uint8_t tag, const TtvBox *values,
+                                 const uint32_t count) {
+  std::vector<const uint8_t *> elements(count);
+  std::vector<uint32_t> lengths(count);
+  std::vector<TtvBox> compacts;
+  for (uint32_t ii = 0; ii < count; ii++) {
+    if (values[ii].isDirty() || (nullptr == values[ii].getPackedBuffer())) {
+      TTV_LOGE("Error: please pack the ttv box %d of tag %d first.", ii, tag);
+      return false;
+    }
+    const TtvBox *element = &values[ii];
+    if (LAYOUT_COMPACT != element->getLayout()) {
+      compacts.reserve(count);
+      compacts.emplace_back();
+      if (!getCompactBox(*element, compacts.back())) {
+        return false;
+      }
+      element = &compacts.back();
+    }
+    elements[ii] = element->getPackedBuffer();
+    lengths[ii] = element->getPackedBytes();
+  }
+  const uint64_t length = getRepeatedBytes(count, lengths.data());
+  if (length > UINT32_MAX) {
+    TTV_LOGE("Error: the list of tag %d is too large.", tag);
+    return false;
+  }
+  std::unique_ptr<uint8_t[]> value(new uint8_t[length]);
+  encodeRepeated(count, elements.data(), lengths.data(), value.get());
+  return putValue(tag, REPEATED_TTV_T, static_cast<uint32_t>(length),
+                  value.get());
+}
+
+bool TtvBox::getTensorView(const uint8_t tag, TtvTensorView &view) const {
+  const int16_t index = mTagIndex[tag];
+  if (index < 0) {
+    TTV_LOGE("Error: tag = %d is not found.", tag);
+    return false;
+  }
+  const Ttv *ttv = mTtvPool[index].get();
+  if (TENSOR_T != ttv->getType()) {
+    TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
+    return false;
+  }
+  const uint8_t *value = (!mDirty && mPackedBuffer)
+                             ? mPackedBuffer.get() + mValueOffsets[index]
+                             : ttv->getValue();
+  if (!decodeTensor(value, ttv->getLength(), view)) {
+    TTV_LOGE("Error: the tensor of tag %d is malformed.", tag);
     return false;
   }
   return true;
 }
 
 bool TtvBox::getStringValue(const uint8_t tag, std::string &value) const {
-  auto iter = mTtvMap.find(tag);
-  if (iter != mTtvMap.end()) {
-    if (STRING_T != iter->second->getType()) {
+  const Ttv *ttv = findTtv(tag);
+  if (nullptr != ttv) {
+    if (STRING_T != ttv->getType()) {
       TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
       return false;
     }
-    value = std::string(reinterpret_cast<char *>(iter->second->getValue()),
-                        iter->second->getLength());
+    value = std::string(reinterpret_cast<char *>(ttv->getValue()),
+                        ttv->getLength());
   } else {
     TTV_LOGE("Error: tag = %d is not found.", tag);
     return false;
@@ -54,13 +657,13 @@ bool TtvBox::getStringValue(const uint8_t tag, std::string &value) const {
 }
 
 bool TtvBox::getBytesValue(const uint8_t tag, char **value) const {
-  auto iter = mTtvMap.find(tag);
-  if (iter != mTtvMap.end()) {
-    if (BYTES_T != iter->second->getType()) {
+  const Ttv *ttv = findTtv(tag);
+  if (nullptr != ttv) {
+    if (BYTES_T != ttv->getType()) {
       TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
       return false;
     }
-    *value = reinterpret_cast<char *>(iter->second->getValue());
+    *value = reinterpret_cast<char *>(ttv->getValue());
   } else {
     TTV_LOGE("Error: tag = %d is not found.", tag);
     return false;
@@ -69,49 +672,209 @@ bool TtvBox::getBytesValue(const uint8_t tag, char **value) const {
 }
 
 bool TtvBox::pack() {
-  if (mPackedBuffer) {
-    mPackedBuffer.reset();
-    freeMem();
+  if (!mDirty && mPackedBuffer) {
+    return true;
   }
+  TTV_STATS_SCOPE(stats, STATS_PACK);
+  TTV_TRACE_SCOPE("TtvBox::pack");
+  layoutPackedBuffer();
 
   uint32_t offset = 0;
-  mPackedBuffer.reset(new uint8_t[mPackedBytes]);
-
-  auto iter = mTtvMap.begin();
-  for (; iter != mTtvMap.end(); iter++) {
-    uint8_t tag = (uint8_t)iter->second->getTag();
-    ::memcpy(mPackedBuffer.get() + offset, &tag, sizeof(uint8_t));
-    offset += sizeof(uint8_t);
-
-    uint8_t type = iter->second->getType();
-    ::memcpy(mPackedBuffer.get() + offset, &type, sizeof(uint8_t));
-    offset += sizeof(uint8_t);
-
-    // the tag and type of start and end is to indicate the start and the end to
-    // store data for the start and the end, store the tag and type only.
-    if (!(((START_TAG == tag) && (START_TYPE == type)) ||
-          ((END_TAG == tag) && (END_TYPE == type)))) {
-      uint32_t length = iter->second->getLength();
-
-      // for basice types like char, int, float, the storage format is tag +
-      // type + value for other non-basice types like string, char *, class,
-      // structure, the storage format is tag + type + length + value
-      if (type > BASIC_TYPE_MAX) {
-        uint32_t newlength = htonl(length);
-        ::memcpy(mPackedBuffer.get() + offset, &newlength, sizeof(uint32_t));
-        offset += sizeof(uint32_t);
+  TtvRecord record;
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    const Ttv *ttv = mTtvPool[ii].get();
+    layoutRecord(offset, ttv->getTag(), ttv->getType(), ttv->getLength(),
+                 mLayout, record);
+    writeRecord(mPackedBuffer.get(), record, ttv->getValue(), mLayout);
+    offset += record.size;
+  }
+
+  mDirty = false;
+  TTV_STATS_ADD(stats, mPackedBytes, mNumTtvs);
+  return true;
+}
+
+bool TtvBox::pack(TtvThreadPool &pool) {
+  if (!mDirty && mPackedBuffer) {
+    return true;
+  }
+  if ((pool.getNumThreads() <= 1) ||
+      (computePackedBytes() < 2 * kPackChunkBytes)) {
+    return pack();
+  }
+  TTV_STATS_SCOPE(stats, STATS_PACK);
+  TTV_TRACE_SCOPE("TtvBox::pack");
+  layoutPackedBuffer();
+
+  // the headers are a few bytes each and written here, the values are cut
+  // into tasks of kPackChunkBytes, a large value spans several tasks and a
+  // task holds many small values
+  std::vector<PackCopy> copies;
+  std::vector<uint32_t> tasks(1, 0);
+  size_t taskBytes = 0;
+  uint32_t offset = 0;
+  TtvRecord record;
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    const Ttv *ttv = mTtvPool[ii].get();
+    layoutRecord(offset, ttv->getTag(), ttv->getType(), ttv->getLength(),
+                 mLayout, record);
+    writeRecordHeader(mPackedBuffer.get(), record, mLayout);
+    PackCopy copy = {mPackedBuffer.get() + record.valueOffset,
+                     ttv->getValue(), record.length};
+    while (copy.bytes > 0) {
+      const size_t bytes = std::min(copy.bytes, kPackChunkBytes - taskBytes);
+      copies.push_back({copy.dst, copy.src, bytes});
+      copy.dst += bytes;
+      copy.src += bytes;
+      copy.bytes -= bytes;
+      taskBytes += bytes;
+      if (kPackChunkBytes == taskBytes) {
+        tasks.push_back(static_cast<uint32_t>(copies.size()));
+        taskBytes = 0;
       }
+    }
+    offset += record.size;
+  }
+  if (tasks.back() != copies.size()) {
+    tasks.push_back(static_cast<uint32_t>(copies.size()));
+  }
 
-      ::memcpy(mPackedBuffer.get() + offset, iter->second->getValue(),
-               static_cast<size_t>(length));
-      offset += length;
+  pool.run(static_cast<uint32_t>(tasks.size() - 1), [&](const uint32_t task) {
+    for (uint32_t ii = tasks[task]; ii < tasks[task + 1]; ii++) {
+      ::memcpy(copies[ii].dst, copies[ii].src, copies[ii].bytes);
     }
+  });
+
+  mDirty = false;
+  TTV_STATS_ADD(stats, mPackedBytes, mNumTtvs);
+  return true;
+}
+
+void TtvBox::layoutPackedBuffer() {
+  if (mValueOffsets.size() < mNumTtvs) {
+    mValueOffsets.resize(mTtvPool.size());
   }
 
+  // locate the records first, the offset of each record is the sum of the
+  // sizes before it and the padding of the aligned layout depends on it
+  uint32_t offset = 0;
+  TtvRecord record;
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    const Ttv *ttv = mTtvPool[ii].get();
+    layoutRecord(offset, ttv->getTag(), ttv->getType(), ttv->getLength(),
+                 mLayout, record);
+    mValueOffsets[ii] = record.valueOffset;
+    offset += record.size;
+  }
+  mPackedBytes = offset;
+
+  // reuse the packed buffer unless it is too small or shared with other boxes
+  if ((mPackedBytes > mPackedCapacity) || (mPackedBuffer.use_count() > 1)) {
+    allocPackedBuffer(mPackedBytes);
+  }
+}
+
+bool TtvBox::pack(uint8_t *buffer, const uint32_t capacity,
+                  uint32_t &bytes) const {
+  TTV_STATS_SCOPE(stats, STATS_PACK);
+  TTV_TRACE_SCOPE("TtvBox::pack");
+  // a box packed already is copied as it is, e.g. a message sent many times
+  if (!mDirty && mPackedBuffer) {
+    bytes = mPackedBytes;
+    if ((nullptr == buffer) || (mPackedBytes > capacity)) {
+      return false;
+    }
+    ::memcpy(buffer, mPackedBuffer.get(), static_cast<size_t>(mPackedBytes));
+    TTV_STATS_ADD(stats, bytes, mNumTtvs);
+    return true;
+  }
+  // locate and write the records in one pass, the buffer is checked record by
+  // record instead of computing the length first
+  uint32_t offset = 0;
+  TtvRecord record;
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    const Ttv *ttv = mTtvPool[ii].get();
+    layoutRecord(offset, ttv->getTag(), ttv->getType(), ttv->getLength(),
+                 mLayout, record);
+    if ((nullptr == buffer) || (record.size > capacity - offset)) {
+      bytes = computePackedBytes();
+      return false;
+    }
+    writeRecord(buffer, record, ttv->getValue(), mLayout);
+    offset += record.size;
+  }
+  bytes = offset;
+  TTV_STATS_ADD(stats, bytes, mNumTtvs);
   return true;
 }
 
+bool TtvBox::hasVarint() const { return mHasVarint; }
+
+bool TtvBox::hasVarint(const uint8_t *buffer, const uint32_t buffersize,
+                       const uint8_t layout) {
+  return hasVarintRecord(buffer, buffersize, layout, 0);
+}
+
+uint32_t TtvBox::computePackedBytes() const {
+  if (!mDirty && mPackedBuffer) {
+    return mPackedBytes;
+  }
+  uint32_t offset = 0;
+  TtvRecord record;
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    const Ttv *ttv = mTtvPool[ii].get();
+    layoutRecord(offset, ttv->getTag(), ttv->getType(), ttv->getLength(),
+                 mLayout, record);
+    offset += record.size;
+  }
+  return offset;
+}
+
+template <typename H> void TtvBox::updateHash(H &hasher) const {
+  // the packed buffer of the compact layout is the canonical encoding unless
+  // a value was put which may be written differently, see mNonCanonical
+  if (!mNonCanonical && !mDirty && mPackedBuffer &&
+      (LAYOUT_COMPACT == mLayout)) {
+    hasher.update(mPackedBuffer.get(), mPackedBytes);
+    return;
+  }
+
+  // otherwise hash the canonical records one by one without packing them
+  uint8_t header[sizeof(uint8_t) + sizeof(uint8_t) + sizeof(uint32_t)];
+  std::vector<uint8_t> canonical;
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    const Ttv *ttv = mTtvPool[ii].get();
+    const uint8_t *value = ttv->getValue();
+    uint32_t length = ttv->getLength();
+    if (mNonCanonical &&
+        canonicalizeValue(ttv->getType(), value, length, 0, nullptr)) {
+      canonical.clear();
+      canonicalizeValue(ttv->getType(), value, length, 0, &canonical);
+      value = canonical.data();
+      length = static_cast<uint32_t>(canonical.size());
+    }
+    hasher.update(header, encodeCanonicalHeader(ttv->getTag(), ttv->getType(),
+                                                length, header));
+    hasher.update(value, length);
+  }
+}
+
+uint64_t TtvBox::hash(const uint64_t seed) const {
+  TtvHasher hasher(seed);
+  updateHash(hasher);
+  return hasher.digest();
+}
+
+TtvHash128 TtvBox::hash128() const {
+  // both halves are computed in one walk of the records
+  TtvHasher128 hasher(0, kHashHighSeed);
+  updateHash(hasher);
+  return hasher.digest();
+}
+
 bool TtvBox::parse(const std::string &file) {
+  TTV_STATS_SCOPE(stats, STATS_PARSE);
+  TTV_TRACE_SCOPE("TtvBox::parse");
   TTV_LOGI("Parse the input file %s...", file.c_str());
   std::ifstream fin(file, std::ios::in);
   if (!fin.is_open()) {
@@ -121,16 +884,21 @@ bool TtvBox::parse(const std::string &file) {
   std::string tagstr = "";
   std::string typestr = "";
   std::string valuestr = "";
+  std::string namestr = "";
+  std::shared_ptr<TtvSchema> schema = std::make_shared<TtvSchema>();
   // support 1024 chars at most each line
   char line[1024] = {0};
 
-  putValue(new Ttv((uint8_t)START_TAG, (uint8_t)START_TYPE));
+  putStartEndTag((uint8_t)START_TAG, (uint8_t)START_TYPE);
 
   while (fin.getline(line, sizeof(line))) {
     std::stringstream word(line);
     word >> tagstr;
     word >> typestr;
     word >> valuestr;
+    // the name in the fourth column is optional
+    namestr.clear();
+    word >> namestr;
 
     const uint8_t tag = (uint8_t)atoi(tagstr.c_str());
     if ((tag <= START_TAG) || (tag >= END_TAG)) {
@@ -194,116 +962,356 @@ bool TtvBox::parse(const std::string &file) {
       const char *value = valuestr.c_str();
       uint32_t length = valuestr.size();
       putNonNumbericalValue(tag, type, length, value);
+    } else if ((strcmp(typestr.c_str(), "tensor") == 0)) {
+      // the path of the tensor file is relative to the input file
+      std::string path = valuestr;
+      const size_t slash = file.find_last_of('/');
+      if ((std::string::npos != slash) && ('/' != path[0])) {
+        path = file.substr(0, slash + 1) + path;
+      }
+      if (!parseTensor(tag, path)) {
+        return false;
+      }
     } else {
       TTV_LOGE("Error: unsupported data type.");
       return false;
     }
+    if (!namestr.empty() && !schema->addName(tag, namestr)) {
+      return false;
+    }
   }
 
-  putValue(new Ttv((uint8_t)END_TAG, (uint8_t)END_TYPE));
+  putStartEndTag((uint8_t)END_TAG, (uint8_t)END_TYPE);
+  if (schema->size() > 0) {
+    if (!schema->build()) {
+      return false;
+    }
+    setSchema(schema);
+  }
 
   fin.close();
+  TTV_STATS_ADD(stats, 0, mNumTtvs);
   return true;
 }
 
+bool TtvBox::parseTensor(const uint8_t tag, const std::string &file) {
+  std::ifstream fin(file, std::ios::in);
+  if (!fin.is_open()) {
+    TTV_LOGE("Error: failed to open the tensor file: %s!", file.c_str());
+    return false;
+  }
+
+  // the first line is the shape and the rest are the elements
+  std::string line;
+  std::getline(fin, line);
+  std::stringstream dims(line);
+  uint32_t shape[TENSOR_MAX_RANK] = {0};
+  uint8_t rank = 0;
+  uint32_t dim = 0;
+  while ((rank < TENSOR_MAX_RANK) && (dims >> dim)) {
+    shape[rank++] = dim;
+  }
+  const uint64_t length = getTensorBytes(FLOAT_T, rank, shape);
+  if ((0 == rank) || (0 == length) || (length > UINT32_MAX)) {
+    TTV_LOGE("Error: the shape of the tensor file %s is invalid.",
+             file.c_str());
+    return false;
+  }
+  const uint64_t numElements = (length - TENSOR_HEADER_BYTES) / sizeof(float);
+
+  std::vector<float> data;
+  data.reserve(numElements);
+  float element = 0.0f;
+  while (fin >> element) {
+    data.push_back(element);
+  }
+  if ((0 == rank) || (data.size() != numElements)) {
+    TTV_LOGE("Error: the tensor file %s has %d elements, but its shape "
+             "requires %d.",
+             file.c_str(), (int)data.size(), (int)numElements);
+    return false;
+  }
+
+  return putTensor(tag, FLOAT_T, rank, shape, data.data());
+}
+
 bool TtvBox::unpack(const uint8_t *buffer, const uint32_t buffersize) {
-  // unpack from another ttvbox
-  if ((0 == mPackedBytes) && (nullptr != buffer) && (buffersize > 0)) {
-    mPackedBuffer.reset(new uint8_t[buffersize]);
+  TTV_STATS_SCOPE(stats, STATS_UNPACK);
+  TTV_TRACE_SCOPE("TtvBox::unpack");
+  // unpack from another ttvbox, reusing the packed buffer if possible
+  if ((buffer != mPackedBuffer.get()) && (nullptr != buffer) &&
+      (buffersize > 0)) {
+    if ((buffersize > mPackedCapacity) || (mPackedBuffer.use_count() > 1)) {
+      allocPackedBuffer(buffersize);
+    }
     ::memcpy(mPackedBuffer.get(), buffer, static_cast<size_t>(buffersize));
   }
+  freeMem();
 
   uint32_t offset = 0;
-  while (offset < buffersize) {
-    uint8_t tag = (*reinterpret_cast<uint8_t *>(mPackedBuffer.get() + offset));
-    offset += sizeof(uint8_t);
-    uint8_t type = (*reinterpret_cast<uint8_t *>(mPackedBuffer.get() + offset));
-    offset += sizeof(uint8_t);
-    // the tag and type of start and end is to indicate the start and the end to
-    // store data for the start and the end, store the tag and type only.
-    if (((START_TAG == tag) && (START_TYPE == type)) ||
-        ((END_TAG == tag) && (END_TYPE == type))) {
-      putValue(new Ttv(tag, type));
-    } else {
-      // for basice types like char, int, float, the storage format is tag +
-      // type + value for other non-basice types like string, char *, class,
-      // structure, the storage format is tag + type + length + value
-      if (type <= BASIC_TYPE_MAX) {
-        uint8_t *value = mPackedBuffer.get() + offset;
-        switch (type) {
-        case BOOL_T: {
-          putValue(new Ttv(tag, type, sizeof(bool), value));
-          offset += sizeof(bool);
-        } break;
-        case UINT8_T: {
-          putValue(new Ttv(tag, type, sizeof(uint8_t), value));
-          offset += sizeof(uint8_t);
-        } break;
-        case INT8_T: {
-          putValue(new Ttv(tag, type, sizeof(int8_t), value));
-          offset += sizeof(int8_t);
-        } break;
-        case UINT16_T: {
-          putValue(new Ttv(tag, type, sizeof(uint16_t), value));
-          offset += sizeof(uint16_t);
-        } break;
-        case INT16_T: {
-          putValue(new Ttv(tag, type, sizeof(int16_t), value));
-          offset += sizeof(int16_t);
-        } break;
-        case UINT32_T: {
-          putValue(new Ttv(tag, type, sizeof(uint32_t), value));
-          offset += sizeof(uint32_t);
-        } break;
-        case INT32_T: {
-          putValue(new Ttv(tag, type, sizeof(int32_t), value));
-          offset += sizeof(int32_t);
-        } break;
-        case UINT64_T: {
-          putValue(new Ttv(tag, type, sizeof(uint64_t), value));
-          offset += sizeof(uint64_t);
-        } break;
-        case INT64_T: {
-          putValue(new Ttv(tag, type, sizeof(int64_t), value));
-          offset += sizeof(int64_t);
-        } break;
-        case FLOAT_T: {
-          putValue(new Ttv(tag, type, sizeof(float), value));
-          offset += sizeof(float);
-        } break;
-        case DOUBLE_T: {
-          putValue(new Ttv(tag, type, sizeof(double), value));
-          offset += sizeof(double);
-        } break;
-        default: {
-          TTV_LOGE("Error: unsupported data type.");
-          ;
-        } break;
-        }
-      } else if ((type > BASIC_TYPE_MAX) && (type <= COMPLEX_TYPE_MAX)) {
-        uint32_t length = ntohl(
-            (*reinterpret_cast<uint32_t *>(mPackedBuffer.get() + offset)));
-        offset += sizeof(uint32_t);
-        uint8_t *value = mPackedBuffer.get() + offset;
-        putValue(new Ttv(tag, type, length, value));
-        offset += length;
-      } else {
-        TTV_LOGE("Error: unsupported data type.");
-        ;
-      }
+  TtvRecord record;
+  while (readRecord(mPackedBuffer.get(), buffersize, offset, record,
+                    mLayout)) {
+    // a duplicate tag leaves an empty box rather than a partial one
+    if (!putPackedValue(record.tag, record.type, record.length,
+                        record.valueOffset)) {
+      clear();
+      return false;
     }
+    offset += record.size;
   }
+  TTV_STATS_ADD(stats, offset, mNumTtvs);
 
+  // the bytes after the last record are malformed, drop the records read
   if (offset != buffersize) {
     TTV_LOGE("Error: buffer size doesn't match.");
+    clear();
+    return false;
   }
 
   mPackedBytes = buffersize;
+  mDirty = false;
+  return updateSchema();
+}
 
-  return true;
+bool TtvBox::unpack(const uint8_t *buffer, const uint32_t buffersize,
+                    const TtvTagMask &tags) {
+  TTV_STATS_SCOPE(stats, STATS_UNPACK);
+  TTV_TRACE_SCOPE("TtvBox::unpack");
+  // the values are copied from the input directly, the packed buffer is
+  // rebuilt from the selected tags by the next pack
+  freeMem();
+  mPackedBytes = 0;
+  mDirty = true;
+
+  uint32_t offset = 0;
+  TtvRecord record;
+  while (readRecord(buffer, buffersize, offset, record, mLayout)) {
+    if (tags.test(record.tag) &&
+        !putValue(record.tag, record.type, record.length,
+                  buffer + record.valueOffset)) {
+      clear();
+      return false;
+    }
+    offset += record.size;
+  }
+  TTV_STATS_ADD(stats, offset, mNumTtvs);
+
+  if (offset != buffersize) {
+    TTV_LOGE("Error: buffer size doesn't match.");
+    clear();
+    return false;
+  }
+
+  return updateSchema();
+}
+
+bool TtvBox::diff(const TtvBox &oldBox, const TtvBox &newBox,
+                  TtvBox &patch) {
+  if (oldBox.isDirty() || newBox.isDirty()) {
+    TTV_LOGE("Error: please pack the ttv boxes before diffing.");
+    return false;
+  }
+
+  const uint8_t *oldBuffer = oldBox.getPackedBuffer();
+  const uint8_t *newBuffer = newBox.getPackedBuffer();
+  const uint32_t oldBytes = oldBox.getPackedBytes();
+  const uint32_t newBytes = newBox.getPackedBytes();
+  const uint8_t oldLayout = oldBox.getLayout();
+  const uint8_t newLayout = newBox.getLayout();
+  // the records of the patch are always stored in the compact layout
+  std::vector<uint8_t> upserts;
+  std::vector<uint8_t> removes;
+  auto upsert = [&](const TtvRecord &record) {
+    TtvRecord patchRecord;
+    layoutRecord(upserts.size(), record.tag, record.type, record.length,
+                 LAYOUT_COMPACT, patchRecord);
+    upserts.resize(upserts.size() + patchRecord.size);
+    writeRecord(upserts.data(), patchRecord, newBuffer + record.valueOffset,
+                LAYOUT_COMPACT);
+  };
+
+  TtvRecord oldRecord;
+  TtvRecord newRecord;
+  bool hasOld = readRecord(oldBuffer, oldBytes, 0, oldRecord, oldLayout);
+  bool hasNew = readRecord(newBuffer, newBytes, 0, newRecord, newLayout);
+  while (hasOld || hasNew) {
+    if (hasOld && (!hasNew || (oldRecord.tag < newRecord.tag))) {
+      removes.push_back(oldRecord.tag);
+      hasOld = readRecord(oldBuffer, oldBytes, oldRecord.offset + oldRecord.size,
+                          oldRecord, oldLayout);
+    } else if (hasNew && (!hasOld || (newRecord.tag < oldRecord.tag))) {
+      upsert(newRecord);
+      hasNew = readRecord(newBuffer, newBytes, newRecord.offset + newRecord.size,
+                          newRecord, newLayout);
+    } else {
+      if ((oldRecord.type != newRecord.type) ||
+          (oldRecord.length != newRecord.length) ||
+          (0 != ::memcmp(oldBuffer + oldRecord.valueOffset,
+                         newBuffer + newRecord.valueOffset, newRecord.length))) {
+        upsert(newRecord);
+      }
+      hasOld = readRecord(oldBuffer, oldBytes, oldRecord.offset + oldRecord.size,
+                          oldRecord, oldLayout);
+      hasNew = readRecord(newBuffer, newBytes, newRecord.offset + newRecord.size,
+                          newRecord, newLayout);
+    }
+  }
+
+  patch.clear();
+  patch.putStartEndTag(START_TAG, START_TYPE);
+  if (!upserts.empty()) {
+    patch.putNonNumbericalValue(PATCH_UPSERT_TAG, TTV_T, upserts.size(),
+                                upserts.data());
+  }
+  if (!removes.empty()) {
+    patch.putNonNumbericalValue(PATCH_REMOVE_TAG, BYTES_T, removes.size(),
+                                removes.data());
+  }
+  patch.putStartEndTag(END_TAG, END_TYPE);
+  return patch.pack();
 }
 
-bool TtvBox::write(const std::string &file) {
+bool TtvBox::apply(const TtvBox &patch) {
+  if (isDirty()) {
+    TTV_LOGE("Error: please pack the ttv box before applying a patch.");
+    return false;
+  }
+
+  const Ttv *upsert = patch.findTtv(PATCH_UPSERT_TAG);
+  const Ttv *remove = patch.findTtv(PATCH_REMOVE_TAG);
+  const uint8_t *patchBuffer = upsert ? upsert->getValue() : nullptr;
+  const uint32_t patchBytes = upsert ? upsert->getLength() : 0;
+  bool removed[256] = {false};
+  for (uint32_t ii = 0; remove && (ii < remove->getLength()); ii++) {
+    removed[remove->getValue()[ii]] = true;
+  }
+
+  // keep the old packed buffer alive while merging
+  const std::shared_ptr<uint8_t> buffer = mPackedBuffer;
+  const uint32_t bytes = mPackedBytes;
+  uint8_t *newBuffer = nullptr;
+  uint32_t newBytes = 0;
+  // merge the records in the ascending order of tags, the first pass computes
+  // the size of the new buffer and the second pass writes it
+  auto merge = [&]() {
+    newBytes = 0;
+    TtvRecord record;
+    TtvRecord patchRecord;
+    TtvRecord newRecord;
+    bool hasRecord = readRecord(buffer.get(), bytes, 0, record, mLayout);
+    bool hasPatch =
+        readRecord(patchBuffer, patchBytes, 0, patchRecord, LAYOUT_COMPACT);
+    while (hasRecord || hasPatch) {
+      if (hasPatch && (!hasRecord || (patchRecord.tag <= record.tag))) {
+        layoutRecord(newBytes, patchRecord.tag, patchRecord.type,
+                     patchRecord.length, mLayout, newRecord);
+        if (newBuffer) {
+          writeRecord(newBuffer, newRecord,
+                      patchBuffer + patchRecord.valueOffset, mLayout);
+        }
+        newBytes += newRecord.size;
+        if (hasRecord && (patchRecord.tag == record.tag)) {
+          hasRecord = readRecord(buffer.get(), bytes,
+                                 record.offset + record.size, record, mLayout);
+        }
+        hasPatch = readRecord(patchBuffer, patchBytes,
+                              patchRecord.offset + patchRecord.size,
+                              patchRecord, LAYOUT_COMPACT);
+      } else {
+        if (!removed[record.tag]) {
+          layoutRecord(newBytes, record.tag, record.type, record.length,
+                       mLayout, newRecord);
+          if (newBuffer) {
+            writeRecord(newBuffer, newRecord,
+                        buffer.get() + record.valueOffset, mLayout);
+          }
+          newBytes += newRecord.size;
+        }
+        hasRecord = readRecord(buffer.get(), bytes, record.offset + record.size,
+                               record, mLayout);
+      }
+    }
+  };
+
+  merge();
+  allocPackedBuffer(newBytes);
+  newBuffer = mPackedBuffer.get();
+  merge();
+
+  // only the values of the patch are decoded, the ttv objects of the other
+  // values are kept and only their offsets move to the merged buffer
+  bool patched[256] = {false};
+  TtvRecord record;
+  for (uint32_t offset = 0;
+       readRecord(patchBuffer, patchBytes, offset, record, LAYOUT_COMPACT);
+       offset += record.size) {
+    patched[record.tag] = true;
+  }
+  std::vector<std::shared_ptr<Ttv>> pool;
+  std::vector<TtvValueSlot> slots;
+  std::vector<uint32_t> offsets;
+  std::vector<bool> kept(mTtvPool.size(), false);
+  pool.reserve(mTtvPool.size());
+  for (uint32_t offset = 0;
+       readRecord(newBuffer, newBytes, offset, record, mLayout);
+       offset += record.size) {
+    const int16_t index = mTagIndex[record.tag];
+    const uint8_t *value = newBuffer + record.valueOffset;
+    if ((index >= 0) && !patched[record.tag]) {
+      pool.push_back(mTtvPool[index]);
+      slots.push_back(mSlots[index]);
+      kept[index] = true;
+    } else {
+      if ((index >= 0) && (1 == mTtvPool[index].use_count())) {
+        mTtvPool[index]->assign(record.tag, record.type, record.length, value);
+        pool.push_back(mTtvPool[index]);
+        kept[index] = true;
+      } else {
+        pool.push_back(makeTtv(record.tag, record.type, record.length, value));
+      }
+      slots.push_back(decodeSlot(record.type, record.length, value));
+    }
+    offsets.push_back(record.valueOffset);
+  }
+
+  // the ttv objects of the removed values are kept for reuse
+  const uint32_t numTtvs = static_cast<uint32_t>(pool.size());
+  const bool hasVarint =
+      mHasVarint || hasVarintRecord(patchBuffer, patchBytes, LAYOUT_COMPACT, 0);
+  bool nonCanonical = mNonCanonical;
+  for (uint32_t offset = 0;
+       !nonCanonical &&
+       readRecord(patchBuffer, patchBytes, offset, record, LAYOUT_COMPACT);
+       offset += record.size) {
+    nonCanonical = mayBeNonCanonical(
+        record.type, patchBuffer + record.valueOffset, record.length);
+  }
+  for (size_t ii = 0; ii < mTtvPool.size(); ii++) {
+    if (!kept[ii]) {
+      pool.push_back(mTtvPool[ii]);
+    }
+  }
+  freeMem();
+  mTtvPool.swap(pool);
+  mSlots.swap(slots);
+  mValueOffsets.swap(offsets);
+  mSlots.resize(mTtvPool.size());
+  mValueOffsets.resize(mTtvPool.size());
+  mNumTtvs = numTtvs;
+  mHasVarint = hasVarint;
+  mNonCanonical = nonCanonical;
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    mTagIndex[mTtvPool[ii]->getTag()] = static_cast<int16_t>(ii);
+  }
+  mPackedBytes = newBytes;
+  mDirty = false;
+  return updateSchema();
+}
+
+bool TtvBox::write(const std::string &file, const bool checksum) {
+  TTV_STATS_SCOPE(stats, STATS_WRITE);
+  TTV_TRACE_SCOPE("TtvBox::write");
   std::fstream out(file, std::ios::binary | std::ios::out);
   if (!out) {
     TTV_LOGE("Error: failed to open file");
@@ -316,14 +1324,34 @@ bool TtvBox::write(const std::string &file) {
     freeMem();
     return false;
   }
+  // the packed buffer is out of date after a value is put or resized
+  if (mDirty) {
+    TTV_LOGE("Error: the ttv box is modified, please pack it first.");
+    return false;
+  }
   TTV_LOGI("The size of ttv box is: mPackedBytes = %d bytes", mPackedBytes);
-  // write the number of bytes frist and then the contents of the buffer
-  uint32_t newlength = htonl(mPackedBytes);
-  // write the size of ttv box object first
-  out.write(reinterpret_cast<const char *>(&newlength), sizeof(mPackedBytes));
+  // write the header frist and then the contents of the buffer, the extended
+  // header is always written so that the box can be located by its magic
+  TtvHeader header;
+  header.payloadBytes = mPackedBytes;
+  if (checksum) {
+    header.flags |= HEADER_FLAG_CRC32C;
+    header.checksum = crc32c(0, mPackedBuffer.get(), mPackedBytes);
+  }
+  if (LAYOUT_ALIGNED == mLayout) {
+    header.flags |= HEADER_FLAG_ALIGNED;
+  }
+  if (hasVarint()) {
+    header.flags |= HEADER_FLAG_VARINT;
+  }
+  uint8_t headerBuffer[EXTENDED_HEADER_BYTES];
+  encodeHeader(header, headerBuffer);
+  out.write(reinterpret_cast<const char *>(headerBuffer),
+            sizeof(headerBuffer));
   // write the contents of ttv box next
   out.write(reinterpret_cast<const char *>(mPackedBuffer.get()), mPackedBytes);
   out.close();
+  TTV_STATS_ADD(stats, mPackedBytes, 0);
 
   return true;
 }
@@ -335,44 +1363,138 @@ bool TtvBox::read(const std::string &file) {
     return false;
   }
 
-  read(in);
+  const bool ret = read(in);
   in.close();
-  return true;
+  return ret;
 }
 
-void TtvBox::read(std::ifstream &file) {
-  uint32_t newlength = 0;
-  // read the number of bytes first and then the contents of the buffer
-  file.read(reinterpret_cast<char *>(&newlength), sizeof(uint32_t));
-  newlength = ntohl(newlength);
-  mPackedBytes = newlength;
-  TTV_LOGI("The size of ttv box is: mPackedBytes = %d bytes", mPackedBytes);
-  // in.read(reinterpret_cast<char *>(&mPackedBytes), sizeof(mPackedBytes));
-  mPackedBuffer.reset(new uint8_t[mPackedBytes]);
+bool TtvBox::read(std::ifstream &file) {
+  TTV_STATS_SCOPE(stats, STATS_READ);
+  TTV_TRACE_SCOPE("TtvBox::read");
+  // the ttv objects are out of date until the buffer is unpacked
+  freeMem();
+  mPackedBytes = 0;
+  mDirty = false;
+
+  // read the header first and then the contents of the buffer
+  uint8_t headerBuffer[EXTENDED_HEADER_BYTES];
+  TtvHeader header;
+  file.read(reinterpret_cast<char *>(headerBuffer), LEGACY_HEADER_BYTES);
+  if (file.gcount() != LEGACY_HEADER_BYTES) {
+    TTV_LOGE("Error: the header of ttv box is truncated.");
+    return false;
+  }
+  if (isExtendedHeader(headerBuffer)) {
+    file.read(reinterpret_cast<char *>(headerBuffer) + LEGACY_HEADER_BYTES,
+              EXTENDED_HEADER_BYTES - LEGACY_HEADER_BYTES);
+    if ((file.gcount() != EXTENDED_HEADER_BYTES - LEGACY_HEADER_BYTES) ||
+        !decodeHeader(headerBuffer, header)) {
+      TTV_LOGE("Error: the header of ttv box is invalid.");
+      return false;
+    }
+    // skip the fields appended by newer writers
+    file.ignore(header.headerBytes - EXTENDED_HEADER_BYTES);
+  } else {
+    uint32_t newlength = 0;
+    ::memcpy(&newlength, headerBuffer, sizeof(uint32_t));
+    header.payloadBytes = ntohl(newlength);
+  }
+  TTV_LOGI("The size of ttv box is: mPackedBytes = %d bytes",
+           header.payloadBytes);
+  // a length beyond the rest of the file rejects foreign data before any
+  // allocation, a stream that cannot seek is checked by the read below
+  const std::streampos begin = file.tellg();
+  if (begin >= 0) {
+    file.seekg(0, std::ios::end);
+    const std::streampos end = file.tellg();
+    file.seekg(begin);
+    if ((end >= begin) &&
+        (static_cast<uint64_t>(end - begin) < header.payloadBytes)) {
+      TTV_LOGE("Error: the ttv box is truncated, %u bytes are expected.",
+               header.payloadBytes);
+      return false;
+    }
+  }
+  allocPackedBuffer(header.payloadBytes);
+  TTV_STATS_ADD(stats, header.payloadBytes, 0);
 
   // read the TTV data buffer
-  file.read(reinterpret_cast<char *>(mPackedBuffer.get()), mPackedBytes);
+  file.read(reinterpret_cast<char *>(mPackedBuffer.get()), header.payloadBytes);
+  if (file.gcount() != static_cast<std::streamsize>(header.payloadBytes)) {
+    TTV_LOGE("Error: the ttv box is truncated, %d of %d bytes are read.",
+             (int)file.gcount(), header.payloadBytes);
+    return false;
+  }
 
-  return;
+  return verifyPackedBuffer(header);
 }
 
-void TtvBox::read(const void *buffer) {
-  uint32_t newlength = 0;
-  // read the number of bytes frist and then the contents of the buffer
-  ::memcpy(&newlength, buffer, sizeof(uint32_t));
-
-  uint8_t *newbuffer = (uint8_t *)buffer + sizeof(uint32_t);
+bool TtvBox::read(const void *buffer) {
+  return read(buffer, std::numeric_limits<size_t>::max());
+}
 
-  newlength = ntohl(newlength);
-  mPackedBytes = newlength;
+bool TtvBox::read(const void *buffer, const size_t buffersize) {
+  TTV_STATS_SCOPE(stats, STATS_READ);
+  TTV_TRACE_SCOPE("TtvBox::read");
+  // the ttv objects are out of date until the buffer is unpacked
+  freeMem();
+  mPackedBytes = 0;
+  mDirty = false;
+
+  // read the header frist and then the contents of the buffer
+  const uint8_t *headerBuffer = static_cast<const uint8_t *>(buffer);
+  TtvHeader header;
+  size_t headerBytes = LEGACY_HEADER_BYTES;
+  if (buffersize < LEGACY_HEADER_BYTES) {
+    TTV_LOGE("Error: the header of ttv box is truncated.");
+    return false;
+  }
+  if (isExtendedHeader(headerBuffer)) {
+    if ((buffersize < EXTENDED_HEADER_BYTES) ||
+        !decodeHeader(headerBuffer, header)) {
+      TTV_LOGE("Error: the header of ttv box is invalid.");
+      return false;
+    }
+    headerBytes = header.headerBytes;
+  } else {
+    uint32_t newlength = 0;
+    ::memcpy(&newlength, headerBuffer, sizeof(uint32_t));
+    header.payloadBytes = ntohl(newlength);
+  }
+  // a length beyond the buffer rejects foreign data before any allocation
+  if ((headerBytes > buffersize) ||
+      (header.payloadBytes > buffersize - headerBytes)) {
+    TTV_LOGE("Error: the ttv box is truncated, %u bytes are expected.",
+             header.payloadBytes);
+    return false;
+  }
 
-  mPackedBuffer.reset(new uint8_t[mPackedBytes]);
+  allocPackedBuffer(header.payloadBytes);
+  TTV_STATS_ADD(stats, header.payloadBytes, 0);
 
   // read the TTV data buffer
-  ::memcpy(mPackedBuffer.get(), newbuffer, static_cast<size_t>(mPackedBytes));
+  ::memcpy(mPackedBuffer.get(), headerBuffer + headerBytes,
+           static_cast<size_t>(header.payloadBytes));
 
-  TTV_LOGI("The size of ttv box is: mPackedBytes = %d bytes", mPackedBytes);
-  return;
+  TTV_LOGI("The size of ttv box is: mPackedBytes = %d bytes",
+           header.payloadBytes);
+  return verifyPackedBuffer(header);
+}
+
+bool TtvBox::verifyPackedBuffer(const TtvHeader &header) {
+  if (header.flags & HEADER_FLAG_CRC32C) {
+    const uint32_t checksum =
+        crc32c(0, mPackedBuffer.get(), header.payloadBytes);
+    if (checksum != header.checksum) {
+      TTV_LOGE("Error: checksum mismatch, expected 0x%08X, got 0x%08X.",
+               header.checksum, checksum);
+      return false;
+    }
+  }
+  mPackedBytes = header.payloadBytes;
+  mLayout =
+      (header.flags & HEADER_FLAG_ALIGNED) ? LAYOUT_ALIGNED : LAYOUT_COMPACT;
+  return true;
 }
 
 uint8_t *TtvBox::getPackedBuffer() const { return mPackedBuffer.get(); }
@@ -380,22 +1502,61 @@ uint8_t *TtvBox::getPackedBuffer() const { return mPackedBuffer.get(); }
 uint32_t TtvBox::getPackedBytes() const { return mPackedBytes; }
 
 uint32_t TtvBox::getStorageBytes() const {
-  return mPackedBytes + sizeof(uint32_t);
+  return mPackedBytes + EXTENDED_HEADER_BYTES;
 }
 
-bool TtvBox::putValue(const Ttv *ttv) {
-  uint8_t tag = ttv->getTag();
-  uint8_t type = ttv->getType();
-
-  auto iter = mTtvMap.find(tag);
-  if (iter != mTtvMap.end()) {
-    delete iter->second;
-    iter->second = nullptr;
-    freeMem();
+bool TtvBox::putValue(const uint8_t tag, const uint8_t type,
+                      const uint32_t length, const void *value) {
+  if (mTagIndex[tag] >= 0) {
     TTV_LOGE("Error: the tag %d has been put before, please check.", tag);
     return false;
+  }
+  if (!fitsPackedBuffer(mPackedBytes, length)) {
+    return false;
+  }
+
+  // keep the pool sorted by tag, values are usually put in ascending order of
+  // tags so the new ttv object is appended in most cases
+  uint32_t position = mNumTtvs;
+  while ((position > 0) && (mTtvPool[position - 1]->getTag() > tag)) {
+    position--;
+  }
+  if (mNumTtvs == mTtvPool.size()) {
+    mTtvPool.push_back(makeTtv(tag, type, length, value));
+  } else if (mTtvPool[mNumTtvs].use_count() > 1) {
+    // the spare ttv object is still referenced by a shared box
+    mTtvPool[mNumTtvs] = makeTtv(tag, type, length, value);
   } else {
-    mTtvMap.insert(std::pair<uint8_t, const Ttv *>(tag, ttv));
+    mTtvPool[mNumTtvs]->assign(tag, type, length, value);
+  }
+  if (mSlots.size() < mTtvPool.size()) {
+    mSlots.resize(mTtvPool.size());
+  }
+  if (mValueOffsets.size() < mTtvPool.size()) {
+    mValueOffsets.resize(mTtvPool.size());
+  }
+  mSlots[mNumTtvs] = decodeSlot(type, length, value);
+  mHasVarint = mHasVarint ||
+               hasVarintValue(type, static_cast<const uint8_t *>(value),
+                              length, 0);
+  // a value put out of the order of tags leaves an unpacked buffer out of the
+  // canonical order as well
+  mNonCanonical =
+      mNonCanonical || (position != mNumTtvs) ||
+      mayBeNonCanonical(type, static_cast<const uint8_t *>(value), length);
+  // the offsets move along with the ttv objects, a buffer unpacked out of
+  // the order of tags keeps the offset of each value
+  std::rotate(mTtvPool.begin() + position, mTtvPool.begin() + mNumTtvs,
+              mTtvPool.begin() + mNumTtvs + 1);
+  std::rotate(mSlots.begin() + position, mSlots.begin() + mNumTtvs,
+              mSlots.begin() + mNumTtvs + 1);
+  std::rotate(mValueOffsets.begin() + position,
+              mValueOffsets.begin() + mNumTtvs,
+              mValueOffsets.begin() + mNumTtvs + 1);
+  mNumTtvs++;
+  mDirty = true;
+  for (uint32_t ii = position; ii < mNumTtvs; ii++) {
+    mTagIndex[mTtvPool[ii]->getTag()] = static_cast<int16_t>(ii);
   }
 
   // the tag and type of start and end is to indicate the start and the end to
@@ -408,20 +1569,69 @@ bool TtvBox::putValue(const Ttv *ttv) {
 
   // for basice types like char, int, float, the storage format is tag + type +
   // value
-  uint8_t length = ttv->getLength();
   mPackedBytes += sizeof(uint8_t) + sizeof(uint8_t) + length;
 
   // for other non-basice types like string, char *, class, structure,
   // the storage format is tag + type + value + length
-  if (type > BASIC_TYPE_MAX) {
+  if (type > FIXED_TYPE_MAX) {
     mPackedBytes += sizeof(uint32_t);
   }
 
   return true;
 }
 
+TtvValueSlot TtvBox::decodeSlot(const uint8_t type, const uint32_t length,
+                                const void *value) {
+  // decode the big-endian value once so that the getters only copy it
+  TtvValueSlot slot;
+  const uint8_t *buffer = static_cast<const uint8_t *>(value);
+  if (isVarintType(type)) {
+    if (decodeVarint(buffer, length, slot.bits) == length) {
+      slot.type = type;
+    }
+    return slot;
+  }
+  if ((type < BOOL_T) || (type > BASIC_TYPE_MAX) ||
+      (length != getBasicTypeSize(type))) {
+    return slot;
+  }
+  switch (length) {
+  case sizeof(uint8_t):
+    ::memcpy(&slot.bits, buffer, sizeof(uint8_t));
+    break;
+  case sizeof(uint16_t): {
+    uint16_t bits = 0;
+    ::memcpy(&bits, buffer, sizeof(uint16_t));
+    bits = be16toh(bits);
+    ::memcpy(&slot.bits, &bits, sizeof(uint16_t));
+  } break;
+  case sizeof(uint32_t): {
+    uint32_t bits = 0;
+    ::memcpy(&bits, buffer, sizeof(uint32_t));
+    bits = be32toh(bits);
+    ::memcpy(&slot.bits, &bits, sizeof(uint32_t));
+  } break;
+  default: {
+    uint64_t bits = 0;
+    ::memcpy(&bits, buffer, sizeof(uint64_t));
+    slot.bits = be64toh(bits);
+  } break;
+  }
+  slot.type = type;
+  return slot;
+}
+
+bool TtvBox::putPackedValue(const uint8_t tag, const uint8_t type,
+                            const uint32_t length, const uint32_t offset) {
+  if (!putValue(tag, type, length, mPackedBuffer.get() + offset)) {
+    return false;
+  }
+  mValueOffsets[mTagIndex[tag]] = offset;
+  return true;
+}
+
 bool TtvBox::putStartEndTag(const uint8_t tag, const uint8_t type) {
-  return putValue(new Ttv(tag, type));
+  return putValue(tag, type, 0, nullptr);
 }
 
 bool TtvBox::putTtvValue(const uint8_t tag, const uint8_t type,
@@ -433,13 +1643,20 @@ bool TtvBox::putTtvValue(const uint8_t tag, const uint8_t type,
     return false;
   }
 
-  return putValue(new Ttv(tag, type, value->getPackedBytes(), buffer));
+  if (LAYOUT_COMPACT != value->getLayout()) {
+    TtvBox compact;
+    return getCompactBox(*value, compact) &&
+           putValue(tag, type, compact.getPackedBytes(),
+                    compact.getPackedBuffer());
+  }
+  return putValue(tag, type, value->getPackedBytes(), buffer);
 }
 
 bool TtvBox::getValue() const {
-  for (const auto &ttvmap : mTtvMap) {
-    uint8_t tag = ttvmap.first;
-    uint8_t type = ttvmap.second->getType();
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    const Ttv *ttv = mTtvPool[ii].get();
+    uint8_t tag = ttv->getTag();
+    uint8_t type = ttv->getType();
 
     if ((START_TAG == tag) && (START_TYPE == type)) {
       TTV_LOGI("Start parsing ttv box... ");
@@ -546,9 +1763,27 @@ bool TtvBox::getValue() const {
         TTV_LOGI("Get the value of the tag 0x%X sucessfully, value = %lf", tag,
                  value);
       } break;
+      case VARUINT_T: {
+        uint64_t value;
+        if (!getNumbericalValue(tag, value)) {
+          TTV_LOGE("Failed to get the value of the tag 0x%X", tag);
+          return false;
+        }
+        TTV_LOGI("Get the value of the tag 0x%X sucessfully, value = %llu", tag,
+                 (unsigned long long int)value);
+      } break;
+      case VARINT_T: {
+        int64_t value;
+        if (!getNumbericalValue(tag, value)) {
+          TTV_LOGE("Failed to get the value of the tag 0x%X", tag);
+          return false;
+        }
+        TTV_LOGI("Get the value of the tag 0x%X sucessfully, value = %lld", tag,
+                 (long long int)value);
+      } break;
       case STRING_T: {
         std::string value;
-        value.resize(ttvmap.second->getLength());
+        value.resize(ttv->getLength());
         if (!getStringValue(tag, value)) {
           TTV_LOGE("Failed to get the value of the tag 0x%X", tag);
           return false;
@@ -565,9 +1800,30 @@ bool TtvBox::getValue() const {
         TTV_LOGI("Get the value of the tag 0x%X sucessfully, value = %s", tag,
                  value);
       } break;
+      case TENSOR_T: {
+        TtvTensorView value;
+        if (!getTensorView(tag, value)) {
+          TTV_LOGE("Failed to get the value of the tag 0x%X", tag);
+          return false;
+        }
+        TTV_LOGI("Get the value of the tag 0x%X sucessfully, tensor of type "
+                 "0x%X with %d dimensions and %lld elements",
+                 tag, value.dtype, value.rank,
+                 (long long int)value.numElements);
+      } break;
+      case REPEATED_TTV_T: {
+        TtvRepeatedView value;
+        if (!getRepeatedView(tag, value)) {
+          TTV_LOGE("Failed to get the value of the tag 0x%X", tag);
+          return false;
+        }
+        TTV_LOGI("Get the value of the tag 0x%X sucessfully, list of %d ttv "
+                 "boxes",
+                 tag, value.count);
+      } break;
       default: {
-        TTV_LOGE("Error: unsupported data type.");
-        ;
+        // the types added by newer writers are kept as they are
+        TTV_LOGI("Skip the tag 0x%X of unknown type 0x%X", tag, type);
       } break;
       }
     }
@@ -577,22 +1833,131 @@ bool TtvBox::getValue() const {
 }
 
 bool TtvBox::getTtvValue(const uint8_t tag, TtvBox &value) const {
-  auto iter = mTtvMap.find(tag);
-  if (iter == mTtvMap.end()) {
+  const Ttv *ttv = findTtv(tag);
+  if (nullptr == ttv) {
+    return false;
+  }
+
+  value.setLayout(LAYOUT_COMPACT);
+  return value.unpack(ttv->getValue(), ttv->getLength());
+}
+
+bool TtvBox::getRepeatedView(const uint8_t tag, TtvRepeatedView &view) const {
+  const int16_t index = mTagIndex[tag];
+  if (index < 0) {
+    TTV_LOGE("Error: tag = %d is not found.", tag);
+    return false;
+  }
+  const Ttv *ttv = mTtvPool[index].get();
+  if (REPEATED_TTV_T != ttv->getType()) {
+    TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
+    return false;
+  }
+  const uint8_t *value = (!mDirty && mPackedBuffer)
+                             ? mPackedBuffer.get() + mValueOffsets[index]
+                             : ttv->getValue();
+  if (!decodeRepeated(value, ttv->getLength(), view)) {
+    TTV_LOGE("Error: the list of tag %d is malformed.", tag);
+    return false;
+  }
+  return true;
+}
+
+bool TtvBox::getRepeatedTtvValue(const uint8_t tag, const uint32_t index,
+                                 TtvBox &value) const {
+  TtvRepeatedView view;
+  if (!getRepeatedView(tag, view)) {
+    return false;
+  }
+  const uint8_t *element = nullptr;
+  uint32_t length = 0;
+  if (!getRepeatedElement(view, index, &element, length)) {
+    TTV_LOGE("Error: the element %d of tag %d is not found.", index, tag);
+    return false;
+  }
+  value.setLayout(LAYOUT_COMPACT);
+  return value.unpack(element, length);
+}
+
+void TtvBox::setSchema(const std::shared_ptr<const TtvSchema> &schema) {
+  mSchema = schema;
+  mSchemaBytes.clear();
+}
+
+std::shared_ptr<const TtvSchema> TtvBox::getSchema() const { return mSchema; }
+
+bool TtvBox::embedSchema() {
+  if (nullptr == mSchema) {
+    TTV_LOGE("Error: there is no schema to embed.");
     return false;
   }
+  std::vector<uint8_t> value;
+  mSchema->encode(value);
+  const Ttv *ttv = findTtv(SCHEMA_TAG);
+  if (nullptr == ttv) {
+    return putNonNumbericalValue(SCHEMA_TAG, BYTES_T, value.size(),
+                                 value.data());
+  }
+  if (!isSchemaValue(ttv->getType(), ttv->getValue(), ttv->getLength())) {
+    TTV_LOGE("Error: the tag %d is used by another value.", SCHEMA_TAG);
+    return false;
+  }
+  return setNonNumbericalValue(SCHEMA_TAG, value.size(), value.data());
+}
 
-  return value.unpack(iter->second->getValue(), iter->second->getLength());
+bool TtvBox::updateSchema() {
+  // a value of another writer at the tag is kept as an ordinary value
+  const Ttv *ttv = findTtv(SCHEMA_TAG);
+  if ((nullptr == ttv) ||
+      !isSchemaValue(ttv->getType(), ttv->getValue(), ttv->getLength())) {
+    return true;
+  }
+  // the messages of a stream usually embed the same names, decode them once
+  const uint8_t *value = ttv->getValue();
+  const uint32_t length = ttv->getLength();
+  if ((nullptr != mSchema) && (mSchemaBytes.size() == length) &&
+      (0 == ::memcmp(mSchemaBytes.data(), value, length))) {
+    return true;
+  }
+  std::shared_ptr<TtvSchema> schema = std::make_shared<TtvSchema>();
+  if (!schema->decode(value, length)) {
+    TTV_LOGE("Error: the embedded schema is malformed.");
+    return false;
+  }
+  mSchema = schema;
+  mSchemaBytes.assign(value, value + length);
+  return true;
+}
+
+bool TtvBox::getTag(const char *name, uint8_t &tag) const {
+  return (nullptr != mSchema) && mSchema->findTag(name, ::strlen(name), tag);
+}
+
+bool TtvBox::getValueByTag(const uint8_t tag, std::string &value) const {
+  return getStringValue(tag, value);
+}
+
+bool TtvBox::getValueByTag(const uint8_t tag, TtvTensorView &value) const {
+  return getTensorView(tag, value);
 }
 
 uint8_t TtvBox::getTagList(std::vector<uint8_t> &list) const {
-  for (const auto &ttvmap : mTtvMap) {
-    list.push_back(ttvmap.first);
+  for (uint32_t ii = 0; ii < mNumTtvs; ii++) {
+    list.push_back(mTtvPool[ii]->getTag());
   }
 
   return list.size();
 }
 
+bool TtvBox::getType(const uint8_t tag, uint8_t &type) const {
+  const Ttv *ttv = findTtv(tag);
+  if (nullptr == ttv) {
+    return false;
+  }
+  type = ttv->getType();
+  return true;
+}
+
 void TtvBox::printTagList() const {
   std::vector<uint8_t> tagList;
   uint8_t numTags = getTagList(tagList);
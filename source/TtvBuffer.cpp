@@ -5,13 +5,16 @@
  */
 
 #include "include/TtvBuffer.h"
+#include "include/TtvTrace.h"
 #include "include/common.h"
 #include <fstream>
 #include <string>
 
 namespace ttv {
 
-bool TtvBuffer::serialize(const std::string &file, TtvBox &ttvbox) {
+bool TtvBuffer::serialize(const std::string &file, TtvBox &ttvbox,
+                          const bool checksum) {
+  TTV_TRACE_SCOPE("TtvBuffer::serialize");
   TTV_LOGI("serialize...");
   if (ttvbox.getPackedBytes() == 0) {
     TTV_LOGE("Error: this is an empty ttv box! please create an non-empty box "
@@ -21,7 +24,10 @@ bool TtvBuffer::serialize(const std::string &file, TtvBox &ttvbox) {
     TTV_LOGI("serialize failed.");
     return false;
   }
-  ttvbox.write(file);
+  if (!ttvbox.write(file, checksum)) {
+    TTV_LOGI("serialize failed.");
+    return false;
+  }
 
   TTV_LOGI("serialize succeeded, the total size is %d bytes.",
            ttvbox.getPackedBytes());
@@ -36,38 +42,44 @@ bool TtvBuffer::deserialize(const std::string &file, TtvBox &ttvbox) {
     return false;
   }
 
-  deserialize(in, ttvbox);
+  const bool ret = deserialize(in, ttvbox);
   in.close();
 
-  return true;
+  return ret;
 }
 
-void TtvBuffer::deserialize(std::ifstream &file, TtvBox &ttvbox) {
+bool TtvBuffer::deserialize(std::ifstream &file, TtvBox &ttvbox) {
+  TTV_TRACE_SCOPE("TtvBuffer::deserialize");
   TTV_LOGI("Deserialize...");
 
-  ttvbox.read(file);
-  if (!ttvbox.unpack(ttvbox.getPackedBuffer(), ttvbox.getPackedBytes())) {
-    TTV_LOGI("Deserialize succeeded, the total size is %d bytes",
-             ttvbox.getPackedBytes());
+  if (!ttvbox.read(file) ||
+      !ttvbox.unpack(ttvbox.getPackedBuffer(), ttvbox.getPackedBytes())) {
+    TTV_LOGE("Deserialize failed.");
+    return false;
   }
+  TTV_LOGI("Deserialize succeeded, the total size is %d bytes",
+           ttvbox.getPackedBytes());
 
   ttvbox.printTagList();
 
-  return;
+  return true;
 }
 
-void TtvBuffer::deserialize(const void *buffer, TtvBox &ttvbox) {
+bool TtvBuffer::deserialize(const void *buffer, TtvBox &ttvbox) {
+  TTV_TRACE_SCOPE("TtvBuffer::deserialize");
   TTV_LOGI("Deserialize...");
 
-  ttvbox.read(buffer);
-  if (!ttvbox.unpack(ttvbox.getPackedBuffer(), ttvbox.getPackedBytes())) {
-    TTV_LOGI("Deserialize succeeded, the total size is %d bytes",
-             ttvbox.getPackedBytes());
+  if (!ttvbox.read(buffer) ||
+      !ttvbox.unpack(ttvbox.getPackedBuffer(), ttvbox.getPackedBytes())) {
+    TTV_LOGE("Deserialize failed.");
+    return false;
   }
+  TTV_LOGI("Deserialize succeeded, the total size is %d bytes",
+           ttvbox.getPackedBytes());
 
   ttvbox.printTagList();
 
-  return;
+  return true;
 }
 
 } // namespace ttv
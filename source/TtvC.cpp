@@ -0,0 +1,276 @@
+/*
+ *  @file     TtvC.cpp
+ *  @brief    TTV C API, a stable C interface over ttv boxes for FFI consumers
+ *  such as ctypes or cffi, exported by libTTV_C
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvC.h"
+#include "include/TtvBox.h"
+#include <exception>
+#include <new>
+#include <string.h>
+#include <vector>
+
+using ttv::TtvBox;
+
+struct ttv_box {
+  TtvBox box;
+};
+
+namespace {
+
+inline int toStatus(const bool ret) { return ret ? TTV_OK : TTV_ERROR; }
+
+// called in the catch of every entry point so that no exception crosses the
+// C callers, e.g. the std::bad_alloc of a put or an unpack
+int onException() {
+  try {
+    throw;
+  } catch (const std::exception &e) {
+    TTV_LOGE("Error: %s.", e.what());
+  } catch (...) {
+    TTV_LOGE("Error: unknown exception.");
+  }
+  return TTV_ERROR;
+}
+
+template <typename T>
+int putNumber(TtvBox &box, const uint8_t tag, const uint8_t type,
+              const void *value) {
+  T number;
+  ::memcpy(&number, value, sizeof(T));
+  return toStatus(box.putNumbericalValue<T>(tag, type, number));
+}
+
+template <typename T>
+int getNumber(const TtvBox &box, const uint8_t tag, void *value) {
+  T number;
+  if (!box.getNumbericalValue<T>(tag, number)) {
+    return TTV_ERROR;
+  }
+  ::memcpy(value, &number, sizeof(T));
+  return TTV_OK;
+}
+
+} // namespace
+
+ttv_box *ttv_box_create(void) {
+  try {
+    return new (std::nothrow) ttv_box();
+  } catch (...) {
+    onException();
+    return nullptr;
+  }
+}
+
+void ttv_box_destroy(ttv_box *box) {
+  try {
+    delete box;
+  } catch (...) {
+    onException();
+  }
+}
+
+void ttv_box_clear(ttv_box *box) {
+  try {
+    box->box.clear();
+  } catch (...) {
+    onException();
+  }
+}
+
+int ttv_box_put_start_end(ttv_box *box, uint8_t tag, uint8_t type) {
+  try {
+    return toStatus(box->box.putStartEndTag(tag, type));
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_put_number(ttv_box *box, uint8_t tag, uint8_t type,
+                       const void *value) {
+  try {
+    switch (type) {
+    case BOOL_T:
+      return putNumber<bool>(box->box, tag, type, value);
+    case UINT8_T:
+      return putNumber<uint8_t>(box->box, tag, type, value);
+    case INT8_T:
+      return putNumber<int8_t>(box->box, tag, type, value);
+    case UINT16_T:
+      return putNumber<uint16_t>(box->box, tag, type, value);
+    case INT16_T:
+      return putNumber<int16_t>(box->box, tag, type, value);
+    case UINT32_T:
+      return putNumber<uint32_t>(box->box, tag, type, value);
+    case INT32_T:
+      return putNumber<int32_t>(box->box, tag, type, value);
+    case UINT64_T:
+      return putNumber<uint64_t>(box->box, tag, type, value);
+    case INT64_T:
+      return putNumber<int64_t>(box->box, tag, type, value);
+    case FLOAT_T:
+      return putNumber<float>(box->box, tag, type, value);
+    case DOUBLE_T:
+      return putNumber<double>(box->box, tag, type, value);
+    case VARUINT_T:
+      return putNumber<uint64_t>(box->box, tag, type, value);
+    case VARINT_T:
+      return putNumber<int64_t>(box->box, tag, type, value);
+    default:
+      TTV_LOGE("Error: unsupported data type.");
+      return TTV_ERROR;
+    }
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_put_bytes(ttv_box *box, uint8_t tag, uint8_t type,
+                      const void *value, uint32_t length) {
+  try {
+    return toStatus(box->box.putNonNumbericalValue(tag, type, length, value));
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_pack(ttv_box *box) {
+  try {
+    return toStatus(box->box.pack());
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_get_packed_buffer(const ttv_box *box, const uint8_t **data,
+                              uint32_t *size) {
+  try {
+    if (box->box.isDirty() || (nullptr == box->box.getPackedBuffer())) {
+      TTV_LOGE("Error: please pack the ttv box first.");
+      return TTV_ERROR;
+    }
+    *data = box->box.getPackedBuffer();
+    *size = box->box.getPackedBytes();
+    return TTV_OK;
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_unpack(ttv_box *box, const uint8_t *data, uint32_t size) {
+  try {
+    return toStatus(box->box.unpack(data, size));
+  } catch (...) {
+    return onException();
+  }
+}
+
+uint32_t ttv_box_get_tags(const ttv_box *box, uint8_t *tags,
+                          uint32_t capacity) {
+  try {
+    std::vector<uint8_t> list;
+    box->box.getTagList(list);
+    if (nullptr != tags) {
+      const size_t count = (list.size() < capacity) ? list.size() : capacity;
+      ::memcpy(tags, list.data(), count);
+    }
+    return static_cast<uint32_t>(list.size());
+  } catch (...) {
+    onException();
+    return 0;
+  }
+}
+
+int ttv_box_get_type(const ttv_box *box, uint8_t tag, uint8_t *type) {
+  try {
+    return toStatus(box->box.getType(tag, *type));
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_get_number(const ttv_box *box, uint8_t tag, uint8_t type,
+                       void *value) {
+  try {
+    uint8_t actualType = 0;
+    if (!box->box.getType(tag, actualType)) {
+      TTV_LOGE("Error: tag = %d is not found.", tag);
+      return TTV_ERROR;
+    }
+    if (actualType != type) {
+      TTV_LOGE("Error: tag = %d is found, but its type mismatch.", tag);
+      return TTV_ERROR;
+    }
+    switch (type) {
+    case BOOL_T:
+      return getNumber<bool>(box->box, tag, value);
+    case UINT8_T:
+      return getNumber<uint8_t>(box->box, tag, value);
+    case INT8_T:
+      return getNumber<int8_t>(box->box, tag, value);
+    case UINT16_T:
+      return getNumber<uint16_t>(box->box, tag, value);
+    case INT16_T:
+      return getNumber<int16_t>(box->box, tag, value);
+    case UINT32_T:
+      return getNumber<uint32_t>(box->box, tag, value);
+    case INT32_T:
+      return getNumber<int32_t>(box->box, tag, value);
+    case UINT64_T:
+      return getNumber<uint64_t>(box->box, tag, value);
+    case INT64_T:
+      return getNumber<int64_t>(box->box, tag, value);
+    case FLOAT_T:
+      return getNumber<float>(box->box, tag, value);
+    case DOUBLE_T:
+      return getNumber<double>(box->box, tag, value);
+    case VARUINT_T:
+      return getNumber<uint64_t>(box->box, tag, value);
+    case VARINT_T:
+      return getNumber<int64_t>(box->box, tag, value);
+    default:
+      TTV_LOGE("Error: unsupported data type.");
+      return TTV_ERROR;
+    }
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_get_packed_value(const ttv_box *box, uint8_t tag,
+                             const uint8_t **value, uint32_t *length) {
+  try {
+    return toStatus(box->box.getPackedValue(tag, value, *length));
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_parse(ttv_box *box, const char *file) {
+  try {
+    return toStatus(box->box.parse(file));
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_write(ttv_box *box, const char *file, int checksum) {
+  try {
+    return toStatus(box->box.write(file, 0 != checksum));
+  } catch (...) {
+    return onException();
+  }
+}
+
+int ttv_box_read(ttv_box *box, const char *file) {
+  try {
+    const std::string path(file);
+    return toStatus(box->box.read(path) &&
+                    box->box.unpack(box->box.getPackedBuffer(),
+                                    box->box.getPackedBytes()));
+  } catch (...) {
+    return onException();
+  }
+}
@@ -0,0 +1,315 @@
+/*
+ *  @file     TtvChannel.cpp
+ *  @brief    TTV channel class, frames packed ttv boxes over a file descriptor
+ *  such as a pipe or a unix domain socket, many small frames are coalesced
+ *  into one system call on both sides
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvChannel.h"
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace ttv {
+
+namespace {
+
+// the status of the frame at the beginning of the receive buffer
+enum FrameStatus {
+  FRAME_COMPLETE = 0,
+  FRAME_PARTIAL = 1,
+  FRAME_MALFORMED = 2,
+};
+
+inline void encodeFrameHeader(const uint32_t length, const uint8_t layout,
+                              const uint8_t flags, uint8_t *header) {
+  const uint32_t bigEndian = htonl(length);
+  ::memcpy(header, &bigEndian, sizeof(uint32_t));
+  header[4] = layout;
+  header[5] = flags;
+  header[6] = 0;
+  header[7] = 0;
+}
+
+// copy a small frame by 16-byte words, the last one overlapping, instead of
+// the rep movs which compilers emit for a memcpy of a bounded size and which
+// costs more than the copy itself for the frames of tens of bytes
+inline void copySmall(uint8_t *dst, const uint8_t *src, const uint32_t bytes) {
+  if (bytes >= 16) {
+    for (uint32_t ii = 0; ii + 16 < bytes; ii += 16) {
+      ::memcpy(dst + ii, src + ii, 16);
+    }
+    ::memcpy(dst + bytes - 16, src + bytes - 16, 16);
+  } else if (bytes >= 8) {
+    ::memcpy(dst, src, 8);
+    ::memcpy(dst + bytes - 8, src + bytes - 8, 8);
+  } else if (bytes >= 4) {
+    ::memcpy(dst, src, 4);
+    ::memcpy(dst + bytes - 4, src + bytes - 4, 4);
+  } else {
+    for (uint32_t ii = 0; ii < bytes; ii++) {
+      dst[ii] = src[ii];
+    }
+  }
+}
+
+inline bool waitFd(const int fd, const short events) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = events;
+  pfd.revents = 0;
+  return (::poll(&pfd, 1, -1) >= 0) || (EINTR == errno);
+}
+
+} // namespace
+
+TtvChannel::TtvChannel(const int fd, const uint32_t bufferBytes)
+    : mFd(fd),
+      mBufferBytes((bufferBytes > CHANNEL_FRAME_HEADER_BYTES)
+                       ? bufferBytes
+                       : static_cast<uint32_t>(CHANNEL_DEFAULT_BUFFER_BYTES)) {
+  struct stat status;
+  mIsSocket = (0 == ::fstat(fd, &status)) && S_ISSOCK(status.st_mode);
+  mSendBuffer.resize(mBufferBytes);
+  mRecvBuffer.resize(mBufferBytes);
+}
+
+int TtvChannel::getFd() const { return mFd; }
+
+uint32_t TtvChannel::getPendingBytes() const { return mSendBytes; }
+
+bool TtvChannel::isEof() const { return mEof; }
+
+uint8_t *TtvChannel::reserve(const uint32_t bytes) {
+  // a frame larger than the buffer grows it, the pending frames are kept
+  if (mSendBytes + bytes > mSendBuffer.size()) {
+    mSendBuffer.resize(mSendBytes + bytes);
+  }
+  uint8_t *dst = mSendBuffer.data() + mSendBytes;
+  mSendBytes += bytes;
+  return dst;
+}
+
+bool TtvChannel::write(const TtvBox &box) {
+  // pack the box right behind its header into the free space of the send
+  // buffer, the length is computed only if the box doesn't fit
+  uint32_t length = 0;
+  uint8_t *header = mSendBuffer.data() + mSendBytes;
+  const uint32_t space =
+      static_cast<uint32_t>(mSendBuffer.size()) - mSendBytes;
+  if ((space <= CHANNEL_FRAME_HEADER_BYTES) ||
+      !box.pack(header + CHANNEL_FRAME_HEADER_BYTES,
+                space - CHANNEL_FRAME_HEADER_BYTES, length)) {
+    length = box.computePackedBytes();
+    if (length > CHANNEL_MAX_FRAME_BYTES) {
+      TTV_LOGE("Error: the frame of %d bytes is too large.", length);
+      return false;
+    }
+    // a frame larger than the buffer grows it
+    if (!flush()) {
+      return false;
+    }
+    if (CHANNEL_FRAME_HEADER_BYTES + length > mSendBuffer.size()) {
+      mSendBuffer.resize(CHANNEL_FRAME_HEADER_BYTES + length);
+    }
+    header = mSendBuffer.data();
+    box.pack(header + CHANNEL_FRAME_HEADER_BYTES, length, length);
+  }
+  encodeFrameHeader(length, box.getLayout(),
+                    box.hasVarint() ? CHANNEL_FLAG_VARINT : 0, header);
+  mSendBytes += CHANNEL_FRAME_HEADER_BYTES + length;
+  return (mSendBytes < mBufferBytes) || flush();
+}
+
+bool TtvChannel::write(const uint8_t *buffer, const uint32_t buffersize,
+                       const uint8_t layout, const uint8_t flags) {
+  if (buffersize > CHANNEL_MAX_FRAME_BYTES) {
+    TTV_LOGE("Error: the frame of %d bytes is too large.", buffersize);
+    return false;
+  }
+  if (0 != (flags & ~CHANNEL_FLAGS_SUPPORTED)) {
+    TTV_LOGE("Error: the frame flags 0x%X are unknown.", flags);
+    return false;
+  }
+  if (buffersize < CHANNEL_COPY_BYTES) {
+    if ((mSendBytes > 0) &&
+        (mSendBytes + CHANNEL_FRAME_HEADER_BYTES + buffersize > mBufferBytes) &&
+        !flush()) {
+      return false;
+    }
+    uint8_t *header = reserve(CHANNEL_FRAME_HEADER_BYTES + buffersize);
+    encodeFrameHeader(buffersize, layout, flags, header);
+    copySmall(header + CHANNEL_FRAME_HEADER_BYTES, buffer, buffersize);
+    return (mSendBytes < mBufferBytes) || flush();
+  }
+
+  // send the pending frames and the large buffer by one system call
+  encodeFrameHeader(buffersize, layout, flags,
+                    reserve(CHANNEL_FRAME_HEADER_BYTES));
+  struct iovec iov[2];
+  iov[0].iov_base = mSendBuffer.data();
+  iov[0].iov_len = mSendBytes;
+  iov[1].iov_base = const_cast<uint8_t *>(buffer);
+  iov[1].iov_len = buffersize;
+  mSendBytes = 0;
+  return sendAll(iov, 2);
+}
+
+bool TtvChannel::flush() {
+  if (0 == mSendBytes) {
+    return true;
+  }
+  struct iovec iov;
+  iov.iov_base = mSendBuffer.data();
+  iov.iov_len = mSendBytes;
+  mSendBytes = 0;
+  return sendAll(&iov, 1);
+}
+
+bool TtvChannel::sendAll(struct iovec *iov, int count) {
+  while (count > 0) {
+    ssize_t bytes = 0;
+    if (mIsSocket) {
+      // a closed peer is reported by EPIPE instead of killing the process
+      struct msghdr msg;
+      ::memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = count;
+      bytes = ::sendmsg(mFd, &msg, MSG_NOSIGNAL);
+    } else {
+      bytes = ::writev(mFd, iov, count);
+    }
+    if (bytes < 0) {
+      if ((EINTR == errno) ||
+          (((EAGAIN == errno) || (EWOULDBLOCK == errno)) &&
+           waitFd(mFd, POLLOUT))) {
+        continue;
+      }
+      TTV_LOGE("Error: failed to send the frames: %s.", strerror(errno));
+      return false;
+    }
+
+    // skip the bytes sent, a partial write may stop inside an iovec
+    size_t sent = static_cast<size_t>(bytes);
+    while ((count > 0) && (sent >= iov->iov_len)) {
+      sent -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + sent;
+      iov->iov_len -= sent;
+    }
+  }
+  return true;
+}
+
+int TtvChannel::parseFrame(uint32_t &length, uint8_t &layout,
+                           uint8_t &flags) const {
+  const uint32_t available = mRecvEnd - mRecvBegin;
+  if (available < CHANNEL_FRAME_HEADER_BYTES) {
+    return FRAME_PARTIAL;
+  }
+  const uint8_t *header = mRecvBuffer.data() + mRecvBegin;
+  ::memcpy(&length, header, sizeof(uint32_t));
+  length = ntohl(length);
+  layout = header[4];
+  flags = header[5];
+  if ((length > CHANNEL_MAX_FRAME_BYTES) || (layout > LAYOUT_ALIGNED) ||
+      (0 != (flags & ~CHANNEL_FLAGS_SUPPORTED)) || (0 != header[6]) ||
+      (0 != header[7])) {
+    return FRAME_MALFORMED;
+  }
+  return (available - CHANNEL_FRAME_HEADER_BYTES >= length) ? FRAME_COMPLETE
+                                                            : FRAME_PARTIAL;
+}
+
+bool TtvChannel::receive() {
+  // move the partial frame to the front and make room for the whole frame
+  const uint32_t unread = mRecvEnd - mRecvBegin;
+  if (mRecvBegin > 0) {
+    ::memmove(mRecvBuffer.data(), mRecvBuffer.data() + mRecvBegin, unread);
+    mRecvBegin = 0;
+    mRecvEnd = unread;
+  }
+  if (unread >= CHANNEL_FRAME_HEADER_BYTES) {
+    uint32_t length = 0;
+    ::memcpy(&length, mRecvBuffer.data(), sizeof(uint32_t));
+    const size_t frameBytes = CHANNEL_FRAME_HEADER_BYTES + ntohl(length);
+    if (frameBytes > mRecvBuffer.size()) {
+      mRecvBuffer.resize(frameBytes);
+    }
+  }
+
+  for (;;) {
+    const ssize_t bytes = ::read(mFd, mRecvBuffer.data() + mRecvEnd,
+                                 mRecvBuffer.size() - mRecvEnd);
+    if (bytes > 0) {
+      mRecvEnd += static_cast<uint32_t>(bytes);
+      return true;
+    }
+    if (0 == bytes) {
+      if (0 == unread) {
+        mEof = true;
+      } else {
+        TTV_LOGE("Error: the stream ends inside a frame.");
+      }
+      return false;
+    }
+    if ((EINTR == errno) ||
+        (((EAGAIN == errno) || (EWOULDBLOCK == errno)) &&
+         waitFd(mFd, POLLIN))) {
+      continue;
+    }
+    TTV_LOGE("Error: failed to receive the frames: %s.", strerror(errno));
+    return false;
+  }
+}
+
+bool TtvChannel::read(const uint8_t **buffer, uint32_t &buffersize,
+                      uint8_t &layout, uint8_t &flags) {
+  uint32_t length = 0;
+  for (;;) {
+    const int status = parseFrame(length, layout, flags);
+    if (FRAME_MALFORMED == status) {
+      TTV_LOGE("Error: the frame header is malformed.");
+      return false;
+    }
+    if (FRAME_COMPLETE == status) {
+      break;
+    }
+    if (!receive()) {
+      return false;
+    }
+  }
+
+  *buffer = mRecvBuffer.data() + mRecvBegin + CHANNEL_FRAME_HEADER_BYTES;
+  buffersize = length;
+  mRecvBegin += CHANNEL_FRAME_HEADER_BYTES + length;
+  return true;
+}
+
+bool TtvChannel::read(TtvView &view) {
+  const uint8_t *frame = nullptr;
+  uint32_t length = 0;
+  uint8_t layout = LAYOUT_COMPACT;
+  uint8_t flags = 0;
+  return read(&frame, length, layout, flags) &&
+         view.reset(frame, length, layout);
+}
+
+bool TtvChannel::read(TtvBox &box) {
+  TtvView view;
+  if (!read(view)) {
+    return false;
+  }
+  box.setLayout(view.getLayout());
+  return box.unpack(view.getBuffer(), view.getSize());
+}
+
+} // namespace ttv
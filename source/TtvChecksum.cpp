@@ -0,0 +1,137 @@
+/*
+ *  @file     TtvChecksum.cpp
+ *  @brief    CRC32C (Castagnoli) checksum of ttv payloads
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvChecksum.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace ttv {
+
+namespace {
+
+// reversed polynomial of CRC32C
+const uint32_t kCrc32cPoly = 0x82F63B78;
+
+// tables for slicing-by-8, kTable[0] is the classic byte-wise table
+struct Crc32cTable {
+  uint32_t table[8][256];
+
+  Crc32cTable() {
+    for (uint32_t ii = 0; ii < 256; ii++) {
+      uint32_t crc = ii;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ kCrc32cPoly : (crc >> 1);
+      }
+      table[0][ii] = crc;
+    }
+    for (uint32_t ii = 0; ii < 256; ii++) {
+      for (int slice = 1; slice < 8; slice++) {
+        const uint32_t crc = table[slice - 1][ii];
+        table[slice][ii] = (crc >> 8) ^ table[0][crc & 0xFF];
+      }
+    }
+  }
+};
+
+const Crc32cTable &getCrc32cTable() {
+  static const Crc32cTable table;
+  return table;
+}
+
+uint32_t crc32cTable(uint32_t crc, const uint8_t *data, size_t length) {
+  const Crc32cTable &t = getCrc32cTable();
+  while (length >= sizeof(uint64_t)) {
+    uint64_t word = 0;
+    ::memcpy(&word, data, sizeof(uint64_t));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    word ^= crc;
+    crc = t.table[7][word & 0xFF] ^ t.table[6][(word >> 8) & 0xFF] ^
+          t.table[5][(word >> 16) & 0xFF] ^ t.table[4][(word >> 24) & 0xFF] ^
+          t.table[3][(word >> 32) & 0xFF] ^ t.table[2][(word >> 40) & 0xFF] ^
+          t.table[1][(word >> 48) & 0xFF] ^ t.table[0][word >> 56];
+    data += sizeof(uint64_t);
+    length -= sizeof(uint64_t);
+  }
+  while (length-- > 0) {
+    crc = (crc >> 8) ^ t.table[0][(crc ^ *data++) & 0xFF];
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) uint32_t
+crc32cHardware(uint32_t crc, const uint8_t *data, size_t length) {
+  uint64_t crc64 = crc;
+  while (length >= sizeof(uint64_t)) {
+    uint64_t word = 0;
+    ::memcpy(&word, data, sizeof(uint64_t));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += sizeof(uint64_t);
+    length -= sizeof(uint64_t);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  while (length-- > 0) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return crc;
+}
+
+bool hasCrc32cInstructions() { return __builtin_cpu_supports("sse4.2"); }
+#elif defined(__aarch64__) && defined(__linux__)
+__attribute__((target("+crc"))) uint32_t
+crc32cHardware(uint32_t crc, const uint8_t *data, size_t length) {
+  while (length >= sizeof(uint64_t)) {
+    uint64_t word = 0;
+    ::memcpy(&word, data, sizeof(uint64_t));
+    crc = __crc32cd(crc, word);
+    data += sizeof(uint64_t);
+    length -= sizeof(uint64_t);
+  }
+  while (length-- > 0) {
+    crc = __crc32cb(crc, *data++);
+  }
+  return crc;
+}
+
+bool hasCrc32cInstructions() { return getauxval(AT_HWCAP) & HWCAP_CRC32; }
+#else
+uint32_t crc32cHardware(uint32_t crc, const uint8_t *data, size_t length) {
+  return crc32cTable(crc, data, length);
+}
+
+bool hasCrc32cInstructions() { return false; }
+#endif
+
+typedef uint32_t (*Crc32cFunc)(uint32_t, const uint8_t *, size_t);
+
+Crc32cFunc getCrc32cFunc() {
+  static const Crc32cFunc func =
+      hasCrc32cInstructions() ? crc32cHardware : crc32cTable;
+  return func;
+}
+
+} // namespace
+
+uint32_t crc32c(const uint32_t crc, const void *data, const size_t length) {
+  // the state is kept inverted between calls so that they can be chained
+  return ~getCrc32cFunc()(~crc, static_cast<const uint8_t *>(data), length);
+}
+
+uint32_t crc32cSoftware(const uint32_t crc, const void *data,
+                        const size_t length) {
+  return ~crc32cTable(~crc, static_cast<const uint8_t *>(data), length);
+}
+
+} // namespace ttv
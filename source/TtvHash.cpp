@@ -0,0 +1,196 @@
+/*
+ *  @file     TtvHash.cpp
+ *  @brief    TTV hash, a fast non-cryptographic hash (XXH64) of byte streams
+ *  to key caches by the content of ttv boxes
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvHash.h"
+#include <string.h>
+
+namespace ttv {
+
+namespace {
+
+const uint64_t kPrime1 = 11400714785074694791ULL;
+const uint64_t kPrime2 = 14029467366897019727ULL;
+const uint64_t kPrime3 = 1609587929392839161ULL;
+const uint64_t kPrime4 = 9650029242287828579ULL;
+const uint64_t kPrime5 = 2870177450012600261ULL;
+
+inline uint64_t rotateLeft(const uint64_t value, const int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// the hash is defined over little-endian words
+inline uint64_t load64(const uint8_t *data) {
+  uint64_t value;
+  ::memcpy(&value, data, sizeof(uint64_t));
+  return le64toh(value);
+}
+
+inline uint32_t load32(const uint8_t *data) {
+  uint32_t value;
+  ::memcpy(&value, data, sizeof(uint32_t));
+  return le32toh(value);
+}
+
+inline uint64_t round(uint64_t lane, const uint64_t input) {
+  lane += input * kPrime2;
+  lane = rotateLeft(lane, 31);
+  return lane * kPrime1;
+}
+
+inline uint64_t mergeRound(uint64_t hash, const uint64_t lane) {
+  hash ^= round(0, lane);
+  return hash * kPrime1 + kPrime4;
+}
+
+inline void initLanes(uint64_t *lanes, const uint64_t seed) {
+  lanes[0] = seed + kPrime1 + kPrime2;
+  lanes[1] = seed + kPrime2;
+  lanes[2] = seed;
+  lanes[3] = seed - kPrime1;
+}
+
+// consume the whole stripes of the data for N hashes of different seeds,
+// each word is loaded once for all of them, return the number of bytes
+// consumed
+template <int N>
+inline size_t consumeStripes(uint64_t (*lanes)[4], const uint8_t *data,
+                             const size_t size) {
+  uint64_t acc[N][4];
+  ::memcpy(acc, lanes, sizeof(acc));
+  const uint8_t *end = data + (size & ~static_cast<size_t>(31));
+  const uint8_t *ptr = data;
+  for (; ptr < end; ptr += 32) {
+    const uint64_t word0 = load64(ptr);
+    const uint64_t word1 = load64(ptr + 8);
+    const uint64_t word2 = load64(ptr + 16);
+    const uint64_t word3 = load64(ptr + 24);
+    for (int nn = 0; nn < N; nn++) {
+      acc[nn][0] = round(acc[nn][0], word0);
+      acc[nn][1] = round(acc[nn][1], word1);
+      acc[nn][2] = round(acc[nn][2], word2);
+      acc[nn][3] = round(acc[nn][3], word3);
+    }
+  }
+  ::memcpy(lanes, acc, sizeof(acc));
+  return static_cast<size_t>(ptr - data);
+}
+
+// hash more bytes into the lanes, the bytes of a stripe not complete yet are
+// kept in the stripe
+template <int N>
+void updateLanes(uint64_t (*lanes)[4], uint8_t *stripe, uint32_t &stripeBytes,
+                 const uint8_t *ptr, size_t remaining) {
+  // complete the pending stripe first
+  if (stripeBytes > 0) {
+    const size_t bytes = (remaining < 32 - stripeBytes)
+                             ? remaining
+                             : static_cast<size_t>(32 - stripeBytes);
+    ::memcpy(stripe + stripeBytes, ptr, bytes);
+    stripeBytes += static_cast<uint32_t>(bytes);
+    ptr += bytes;
+    remaining -= bytes;
+    if (stripeBytes < 32) {
+      return;
+    }
+    consumeStripes<N>(lanes, stripe, 32);
+    stripeBytes = 0;
+  }
+
+  const size_t consumed = consumeStripes<N>(lanes, ptr, remaining);
+  ptr += consumed;
+  remaining -= consumed;
+  if (remaining > 0) {
+    ::memcpy(stripe, ptr, remaining);
+    stripeBytes = static_cast<uint32_t>(remaining);
+  }
+}
+
+uint64_t digestLanes(const uint64_t *lanes, const uint64_t seed,
+                     const uint64_t totalBytes, const uint8_t *stripe,
+                     const uint32_t stripeBytes) {
+  uint64_t hash = 0;
+  if (totalBytes >= 32) {
+    hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) +
+           rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+    for (int ii = 0; ii < 4; ii++) {
+      hash = mergeRound(hash, lanes[ii]);
+    }
+  } else {
+    hash = seed + kPrime5;
+  }
+  hash += totalBytes;
+
+  // the tail shorter than a stripe
+  const uint8_t *ptr = stripe;
+  const uint8_t *end = stripe + stripeBytes;
+  for (; ptr + 8 <= end; ptr += 8) {
+    hash ^= round(0, load64(ptr));
+    hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+  }
+  if (ptr + 4 <= end) {
+    hash ^= static_cast<uint64_t>(load32(ptr)) * kPrime1;
+    hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+    ptr += 4;
+  }
+  for (; ptr < end; ptr++) {
+    hash ^= (*ptr) * kPrime5;
+    hash = rotateLeft(hash, 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+} // namespace
+
+TtvHasher::TtvHasher(const uint64_t seed) : mSeed(seed) {
+  initLanes(mLanes, seed);
+}
+
+void TtvHasher::update(const void *data, const size_t size) {
+  mTotalBytes += size;
+  updateLanes<1>(&mLanes, mStripe, mStripeBytes,
+                 static_cast<const uint8_t *>(data), size);
+}
+
+uint64_t TtvHasher::digest() const {
+  return digestLanes(mLanes, mSeed, mTotalBytes, mStripe, mStripeBytes);
+}
+
+TtvHasher128::TtvHasher128(const uint64_t lowSeed, const uint64_t highSeed) {
+  mSeeds[0] = lowSeed;
+  mSeeds[1] = highSeed;
+  initLanes(mLanes[0], lowSeed);
+  initLanes(mLanes[1], highSeed);
+}
+
+void TtvHasher128::update(const void *data, const size_t size) {
+  mTotalBytes += size;
+  updateLanes<2>(mLanes, mStripe, mStripeBytes,
+                 static_cast<const uint8_t *>(data), size);
+}
+
+TtvHash128 TtvHasher128::digest() const {
+  TtvHash128 result;
+  result.low =
+      digestLanes(mLanes[0], mSeeds[0], mTotalBytes, mStripe, mStripeBytes);
+  result.high =
+      digestLanes(mLanes[1], mSeeds[1], mTotalBytes, mStripe, mStripeBytes);
+  return result;
+}
+
+uint64_t hashBytes(const void *data, const size_t size, const uint64_t seed) {
+  TtvHasher hasher(seed);
+  hasher.update(data, size);
+  return hasher.digest();
+}
+
+} // namespace ttv
@@ -0,0 +1,86 @@
+/*
+ *  @file     TtvHeader.cpp
+ *  @brief    TTV header, the header written in front of a packed ttv box
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvHeader.h"
+#include <string.h>
+
+namespace ttv {
+
+bool isExtendedHeader(const uint8_t *buffer) {
+  return 0 == ::memcmp(buffer, TTV_HEADER_MAGIC, sizeof(TTV_HEADER_MAGIC));
+}
+
+void encodeHeader(const TtvHeader &header, uint8_t *buffer) {
+  ::memcpy(buffer, TTV_HEADER_MAGIC, sizeof(TTV_HEADER_MAGIC));
+  buffer[4] = header.version;
+  // the fields after EXTENDED_HEADER_BYTES are not known to this writer
+  buffer[5] = EXTENDED_HEADER_BYTES;
+  const uint16_t flags = htons(header.flags);
+  ::memcpy(buffer + 6, &flags, sizeof(uint16_t));
+  const uint32_t payloadBytes = htonl(header.payloadBytes);
+  ::memcpy(buffer + 8, &payloadBytes, sizeof(uint32_t));
+  const uint32_t checksum = htonl(header.checksum);
+  ::memcpy(buffer + 12, &checksum, sizeof(uint32_t));
+}
+
+bool decodeHeader(const uint8_t *buffer, TtvHeader &header,
+                  const uint16_t supportedFlags) {
+  if (!isExtendedHeader(buffer)) {
+    TTV_LOGE("Error: the header magic doesn't match.");
+    return false;
+  }
+  header.version = buffer[4];
+  header.headerBytes = buffer[5];
+  if ((HEADER_VERSION != header.version) ||
+      (header.headerBytes < EXTENDED_HEADER_BYTES)) {
+    TTV_LOGE("Error: unsupported header version %d.", header.version);
+    return false;
+  }
+  uint16_t flags = 0;
+  ::memcpy(&flags, buffer + 6, sizeof(uint16_t));
+  header.flags = ntohs(flags);
+  if (header.flags & ~supportedFlags) {
+    TTV_LOGE("Error: unsupported header flags 0x%04X.", header.flags);
+    return false;
+  }
+  uint32_t payloadBytes = 0;
+  ::memcpy(&payloadBytes, buffer + 8, sizeof(uint32_t));
+  header.payloadBytes = ntohl(payloadBytes);
+  uint32_t checksum = 0;
+  ::memcpy(&checksum, buffer + 12, sizeof(uint32_t));
+  header.checksum = ntohl(checksum);
+  return true;
+}
+
+bool locateHeader(const uint8_t *buffer, const size_t buffersize,
+                  size_t &offset, TtvHeader &header) {
+  const uint8_t *cursor = buffer;
+  const uint8_t *const last = buffer + buffersize;
+  while (static_cast<size_t>(last - cursor) >= EXTENDED_HEADER_BYTES) {
+    // memchr skips the bytes which cannot start the magic at memory speed
+    cursor = static_cast<const uint8_t *>(
+        ::memchr(cursor, TTV_HEADER_MAGIC[0],
+                 last - cursor - EXTENDED_HEADER_BYTES + 1));
+    if (nullptr == cursor) {
+      break;
+    }
+    if (isExtendedHeader(cursor)) {
+      TtvHeader candidate;
+      const size_t remaining = last - cursor;
+      if (decodeHeader(cursor, candidate) &&
+          (candidate.headerBytes <= remaining) &&
+          (candidate.payloadBytes <= remaining - candidate.headerBytes)) {
+        offset = cursor - buffer;
+        header = candidate;
+        return true;
+      }
+    }
+    cursor++;
+  }
+  return false;
+}
+
+} // namespace ttv
@@ -0,0 +1,432 @@
+/*
+ *  @file     TtvPreprocess.cpp
+ *  @brief    TTV preprocessing, converts batches of images into the input of
+ *  a model as described by a preprocessing config box, see
+ *  demo/modelPreCfg.yaml
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvPreprocess.h"
+#include "include/TtvThreadPool.h"
+#include <fstream>
+#include <string.h>
+#include <string>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace ttv {
+
+namespace {
+
+// the image being converted by a kernel
+struct PreprocessImage {
+  const uint8_t *src;
+  float *dst;
+  uint32_t pixels;
+  uint32_t channels;
+  // the mean of each channel
+  const float *mean;
+  // the means in the CHW order, nullptr without a mean map
+  const float *meanMap;
+  float scale;
+};
+
+// convert the pixels in [begin, pixels) of an image, the kernels below use
+// the same operations so that the results are equal bit by bit
+void preprocessTable(const PreprocessImage &image, const uint32_t begin) {
+  for (uint32_t cc = 0; cc < image.channels; cc++) {
+    const uint8_t *src = image.src + cc;
+    float *dst = image.dst + static_cast<size_t>(cc) * image.pixels;
+    const float *meanMap =
+        image.meanMap ? image.meanMap + static_cast<size_t>(cc) * image.pixels
+                      : nullptr;
+    for (uint32_t ii = begin; ii < image.pixels; ii++) {
+      const float mean = meanMap ? meanMap[ii] : image.mean[cc];
+      dst[ii] = (static_cast<float>(src[ii * image.channels]) - mean) *
+                image.scale;
+    }
+  }
+}
+
+#if defined(__x86_64__)
+// convert 8 pixels of a channel from the low 8 bytes of a vector
+__attribute__((target("avx2"))) inline void
+convert8(const __m128i bytes, const float *meanMap, const __m256 mean,
+         const __m256 scale, float *dst) {
+  const __m256 value = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+  const __m256 means = meanMap ? _mm256_loadu_ps(meanMap) : mean;
+  _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_sub_ps(value, means), scale));
+}
+
+__attribute__((target("avx2"))) void
+preprocessHardware(const PreprocessImage &image) {
+  const uint32_t channels = image.channels;
+  if ((1 != channels) && (3 != channels)) {
+    preprocessTable(image, 0);
+    return;
+  }
+
+  // the shuffles gathering a channel of 16 pixels out of 48 bytes
+  const __m128i shuffles[3][3] = {
+      {_mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                     -1),
+       _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1,
+                     -1),
+       _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10,
+                     13)},
+      {_mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                     -1),
+       _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1,
+                     -1),
+       _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11,
+                     14)},
+      {_mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                     -1),
+       _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1,
+                     -1),
+       _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12,
+                     15)}};
+  const __m256 scale = _mm256_set1_ps(image.scale);
+  __m256 means[3];
+  for (uint32_t cc = 0; cc < channels; cc++) {
+    means[cc] = _mm256_set1_ps(image.mean[cc]);
+  }
+
+  uint32_t ii = 0;
+  for (; ii + 16 <= image.pixels; ii += 16) {
+    const uint8_t *src = image.src + static_cast<size_t>(ii) * channels;
+    __m128i planes[3];
+    if (1 == channels) {
+      planes[0] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    } else {
+      const __m128i first =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+      const __m128i second =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+      const __m128i third =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32));
+      for (uint32_t cc = 0; cc < 3; cc++) {
+        planes[cc] = _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(first, shuffles[cc][0]),
+                         _mm_shuffle_epi8(second, shuffles[cc][1])),
+            _mm_shuffle_epi8(third, shuffles[cc][2]));
+      }
+    }
+    for (uint32_t cc = 0; cc < channels; cc++) {
+      const size_t offset = static_cast<size_t>(cc) * image.pixels + ii;
+      const float *meanMap = image.meanMap ? image.meanMap + offset : nullptr;
+      convert8(planes[cc], meanMap, means[cc], scale, image.dst + offset);
+      convert8(_mm_srli_si128(planes[cc], 8), meanMap ? meanMap + 8 : nullptr,
+               means[cc], scale, image.dst + offset + 8);
+    }
+  }
+  preprocessTable(image, ii);
+}
+
+bool hasSimdInstructions() { return __builtin_cpu_supports("avx2"); }
+#elif defined(__aarch64__)
+// convert 4 pixels of a channel
+inline void convert4(const uint32x4_t bytes, const float *meanMap,
+                     const float32x4_t mean, const float32x4_t scale,
+                     float *dst) {
+  const float32x4_t value = vcvtq_f32_u32(bytes);
+  const float32x4_t means = meanMap ? vld1q_f32(meanMap) : mean;
+  vst1q_f32(dst, vmulq_f32(vsubq_f32(value, means), scale));
+}
+
+void preprocessHardware(const PreprocessImage &image) {
+  const uint32_t channels = image.channels;
+  if ((1 != channels) && (3 != channels)) {
+    preprocessTable(image, 0);
+    return;
+  }
+
+  const float32x4_t scale = vdupq_n_f32(image.scale);
+  uint32_t ii = 0;
+  for (; ii + 16 <= image.pixels; ii += 16) {
+    const uint8_t *src = image.src + static_cast<size_t>(ii) * channels;
+    uint8x16x3_t planes;
+    if (1 == channels) {
+      planes.val[0] = vld1q_u8(src);
+    } else {
+      planes = vld3q_u8(src);
+    }
+    for (uint32_t cc = 0; cc < channels; cc++) {
+      const size_t offset = static_cast<size_t>(cc) * image.pixels + ii;
+      const float *meanMap = image.meanMap ? image.meanMap + offset : nullptr;
+      const float32x4_t mean = vdupq_n_f32(image.mean[cc]);
+      const uint16x8_t low = vmovl_u8(vget_low_u8(planes.val[cc]));
+      const uint16x8_t high = vmovl_high_u8(planes.val[cc]);
+      const uint32x4_t values[4] = {
+          vmovl_u16(vget_low_u16(low)), vmovl_high_u16(low),
+          vmovl_u16(vget_low_u16(high)), vmovl_high_u16(high)};
+      for (uint32_t jj = 0; jj < 4; jj++) {
+        convert4(values[jj], meanMap ? meanMap + jj * 4 : nullptr, mean, scale,
+                 image.dst + offset + jj * 4);
+      }
+    }
+  }
+  preprocessTable(image, ii);
+}
+
+// NEON is always present on aarch64
+bool hasSimdInstructions() { return true; }
+#else
+void preprocessHardware(const PreprocessImage &image) {
+  preprocessTable(image, 0);
+}
+
+bool hasSimdInstructions() { return false; }
+#endif
+
+void preprocessSoftware(const PreprocessImage &image) {
+  preprocessTable(image, 0);
+}
+
+typedef void (*PreprocessFunc)(const PreprocessImage &);
+
+PreprocessFunc getPreprocessFunc() {
+  static const PreprocessFunc func =
+      hasSimdInstructions() ? preprocessHardware : preprocessSoftware;
+  return func;
+}
+
+// read a config value of the expected type
+template <typename T>
+bool getConfigValue(const TtvBox &config, const uint8_t tag, const char *name,
+                    T &value) {
+  if (!config.getNumbericalValue<T>(tag, value)) {
+    TTV_LOGE("Error: missing or invalid %s (tag = %d) in the config.", name,
+             tag);
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool TtvPreprocessPlan::build(const TtvBox &config) {
+  mChannels = 0;
+  mMean.clear();
+  mMeanMap.clear();
+
+  uint32_t channels = 0;
+  if (!getConfigValue(config, PREPROCESS_TAG_INPUT_CHANNEL, "input_channel",
+                      channels) ||
+      !getConfigValue(config, PREPROCESS_TAG_INPUT_H, "input_h", mHeight) ||
+      !getConfigValue(config, PREPROCESS_TAG_INPUT_W, "input_w", mWidth) ||
+      !getConfigValue(config, PREPROCESS_TAG_MEAN_TYPE, "mean_type",
+                      mMeanType) ||
+      !getConfigValue(config, PREPROCESS_TAG_SCALE_VALUE, "scale_value",
+                      mScale)) {
+    return false;
+  }
+  if ((0 == channels) || (0 == mHeight) || (0 == mWidth) ||
+      (static_cast<uint64_t>(channels) * mHeight * mWidth > UINT32_MAX)) {
+    TTV_LOGE("Error: invalid input shape %u x %u x %u.", mHeight, mWidth,
+             channels);
+    return false;
+  }
+  if (!(mScale > 0.0f)) {
+    TTV_LOGE("Error: the scale value must be positive.");
+    return false;
+  }
+
+  mMean.assign(channels, 0.0f);
+  if (MEAN_TYPE_VALUE == mMeanType) {
+    // the mean values are given for the first 3 channels at most
+    const uint8_t tags[] = {PREPROCESS_TAG_MEAN_VALUE_R,
+                            PREPROCESS_TAG_MEAN_VALUE_G,
+                            PREPROCESS_TAG_MEAN_VALUE_B};
+    const char *names[] = {"mean_value_r", "mean_value_g", "mean_value_b"};
+    if (channels > 3) {
+      TTV_LOGE("Error: %u channels have no mean value.", channels);
+      return false;
+    }
+    for (uint32_t cc = 0; cc < channels; cc++) {
+      if (!getConfigValue(config, tags[cc], names[cc], mMean[cc])) {
+        return false;
+      }
+    }
+  } else if (MEAN_TYPE_MAP == mMeanType) {
+    // the mean map is a tensor of the config, or the path of a text file
+    uint8_t type = 0;
+    std::string file;
+    const bool loaded =
+        config.getType(PREPROCESS_TAG_MEAN_MAP, type) &&
+        ((TENSOR_T == type)
+             ? copyMeanMap(config, channels)
+             : (config.getStringValue(PREPROCESS_TAG_MEAN_MAP, file) &&
+                loadMeanMap(file, static_cast<size_t>(channels) * mHeight *
+                                      mWidth)));
+    if (!loaded) {
+      TTV_LOGE("Error: missing or invalid mean_map in the config.");
+      return false;
+    }
+  } else if (MEAN_TYPE_NONE != mMeanType) {
+    TTV_LOGE("Error: unsupported mean type %u.", mMeanType);
+    return false;
+  }
+
+  mChannels = channels;
+  return true;
+}
+
+bool TtvPreprocessPlan::run(const uint8_t *images, const uint32_t batch,
+                            float *output) const {
+  if (0 == mChannels) {
+    TTV_LOGE("Error: the plan is not built.");
+    return false;
+  }
+  const PreprocessFunc func = getPreprocessFunc();
+  for (uint32_t ii = 0; ii < batch; ii++) {
+    func({images + static_cast<size_t>(ii) * getInputBytes(),
+          output + static_cast<size_t>(ii) * getOutputSize(),
+          mHeight * mWidth, mChannels, mMean.data(),
+          mMeanMap.empty() ? nullptr : mMeanMap.data(), mScale});
+  }
+  return true;
+}
+
+bool TtvPreprocessPlan::run(const uint8_t *images, const uint32_t batch,
+                            float *output, TtvThreadPool &pool) const {
+  if (0 == mChannels) {
+    TTV_LOGE("Error: the plan is not built.");
+    return false;
+  }
+  const PreprocessFunc func = getPreprocessFunc();
+  pool.run(batch, [&](const uint32_t index) {
+    func({images + static_cast<size_t>(index) * getInputBytes(),
+          output + static_cast<size_t>(index) * getOutputSize(),
+          mHeight * mWidth, mChannels, mMean.data(),
+          mMeanMap.empty() ? nullptr : mMeanMap.data(), mScale});
+  });
+  return true;
+}
+
+bool TtvPreprocessPlan::runScalar(const uint8_t *images, const uint32_t batch,
+                                  float *output) const {
+  if (0 == mChannels) {
+    TTV_LOGE("Error: the plan is not built.");
+    return false;
+  }
+  for (uint32_t ii = 0; ii < batch; ii++) {
+    preprocessSoftware({images + static_cast<size_t>(ii) * getInputBytes(),
+                        output + static_cast<size_t>(ii) * getOutputSize(),
+                        mHeight * mWidth, mChannels, mMean.data(),
+                        mMeanMap.empty() ? nullptr : mMeanMap.data(), mScale});
+  }
+  return true;
+}
+
+uint32_t TtvPreprocessPlan::getChannels() const { return mChannels; }
+
+uint32_t TtvPreprocessPlan::getHeight() const { return mHeight; }
+
+uint32_t TtvPreprocessPlan::getWidth() const { return mWidth; }
+
+uint32_t TtvPreprocessPlan::getMeanType() const { return mMeanType; }
+
+uint32_t TtvPreprocessPlan::getInputBytes() const {
+  return mChannels * mHeight * mWidth;
+}
+
+uint32_t TtvPreprocessPlan::getOutputSize() const {
+  return mChannels * mHeight * mWidth;
+}
+
+bool TtvPreprocessPlan::copyMeanMap(const TtvBox &config,
+                                    const uint32_t channels) {
+  // the tensor holds the floats in the CHW order already, copy them so that
+  // the plan outlives the config
+  TtvTensorView view;
+  if (!config.getTensorView(PREPROCESS_TAG_MEAN_MAP, view) ||
+      (FLOAT_T != view.dtype) || (3 != view.rank) ||
+      (channels != view.shape[0]) || (mHeight != view.shape[1]) ||
+      (mWidth != view.shape[2])) {
+    TTV_LOGE("Error: the mean map is not a float tensor of %u x %u x %u.",
+             channels, mHeight, mWidth);
+    return false;
+  }
+  const float *data = static_cast<const float *>(view.data);
+  mMeanMap.assign(data, data + view.numElements);
+  return true;
+}
+
+bool TtvPreprocessPlan::loadMeanMap(const std::string &file,
+                                    const size_t size) {
+  std::ifstream in(file);
+  if (!in) {
+    TTV_LOGE("Error: failed to open the mean map %s.", file.c_str());
+    return false;
+  }
+  mMeanMap.resize(size);
+  size_t count = 0;
+  float mean = 0.0f;
+  while ((count < size) && (in >> mean)) {
+    mMeanMap[count++] = mean;
+  }
+  // the file must hold exactly one mean per channel and pixel
+  if ((count != size) || (in >> mean) || !in.eof()) {
+    TTV_LOGE("Error: the mean map %s doesn't hold %d floats.", file.c_str(),
+             (int)size);
+    mMeanMap.clear();
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<const TtvPreprocessPlan>
+TtvPreprocessCache::get(const TtvBox &config) {
+  const uint64_t key = config.hash();
+  // the config is compared in the compact layout, which a packed config in
+  // that layout gives without packing again
+  TtvBox compact = config.share();
+  compact.setLayout(LAYOUT_COMPACT);
+  compact.pack();
+  const uint8_t *packed = compact.getPackedBuffer();
+  const uint32_t packedBytes = compact.getPackedBytes();
+  auto isSameConfig = [packed, packedBytes](const Entry &entry) {
+    return (entry.config.size() == packedBytes) &&
+           (0 == ::memcmp(entry.config.data(), packed, packedBytes));
+  };
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mPlans.find(key);
+    if ((iter != mPlans.end()) && isSameConfig(iter->second)) {
+      return iter->second.plan;
+    }
+  }
+
+  // the plan is built outside the lock since a mean map is read from a file,
+  // the first plan inserted wins if several threads build the same config and
+  // a config sharing the hash of another one replaces it
+  std::shared_ptr<TtvPreprocessPlan> plan =
+      std::make_shared<TtvPreprocessPlan>();
+  if (!plan->build(config)) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(mMutex);
+  Entry &entry = mPlans[key];
+  if (!entry.plan || !isSameConfig(entry)) {
+    entry.config.assign(packed, packed + packedBytes);
+    entry.plan = std::move(plan);
+  }
+  return entry.plan;
+}
+
+uint32_t TtvPreprocessCache::size() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return static_cast<uint32_t>(mPlans.size());
+}
+
+void TtvPreprocessCache::clear() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  mPlans.clear();
+}
+
+} // namespace ttv
@@ -0,0 +1,190 @@
+/*
+ *  @file     TtvRecord.cpp
+ *  @brief    TTV record, the layout of a ttv object inside a packed ttv box
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvRecord.h"
+#include "include/TtvVarint.h"
+#include <string.h>
+
+namespace ttv {
+
+uint32_t getBasicTypeSize(const uint8_t type) {
+  switch (type) {
+  case BOOL_T:
+    return sizeof(bool);
+  case UINT8_T:
+    return sizeof(uint8_t);
+  case INT8_T:
+    return sizeof(int8_t);
+  case UINT16_T:
+    return sizeof(uint16_t);
+  case INT16_T:
+    return sizeof(int16_t);
+  case UINT32_T:
+    return sizeof(uint32_t);
+  case INT32_T:
+    return sizeof(int32_t);
+  case UINT64_T:
+    return sizeof(uint64_t);
+  case INT64_T:
+    return sizeof(int64_t);
+  case FLOAT_T:
+    return sizeof(float);
+  case DOUBLE_T:
+    return sizeof(double);
+  default:
+    return 0;
+  }
+}
+
+namespace {
+
+inline bool isStartEndRecord(const uint8_t tag, const uint8_t type) {
+  return ((START_TAG == tag) && (START_TYPE == type)) ||
+         ((END_TAG == tag) && (END_TYPE == type));
+}
+
+inline uint32_t alignUp(const uint32_t offset, const uint32_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// the offset of the length of a non basic value
+inline uint32_t getLengthOffset(const uint32_t offset, const uint8_t layout) {
+  const uint32_t lengthOffset = offset + sizeof(uint8_t) + sizeof(uint8_t);
+  return (LAYOUT_ALIGNED == layout) ? alignUp(lengthOffset, sizeof(uint32_t))
+                                    : lengthOffset;
+}
+
+} // namespace
+
+uint32_t getValueAlignment(const uint8_t type, const uint32_t length,
+                           const uint8_t layout) {
+  if (LAYOUT_ALIGNED != layout) {
+    return 1;
+  }
+  if (type <= BASIC_TYPE_MAX) {
+    return (length > 0) ? length : 1;
+  }
+  if (type <= FIXED_TYPE_MAX) {
+    return 1;
+  }
+  return (length >= LARGE_VALUE_BYTES) ? LARGE_VALUE_ALIGNMENT
+                                       : VALUE_ALIGNMENT;
+}
+
+namespace {
+
+// the body of layoutRecord(), inlined into readRecord() which runs once per
+// record of every unpack and view
+inline void locateRecord(const uint32_t offset, const uint8_t tag,
+                         const uint8_t type, const uint32_t length,
+                         const uint8_t layout, TtvRecord &record) {
+  record.tag = tag;
+  record.type = type;
+  record.length = length;
+  record.offset = offset;
+
+  // the tag and type of start and end is to indicate the start and the end to
+  // store data for the start and the end, store the tag and type only.
+  uint32_t valueOffset = offset + sizeof(uint8_t) + sizeof(uint8_t);
+  if (isStartEndRecord(tag, type)) {
+    record.length = 0;
+  } else {
+    // for basice types like char, int, float, the storage format is tag +
+    // type + value, for other non-basice types like string, char *, class,
+    // structure, the storage format is tag + type + length + value
+    if (type > FIXED_TYPE_MAX) {
+      valueOffset = getLengthOffset(offset, layout) + sizeof(uint32_t);
+    }
+    valueOffset =
+        alignUp(valueOffset, getValueAlignment(type, length, layout));
+  }
+  record.valueOffset = valueOffset;
+  record.size = valueOffset + record.length - offset;
+}
+
+} // namespace
+
+void layoutRecord(const uint32_t offset, const uint8_t tag, const uint8_t type,
+                  const uint32_t length, const uint8_t layout,
+                  TtvRecord &record) {
+  locateRecord(offset, tag, type, length, layout, record);
+}
+
+void writeRecordHeader(uint8_t *buffer, const TtvRecord &record,
+                       const uint8_t layout) {
+  uint8_t *dst = buffer + record.offset;
+  dst[0] = record.tag;
+  dst[1] = record.type;
+  if (isStartEndRecord(record.tag, record.type)) {
+    return;
+  }
+
+  const uint32_t headerBytes = record.valueOffset - record.offset;
+  ::memset(dst + sizeof(uint8_t) + sizeof(uint8_t), 0,
+           headerBytes - sizeof(uint8_t) - sizeof(uint8_t));
+  if (record.type > FIXED_TYPE_MAX) {
+    const uint32_t length = htonl(record.length);
+    ::memcpy(buffer + getLengthOffset(record.offset, layout), &length,
+             sizeof(uint32_t));
+  }
+}
+
+void writeRecord(uint8_t *buffer, const TtvRecord &record, const void *value,
+                 const uint8_t layout) {
+  writeRecordHeader(buffer, record, layout);
+  if (record.length > 0) {
+    ::memcpy(buffer + record.valueOffset, value,
+             static_cast<size_t>(record.length));
+  }
+}
+
+bool readRecord(const uint8_t *buffer, const uint32_t buffersize,
+                const uint32_t offset, TtvRecord &record,
+                const uint8_t layout) {
+  if ((offset >= buffersize) ||
+      (buffersize - offset < sizeof(uint8_t) + sizeof(uint8_t))) {
+    return false;
+  }
+  const uint8_t tag = buffer[offset];
+  const uint8_t type = buffer[offset + sizeof(uint8_t)];
+
+  uint32_t length = 0;
+  if (isStartEndRecord(tag, type)) {
+    length = 0;
+  } else if (isVarintType(type)) {
+    // a varint ends at the first byte without the continuation bit
+    const uint32_t valueOffset = offset + sizeof(uint8_t) + sizeof(uint8_t);
+    uint64_t value = 0;
+    length = decodeVarint(buffer + valueOffset, buffersize - valueOffset, value);
+    if (0 == length) {
+      return false;
+    }
+  } else if (type <= FIXED_TYPE_MAX) {
+    // the size of a value without a length must be known to the reader
+    length = getBasicTypeSize(type);
+    if (0 == length) {
+      return false;
+    }
+  } else if (type != END_TYPE) {
+    // every other type carries a length, so the types added by newer writers
+    // are skipped by older readers
+    const uint32_t lengthOffset = getLengthOffset(offset, layout);
+    if ((lengthOffset > buffersize) ||
+        (buffersize - lengthOffset < sizeof(uint32_t))) {
+      return false;
+    }
+    ::memcpy(&length, buffer + lengthOffset, sizeof(uint32_t));
+    length = ntohl(length);
+  } else {
+    return false;
+  }
+
+  locateRecord(offset, tag, type, length, layout, record);
+  return (record.valueOffset <= buffersize) &&
+         (record.length <= buffersize - record.valueOffset);
+}
+
+} // namespace ttv
@@ -0,0 +1,90 @@
+/*
+ *  @file     TtvRepeated.cpp
+ *  @brief    TTV repeated, the value of a ttv object with the type
+ *  REPEATED_TTV_T, i.e. a list of packed ttv boxes
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvRepeated.h"
+#include <string.h>
+
+namespace ttv {
+
+namespace {
+
+inline uint32_t loadBigEndian(const uint8_t *buffer) {
+  uint32_t value = 0;
+  ::memcpy(&value, buffer, sizeof(uint32_t));
+  return ntohl(value);
+}
+
+inline void storeBigEndian(uint8_t *buffer, const uint32_t value) {
+  const uint32_t newvalue = htonl(value);
+  ::memcpy(buffer, &newvalue, sizeof(uint32_t));
+}
+
+// the size of the count and the offsets
+inline uint64_t getRepeatedHeaderBytes(const uint32_t count) {
+  return REPEATED_COUNT_BYTES +
+         (static_cast<uint64_t>(count) + 1) * REPEATED_OFFSET_BYTES;
+}
+
+} // namespace
+
+uint64_t getRepeatedBytes(const uint32_t count, const uint32_t *lengths) {
+  uint64_t bytes = getRepeatedHeaderBytes(count);
+  for (uint32_t ii = 0; ii < count; ii++) {
+    bytes += lengths[ii];
+  }
+  return bytes;
+}
+
+void encodeRepeated(const uint32_t count, const uint8_t *const *elements,
+                    const uint32_t *lengths, uint8_t *buffer) {
+  storeBigEndian(buffer, count);
+  uint8_t *offsets = buffer + REPEATED_COUNT_BYTES;
+  uint32_t offset = static_cast<uint32_t>(getRepeatedHeaderBytes(count));
+  for (uint32_t ii = 0; ii < count; ii++) {
+    storeBigEndian(offsets + ii * REPEATED_OFFSET_BYTES, offset);
+    if (lengths[ii] > 0) {
+      ::memcpy(buffer + offset, elements[ii], lengths[ii]);
+    }
+    offset += lengths[ii];
+  }
+  storeBigEndian(offsets + count * REPEATED_OFFSET_BYTES, offset);
+}
+
+bool decodeRepeated(const uint8_t *value, const uint32_t length,
+                    TtvRepeatedView &view) {
+  if (length < REPEATED_COUNT_BYTES) {
+    return false;
+  }
+  const uint32_t count = loadBigEndian(value);
+  if (getRepeatedHeaderBytes(count) > length) {
+    return false;
+  }
+  view.count = count;
+  view.value = value;
+  view.length = length;
+  return true;
+}
+
+bool getRepeatedElement(const TtvRepeatedView &view, const uint32_t index,
+                        const uint8_t **element, uint32_t &length) {
+  if (index >= view.count) {
+    return false;
+  }
+  const uint8_t *offsets = view.value + REPEATED_COUNT_BYTES;
+  const uint32_t begin = loadBigEndian(offsets + index * REPEATED_OFFSET_BYTES);
+  const uint32_t end =
+      loadBigEndian(offsets + (index + 1) * REPEATED_OFFSET_BYTES);
+  if ((begin < getRepeatedHeaderBytes(view.count)) || (begin > end) ||
+      (end > view.length)) {
+    return false;
+  }
+  *element = view.value + begin;
+  length = end - begin;
+  return true;
+}
+
+} // namespace ttv
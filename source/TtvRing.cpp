@@ -0,0 +1,226 @@
+/*
+ *  @file     TtvRing.cpp
+ *  @brief    TTV ring class, a lock-free ring of preallocated slots which
+ *  hands packed ttv boxes between threads without copying them twice
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvRing.h"
+#include <new>
+#include <string.h>
+
+namespace ttv {
+
+// the header of a slot, the sequence follows the bounded queue of Dmitry
+// Vyukov: it equals the position when the slot is empty and the position + 1
+// when the slot is published
+struct TtvRing::SlotHeader {
+  std::atomic<uint64_t> sequence;
+  uint32_t bytes;
+  uint8_t layout;
+};
+
+namespace {
+
+inline uint32_t alignUp(const uint32_t bytes, const uint32_t alignment) {
+  return (bytes + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+TtvRing::TtvRing(const uint32_t slots, const uint32_t slotBytes,
+                 const uint8_t mode)
+    : mHead(0), mTail(0), mMode(mode) {
+  uint32_t count = 2;
+  while (count < slots) {
+    count <<= 1;
+  }
+  mMask = count - 1;
+  mSlotBytes = alignUp((slotBytes > 0) ? slotBytes : 1, RING_CACHE_LINE_BYTES);
+  mStride = RING_CACHE_LINE_BYTES + mSlotBytes;
+
+  // align the slots to the cache line so that the values of the aligned
+  // layout are aligned in memory as well
+  const size_t bytes = static_cast<size_t>(mStride) * count;
+  mStorage.reset(new uint8_t[bytes + RING_CACHE_LINE_BYTES]);
+  const uintptr_t address = reinterpret_cast<uintptr_t>(mStorage.get());
+  mSlots = mStorage.get() + (RING_CACHE_LINE_BYTES -
+                             address % RING_CACHE_LINE_BYTES) %
+                                RING_CACHE_LINE_BYTES;
+  for (uint32_t ii = 0; ii < count; ii++) {
+    SlotHeader *header = new (mSlots + static_cast<size_t>(mStride) * ii)
+        SlotHeader();
+    header->sequence.store(ii, std::memory_order_relaxed);
+  }
+}
+
+TtvRing::~TtvRing() {
+  for (uint32_t ii = 0; ii <= mMask; ii++) {
+    getHeader(ii)->~SlotHeader();
+  }
+}
+
+uint32_t TtvRing::getSlotCount() const { return mMask + 1; }
+
+uint32_t TtvRing::getSlotBytes() const { return mSlotBytes; }
+
+uint8_t TtvRing::getMode() const { return mMode; }
+
+TtvRing::SlotHeader *TtvRing::getHeader(const uint64_t position) const {
+  return reinterpret_cast<SlotHeader *>(
+      mSlots + static_cast<size_t>(mStride) * (position & mMask));
+}
+
+bool TtvRing::tryClaim(TtvRingSlot &slot) {
+  uint64_t position = mHead.load(std::memory_order_relaxed);
+  if (RING_SPSC == mMode) {
+    // the consumer counter is read only when the ring looks full
+    if (position - mCachedTail > mMask) {
+      mCachedTail = mTail.load(std::memory_order_acquire);
+      if (position - mCachedTail > mMask) {
+        return false;
+      }
+    }
+  } else {
+    for (;;) {
+      const uint64_t sequence =
+          getHeader(position)->sequence.load(std::memory_order_acquire);
+      const int64_t distance =
+          static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+      if (0 == distance) {
+        if (mHead.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (distance < 0) {
+        return false;
+      } else {
+        position = mHead.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  slot.data = reinterpret_cast<uint8_t *>(getHeader(position)) +
+              RING_CACHE_LINE_BYTES;
+  slot.capacity = mSlotBytes;
+  slot.bytes = 0;
+  slot.layout = LAYOUT_COMPACT;
+  slot.position = position;
+  return true;
+}
+
+void TtvRing::publish(const TtvRingSlot &slot) {
+  SlotHeader *header = getHeader(slot.position);
+  header->bytes = slot.bytes;
+  header->layout = slot.layout;
+  if (RING_SPSC == mMode) {
+    mHead.store(slot.position + 1, std::memory_order_release);
+  } else {
+    header->sequence.store(slot.position + 1, std::memory_order_release);
+  }
+}
+
+bool TtvRing::tryConsume(TtvRingSlot &slot) {
+  uint64_t position = mTail.load(std::memory_order_relaxed);
+  if (RING_SPSC == mMode) {
+    // the producer counter is read only when the ring looks empty
+    if (position == mCachedHead) {
+      mCachedHead = mHead.load(std::memory_order_acquire);
+      if (position == mCachedHead) {
+        return false;
+      }
+    }
+  } else {
+    for (;;) {
+      const uint64_t sequence =
+          getHeader(position)->sequence.load(std::memory_order_acquire);
+      const int64_t distance =
+          static_cast<int64_t>(sequence) - static_cast<int64_t>(position + 1);
+      if (0 == distance) {
+        if (mTail.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (distance < 0) {
+        return false;
+      } else {
+        position = mTail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  SlotHeader *header = getHeader(position);
+  slot.data = reinterpret_cast<uint8_t *>(header) + RING_CACHE_LINE_BYTES;
+  slot.capacity = mSlotBytes;
+  slot.bytes = header->bytes;
+  slot.layout = header->layout;
+  slot.position = position;
+  return true;
+}
+
+void TtvRing::release(const TtvRingSlot &slot) {
+  if (RING_SPSC == mMode) {
+    mTail.store(slot.position + 1, std::memory_order_release);
+  } else {
+    getHeader(slot.position)
+        ->sequence.store(slot.position + mMask + 1, std::memory_order_release);
+  }
+}
+
+bool TtvRing::tryPush(const TtvBox &box) {
+  // check the size before claiming, a claimed slot must be published
+  if (box.computePackedBytes() > mSlotBytes) {
+    TTV_LOGE("Error: the packed box exceeds the slot of %d bytes.", mSlotBytes);
+    return false;
+  }
+  TtvRingSlot slot;
+  if (!tryClaim(slot)) {
+    return false;
+  }
+  box.pack(slot.data, slot.capacity, slot.bytes);
+  slot.layout = box.getLayout();
+  publish(slot);
+  return true;
+}
+
+bool TtvRing::tryPush(const uint8_t *buffer, const uint32_t buffersize,
+                      const uint8_t layout) {
+  if (buffersize > mSlotBytes) {
+    TTV_LOGE("Error: the packed buffer exceeds the slot of %d bytes.",
+             mSlotBytes);
+    return false;
+  }
+  TtvRingSlot slot;
+  if (!tryClaim(slot)) {
+    return false;
+  }
+  ::memcpy(slot.data, buffer, buffersize);
+  slot.bytes = buffersize;
+  slot.layout = layout;
+  publish(slot);
+  return true;
+}
+
+bool TtvRing::tryPop(TtvView &view, TtvRingSlot &slot) {
+  if (!tryConsume(slot)) {
+    return false;
+  }
+  if (!view.reset(slot.data, slot.bytes, slot.layout)) {
+    release(slot);
+    return false;
+  }
+  return true;
+}
+
+bool TtvRing::tryPop(TtvBox &box) {
+  TtvRingSlot slot;
+  if (!tryConsume(slot)) {
+    return false;
+  }
+  box.setLayout(slot.layout);
+  const bool ret = box.unpack(slot.data, slot.bytes);
+  release(slot);
+  return ret;
+}
+
+} // namespace ttv
@@ -0,0 +1,182 @@
+/*
+ *  @file     TtvSchema.cpp
+ *  @brief    TTV schema, the names of the tags of a ttv box
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvSchema.h"
+#include <algorithm>
+#include <string.h>
+
+namespace ttv {
+
+namespace {
+
+// the number of seeds tried for a table size before doubling it
+const uint32_t kMaxSeeds = 1024;
+
+inline uint64_t load64(const char *data) {
+  uint64_t value;
+  ::memcpy(&value, data, sizeof(uint64_t));
+  return value;
+}
+
+inline uint64_t load32(const char *data) {
+  uint32_t value;
+  ::memcpy(&value, data, sizeof(uint32_t));
+  return value;
+}
+
+// the names are read a word at a time, the last word overlapping the
+// previous one, and each word is mixed in by a multiplication, so that a
+// short name costs a few loads and multiplications instead of one per byte.
+// the hash is finalized so that the slot taken from the high bits depends on
+// every byte of the name. it's only used in memory, the slots are rebuilt from
+// the names when they are decoded
+inline uint64_t hashName(const char *name, const size_t length,
+                         const uint64_t seed) {
+  const uint64_t kMultiplier = 0x9E3779B97F4A7C15ULL;
+  uint64_t hash = (seed + length) * kMultiplier;
+  uint64_t tail = 0;
+  if (length > sizeof(uint64_t)) {
+    for (size_t offset = 0; offset + sizeof(uint64_t) < length;
+         offset += sizeof(uint64_t)) {
+      hash = (hash ^ load64(name + offset)) * kMultiplier;
+      hash ^= hash >> 32;
+    }
+    tail = load64(name + length - sizeof(uint64_t));
+  } else if (length >= sizeof(uint32_t)) {
+    tail = load32(name) | (load32(name + length - sizeof(uint32_t)) << 32);
+  } else if (length > 0) {
+    tail = (static_cast<uint64_t>(static_cast<uint8_t>(name[0])) << 16) |
+           (static_cast<uint64_t>(static_cast<uint8_t>(name[length >> 1]))
+            << 8) |
+           static_cast<uint8_t>(name[length - 1]);
+  }
+  hash = (hash ^ tail) * kMultiplier;
+  return (hash ^ (hash >> 29)) * 0xBF58476D1CE4E5B9ULL;
+}
+
+inline uint32_t getSlot(const uint64_t hash, const uint32_t mask) {
+  return static_cast<uint32_t>(hash >> 32) & mask;
+}
+
+} // namespace
+
+bool isSchemaValue(const uint8_t type, const uint8_t *value,
+                   const uint32_t length) {
+  return (BYTES_T == type) && (length >= SCHEMA_MAGIC_BYTES) &&
+         (0 == ::memcmp(value, TTV_SCHEMA_MAGIC, SCHEMA_MAGIC_BYTES));
+}
+
+bool TtvSchema::addName(const uint8_t tag, const std::string &name) {
+  if (name.empty() || (name.size() > SCHEMA_MAX_NAME_BYTES)) {
+    TTV_LOGE("Error: the name of tag %d is empty or too long.", tag);
+    return false;
+  }
+  if ((START_TAG == tag) || (END_TAG == tag) || (SCHEMA_TAG == tag)) {
+    TTV_LOGE("Error: the reserved tag %d cannot be named.", tag);
+    return false;
+  }
+  for (size_t ii = 0; ii < mNames.size(); ii++) {
+    if ((mTags[ii] == tag) || (mNames[ii] == name)) {
+      TTV_LOGE("Error: the tag %d or the name %s has been added before.", tag,
+               name.c_str());
+      return false;
+    }
+  }
+  mNames.push_back(name);
+  mTags.push_back(tag);
+  return true;
+}
+
+bool TtvSchema::build() {
+  // keep the table at most half full so that a seed is found quickly
+  uint32_t slots = 2;
+  while (slots < 2 * mNames.size()) {
+    slots <<= 1;
+  }
+  for (; slots <= (1u << 16); slots <<= 1) {
+    mSlots.assign(slots, -1);
+    mMask = slots - 1;
+    for (uint64_t seed = 0; seed < kMaxSeeds; seed++) {
+      bool collided = false;
+      for (size_t ii = 0; (ii < mNames.size()) && !collided; ii++) {
+        const uint32_t slot =
+            getSlot(hashName(mNames[ii].data(), mNames[ii].size(), seed), mMask);
+        collided = (mSlots[slot] >= 0);
+        mSlots[slot] = static_cast<int16_t>(ii);
+      }
+      if (!collided) {
+        mSeed = seed;
+        return true;
+      }
+      std::fill(mSlots.begin(), mSlots.end(), -1);
+    }
+  }
+  TTV_LOGE("Error: failed to build the perfect hash of %d names.",
+           (int)mNames.size());
+  mSlots.clear();
+  return false;
+}
+
+bool TtvSchema::findTag(const char *name, const size_t length,
+                        uint8_t &tag) const {
+  if (mSlots.empty()) {
+    return false;
+  }
+  const int16_t index = mSlots[getSlot(hashName(name, length, mSeed), mMask)];
+  if ((index < 0) || (mNames[index].size() != length) ||
+      (0 != ::memcmp(mNames[index].data(), name, length))) {
+    return false;
+  }
+  tag = mTags[index];
+  return true;
+}
+
+const std::string *TtvSchema::getName(const uint8_t tag) const {
+  for (size_t ii = 0; ii < mTags.size(); ii++) {
+    if (mTags[ii] == tag) {
+      return &mNames[ii];
+    }
+  }
+  return nullptr;
+}
+
+uint32_t TtvSchema::size() const { return mNames.size(); }
+
+void TtvSchema::encode(std::vector<uint8_t> &value) const {
+  value.assign(TTV_SCHEMA_MAGIC, TTV_SCHEMA_MAGIC + SCHEMA_MAGIC_BYTES);
+  for (size_t ii = 0; ii < mNames.size(); ii++) {
+    value.push_back(mTags[ii]);
+    value.push_back(static_cast<uint8_t>(mNames[ii].size()));
+    value.insert(value.end(), mNames[ii].begin(), mNames[ii].end());
+  }
+}
+
+bool TtvSchema::decode(const uint8_t *value, const uint32_t length) {
+  mNames.clear();
+  mTags.clear();
+  if (!isSchemaValue(BYTES_T, value, length)) {
+    return false;
+  }
+  uint32_t offset = SCHEMA_MAGIC_BYTES;
+  while (offset < length) {
+    if (length - offset < 2) {
+      return false;
+    }
+    const uint8_t tag = value[offset];
+    const uint8_t bytes = value[offset + 1];
+    offset += 2;
+    if ((bytes > length - offset) ||
+        !addName(tag, std::string(reinterpret_cast<const char *>(value) +
+                                      offset,
+                                  bytes))) {
+      return false;
+    }
+    offset += bytes;
+  }
+  return build();
+}
+
+} // namespace ttv
@@ -0,0 +1,321 @@
+/*
+ *  @file     TtvShm.cpp
+ *  @brief    TTV shared memory, publishes a packed ttv box in a POSIX shared
+ *  memory segment so that the processes on the host read it in place
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvShm.h"
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ttv {
+
+// the atomics are shared by the processes, they must not use a lock
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64-bit atomics must be lock-free");
+
+// the state of one of the two buffers, the fields are atomics so that the
+// readers racing with the publisher read them without undefined behaviour
+struct TtvShmBufferState {
+  // seqlock counter, odd while the publisher writes the buffer
+  std::atomic<uint64_t> lock;
+  std::atomic<uint64_t> version;
+  std::atomic<uint32_t> bytes;
+  std::atomic<uint32_t> layout;
+  uint8_t padding[SHM_BUFFER_ALIGNMENT - 3 * sizeof(uint64_t)];
+};
+
+// the control block at the beginning of a segment
+struct TtvShmControl {
+  // SHM_MAGIC once the segment is initialized
+  std::atomic<uint32_t> magic;
+  uint32_t formatVersion;
+  // the size of each buffer
+  uint32_t capacity;
+  // the features used by the boxes published so far, see SHM_FLAG_VARINT
+  std::atomic<uint32_t> flags;
+  // the number of publications, the current box is in the buffer
+  // (sequence - 1) & 1
+  std::atomic<uint64_t> sequence;
+  uint8_t padding[SHM_BUFFER_ALIGNMENT - 3 * sizeof(uint64_t)];
+  TtvShmBufferState buffers[2];
+};
+
+static_assert(sizeof(TtvShmControl) <= SHM_HEADER_BYTES,
+              "the control block exceeds the header");
+
+namespace {
+
+inline uint8_t *getBufferData(const TtvShmControl *control,
+                              const uint32_t buffer) {
+  return reinterpret_cast<uint8_t *>(const_cast<TtvShmControl *>(control)) +
+         SHM_HEADER_BYTES + static_cast<size_t>(control->capacity) * buffer;
+}
+
+inline size_t getSegmentBytes(const uint32_t capacity) {
+  return SHM_HEADER_BYTES + 2 * static_cast<size_t>(capacity);
+}
+
+} // namespace
+
+TtvShmPublisher::~TtvShmPublisher() {
+  if (nullptr != mControl) {
+    ::munmap(mControl, mMappedBytes);
+  }
+}
+
+bool TtvShmPublisher::create(const std::string &name,
+                             const uint32_t capacity) {
+  const uint32_t alignedCapacity =
+      (capacity + SHM_BUFFER_ALIGNMENT - 1) & ~(SHM_BUFFER_ALIGNMENT - 1);
+  const size_t bytes = getSegmentBytes(alignedCapacity);
+  const int fd = ::shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+  if (fd < 0) {
+    TTV_LOGE("Error: failed to open the shared memory %s: %s.", name.c_str(),
+             strerror(errno));
+    return false;
+  }
+
+  // resizing a segment mapped by the readers would crash them
+  struct stat status;
+  if ((0 != ::fstat(fd, &status)) ||
+      ((0 != status.st_size) && (bytes != (size_t)status.st_size)) ||
+      ((0 == status.st_size) && (0 != ::ftruncate(fd, bytes)))) {
+    TTV_LOGE("Error: the shared memory %s exists with another capacity.",
+             name.c_str());
+    ::close(fd);
+    return false;
+  }
+  void *address =
+      ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (MAP_FAILED == address) {
+    TTV_LOGE("Error: failed to map the shared memory %s: %s.", name.c_str(),
+             strerror(errno));
+    return false;
+  }
+  if (nullptr != mControl) {
+    ::munmap(mControl, mMappedBytes);
+  }
+  mControl = static_cast<TtvShmControl *>(address);
+  mMappedBytes = bytes;
+
+  // a segment left by a previous publisher is reused, the readers keep going
+  if ((SHM_MAGIC == mControl->magic.load(std::memory_order_acquire)) &&
+      (SHM_FORMAT_VERSION == mControl->formatVersion) &&
+      (alignedCapacity == mControl->capacity)) {
+    // a publisher which crashed inside a write left the counter of the buffer
+    // which is not current odd, writing it again would flip the counter the
+    // wrong way and the readers would spin once it became current
+    for (TtvShmBufferState &state : mControl->buffers) {
+      const uint64_t lock = state.lock.load(std::memory_order_relaxed);
+      if (lock & 1) {
+        state.lock.store(lock + 1, std::memory_order_release);
+      }
+    }
+    return true;
+  }
+  mControl->magic.store(0, std::memory_order_relaxed);
+  mControl->formatVersion = SHM_FORMAT_VERSION;
+  mControl->capacity = alignedCapacity;
+  mControl->flags.store(0, std::memory_order_relaxed);
+  mControl->sequence.store(0, std::memory_order_relaxed);
+  for (TtvShmBufferState &state : mControl->buffers) {
+    state.lock.store(0, std::memory_order_relaxed);
+    state.bytes.store(0, std::memory_order_relaxed);
+  }
+  mControl->magic.store(SHM_MAGIC, std::memory_order_release);
+  return true;
+}
+
+uint8_t *TtvShmPublisher::beginWrite(uint32_t &buffer) {
+  // write the buffer which is not current, the readers of the current box
+  // are not disturbed
+  buffer = static_cast<uint32_t>(
+      mControl->sequence.load(std::memory_order_relaxed) & 1);
+  TtvShmBufferState &state = mControl->buffers[buffer];
+  state.lock.store(state.lock.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  return getBufferData(mControl, buffer);
+}
+
+void TtvShmPublisher::endWrite(const uint32_t buffer, const uint32_t bytes,
+                               const uint8_t layout, const uint32_t flags,
+                               const uint64_t version) {
+  // the flags are set before the box is made current, so a reader which
+  // sees the box sees its flags as well
+  if (flags & ~mControl->flags.load(std::memory_order_relaxed)) {
+    mControl->flags.fetch_or(flags, std::memory_order_relaxed);
+  }
+  TtvShmBufferState &state = mControl->buffers[buffer];
+  state.version.store(version, std::memory_order_relaxed);
+  state.bytes.store(bytes, std::memory_order_relaxed);
+  state.layout.store(layout, std::memory_order_relaxed);
+  state.lock.store(state.lock.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+  mControl->sequence.fetch_add(1, std::memory_order_release);
+}
+
+bool TtvShmPublisher::publish(const TtvBox &box, const uint64_t version) {
+  if (nullptr == mControl) {
+    TTV_LOGE("Error: please create the shared memory first.");
+    return false;
+  }
+  if (box.computePackedBytes() > mControl->capacity) {
+    TTV_LOGE("Error: the packed box exceeds the capacity of %d bytes.",
+             mControl->capacity);
+    return false;
+  }
+  uint32_t buffer = 0;
+  uint32_t bytes = 0;
+  box.pack(beginWrite(buffer), mControl->capacity, bytes);
+  endWrite(buffer, bytes, box.getLayout(),
+           box.hasVarint() ? SHM_FLAG_VARINT : 0, version);
+  return true;
+}
+
+bool TtvShmPublisher::publish(const uint8_t *buffer, const uint32_t buffersize,
+                              const uint8_t layout, const uint64_t version) {
+  if (nullptr == mControl) {
+    TTV_LOGE("Error: please create the shared memory first.");
+    return false;
+  }
+  if (buffersize > mControl->capacity) {
+    TTV_LOGE("Error: the packed buffer exceeds the capacity of %d bytes.",
+             mControl->capacity);
+    return false;
+  }
+  uint32_t index = 0;
+  ::memcpy(beginWrite(index), buffer, buffersize);
+  endWrite(index, buffersize, layout,
+           TtvBox::hasVarint(buffer, buffersize, layout) ? SHM_FLAG_VARINT : 0,
+           version);
+  return true;
+}
+
+bool TtvShmPublisher::unlink(const std::string &name) {
+  if (0 != ::shm_unlink(name.c_str())) {
+    TTV_LOGE("Error: failed to unlink the shared memory %s: %s.",
+             name.c_str(), strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+TtvShmReader::~TtvShmReader() {
+  if (nullptr != mControl) {
+    ::munmap(const_cast<TtvShmControl *>(mControl), mMappedBytes);
+  }
+}
+
+bool TtvShmReader::open(const std::string &name) {
+  const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    TTV_LOGE("Error: failed to open the shared memory %s: %s.", name.c_str(),
+             strerror(errno));
+    return false;
+  }
+  struct stat status;
+  if ((0 != ::fstat(fd, &status)) ||
+      ((size_t)status.st_size < SHM_HEADER_BYTES)) {
+    TTV_LOGE("Error: the shared memory %s is not initialized.", name.c_str());
+    ::close(fd);
+    return false;
+  }
+  const size_t bytes = static_cast<size_t>(status.st_size);
+  void *address = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (MAP_FAILED == address) {
+    TTV_LOGE("Error: failed to map the shared memory %s: %s.", name.c_str(),
+             strerror(errno));
+    return false;
+  }
+
+  const TtvShmControl *control = static_cast<const TtvShmControl *>(address);
+  if ((SHM_MAGIC != control->magic.load(std::memory_order_acquire)) ||
+      (SHM_FORMAT_VERSION != control->formatVersion) ||
+      (getSegmentBytes(control->capacity) != bytes)) {
+    TTV_LOGE("Error: the shared memory %s is not a ttv segment.",
+             name.c_str());
+    ::munmap(address, bytes);
+    return false;
+  }
+  if (control->flags.load(std::memory_order_relaxed) & ~SHM_FLAGS_SUPPORTED) {
+    TTV_LOGE("Error: the shared memory %s uses unknown flags.", name.c_str());
+    ::munmap(address, bytes);
+    return false;
+  }
+  if (nullptr != mControl) {
+    ::munmap(const_cast<TtvShmControl *>(mControl), mMappedBytes);
+  }
+  mControl = control;
+  mMappedBytes = bytes;
+  return true;
+}
+
+uint64_t TtvShmReader::getSequence() const {
+  return (nullptr != mControl)
+             ? mControl->sequence.load(std::memory_order_acquire)
+             : 0;
+}
+
+bool TtvShmReader::read(TtvView &view, TtvShmSnapshot &snapshot) const {
+  for (;;) {
+    const uint64_t sequence = getSequence();
+    if (0 == sequence) {
+      return false;
+    }
+    if (mControl->flags.load(std::memory_order_relaxed) &
+        ~SHM_FLAGS_SUPPORTED) {
+      TTV_LOGE("Error: the shared memory uses unknown flags.");
+      return false;
+    }
+    const uint32_t buffer = static_cast<uint32_t>((sequence - 1) & 1);
+    const TtvShmBufferState &state = mControl->buffers[buffer];
+    snapshot.lock = state.lock.load(std::memory_order_acquire);
+    if (snapshot.lock & 1) {
+      // two boxes have been published since loading the sequence
+      continue;
+    }
+    snapshot.sequence = sequence;
+    snapshot.buffer = buffer;
+    snapshot.version = state.version.load(std::memory_order_relaxed);
+    const uint32_t bytes = state.bytes.load(std::memory_order_relaxed);
+    const uint8_t layout =
+        static_cast<uint8_t>(state.layout.load(std::memory_order_relaxed));
+    if ((bytes <= mControl->capacity) &&
+        view.reset(getBufferData(mControl, buffer), bytes, layout)) {
+      return true;
+    }
+    if (validate(snapshot)) {
+      TTV_LOGE("Error: the published box is malformed.");
+      return false;
+    }
+  }
+}
+
+bool TtvShmReader::validate(const TtvShmSnapshot &snapshot) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return mControl->buffers[snapshot.buffer].lock.load(
+             std::memory_order_relaxed) == snapshot.lock;
+}
+
+bool TtvShmReader::copy(TtvBox &box, TtvShmSnapshot &snapshot) const {
+  TtvView view;
+  do {
+    if (!read(view, snapshot)) {
+      return false;
+    }
+    box.setLayout(view.getLayout());
+    box.unpack(view.getBuffer(), view.getSize());
+  } while (!validate(snapshot));
+  return true;
+}
+
+} // namespace ttv
@@ -0,0 +1,202 @@
+/*
+ *  @file     TtvStats.cpp
+ *  @brief    TTV stats, the runtime counters of ttv operations
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvStats.h"
+
+#ifdef TTV_ENABLE_STATS
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace ttv {
+
+const char *getStatsOperationName(const uint8_t operation) {
+  static const char *const names[STATS_OPERATION_MAX] = {
+      "pack", "unpack", "read", "write", "parse"};
+  return (operation < STATS_OPERATION_MAX) ? names[operation] : "unknown";
+}
+
+#ifdef TTV_ENABLE_STATS
+
+namespace {
+
+// the counters of a thread, written by the thread only and read by stats()
+struct OperationCounters {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> fields{0};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> nanoseconds{0};
+  std::atomic<uint64_t> histogram[STATS_HISTOGRAM_BUCKETS];
+
+  OperationCounters() {
+    for (uint32_t ii = 0; ii < STATS_HISTOGRAM_BUCKETS; ii++) {
+      histogram[ii].store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+struct ThreadCounters {
+  std::atomic<uint64_t> allocations{0};
+  OperationCounters operations[STATS_OPERATION_MAX];
+};
+
+// a single writer updates a counter without a locked instruction
+inline void increase(std::atomic<uint64_t> &counter, const uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+inline void merge(const ThreadCounters &counters, TtvStats &snapshot) {
+  snapshot.allocations += counters.allocations.load(std::memory_order_relaxed);
+  for (uint32_t op = 0; op < STATS_OPERATION_MAX; op++) {
+    const OperationCounters &src = counters.operations[op];
+    TtvOperationStats &dst = snapshot.operations[op];
+    dst.calls += src.calls.load(std::memory_order_relaxed);
+    dst.bytes += src.bytes.load(std::memory_order_relaxed);
+    dst.fields += src.fields.load(std::memory_order_relaxed);
+    dst.allocations += src.allocations.load(std::memory_order_relaxed);
+    dst.nanoseconds += src.nanoseconds.load(std::memory_order_relaxed);
+    for (uint32_t ii = 0; ii < STATS_HISTOGRAM_BUCKETS; ii++) {
+      dst.histogram[ii] += src.histogram[ii].load(std::memory_order_relaxed);
+    }
+  }
+}
+
+inline void subtract(const TtvStats &baseline, TtvStats &snapshot) {
+  snapshot.allocations -= baseline.allocations;
+  for (uint32_t op = 0; op < STATS_OPERATION_MAX; op++) {
+    const TtvOperationStats &src = baseline.operations[op];
+    TtvOperationStats &dst = snapshot.operations[op];
+    dst.calls -= src.calls;
+    dst.bytes -= src.bytes;
+    dst.fields -= src.fields;
+    dst.allocations -= src.allocations;
+    dst.nanoseconds -= src.nanoseconds;
+    for (uint32_t ii = 0; ii < STATS_HISTOGRAM_BUCKETS; ii++) {
+      dst.histogram[ii] -= src.histogram[ii];
+    }
+  }
+}
+
+// the counters of the running threads and the ones merged from the exited
+// threads, never destroyed so that it outlives the thread local counters
+struct Registry {
+  std::mutex mutex;
+  std::vector<const ThreadCounters *> threads;
+  TtvStats exited;
+  TtvStats baseline;
+};
+
+Registry &getRegistry() {
+  static Registry *registry = new Registry();
+  return *registry;
+}
+
+struct ThreadRegistration {
+  ThreadCounters counters;
+  // the operation which the heap allocations are attributed to
+  uint8_t operation = STATS_OPERATION_MAX;
+
+  ThreadRegistration() {
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(&counters);
+  }
+
+  ~ThreadRegistration() {
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    merge(counters, registry.exited);
+    registry.threads.erase(std::find(registry.threads.begin(),
+                                     registry.threads.end(), &counters));
+  }
+};
+
+thread_local ThreadRegistration tRegistration;
+
+inline int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline uint32_t getHistogramBucket(const uint64_t nanoseconds) {
+  if (0 == nanoseconds) {
+    return 0;
+  }
+  const uint32_t bucket = 63 - __builtin_clzll(nanoseconds);
+  return std::min<uint32_t>(bucket, STATS_HISTOGRAM_BUCKETS - 1);
+}
+
+TtvStats collect(Registry &registry) {
+  TtvStats snapshot = registry.exited;
+  for (const ThreadCounters *counters : registry.threads) {
+    merge(*counters, snapshot);
+  }
+  return snapshot;
+}
+
+} // namespace
+
+TtvStatsScope::TtvStatsScope(const uint8_t operation)
+    : mOperation(operation), mOuterOperation(tRegistration.operation),
+      mStart(now()) {
+  tRegistration.operation = operation;
+}
+
+TtvStatsScope::~TtvStatsScope() {
+  const uint64_t nanoseconds = static_cast<uint64_t>(now() - mStart);
+  OperationCounters &counters = tRegistration.counters.operations[mOperation];
+  increase(counters.calls, 1);
+  increase(counters.nanoseconds, nanoseconds);
+  increase(counters.histogram[getHistogramBucket(nanoseconds)], 1);
+  tRegistration.operation = mOuterOperation;
+}
+
+void TtvStatsScope::add(const uint64_t bytes, const uint64_t fields) {
+  OperationCounters &counters = tRegistration.counters.operations[mOperation];
+  increase(counters.bytes, bytes);
+  increase(counters.fields, fields);
+}
+
+void countStatsAllocation() {
+  ThreadRegistration &registration = tRegistration;
+  increase(registration.counters.allocations, 1);
+  if (registration.operation < STATS_OPERATION_MAX) {
+    increase(
+        registration.counters.operations[registration.operation].allocations,
+        1);
+  }
+}
+
+TtvStats stats() {
+  Registry &registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  TtvStats snapshot = collect(registry);
+  subtract(registry.baseline, snapshot);
+  snapshot.enabled = true;
+  return snapshot;
+}
+
+void resetStats() {
+  Registry &registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.baseline = collect(registry);
+}
+
+#else
+
+TtvStats stats() { return TtvStats(); }
+
+void resetStats() {}
+
+#endif
+
+} // namespace ttv
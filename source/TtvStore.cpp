@@ -0,0 +1,224 @@
+/*
+ *  @file     TtvStore.cpp
+ *  @brief    TTV store, an in-memory cache of packed ttv boxes keyed by
+ *  string, e.g. the configs of tens of thousands of models, bounded by a
+ *  memory budget
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvStore.h"
+#include "include/TtvHash.h"
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <string.h>
+#include <unordered_map>
+
+namespace ttv {
+
+namespace {
+
+// a box of a shard, the key is the one of the hash table node
+struct StoreEntry {
+  const std::string *key;
+  std::shared_ptr<const uint8_t> buffer;
+  uint32_t buffersize;
+  uint8_t layout;
+  // the bytes charged to the budget
+  uint64_t bytes;
+};
+
+// allocate a packed buffer, aligned to the cache line for the aligned layout
+// so that its values are aligned in memory as well
+std::shared_ptr<uint8_t> allocBuffer(const uint32_t buffersize,
+                                     const uint8_t layout, uint64_t &bytes) {
+  const uint32_t padding =
+      (LAYOUT_ALIGNED == layout) ? LARGE_VALUE_ALIGNMENT : 0;
+  std::shared_ptr<uint8_t> buffer(new uint8_t[buffersize + padding],
+                                  std::default_delete<uint8_t[]>());
+  bytes = static_cast<uint64_t>(buffersize) + padding;
+  if (0 == padding) {
+    return buffer;
+  }
+  const uintptr_t address = reinterpret_cast<uintptr_t>(buffer.get());
+  const uintptr_t offset =
+      (LARGE_VALUE_ALIGNMENT - address % LARGE_VALUE_ALIGNMENT) %
+      LARGE_VALUE_ALIGNMENT;
+  return std::shared_ptr<uint8_t>(buffer, buffer.get() + offset);
+}
+
+} // namespace
+
+// the boxes of a shard, the front of the lru list is the most recently used
+struct TtvStoreShard {
+  std::mutex mutex;
+  std::list<StoreEntry> lru;
+  std::unordered_map<std::string, std::list<StoreEntry>::iterator> index;
+  uint64_t bytes = 0;
+  uint64_t evictions = 0;
+
+  // unlink an entry, its buffer lives on in the views which hold it
+  void erase(const std::list<StoreEntry>::iterator entry) {
+    bytes -= entry->bytes;
+    const auto node = index.find(*entry->key);
+    lru.erase(entry);
+    index.erase(node);
+  }
+};
+
+const TtvView &TtvStoreView::getView() const { return mView; }
+
+void TtvStoreView::clear() {
+  mView.clear();
+  mBuffer.reset();
+}
+
+TtvStore::TtvStore(const uint64_t budget, const uint32_t numShards)
+    : mNumShards((0 == numShards) ? 1 : numShards) {
+  mShards.reset(new TtvStoreShard[mNumShards]);
+  mShardBudget = budget / mNumShards;
+}
+
+TtvStore::~TtvStore() = default;
+
+bool TtvStore::put(const std::string &key, const TtvBox &box) {
+  uint64_t bytes = 0;
+  std::shared_ptr<uint8_t> buffer;
+  uint32_t buffersize = 0;
+  if (!box.isDirty() && (nullptr != box.getPackedBuffer())) {
+    buffersize = box.getPackedBytes();
+    buffer = allocBuffer(buffersize, box.getLayout(), bytes);
+    ::memcpy(buffer.get(), box.getPackedBuffer(), buffersize);
+  } else {
+    // pack straight into the buffer of the store, the box is left as it is
+    box.pack(nullptr, 0, buffersize);
+    buffer = allocBuffer(buffersize, box.getLayout(), bytes);
+    if (!box.pack(buffer.get(), buffersize, buffersize)) {
+      TTV_LOGE("Error: failed to pack the box of %s.", key.c_str());
+      return false;
+    }
+  }
+  return insert(key, std::move(buffer), buffersize, box.getLayout(), bytes);
+}
+
+bool TtvStore::put(const std::string &key, const uint8_t *buffer,
+                   const uint32_t buffersize, const uint8_t layout) {
+  // a malformed buffer is rejected here so that every get succeeds
+  TtvView view;
+  if (!view.reset(buffer, buffersize, layout)) {
+    TTV_LOGE("Error: the packed buffer of %s is malformed.", key.c_str());
+    return false;
+  }
+  uint64_t bytes = 0;
+  std::shared_ptr<uint8_t> copy = allocBuffer(buffersize, layout, bytes);
+  ::memcpy(copy.get(), buffer, buffersize);
+  return insert(key, std::move(copy), buffersize, layout, bytes);
+}
+
+bool TtvStore::get(const std::string &key, TtvStoreView &view) {
+  uint32_t buffersize = 0;
+  uint8_t layout = LAYOUT_COMPACT;
+  {
+    TtvStoreShard &shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.index.find(key);
+    if (iter == shard.index.end()) {
+      view.clear();
+      return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+    view.mBuffer = iter->second->buffer;
+    buffersize = iter->second->buffersize;
+    layout = iter->second->layout;
+  }
+  // the buffer is indexed outside of the lock, it's never modified
+  return view.mView.reset(view.mBuffer.get(), buffersize, layout);
+}
+
+bool TtvStore::remove(const std::string &key) {
+  TtvStoreShard &shard = getShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto iter = shard.index.find(key);
+  if (iter == shard.index.end()) {
+    return false;
+  }
+  shard.erase(iter->second);
+  return true;
+}
+
+void TtvStore::clear() {
+  for (uint32_t ii = 0; ii < mNumShards; ii++) {
+    TtvStoreShard &shard = mShards[ii];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.lru.clear();
+    shard.index.clear();
+    shard.bytes = 0;
+  }
+}
+
+uint32_t TtvStore::getCount() const {
+  uint32_t count = 0;
+  for (uint32_t ii = 0; ii < mNumShards; ii++) {
+    TtvStoreShard &shard = mShards[ii];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    count += static_cast<uint32_t>(shard.index.size());
+  }
+  return count;
+}
+
+uint64_t TtvStore::getBytes() const {
+  uint64_t bytes = 0;
+  for (uint32_t ii = 0; ii < mNumShards; ii++) {
+    TtvStoreShard &shard = mShards[ii];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    bytes += shard.bytes;
+  }
+  return bytes;
+}
+
+uint64_t TtvStore::getEvictions() const {
+  uint64_t evictions = 0;
+  for (uint32_t ii = 0; ii < mNumShards; ii++) {
+    TtvStoreShard &shard = mShards[ii];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    evictions += shard.evictions;
+  }
+  return evictions;
+}
+
+TtvStoreShard &TtvStore::getShard(const std::string &key) const {
+  return mShards[hashBytes(key.data(), key.size()) % mNumShards];
+}
+
+bool TtvStore::insert(const std::string &key,
+                      std::shared_ptr<const uint8_t> buffer,
+                      const uint32_t buffersize, const uint8_t layout,
+                      const uint64_t bytes) {
+  const uint64_t charged = bytes + key.size() + STORE_ENTRY_OVERHEAD_BYTES;
+  if (charged > mShardBudget) {
+    TTV_LOGE("Error: the box of %s exceeds the budget of a shard.",
+             key.c_str());
+    return false;
+  }
+
+  TtvStoreShard &shard = getShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto iter = shard.index.find(key);
+  if (iter != shard.index.end()) {
+    shard.erase(iter->second);
+  }
+  // make room for the box, the least recently used boxes go first
+  while (shard.bytes + charged > mShardBudget) {
+    shard.erase(std::prev(shard.lru.end()));
+    shard.evictions++;
+  }
+
+  iter = shard.index.emplace(key, shard.lru.end()).first;
+  shard.lru.push_front(
+      {&iter->first, std::move(buffer), buffersize, layout, charged});
+  iter->second = shard.lru.begin();
+  shard.bytes += charged;
+  return true;
+}
+
+} // namespace ttv
@@ -0,0 +1,314 @@
+/*
+ *  @file     TtvStream.cpp
+ *  @brief    TTV stream, writes and reads a file of ttv records whose large
+ *  values are streamed in chunks, so that a value of any size, e.g. the
+ *  weights of a model, is never held in memory as a whole
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvStream.h"
+#include "include/TtvHeader.h"
+#include "include/TtvRecord.h"
+#include "include/TtvVarint.h"
+#include <limits>
+#include <string.h>
+
+namespace ttv {
+
+bool TtvStreamWriter::open(const std::string &file) {
+  if (mFile.is_open()) {
+    mFile.close();
+  }
+  mFile.clear();
+  mFile.open(file, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (!mFile) {
+    TTV_LOGE("Error: failed to open the stream %s.", file.c_str());
+    return false;
+  }
+  mBytes = 0;
+  mValueBytes = 0;
+  mInValue = false;
+
+  // the length of a stream is not known when the header is written
+  TtvHeader header;
+  header.flags = HEADER_FLAG_STREAM;
+  uint8_t headerBuffer[EXTENDED_HEADER_BYTES];
+  encodeHeader(header, headerBuffer);
+  mFile.write(reinterpret_cast<const char *>(headerBuffer),
+              sizeof(headerBuffer));
+  return mFile.good();
+}
+
+bool TtvStreamWriter::write(const TtvBox &box) {
+  if (mInValue) {
+    TTV_LOGE("Error: please end the value first.");
+    return false;
+  }
+  if (LAYOUT_COMPACT != box.getLayout()) {
+    TTV_LOGE("Error: only the boxes with the compact layout can be streamed.");
+    return false;
+  }
+  if (!box.isDirty() && (nullptr != box.getPackedBuffer())) {
+    return writeBytes(box.getPackedBuffer(), box.getPackedBytes());
+  }
+  uint32_t bytes = 0;
+  if (!box.pack(mBuffer.data(), static_cast<uint32_t>(mBuffer.size()),
+                bytes)) {
+    mBuffer.resize(bytes);
+    box.pack(mBuffer.data(), bytes, bytes);
+  }
+  return writeBytes(mBuffer.data(), bytes);
+}
+
+bool TtvStreamWriter::beginValue(const uint8_t tag) {
+  if (mInValue) {
+    TTV_LOGE("Error: please end the value first.");
+    return false;
+  }
+  const uint8_t header[] = {tag, CHUNKED_T};
+  mInValue = true;
+  mValueBytes = 0;
+  return writeBytes(header, sizeof(header));
+}
+
+bool TtvStreamWriter::writeChunk(const void *data, const uint32_t size) {
+  if (!mInValue) {
+    TTV_LOGE("Error: please begin a value first.");
+    return false;
+  }
+  // an empty chunk would end the value
+  if (0 == size) {
+    return true;
+  }
+  const uint32_t length = htonl(size);
+  if (!writeBytes(&length, sizeof(length)) || !writeBytes(data, size)) {
+    return false;
+  }
+  mValueBytes += size;
+  return true;
+}
+
+bool TtvStreamWriter::endValue() {
+  if (!mInValue) {
+    TTV_LOGE("Error: please begin a value first.");
+    return false;
+  }
+  const uint32_t length = 0;
+  mInValue = false;
+  return writeBytes(&length, sizeof(length));
+}
+
+bool TtvStreamWriter::close() {
+  if (mInValue) {
+    TTV_LOGE("Error: please end the value before closing.");
+    return false;
+  }
+  mFile.flush();
+  const bool written = mFile.good();
+  mFile.close();
+  if (!written || mFile.fail()) {
+    TTV_LOGE("Error: failed to write the stream.");
+    return false;
+  }
+  return true;
+}
+
+uint64_t TtvStreamWriter::getBytes() const { return mBytes; }
+
+uint64_t TtvStreamWriter::getValueBytes() const { return mValueBytes; }
+
+bool TtvStreamWriter::writeBytes(const void *data, const size_t size) {
+  mFile.write(static_cast<const char *>(data), size);
+  if (!mFile) {
+    TTV_LOGE("Error: failed to write %d bytes to the stream.", (int)size);
+    return false;
+  }
+  mBytes += size;
+  return true;
+}
+
+bool TtvStreamReader::open(const std::string &file) {
+  if (mFile.is_open()) {
+    mFile.close();
+  }
+  mFile.clear();
+  mFile.open(file, std::ios::binary);
+  if (!mFile) {
+    TTV_LOGE("Error: failed to open the stream %s.", file.c_str());
+    return false;
+  }
+  mPeeked = false;
+  mInValue = false;
+  mFailed = false;
+  mChunkBytes = 0;
+  mValueBytes = 0;
+
+  uint8_t headerBuffer[EXTENDED_HEADER_BYTES];
+  TtvHeader header;
+  if (!readBytes(headerBuffer, sizeof(headerBuffer)) ||
+      !decodeHeader(headerBuffer, header,
+                    HEADER_FLAG_STREAM | HEADER_FLAG_VARINT) ||
+      !(header.flags & HEADER_FLAG_STREAM)) {
+    TTV_LOGE("Error: %s is not a ttv stream.", file.c_str());
+    mFailed = true;
+    return false;
+  }
+  // skip the fields appended by newer writers
+  mFile.ignore(header.headerBytes - EXTENDED_HEADER_BYTES);
+  return true;
+}
+
+bool TtvStreamReader::read(TtvBox &box) {
+  if (mInValue) {
+    TTV_LOGE("Error: please read the value to its end first.");
+    return false;
+  }
+
+  // copy the records as they are, their lengths tell how many bytes to read
+  mBuffer.clear();
+  while (peekRecord() && (CHUNKED_T != mType)) {
+    mPeeked = false;
+    mBuffer.push_back(mTag);
+    mBuffer.push_back(mType);
+    if ((START_TAG == mTag) && (START_TYPE == mType)) {
+      continue;
+    }
+    // the end of a box, the boxes written one after another are read one by
+    // one
+    if ((END_TAG == mTag) && (END_TYPE == mType)) {
+      break;
+    }
+
+    size_t length = 0;
+    if (isVarintType(mType)) {
+      uint8_t byte = 0x80;
+      for (uint32_t ii = 0; byte & 0x80; ii++) {
+        if ((ii == VARINT_MAX_BYTES) || !readBytes(&byte, sizeof(byte))) {
+          TTV_LOGE("Error: the varint of tag = %d is malformed.", mTag);
+          mFailed = true;
+          return false;
+        }
+        mBuffer.push_back(byte);
+      }
+      continue;
+    } else if (mType <= FIXED_TYPE_MAX) {
+      length = getBasicTypeSize(mType);
+      if (0 == length) {
+        TTV_LOGE("Error: the type %d of tag = %d is unknown.", mType, mTag);
+        mFailed = true;
+        return false;
+      }
+    } else {
+      uint32_t newlength = 0;
+      if (!readBytes(&newlength, sizeof(newlength))) {
+        mFailed = true;
+        return false;
+      }
+      const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&newlength);
+      mBuffer.insert(mBuffer.end(), bytes, bytes + sizeof(newlength));
+      length = ntohl(newlength);
+    }
+    if (mBuffer.size() + length > std::numeric_limits<uint32_t>::max()) {
+      TTV_LOGE("Error: the records exceed the 4GB of a ttv box.");
+      mFailed = true;
+      return false;
+    }
+    const size_t offset = mBuffer.size();
+    mBuffer.resize(offset + length);
+    if (!readBytes(mBuffer.data() + offset, length)) {
+      mFailed = true;
+      return false;
+    }
+  }
+  if (mFailed) {
+    return false;
+  }
+
+  box.setLayout(LAYOUT_COMPACT);
+  return box.unpack(mBuffer.data(), static_cast<uint32_t>(mBuffer.size()));
+}
+
+bool TtvStreamReader::beginValue(uint8_t &tag) {
+  if (mInValue || !peekRecord() || (CHUNKED_T != mType)) {
+    TTV_LOGE("Error: the next record is not a chunked value.");
+    return false;
+  }
+  mPeeked = false;
+  mInValue = true;
+  mChunkBytes = 0;
+  mValueBytes = 0;
+  tag = mTag;
+  return true;
+}
+
+bool TtvStreamReader::readChunk(void *buffer, const uint32_t capacity,
+                                uint32_t &bytes) {
+  bytes = 0;
+  if (!mInValue) {
+    TTV_LOGE("Error: please begin a value first.");
+    return false;
+  }
+  if (0 == mChunkBytes) {
+    uint32_t length = 0;
+    if (!readBytes(&length, sizeof(length))) {
+      mFailed = true;
+      return false;
+    }
+    mChunkBytes = ntohl(length);
+    if (0 == mChunkBytes) {
+      mInValue = false;
+      return true;
+    }
+  }
+  bytes = (capacity < mChunkBytes) ? capacity : mChunkBytes;
+  if (!readBytes(buffer, bytes)) {
+    bytes = 0;
+    mFailed = true;
+    return false;
+  }
+  mChunkBytes -= bytes;
+  mValueBytes += bytes;
+  return true;
+}
+
+bool TtvStreamReader::isEof() {
+  return !mInValue && !peekRecord();
+}
+
+uint64_t TtvStreamReader::getValueBytes() const { return mValueBytes; }
+
+bool TtvStreamReader::peekRecord() {
+  if (mPeeked) {
+    return true;
+  }
+  if (mFailed || !mFile.is_open()) {
+    return false;
+  }
+  uint8_t header[2];
+  mFile.read(reinterpret_cast<char *>(header), sizeof(header));
+  if (0 == mFile.gcount()) {
+    // the end of the stream
+    return false;
+  }
+  if (sizeof(header) != mFile.gcount()) {
+    TTV_LOGE("Error: the stream is truncated.");
+    mFailed = true;
+    return false;
+  }
+  mTag = header[0];
+  mType = header[1];
+  mPeeked = true;
+  return true;
+}
+
+bool TtvStreamReader::readBytes(void *data, const size_t size) {
+  mFile.read(static_cast<char *>(data), size);
+  if (static_cast<size_t>(mFile.gcount()) != size) {
+    TTV_LOGE("Error: the stream is truncated, %d of %d bytes are read.",
+             (int)mFile.gcount(), (int)size);
+    return false;
+  }
+  return true;
+}
+
+} // namespace ttv
@@ -0,0 +1,100 @@
+/*
+ *  @file     TtvTensor.cpp
+ *  @brief    TTV tensor, the value of a ttv object with the type TENSOR_T
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvTensor.h"
+#include "include/TtvRecord.h"
+#include <limits>
+#include <string.h>
+
+namespace ttv {
+
+namespace {
+
+// offset of the shape in the tensor header
+const uint32_t kShapeOffset = 8;
+
+// the elements are stored in little-endian, the native order of our targets
+void copyElements(uint8_t *dst, const uint8_t *src, const uint64_t bytes,
+                  const uint32_t elementBytes) {
+  if (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) {
+    ::memcpy(dst, src, static_cast<size_t>(bytes));
+    return;
+  }
+  for (uint64_t ii = 0; ii < bytes; ii += elementBytes) {
+    for (uint32_t jj = 0; jj < elementBytes; jj++) {
+      dst[ii + jj] = src[ii + elementBytes - 1 - jj];
+    }
+  }
+}
+
+} // namespace
+
+uint64_t getTensorBytes(const uint8_t dtype, const uint8_t rank,
+                        const uint32_t *shape) {
+  const uint32_t elementBytes = getBasicTypeSize(dtype);
+  if ((0 == elementBytes) || (rank > TENSOR_MAX_RANK)) {
+    return 0;
+  }
+  // a crafted shape must not wrap around to the length of its record
+  const uint64_t maxElements =
+      (std::numeric_limits<uint64_t>::max() - TENSOR_HEADER_BYTES) /
+      elementBytes;
+  uint64_t numElements = 1;
+  for (uint8_t ii = 0; ii < rank; ii++) {
+    if ((0 != shape[ii]) && (numElements > maxElements / shape[ii])) {
+      return 0;
+    }
+    numElements *= shape[ii];
+  }
+  return TENSOR_HEADER_BYTES + numElements * elementBytes;
+}
+
+void encodeTensor(const uint8_t dtype, const uint8_t rank,
+                  const uint32_t *shape, const void *data, uint8_t *buffer) {
+  ::memset(buffer, 0, TENSOR_HEADER_BYTES);
+  buffer[0] = dtype;
+  buffer[1] = rank;
+  for (uint8_t ii = 0; ii < rank; ii++) {
+    const uint32_t dim = htonl(shape[ii]);
+    ::memcpy(buffer + kShapeOffset + ii * sizeof(uint32_t), &dim,
+             sizeof(uint32_t));
+  }
+  const uint64_t bytes = getTensorBytes(dtype, rank, shape);
+  copyElements(buffer + TENSOR_HEADER_BYTES,
+               static_cast<const uint8_t *>(data), bytes - TENSOR_HEADER_BYTES,
+               getBasicTypeSize(dtype));
+}
+
+bool decodeTensor(const uint8_t *value, const uint64_t length,
+                  TtvTensorView &view) {
+  if (length < TENSOR_HEADER_BYTES) {
+    return false;
+  }
+  view.dtype = value[0];
+  view.rank = value[1];
+  if ((0 == getBasicTypeSize(view.dtype)) || (view.rank > TENSOR_MAX_RANK)) {
+    return false;
+  }
+  for (uint8_t ii = 0; ii < view.rank; ii++) {
+    uint32_t dim = 0;
+    ::memcpy(&dim, value + kShapeOffset + ii * sizeof(uint32_t),
+             sizeof(uint32_t));
+    view.shape[ii] = ntohl(dim);
+  }
+  if (getTensorBytes(view.dtype, view.rank, view.shape) != length) {
+    return false;
+  }
+  view.bytes = length - TENSOR_HEADER_BYTES;
+  view.numElements = view.bytes / getBasicTypeSize(view.dtype);
+  view.data = value + TENSOR_HEADER_BYTES;
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  TTV_LOGE("Error: tensors cannot be used in place on big-endian hosts.");
+  return false;
+#endif
+  return true;
+}
+
+} // namespace ttv
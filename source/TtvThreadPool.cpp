@@ -0,0 +1,99 @@
+/*
+ *  @file     TtvThreadPool.cpp
+ *  @brief    TTV thread pool, runs the pieces of a large job, e.g. packing a
+ *  box of hundreds of MB, on a fixed set of threads
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvThreadPool.h"
+
+namespace ttv {
+
+TtvThreadPool::TtvThreadPool(const uint32_t numThreads) : mNext(0) {
+  uint32_t threads = numThreads;
+  if (0 == threads) {
+    threads = std::thread::hardware_concurrency();
+  }
+  // the calling thread is one of the threads running a job
+  for (uint32_t ii = 1; ii < threads; ii++) {
+    mWorkers.emplace_back(&TtvThreadPool::work, this);
+  }
+}
+
+TtvThreadPool::~TtvThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+  }
+  mWakeup.notify_all();
+  for (std::thread &worker : mWorkers) {
+    worker.join();
+  }
+}
+
+uint32_t TtvThreadPool::getNumThreads() const {
+  return static_cast<uint32_t>(mWorkers.size()) + 1;
+}
+
+void TtvThreadPool::run(const uint32_t count,
+                        const std::function<void(uint32_t)> &task) {
+  if (mWorkers.empty() || (count <= 1)) {
+    for (uint32_t ii = 0; ii < count; ii++) {
+      task(ii);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> runLock(mRunMutex);
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTask = &task;
+    mCount = count;
+    mNext.store(0, std::memory_order_relaxed);
+    mGeneration++;
+  }
+  mWakeup.notify_all();
+  execute();
+
+  // every index has been claimed, wait for the workers still running one.
+  // a worker waking up after the job sees no task and goes back to sleep
+  std::unique_lock<std::mutex> lock(mMutex);
+  mDone.wait(lock, [this] { return 0 == mActive; });
+  mTask = nullptr;
+}
+
+void TtvThreadPool::work() {
+  uint64_t generation = 0;
+  std::unique_lock<std::mutex> lock(mMutex);
+  for (;;) {
+    mWakeup.wait(lock,
+                 [&] { return mStopping || (generation != mGeneration); });
+    if (mStopping) {
+      return;
+    }
+    generation = mGeneration;
+    if (nullptr == mTask) {
+      continue;
+    }
+    mActive++;
+    lock.unlock();
+    execute();
+    lock.lock();
+    if (0 == --mActive) {
+      mDone.notify_all();
+    }
+  }
+}
+
+void TtvThreadPool::execute() {
+  const std::function<void(uint32_t)> &task = *mTask;
+  for (;;) {
+    const uint32_t index = mNext.fetch_add(1, std::memory_order_relaxed);
+    if (index >= mCount) {
+      return;
+    }
+    task(index);
+  }
+}
+
+} // namespace ttv
@@ -0,0 +1,237 @@
+/*
+ *  @file     TtvTrace.cpp
+ *  @brief    TTV trace, the timeline of ttv operations in the Chrome trace
+ *  event format, which chrome://tracing and Perfetto display
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvTrace.h"
+#include <fstream>
+#include <stdio.h>
+#include <unistd.h>
+
+#ifdef TTV_ENABLE_TRACE
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#endif
+
+namespace ttv {
+
+namespace {
+
+// append a string to the json, escaping the quotes and the backslashes
+void appendJsonString(std::string &json, const char *str) {
+  json += '"';
+  for (const char *cc = str; '\0' != *cc; cc++) {
+    if (('"' == *cc) || ('\\' == *cc)) {
+      json += '\\';
+    }
+    json += *cc;
+  }
+  json += '"';
+}
+
+// append nanoseconds as microseconds, the unit of the Chrome trace
+void appendMicroseconds(std::string &json, const int64_t nanoseconds) {
+  char buffer[32];
+  const int64_t sign = (nanoseconds < 0) ? -1 : 1;
+  const int64_t value = nanoseconds * sign;
+  ::snprintf(buffer, sizeof(buffer), "%s%lld.%03lld", (sign < 0) ? "-" : "",
+             (long long)(value / 1000), (long long)(value % 1000));
+  json += buffer;
+}
+
+} // namespace
+
+#ifdef TTV_ENABLE_TRACE
+
+namespace {
+
+// the spans of the exited threads kept at most
+const size_t kMaxExitedEvents = 64 * TRACE_THREAD_EVENTS;
+
+// a span in the buffer of a thread, written by the thread only and read by
+// traceEvents(), the fields are atomic since a span may be overwritten while
+// it's read
+struct ThreadEvent {
+  std::atomic<const char *> name{nullptr};
+  std::atomic<int64_t> start{0};
+  std::atomic<int64_t> nanoseconds{0};
+};
+
+struct ThreadBuffer {
+  uint32_t tid = 0;
+  // the number of spans recorded, the latest ones are in events
+  std::atomic<uint64_t> count{0};
+  ThreadEvent events[TRACE_THREAD_EVENTS];
+};
+
+// copy the spans of a thread which start after a time, the spans overwritten
+// during the copy are dropped
+void collectEvents(const ThreadBuffer &buffer, const int64_t after,
+                   std::vector<TtvTraceEvent> &events) {
+  const uint64_t end = buffer.count.load(std::memory_order_acquire);
+  const uint64_t begin =
+      (end > TRACE_THREAD_EVENTS) ? end - TRACE_THREAD_EVENTS : 0;
+  const size_t first = events.size();
+  for (uint64_t ii = begin; ii < end; ii++) {
+    const ThreadEvent &src = buffer.events[ii % TRACE_THREAD_EVENTS];
+    TtvTraceEvent event;
+    event.name = src.name.load(std::memory_order_relaxed);
+    event.tid = buffer.tid;
+    event.start = src.start.load(std::memory_order_relaxed);
+    event.nanoseconds = src.nanoseconds.load(std::memory_order_relaxed);
+    events.push_back(event);
+  }
+
+  // the spans before the latest TRACE_THREAD_EVENTS ones may be torn
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t latest = buffer.count.load(std::memory_order_relaxed);
+  const uint64_t valid =
+      (latest > TRACE_THREAD_EVENTS) ? latest - TRACE_THREAD_EVENTS : 0;
+  size_t kept = first;
+  for (uint64_t ii = begin; ii < end; ii++) {
+    const TtvTraceEvent &event = events[first + (ii - begin)];
+    if ((ii >= valid) && (event.start >= after)) {
+      events[kept++] = event;
+    }
+  }
+  events.resize(kept);
+}
+
+// the buffers of the running threads and the spans of the exited threads,
+// never destroyed so that it outlives the thread local buffers
+struct Registry {
+  std::mutex mutex;
+  std::vector<const ThreadBuffer *> threads;
+  std::vector<TtvTraceEvent> exited;
+  // the spans starting before are dropped, see clearTrace()
+  int64_t clearedAt = INT64_MIN;
+};
+
+Registry &getRegistry() {
+  static Registry *registry = new Registry();
+  return *registry;
+}
+
+// the buffer is allocated on the heap so that the threads which never
+// record a span don't pay for it in their thread local storage
+struct ThreadRegistration {
+  std::unique_ptr<ThreadBuffer> buffer;
+
+  ThreadRegistration() : buffer(new ThreadBuffer()) {
+    buffer->tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(buffer.get());
+  }
+
+  ~ThreadRegistration() {
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    collectEvents(*buffer, registry.clearedAt, registry.exited);
+    if (registry.exited.size() > kMaxExitedEvents) {
+      registry.exited.erase(registry.exited.begin(),
+                            registry.exited.end() - kMaxExitedEvents);
+    }
+    for (size_t ii = 0; ii < registry.threads.size(); ii++) {
+      if (registry.threads[ii] == buffer.get()) {
+        registry.threads.erase(registry.threads.begin() + ii);
+        break;
+      }
+    }
+  }
+};
+
+thread_local ThreadRegistration tRegistration;
+
+inline int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+TtvTraceScope::TtvTraceScope(const char *name) : mName(name), mStart(now()) {}
+
+TtvTraceScope::~TtvTraceScope() {
+  const int64_t end = now();
+  ThreadBuffer &buffer = *tRegistration.buffer;
+  // a single writer publishes a span without a locked instruction
+  const uint64_t count = buffer.count.load(std::memory_order_relaxed);
+  ThreadEvent &event = buffer.events[count % TRACE_THREAD_EVENTS];
+  event.name.store(mName, std::memory_order_relaxed);
+  event.start.store(mStart, std::memory_order_relaxed);
+  event.nanoseconds.store(end - mStart, std::memory_order_relaxed);
+  buffer.count.store(count + 1, std::memory_order_release);
+}
+
+std::vector<TtvTraceEvent> traceEvents() {
+  Registry &registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::vector<TtvTraceEvent> events = registry.exited;
+  for (const ThreadBuffer *buffer : registry.threads) {
+    collectEvents(*buffer, registry.clearedAt, events);
+  }
+  return events;
+}
+
+void clearTrace() {
+  const int64_t clearedAt = now();
+  Registry &registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.exited.clear();
+  registry.clearedAt = clearedAt;
+}
+
+#else
+
+std::vector<TtvTraceEvent> traceEvents() {
+  return std::vector<TtvTraceEvent>();
+}
+
+void clearTrace() {}
+
+#endif
+
+std::string exportTrace() {
+  const std::vector<TtvTraceEvent> events = traceEvents();
+  const int pid = static_cast<int>(::getpid());
+  std::string json = "{\"traceEvents\":[";
+  for (size_t ii = 0; ii < events.size(); ii++) {
+    const TtvTraceEvent &event = events[ii];
+    json += (0 == ii) ? "\n" : ",\n";
+    json += "{\"name\":";
+    appendJsonString(json, event.name);
+    json += ",\"cat\":\"ttv\",\"ph\":\"X\",\"ts\":";
+    appendMicroseconds(json, event.start);
+    json += ",\"dur\":";
+    appendMicroseconds(json, event.nanoseconds);
+    json += ",\"pid\":" + std::to_string(pid) +
+            ",\"tid\":" + std::to_string(event.tid) + "}";
+  }
+  json += "\n],\"displayTimeUnit\":\"ns\"}\n";
+  return json;
+}
+
+bool exportTrace(const std::string &file) {
+  std::ofstream out(file, std::ios::trunc);
+  if (!out) {
+    TTV_LOGE("Error: failed to open %s.", file.c_str());
+    return false;
+  }
+  const std::string json = exportTrace();
+  out.write(json.data(), json.size());
+  out.close();
+  if (out.fail()) {
+    TTV_LOGE("Error: failed to write %s.", file.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace ttv
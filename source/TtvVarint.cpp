@@ -0,0 +1,42 @@
+/*
+ *  @file     TtvVarint.cpp
+ *  @brief    TTV varint, the values of ttv objects with the types VARUINT_T
+ *  and VARINT_T
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvVarint.h"
+#include <string.h>
+
+namespace ttv {
+
+uint32_t encodeVarint(const uint64_t value, uint8_t *buffer) {
+  uint64_t remaining = value;
+  uint32_t size = 0;
+  while (remaining >= 0x80) {
+    buffer[size++] = static_cast<uint8_t>(remaining | 0x80);
+    remaining >>= 7;
+  }
+  buffer[size++] = static_cast<uint8_t>(remaining);
+  return size;
+}
+
+uint32_t decodeVarintSlow(const uint8_t *buffer, const size_t size,
+                          uint64_t &value) {
+  uint64_t result = 0;
+  for (uint32_t ii = 0; (ii < VARINT_MAX_BYTES) && (ii < size); ii++) {
+    const uint64_t byte = buffer[ii];
+    // the 10th byte holds the most significant bit only
+    if ((VARINT_MAX_BYTES - 1 == ii) && (byte > 1)) {
+      return 0;
+    }
+    result |= (byte & 0x7F) << (7 * ii);
+    if (0 == (byte & 0x80)) {
+      value = result;
+      return ii + 1;
+    }
+  }
+  return 0;
+}
+
+} // namespace ttv
@@ -0,0 +1,110 @@
+/*
+ *  @file     TtvView.cpp
+ *  @brief    TTV view class, a read-only view over a packed ttv box which
+ *  reads the values in place without copying them
+ *  Author:   Simon (dewen.wu@gmail.com)
+ */
+
+#include "include/TtvView.h"
+
+namespace ttv {
+
+TtvView::TtvView() { mTagIndex.fill(-1); }
+
+bool TtvView::reset(const uint8_t *buffer, const uint32_t buffersize,
+                    const uint8_t layout) {
+  clear();
+  if (nullptr == buffer) {
+    TTV_LOGE("Error: the packed buffer is null.");
+    return false;
+  }
+
+  // the records are read in place at the back of the list, copying them would
+  // reload each record right after its fields are stored
+  uint32_t offset = 0;
+  mRecords.emplace_back();
+  while (readRecord(buffer, buffersize, offset, mRecords.back(), layout)) {
+    const TtvRecord &record = mRecords.back();
+    if (mTagIndex[record.tag] >= 0) {
+      TTV_LOGE("Error: tag = %d is duplicated.", record.tag);
+      clear();
+      return false;
+    }
+    mTagIndex[record.tag] = static_cast<int16_t>(mRecords.size() - 1);
+    offset += record.size;
+    mRecords.emplace_back();
+  }
+  mRecords.pop_back();
+  if (offset != buffersize) {
+    TTV_LOGE("Error: buffer size doesn't match.");
+    clear();
+    return false;
+  }
+
+  mBuffer = buffer;
+  mBufferSize = buffersize;
+  mLayout = layout;
+  return true;
+}
+
+void TtvView::clear() {
+  // reset the tags in use only, which is cheaper than refilling the index
+  for (const TtvRecord &record : mRecords) {
+    mTagIndex[record.tag] = -1;
+  }
+  mRecords.clear();
+  mBuffer = nullptr;
+  mBufferSize = 0;
+}
+
+const uint8_t *TtvView::getBuffer() const { return mBuffer; }
+
+uint32_t TtvView::getSize() const { return mBufferSize; }
+
+uint8_t TtvView::getLayout() const { return mLayout; }
+
+uint32_t TtvView::getCount() const {
+  return static_cast<uint32_t>(mRecords.size());
+}
+
+bool TtvView::hasTag(const uint8_t tag) const { return mTagIndex[tag] >= 0; }
+
+bool TtvView::getType(const uint8_t tag, uint8_t &type) const {
+  const TtvRecord *record = findRecord(tag);
+  if (nullptr == record) {
+    return false;
+  }
+  type = record->type;
+  return true;
+}
+
+bool TtvView::getPackedValue(const uint8_t tag, const uint8_t **value,
+                             uint32_t &length) const {
+  const TtvRecord *record = findRecord(tag);
+  if (nullptr == record) {
+    TTV_LOGE("Error: tag = %d is not found.", tag);
+    return false;
+  }
+  *value = mBuffer + record->valueOffset;
+  length = record->length;
+  return true;
+}
+
+bool TtvView::getStringValue(const uint8_t tag, std::string &value) const {
+  const TtvRecord *record = findRecord(tag);
+  if ((nullptr == record) ||
+      ((STRING_T != record->type) && (BYTES_T != record->type))) {
+    TTV_LOGE("Error: tag = %d is not found or its type mismatch.", tag);
+    return false;
+  }
+  value.assign(reinterpret_cast<const char *>(mBuffer + record->valueOffset),
+               record->length);
+  return true;
+}
+
+const TtvRecord *TtvView::findRecord(const uint8_t tag) const {
+  const int16_t index = mTagIndex[tag];
+  return (index >= 0) ? &mRecords[index] : nullptr;
+}
+
+} // namespace ttv
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*****************************************
+   Heap allocation counters of the unit tests.
+*****************************************/
+
+// count the heap allocations and their bytes in the whole process. the
+// replacements are not inlined so that the compiler doesn't pair their
+// malloc() and free() with the new and delete expressions. they replace the
+// global ones, so the header is included by one source of a test only
+static std::atomic<uint64_t> gNumAllocations(0);
+static std::atomic<uint64_t> gAllocatedBytes(0);
+
+__attribute__((noinline)) void *operator new(size_t size) {
+  gNumAllocations.fetch_add(1, std::memory_order_relaxed);
+  gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  void *ptr = malloc(size > 0 ? size : 1);
+  if (nullptr == ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+__attribute__((noinline)) void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept {
+  free(ptr);
+}
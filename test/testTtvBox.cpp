@@ -1,10 +1,895 @@
 #include "include/TtvBox.h"
+#include "include/TtvThreadPool.h"
 #include "include/common.h"
+#include "test/testTtvAlloc.h"
+#include "test/testTtvCommon.h"
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <stdio.h>
+#include <string.h>
 #include <string>
+#include <vector>
 
 using namespace ttv;
 
+static TtvBox createPackedBox(const uint32_t value) {
+  TtvBox box;
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<uint32_t>(1, UINT32_T, value);
+  std::string str = "shared";
+  box.putNonNumbericalValue(2, STRING_T, str.size(), str.c_str());
+  box.putStartEndTag(END_TAG, END_TYPE);
+  box.pack();
+  return box;
+}
+
+static TtvBox createCounterBox(const uint32_t counter, const double ratio,
+                               const std::string &name) {
+  TtvBox box;
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<uint32_t>(1, UINT32_T, counter);
+  box.putNonNumbericalValue(2, STRING_T, name.size(), name.c_str());
+  box.putNumbericalValue<double>(3, DOUBLE_T, ratio);
+  box.putStartEndTag(END_TAG, END_TYPE);
+  box.pack();
+  return box;
+}
+
+static bool isSamePackedBuffer(const TtvBox &box1, const TtvBox &box2) {
+  return (box1.getPackedBytes() == box2.getPackedBytes()) &&
+         (0 == ::memcmp(box1.getPackedBuffer(), box2.getPackedBuffer(),
+                        box1.getPackedBytes()));
+}
+
+/*****************************************
+   Move and share a ttv box.
+*****************************************/
+static int testMoveAndShare() {
+  std::vector<TtvBox> boxes;
+  for (uint32_t ii = 0; ii < 8; ii++) {
+    boxes.push_back(createPackedBox(ii));
+  }
+
+  TtvBox moved(std::move(boxes[3]));
+  if ((0 != boxes[3].getPackedBytes()) ||
+      (nullptr != boxes[3].getPackedBuffer())) {
+    TTV_LOGE("Error: the moved-from ttv box is not empty.");
+    return -1;
+  }
+  uint32_t value = 0;
+  if (!moved.getNumbericalValue(1, value) || (3 != value)) {
+    TTV_LOGE("Error: move construction lost the value of tag 1.");
+    return -1;
+  }
+
+  boxes[3] = std::move(boxes[5]);
+  if (!boxes[3].getNumbericalValue(1, value) || (5 != value)) {
+    TTV_LOGE("Error: move assignment lost the value of tag 1.");
+    return -1;
+  }
+
+  TtvBox shared = moved.share();
+  if ((shared.getPackedBuffer() != moved.getPackedBuffer()) ||
+      (shared.getPackedBytes() != moved.getPackedBytes())) {
+    TTV_LOGE("Error: share() does not share the packed buffer.");
+    return -1;
+  }
+
+  // the shared box outlives the box it was shared from
+  moved = TtvBox();
+  std::string str;
+  if (!shared.getNumbericalValue(1, value) || (3 != value) ||
+      !shared.getStringValue(2, str) || (str != "shared")) {
+    TTV_LOGE("Error: the shared box lost its values.");
+    return -1;
+  }
+  TtvBox decoded;
+  if (!decoded.unpack(shared.getPackedBuffer(), shared.getPackedBytes()) ||
+      !decoded.getNumbericalValue(1, value) || (3 != value)) {
+    TTV_LOGE("Error: the shared packed buffer cannot be unpacked.");
+    return -1;
+  }
+
+  TTV_LOGI("testMoveAndShare() succeded.");
+  return 0;
+}
+
+/*****************************************
+   Reuse a ttv box across messages.
+*****************************************/
+static int testReuse() {
+  TtvBox box;
+  TtvBox decoded;
+  box.reserve(8, 256);
+  decoded.reserve(8, 256);
+  const std::string str = "a string longer than the inline storage";
+
+  uint64_t numAllocations = 0;
+  for (uint32_t ii = 0; ii < 100; ii++) {
+    // the first message warms up the value buffers of the ttv objects
+    if (1 == ii) {
+      numAllocations = gNumAllocations;
+    }
+    box.clear();
+    box.putStartEndTag(START_TAG, START_TYPE);
+    box.putNumbericalValue<uint32_t>(1, UINT32_T, ii);
+    box.putNumbericalValue<float>(2, FLOAT_T, (float)ii / 2);
+    box.putNonNumbericalValue(3, STRING_T, str.size(), str.c_str());
+    box.putStartEndTag(END_TAG, END_TYPE);
+    if (!box.pack()) {
+      TTV_LOGE("Error: pack() failed.");
+      return -1;
+    }
+
+    uint32_t value = 0;
+    if (!decoded.unpack(box.getPackedBuffer(), box.getPackedBytes()) ||
+        !decoded.getNumbericalValue(1, value) || (ii != value)) {
+      TTV_LOGE("Error: the reused box cannot be unpacked.");
+      return -1;
+    }
+  }
+
+  numAllocations = gNumAllocations - numAllocations;
+  if (0 != numAllocations) {
+    TTV_LOGE("Error: %lu heap allocations in steady state.",
+             (unsigned long)numAllocations);
+    return -1;
+  }
+
+  // a cleared box can be refilled in any order of tags
+  box.clear();
+  box.putNumbericalValue<uint8_t>(9, UINT8_T, (uint8_t)9);
+  box.putNumbericalValue<uint8_t>(4, UINT8_T, (uint8_t)4);
+  box.pack();
+  std::vector<uint8_t> tagList;
+  if ((2 != box.getTagList(tagList)) || (4 != tagList[0]) ||
+      (9 != tagList[1]) || (6 != box.getPackedBytes())) {
+    TTV_LOGE("Error: the cleared box is not refilled correctly.");
+    return -1;
+  }
+
+  TTV_LOGI("testReuse() succeded.");
+  return 0;
+}
+
+/*****************************************
+   Update values of a packed ttv box in place.
+*****************************************/
+static int testSetValue() {
+  TtvBox box = createCounterBox(1, 0.5, "abc");
+  TtvBox shared = box.share();
+
+  // the first update copies the value and the packed buffer shared with
+  // another box, the following ones patch them in place
+  if (!box.setNumbericalValue<uint32_t>(1, 0) ||
+      !box.setNumbericalValue<double>(3, 0.25) ||
+      !box.setNonNumbericalValue(2, 3, "xyz") || box.isDirty()) {
+    TTV_LOGE("Error: updating fixed-size values made the box dirty.");
+    return -1;
+  }
+  uint64_t numAllocations = gNumAllocations;
+  for (uint32_t ii = 0; ii < 1000; ii++) {
+    box.setNumbericalValue<uint32_t>(1, ii);
+  }
+  if (gNumAllocations != numAllocations) {
+    TTV_LOGE("Error: updating values in place allocated memory.");
+    return -1;
+  }
+  if (!isSamePackedBuffer(box, createCounterBox(999, 0.25, "xyz"))) {
+    TTV_LOGE("Error: the patched packed buffer is wrong.");
+    return -1;
+  }
+  if (!isSamePackedBuffer(shared, createCounterBox(1, 0.5, "abc"))) {
+    TTV_LOGE("Error: updating a box modified the box shared from it.");
+    return -1;
+  }
+
+  if (box.setNumbericalValue<uint16_t>(1, (uint16_t)1) ||
+      box.setNumbericalValue<uint32_t>(2, 1) ||
+      box.setNonNumbericalValue(1, 4, "abcd")) {
+    TTV_LOGE("Error: a value of another type was accepted.");
+    return -1;
+  }
+
+  if (!box.setNonNumbericalValue(2, 6, "abcdef") || !box.isDirty()) {
+    TTV_LOGE("Error: resizing a value didn't make the box dirty.");
+    return -1;
+  }
+  box.pack();
+  uint32_t value = 0;
+  if (box.isDirty() ||
+      !isSamePackedBuffer(box, createCounterBox(999, 0.25, "abcdef")) ||
+      !box.getNumbericalValue(1, value) || (999 != value)) {
+    TTV_LOGE("Error: repacking the resized box failed.");
+    return -1;
+  }
+
+  // a resized box is written only after packing it again
+  const std::string file = getTempFile("resized.bin");
+  const std::string grown(4096, 'g');
+  TtvBox reread;
+  std::string str;
+  if (!box.setNonNumbericalValue(2, grown.size(), grown.c_str()) ||
+      box.write(file) || !box.pack() || !box.write(file) ||
+      !reread.read(file) ||
+      !reread.unpack(reread.getPackedBuffer(), reread.getPackedBytes()) ||
+      !reread.getStringValue(2, str) || (grown != str)) {
+    TTV_LOGE("Error: failed to write and read the resized box.");
+    ::remove(file.c_str());
+    return -1;
+  }
+  ::remove(file.c_str());
+
+  // a buffer written out of the order of tags keeps the offset of each value
+  const uint8_t unsorted[] = {START_TAG, START_TYPE, 5, UINT32_T, 0, 0, 0, 5,
+                              3,         UINT16_T,   0, 3,        END_TAG,
+                              END_TYPE};
+  TtvBox decoded;
+  const uint8_t *packed = nullptr;
+  uint32_t length = 0;
+  uint16_t value16 = 0;
+  if (!decoded.unpack(unsorted, sizeof(unsorted)) ||
+      !decoded.getPackedValue(5, &packed, length) || (4 != length) ||
+      (0 != ::memcmp(packed, unsorted + 4, length)) ||
+      !decoded.getPackedValue(3, &packed, length) || (2 != length) ||
+      (0 != ::memcmp(packed, unsorted + 10, length)) ||
+      !decoded.setNumbericalValue<uint32_t>(5, 50) || decoded.isDirty() ||
+      (50 != decoded.getPackedBuffer()[7]) ||
+      (0 != ::memcmp(decoded.getPackedBuffer() + 8, unsorted + 8, 6)) ||
+      !decoded.getNumbericalValue(3, value16) || (3 != value16)) {
+    TTV_LOGE("Error: the values of an unsorted buffer are misplaced.");
+    return -1;
+  }
+
+  TTV_LOGI("testSetValue() succeded.");
+  return 0;
+}
+
+static TtvBox createPreCfgBox(const float scale, const bool hasMeanMap,
+                              const bool hasMeanType) {
+  TtvBox config;
+  createConfig(config, 3, 224, 224, 1, "./mean.txt", scale);
+  config.pack();
+  // drop the optional tags by unpacking the others
+  TtvTagMask tags;
+  tags.set();
+  tags.set(4, hasMeanType);
+  tags.set(8, hasMeanMap);
+  TtvBox box;
+  box.unpack(config.getPackedBuffer(), config.getPackedBytes(), tags);
+  box.pack();
+  return box;
+}
+
+/*****************************************
+   Diff two ttv boxes and apply the patch.
+*****************************************/
+static int testDiffPatch() {
+  TtvBox oldBox = createPreCfgBox(0.017f, true, true);
+  TtvBox newBox = createPreCfgBox(0.018f, false, false);
+  TtvBox addBox = createPreCfgBox(0.017f, true, true);
+
+  // scale_value is changed, mean_map and mean_type are removed
+  TtvBox patch;
+  if (!TtvBox::diff(oldBox, newBox, patch) ||
+      (patch.getPackedBytes() >= newBox.getPackedBytes())) {
+    TTV_LOGE("Error: diff() failed or the patch is not compact.");
+    return -1;
+  }
+
+  // the patch is sent as a packed buffer and applied to another copy
+  TtvBox received;
+  received.unpack(patch.getPackedBuffer(), patch.getPackedBytes());
+  TtvBox box = oldBox.share();
+  if (!box.apply(received) || !isSamePackedBuffer(box, newBox) ||
+      !isSamePackedBuffer(oldBox, createPreCfgBox(0.017f, true, true))) {
+    TTV_LOGE("Error: apply() failed to remove and change values.");
+    return -1;
+  }
+  float scale = 0.0f;
+  if (!box.getNumbericalValue(9, scale) || (0.018f != scale)) {
+    TTV_LOGE("Error: the patched box cannot be read.");
+    return -1;
+  }
+
+  // adding the values back
+  if (!TtvBox::diff(newBox, addBox, patch) || !box.apply(patch) ||
+      !isSamePackedBuffer(box, addBox)) {
+    TTV_LOGE("Error: apply() failed to add values.");
+    return -1;
+  }
+
+  // an empty patch for equal boxes
+  if (!TtvBox::diff(box, addBox, patch) || (4 != patch.getPackedBytes()) ||
+      !box.apply(patch) || !isSamePackedBuffer(box, addBox)) {
+    TTV_LOGE("Error: the patch of equal boxes is not empty.");
+    return -1;
+  }
+
+  TTV_LOGI("testDiffPatch() succeded.");
+  return 0;
+}
+
+/*****************************************
+   Pack a ttv box with the aligned layout.
+*****************************************/
+static int testAlignedLayout() {
+  std::vector<float> array(100);
+  for (size_t ii = 0; ii < array.size(); ii++) {
+    array[ii] = static_cast<float>(ii);
+  }
+  TtvBox box;
+  box.setLayout(LAYOUT_ALIGNED);
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<uint8_t>(1, UINT8_T, (uint8_t)1);
+  box.putNumbericalValue<uint16_t>(2, UINT16_T, (uint16_t)2);
+  box.putNumbericalValue<uint32_t>(3, UINT32_T, 3);
+  box.putNumbericalValue<uint64_t>(4, UINT64_T, 4);
+  box.putNumbericalValue<double>(5, DOUBLE_T, 5.0);
+  box.putNonNumbericalValue(6, STRING_T, 3, "abc");
+  box.putNonNumbericalValue(7, BYTES_T, array.size() * sizeof(float),
+                            array.data());
+  box.putStartEndTag(END_TAG, END_TYPE);
+  box.pack();
+
+  const uint32_t alignments[] = {1, 2, 4, 8, 8, 8, 64};
+  for (uint8_t tag = 1; tag <= 7; tag++) {
+    const uint8_t *value = nullptr;
+    uint32_t length = 0;
+    if (!box.getPackedValue(tag, &value, length) ||
+        (0 != reinterpret_cast<uintptr_t>(value) % alignments[tag - 1])) {
+      TTV_LOGE("Error: the value of tag %d is not aligned.", tag);
+      return -1;
+    }
+  }
+  const uint8_t *value = nullptr;
+  uint32_t length = 0;
+  box.getPackedValue(7, &value, length);
+  if (0 != ::memcmp(value, array.data(), length)) {
+    TTV_LOGE("Error: the array cannot be used in place.");
+    return -1;
+  }
+
+  // the layout is recorded in the header
+  const std::string file = getTempFile("aligned.bin");
+  TtvBox decoded;
+  uint64_t value64 = 0;
+  double valueDouble = 0;
+  if (!box.write(file) || !decoded.read(file) ||
+      (LAYOUT_ALIGNED != decoded.getLayout()) ||
+      !decoded.unpack(decoded.getPackedBuffer(), decoded.getPackedBytes()) ||
+      !isSamePackedBuffer(box, decoded) ||
+      !decoded.getNumbericalValue(4, value64) || (4 != value64) ||
+      !decoded.getNumbericalValue(5, valueDouble) || (5.0 != valueDouble)) {
+    TTV_LOGE("Error: failed to read the aligned ttv box.");
+    return -1;
+  }
+  ::remove(file.c_str());
+
+  // patching and diffing follow the layout of the boxes
+  TtvBox newBox = std::move(decoded);
+  newBox.setNumbericalValue<uint64_t>(4, 40);
+  std::string str = "./mean.txt";
+  newBox.setNonNumbericalValue(6, str.size(), str.c_str());
+  newBox.pack();
+  TtvBox patch;
+  if (!TtvBox::diff(box, newBox, patch) || !box.apply(patch) ||
+      !isSamePackedBuffer(box, newBox) ||
+      !box.getNumbericalValue(4, value64) || (40 != value64)) {
+    TTV_LOGE("Error: failed to patch the aligned ttv box.");
+    return -1;
+  }
+
+  // the nested boxes are read back by a default box, whatever their layout
+  TtvBox parent;
+  parent.setLayout(LAYOUT_ALIGNED);
+  parent.putTtvValue(1, TTV_T, &box);
+  parent.putRepeatedTtvValue(2, &box, 1);
+  parent.pack();
+  TtvBox child;
+  TtvBox element;
+  if (!parent.getTtvValue(1, child) || !child.getNumbericalValue(4, value64) ||
+      (40 != value64) || !parent.getRepeatedTtvValue(2, 0, element) ||
+      !element.getNumbericalValue(5, valueDouble) || (5.0 != valueDouble)) {
+    TTV_LOGE("Error: failed to read the nested aligned ttv box.");
+    return -1;
+  }
+
+  TTV_LOGI("testAlignedLayout() succeded.");
+  return 0;
+}
+
+/*****************************************
+   Reject a length beyond the packed data.
+*****************************************/
+static int testHugeLength() {
+  // a legacy header whose length is near 4 GB followed by a few bytes, the
+  // length must neither wrap the allocation around nor be trusted
+  std::vector<uint8_t> data(sizeof(uint32_t) + 300, 0xAB);
+  const uint32_t length = htonl(0xFFFFFFF0u);
+  ::memcpy(data.data(), &length, sizeof(length));
+
+  const std::string file = getTempFile("huge.bin");
+  {
+    std::ofstream out(file, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(data.data()), data.size());
+  }
+  TtvBox box;
+  const bool readFile = box.read(file);
+  ::remove(file.c_str());
+  if (readFile || box.read(data.data(), data.size()) ||
+      (0 != box.getPackedBytes())) {
+    TTV_LOGE("Error: a length beyond the packed data is accepted.");
+    return -1;
+  }
+
+  TTV_LOGI("testHugeLength() succeded.");
+  return 0;
+}
+
+/*****************************************
+   Put a tensor and view it in place.
+*****************************************/
+static int testTensor() {
+  const uint32_t shape[3] = {3, 4, 5};
+  std::vector<float> meanMap(3 * 4 * 5);
+  for (size_t ii = 0; ii < meanMap.size(); ii++) {
+    meanMap[ii] = 100.0f + ii;
+  }
+
+  TtvBox box;
+  box.setLayout(LAYOUT_ALIGNED);
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<uint32_t>(4, UINT32_T, 2);
+  box.putTensor(8, FLOAT_T, 3, shape, meanMap.data());
+  box.putStartEndTag(END_TAG, END_TYPE);
+  box.pack();
+
+  const std::string file = getTempFile("tensor.bin");
+  TtvBox decoded;
+  TtvTensorView view;
+  if (!box.write(file) || !decoded.read(file) ||
+      !decoded.unpack(decoded.getPackedBuffer(), decoded.getPackedBytes()) ||
+      !decoded.getTensorView(8, view)) {
+    TTV_LOGE("Error: failed to read the tensor.");
+    return -1;
+  }
+  ::remove(file.c_str());
+  if ((FLOAT_T != view.dtype) || (3 != view.rank) || (4 != view.shape[1]) ||
+      (meanMap.size() != view.numElements) ||
+      (0 != reinterpret_cast<uintptr_t>(view.data) % 64) ||
+      (0 != ::memcmp(view.data, meanMap.data(), view.bytes))) {
+    TTV_LOGE("Error: the tensor view is wrong or not aligned.");
+    return -1;
+  }
+
+  // parse a tensor file given in the text configuration, its path is
+  // relative to the configuration
+  const std::string meanFile = getTempFile("mean.txt");
+  const std::string cfgFile = getTempFile("tensor.txt");
+  {
+    std::ofstream tensorFile(meanFile);
+    tensorFile << "3 2 2" << std::endl;
+    for (int ii = 0; ii < 12; ii++) {
+      tensorFile << ii * 0.5f << " ";
+    }
+    std::ofstream cfg(cfgFile);
+    cfg << "4 uint32 2 mean_type" << std::endl;
+    cfg << "8 tensor ./" << meanFile.substr(meanFile.find_last_of('/') + 1)
+        << " mean_map" << std::endl;
+  }
+  TtvBox parsed;
+  const bool ret = parsed.parse(cfgFile);
+  ::remove(meanFile.c_str());
+  ::remove(cfgFile.c_str());
+  if (!ret || !parsed.getTensorView(8, view) || (12 != view.numElements) ||
+      (2 != view.shape[2]) ||
+      (5.5f != static_cast<const float *>(view.data)[11])) {
+    TTV_LOGE("Error: failed to parse the tensor file.");
+    return -1;
+  }
+
+  // a shape whose length wraps around to the length of its record
+  const uint32_t huge[2] = {0x80000000u, 0x80000000u};
+  uint8_t crafted[TENSOR_HEADER_BYTES] = {FLOAT_T, 2, 0, 0, 0, 0, 0, 0,
+                                          0x80,    0, 0, 0, 0x80};
+  if ((0 != getTensorBytes(FLOAT_T, 2, huge)) ||
+      decodeTensor(crafted, sizeof(crafted), view) ||
+      box.putTensor(9, FLOAT_T, 2, huge, meanMap.data())) {
+    TTV_LOGE("Error: a tensor of an overflowing shape is accepted.");
+    return -1;
+  }
+
+  TTV_LOGI("testTensor() succeded.");
+  return 0;
+}
+
+/*****************************************
+   Unpack the selected tags only.
+*****************************************/
+static int testProjectedUnpack() {
+  TtvBox box;
+  std::vector<uint8_t> weights(4 << 20, 0x3C);
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<uint32_t>(1, UINT32_T, 224);
+  box.putNonNumbericalValue(2, BYTES_T, weights.size(), weights.data());
+  box.putNumbericalValue<float>(3, FLOAT_T, 0.5f);
+  box.putStartEndTag(END_TAG, END_TYPE);
+  box.pack();
+
+  TtvTagMask tags;
+  tags.set(1);
+  tags.set(3);
+  TtvBox decoded;
+  decoded.reserve(4, 0);
+  // the selected scalars are stored inline, so the large value skipped costs
+  // no allocation
+  uint64_t numAllocations = gNumAllocations;
+  if (!decoded.unpack(box.getPackedBuffer(), box.getPackedBytes(), tags)) {
+    TTV_LOGE("Error: the projected unpack failed.");
+    return -1;
+  }
+  if (gNumAllocations != numAllocations) {
+    TTV_LOGE("Error: the projected unpack allocated memory.");
+    return -1;
+  }
+
+  uint32_t value = 0;
+  float scale = 0;
+  std::vector<uint8_t> tagList;
+  if (!decoded.getNumbericalValue(1, value) || (224 != value) ||
+      !decoded.getNumbericalValue(3, scale) || (0.5f != scale) ||
+      (2 != decoded.getTagList(tagList)) || !decoded.isDirty()) {
+    TTV_LOGE("Error: the projected values are wrong.");
+    return -1;
+  }
+
+  // packing the projected box writes the selected tags only
+  decoded.pack();
+  TtvBox expected;
+  expected.putNumbericalValue<uint32_t>(1, UINT32_T, 224);
+  expected.putNumbericalValue<float>(3, FLOAT_T, 0.5f);
+  expected.pack();
+  if (!isSamePackedBuffer(decoded, expected)) {
+    TTV_LOGE("Error: the projected box is not packed correctly.");
+    return -1;
+  }
+
+  // a malformed buffer is detected even if its tags are skipped, and the
+  // tags selected before the malformed bytes are dropped
+  tagList.clear();
+  if (decoded.unpack(box.getPackedBuffer(), box.getPackedBytes() - 1, tags) ||
+      (0 != decoded.getTagList(tagList))) {
+    TTV_LOGE("Error: the truncated buffer is not detected.");
+    return -1;
+  }
+
+  // a tag stored twice is rejected and leaves an empty box
+  const uint8_t duplicate[] = {START_TAG, START_TYPE, 1, UINT8_T, 1,
+                               1,         UINT8_T,    2, END_TAG, END_TYPE};
+  tagList.clear();
+  if (decoded.unpack(duplicate, sizeof(duplicate)) ||
+      (0 != decoded.getTagList(tagList)) ||
+      decoded.unpack(duplicate, sizeof(duplicate), tags) ||
+      (0 != decoded.getTagList(tagList))) {
+    TTV_LOGE("Error: the duplicate tag is not detected.");
+    return -1;
+  }
+
+  TTV_LOGI("testProjectedUnpack() succeded.");
+  return 0;
+}
+
+/*****************************************
+   Put a list of ttv boxes and access them in O(1).
+*****************************************/
+static int testRepeated() {
+  // the preprocessing configs of a model with three inputs
+  std::vector<TtvBox> inputs;
+  for (uint32_t ii = 0; ii < 3; ii++) {
+    inputs.push_back(createCounterBox(224 + ii, 0.5 * ii, "input"));
+  }
+  TtvBox box;
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<uint8_t>(1, UINT8_T, (uint8_t)3);
+  if (!box.putRepeatedTtvValue(2, inputs.data(), inputs.size())) {
+    TTV_LOGE("Error: putRepeatedTtvValue() failed.");
+    return -1;
+  }
+  box.putStartEndTag(END_TAG, END_TYPE);
+
+  // a duplicated tag is rejected without dropping the values put before
+  uint8_t count = 0;
+  if (box.putRepeatedTtvValue(2, inputs.data(), 1) ||
+      !box.getNumbericalValue(1, count) || (3 != count)) {
+    TTV_LOGE("Error: the duplicated tag is not handled correctly.");
+    return -1;
+  }
+
+  for (uint8_t layout = LAYOUT_COMPACT; layout <= LAYOUT_ALIGNED; layout++) {
+    box.setLayout(layout);
+    box.pack();
+    TtvBox decoded;
+    decoded.setLayout(layout);
+    TtvRepeatedView view;
+    if (!decoded.unpack(box.getPackedBuffer(), box.getPackedBytes()) ||
+        !decoded.getRepeatedView(2, view) || (3 != view.count)) {
+      TTV_LOGE("Error: failed to get the list of ttv boxes.");
+      return -1;
+    }
+    // each element is reached without decoding the others
+    for (uint32_t ii = view.count; ii > 0; ii--) {
+      const uint8_t *element = nullptr;
+      uint32_t length = 0;
+      if (!getRepeatedElement(view, ii - 1, &element, length) ||
+          (length != inputs[ii - 1].getPackedBytes()) ||
+          (0 != ::memcmp(element, inputs[ii - 1].getPackedBuffer(), length))) {
+        TTV_LOGE("Error: the element %d is wrong.", ii - 1);
+        return -1;
+      }
+    }
+    TtvBox input;
+    uint32_t value = 0;
+    if (!decoded.getRepeatedTtvValue(2, 1, input) ||
+        !input.getNumbericalValue(1, value) || (225 != value) ||
+        decoded.getRepeatedTtvValue(2, 3, input)) {
+      TTV_LOGE("Error: getRepeatedTtvValue() failed.");
+      return -1;
+    }
+  }
+
+  // an empty list
+  TtvBox empty;
+  TtvRepeatedView view;
+  const uint8_t *element = nullptr;
+  uint32_t length = 0;
+  if (!empty.putRepeatedTtvValue(1, nullptr, 0) || !empty.pack() ||
+      !empty.getRepeatedView(1, view) || (0 != view.count) ||
+      getRepeatedElement(view, 0, &element, length)) {
+    TTV_LOGE("Error: the empty list is not handled correctly.");
+    return -1;
+  }
+
+  TTV_LOGI("testRepeated() succeded.");
+  return 0;
+}
+
+static int testValueSlots() {
+  TtvBox box;
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<uint16_t>(1, UINT16_T, 1234);
+  box.putNumbericalValue<int32_t>(2, INT32_T, -123456);
+  box.putNumbericalValue<uint64_t>(3, VARUINT_T, 300);
+  box.putNumbericalValue<double>(4, DOUBLE_T, 0.5);
+  const std::string str = "./mean.txt";
+  box.putNonNumbericalValue(8, STRING_T, str.size(), str.c_str());
+  box.putStartEndTag(END_TAG, END_TYPE);
+  box.pack();
+
+  // the values are decoded once by unpack(), T must match the stored type
+  TtvBox decoded;
+  decoded.unpack(box.getPackedBuffer(), box.getPackedBytes());
+  uint16_t value16 = 0;
+  int32_t value32 = 0;
+  uint32_t unsigned32 = 0;
+  uint8_t value8 = 0;
+  double valueDouble = 0;
+  float valueFloat = 0;
+  if (!decoded.getNumbericalValue(1, value16) || (1234 != value16) ||
+      !decoded.getNumbericalValue(2, value32) || (-123456 != value32) ||
+      !decoded.getNumbericalValue(3, value16) || (300 != value16) ||
+      !decoded.getNumbericalValue(4, valueDouble) || (0.5 != valueDouble)) {
+    TTV_LOGE("Error: failed to get the decoded values.");
+    return -1;
+  }
+  if (decoded.getNumbericalValue(1, unsigned32) ||
+      decoded.getNumbericalValue(2, unsigned32) ||
+      decoded.getNumbericalValue(3, value8) ||
+      decoded.getNumbericalValue(4, valueFloat) ||
+      decoded.getNumbericalValue(8, unsigned32)) {
+    TTV_LOGE("Error: the type of the value is not checked.");
+    return -1;
+  }
+
+  // the decoded values follow the changes, a shared box keeps its own
+  TtvBox shared = decoded.share();
+  decoded.setNumbericalValue<uint16_t>(1, 4321);
+  decoded.setNumbericalValue<uint64_t>(3, 70000);
+  TtvBox moved(std::move(decoded));
+  uint32_t varint = 0;
+  if (!moved.getNumbericalValue(1, value16) || (4321 != value16) ||
+      !moved.getNumbericalValue(3, varint) || (70000 != varint) ||
+      !shared.getNumbericalValue(1, value16) || (1234 != value16)) {
+    TTV_LOGE("Error: the decoded values are stale.");
+    return -1;
+  }
+
+  const int rounds = 1000000;
+  int64_t sum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int ii = 0; ii < rounds; ii++) {
+    moved.getNumbericalValue(2, value32);
+    moved.getNumbericalValue(4, valueDouble);
+    sum += value32 + static_cast<int64_t>(valueDouble);
+  }
+  const std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  TTV_LOGI("get a numberical value: %.1f ns (%lld)",
+           seconds.count() * 1e9 / rounds / 2, (long long)sum);
+
+  TTV_LOGI("testValueSlots() succeded.");
+  return 0;
+}
+
+static int testHash() {
+  // the same content gives the same hash whatever the layout and the state
+  TtvBox compact;
+  TtvBox aligned;
+  TtvBox dirty;
+  createMessage(compact, 100);
+  createMessage(aligned, 100);
+  createMessage(dirty, 100);
+  aligned.setLayout(LAYOUT_ALIGNED);
+  compact.pack();
+  aligned.pack();
+  const uint64_t hash = compact.hash();
+  if ((hash != aligned.hash()) || (hash != dirty.hash()) ||
+      (compact.hash128() != aligned.hash128()) || (hash == compact.hash(1)) ||
+      (hash != hashBytes(compact.getPackedBuffer(), compact.getPackedBytes())) ||
+      (hash != compact.hash128().low) ||
+      (compact.hash(0x9E3779B97F4A7C15ULL) != compact.hash128().high)) {
+    TTV_LOGE("Error: the same content gives different hashes.");
+    return -1;
+  }
+
+  // a NaN with a payload and an overlong varint written by another writer
+  // hash like the canonical ones
+  float nan = 0;
+  const uint32_t nanBits = 0x7FC00001u;
+  ::memcpy(&nan, &nanBits, sizeof(float));
+  TtvBox canonical;
+  canonical.putNumbericalValue<float>(2, FLOAT_T, nan);
+  canonical.putNumbericalValue<uint32_t>(3, VARUINT_T, 300);
+  const uint8_t foreign[] = {2, FLOAT_T, 0x7F, 0xC0, 0x00, 0x01,
+                             3, VARUINT_T, 0xAC, 0x82, 0x00};
+  TtvBox decoded;
+  if (!decoded.unpack(foreign, sizeof(foreign)) ||
+      (canonical.hash() != decoded.hash())) {
+    TTV_LOGE("Error: the non canonical values change the hash.");
+    return -1;
+  }
+
+  // a buffer of another writer with the records out of the order of tags
+  TtvBox ordered;
+  ordered.putNumbericalValue<float>(2, FLOAT_T, 1.0f);
+  ordered.putNumbericalValue<uint32_t>(3, VARUINT_T, 300);
+  ordered.pack();
+  const uint8_t swapped[] = {3, VARUINT_T, 0xAC, 0x02,
+                             2, FLOAT_T,   0x3F, 0x80, 0x00, 0x00};
+  if (!decoded.unpack(swapped, sizeof(swapped)) ||
+      (ordered.hash() != decoded.hash()) ||
+      (ordered.hash128() != decoded.hash128())) {
+    TTV_LOGE("Error: the order of the records changes the hash.");
+    return -1;
+  }
+
+  // so do the boxes nested in the aligned layout and the NaNs in a tensor
+  float quietNan = 0;
+  const uint32_t quietNanBits = 0x7FC00000u;
+  ::memcpy(&quietNan, &quietNanBits, sizeof(float));
+  const float payloadElements[] = {1.0f, nan, 2.0f};
+  const float quietElements[] = {1.0f, quietNan, 2.0f};
+  const uint32_t shape[] = {3};
+  TtvBox children[2][2];
+  TtvBox nested[2];
+  for (uint32_t ii = 0; ii < 2; ii++) {
+    for (uint32_t jj = 0; jj < 2; jj++) {
+      createMessage(children[ii][jj], 7 + jj);
+      children[ii][jj].setLayout((0 == ii) ? LAYOUT_ALIGNED : LAYOUT_COMPACT);
+      children[ii][jj].pack();
+    }
+    nested[ii].putTtvValue(1, TTV_T, &children[ii][0]);
+    nested[ii].putRepeatedTtvValue(2, children[ii], 2);
+    nested[ii].putTensor(3, FLOAT_T, 1, shape,
+                         (0 == ii) ? payloadElements : quietElements);
+    nested[ii].pack();
+  }
+  TtvBox otherChild;
+  otherChild.putTtvValue(1, TTV_T, &children[1][1]);
+  if ((nested[0].hash() != nested[1].hash()) ||
+      (nested[1].hash() !=
+       hashBytes(nested[1].getPackedBuffer(), nested[1].getPackedBytes())) ||
+      (otherChild.hash() == nested[1].hash())) {
+    TTV_LOGE("Error: the nested values are not hashed canonically.");
+    return -1;
+  }
+
+  // any change of the content changes the hash
+  dirty.setNumbericalValue<uint32_t>(1, 101);
+  TtvBox retyped;
+  retyped.putStartEndTag(START_TAG, START_TYPE);
+  retyped.putNumbericalValue<uint16_t>(1, UINT16_T, 100);
+  retyped.putNumbericalValue<float>(2, FLOAT_T, 0.017f);
+  retyped.putNumbericalValue<uint32_t>(3, VARUINT_T, 300);
+  const std::string str = "./mean.txt";
+  retyped.putNonNumbericalValue(8, STRING_T, str.size(), str.c_str());
+  retyped.putStartEndTag(END_TAG, END_TYPE);
+  if ((hash == dirty.hash()) || (hash == retyped.hash())) {
+    TTV_LOGE("Error: the different content gives the same hash.");
+    return -1;
+  }
+
+  TTV_LOGI("testHash() succeded.");
+  return 0;
+}
+
+static int testParallelPack() {
+  // values of a few bytes to several MB, in both layouts
+  const uint32_t lengths[] = {100, 3 << 20, 7, 1 << 20, 5000, (5 << 20) + 3, 1};
+  std::vector<std::vector<char>> values;
+  for (const uint32_t length : lengths) {
+    values.emplace_back(length);
+    for (uint32_t ii = 0; ii < length; ii++) {
+      values.back()[ii] = static_cast<char>(ii * 7 + length);
+    }
+  }
+  TtvThreadPool pool(4);
+  for (const uint8_t layout : {LAYOUT_COMPACT, LAYOUT_ALIGNED}) {
+    TtvBox serial;
+    TtvBox parallel;
+    for (TtvBox *box : {&serial, &parallel}) {
+      box->setLayout(layout);
+      box->putStartEndTag(START_TAG, START_TYPE);
+      box->putNumbericalValue<uint32_t>(1, UINT32_T, 224);
+      for (uint32_t ii = 0; ii < values.size(); ii++) {
+        box->putNonNumbericalValue(10 + ii, BYTES_T, values[ii].size(),
+                                   values[ii].data());
+      }
+      box->putStartEndTag(END_TAG, END_TYPE);
+    }
+    serial.pack();
+    parallel.pack(pool);
+    uint32_t value = 0;
+    if (parallel.isDirty() ||
+        (serial.getPackedBytes() != parallel.getPackedBytes()) ||
+        (0 != ::memcmp(serial.getPackedBuffer(), parallel.getPackedBuffer(),
+                       serial.getPackedBytes())) ||
+        !parallel.getNumbericalValue(1, value) || (224 != value)) {
+      TTV_LOGE("Error: the parallel pack differs from the serial one.");
+      return -1;
+    }
+  }
+
+  // many large values, the threads copy them until the memory bandwidth is
+  // saturated
+  const uint32_t fields = 32;
+  std::vector<char> large(4 << 20, 'x');
+  TtvBox box;
+  for (uint32_t ii = 0; ii < fields; ii++) {
+    box.putNonNumbericalValue(ii + 1, BYTES_T, large.size(), large.data());
+  }
+  for (const uint32_t threads : {1, 2, 4}) {
+    TtvThreadPool threadPool(threads);
+    const int rounds = 5;
+    const auto start = std::chrono::steady_clock::now();
+    for (int ii = 0; ii < rounds; ii++) {
+      box.setNonNumbericalValue(1, 1, "y");
+      box.pack(threadPool);
+      box.setNonNumbericalValue(1, large.size(), large.data());
+      box.pack(threadPool);
+    }
+    const std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    TTV_LOGI("pack %d MB with %d threads: %.2f GB/s",
+             (int)(box.getPackedBytes() >> 20), threads,
+             box.getPackedBytes() * 2.0 * rounds / seconds.count() / 1e9);
+  }
+
+  TTV_LOGI("testParallelPack() succeded.");
+  return 0;
+}
+
 /*****************************************
    Unit Testing for ttv box class.
 *****************************************/
@@ -172,5 +1057,53 @@ int main(int argc, char const *argv[]) {
     tag++;
   }
 
+  if (0 != testMoveAndShare()) {
+    return -1;
+  }
+
+  if (0 != testReuse()) {
+    return -1;
+  }
+
+  if (0 != testSetValue()) {
+    return -1;
+  }
+
+  if (0 != testDiffPatch()) {
+    return -1;
+  }
+
+  if (0 != testAlignedLayout()) {
+    return -1;
+  }
+
+  if (0 != testHugeLength()) {
+    return -1;
+  }
+
+  if (0 != testTensor()) {
+    return -1;
+  }
+
+  if (0 != testProjectedUnpack()) {
+    return -1;
+  }
+
+  if (0 != testRepeated()) {
+    return -1;
+  }
+
+  if (0 != testHash()) {
+    return -1;
+  }
+
+  if (0 != testValueSlots()) {
+    return -1;
+  }
+
+  if (0 != testParallelPack()) {
+    return -1;
+  }
+
   return 0;
 }
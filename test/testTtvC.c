@@ -0,0 +1,110 @@
+#include "include/TtvC.h"
+#include "include/common.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*****************************************
+   Unit Testing for the C API, built as C.
+*****************************************/
+
+// the C counterpart of getTempFile() of test/testTtvCommon.h
+static void getTempFile(const char *name, char *file, const size_t size) {
+  const char *dir = getenv("TMPDIR");
+  snprintf(file, size, "%s/ttv-%d-%s", (NULL != dir) ? dir : "/tmp",
+           (int)getpid(), name);
+}
+
+static int testPutAndGet(void) {
+  ttv_box *box = ttv_box_create();
+  const uint32_t height = 224;
+  const float scale = 0.5f;
+  const bool flag = true;
+  const char path[] = "./mean.txt";
+  if ((TTV_OK != ttv_box_put_start_end(box, START_TAG, START_TYPE)) ||
+      (TTV_OK != ttv_box_put_number(box, 1, UINT32_T, &height)) ||
+      (TTV_OK != ttv_box_put_number(box, 2, FLOAT_T, &scale)) ||
+      (TTV_OK != ttv_box_put_number(box, 3, BOOL_T, &flag)) ||
+      (TTV_OK != ttv_box_put_bytes(box, 8, STRING_T, path, strlen(path))) ||
+      (TTV_OK != ttv_box_put_start_end(box, END_TAG, END_TYPE)) ||
+      (TTV_OK == ttv_box_put_number(box, 4, STRING_T, &height))) {
+    TTV_LOGE("Error: failed to put values through the C API.");
+    ttv_box_destroy(box);
+    return -1;
+  }
+
+  // the packed buffer is borrowed until the box is modified
+  const uint8_t *data = NULL;
+  uint32_t size = 0;
+  if ((TTV_OK == ttv_box_get_packed_buffer(box, &data, &size)) ||
+      (TTV_OK != ttv_box_pack(box)) ||
+      (TTV_OK != ttv_box_get_packed_buffer(box, &data, &size))) {
+    TTV_LOGE("Error: failed to pack through the C API.");
+    ttv_box_destroy(box);
+    return -1;
+  }
+
+  ttv_box *decoded = ttv_box_create();
+  uint32_t value = 0;
+  float ratio = 0;
+  bool decodedFlag = false;
+  uint8_t type = 0;
+  uint8_t tags[2];
+  const uint8_t *packedValue = NULL;
+  uint32_t length = 0;
+  int ret = 0;
+  if ((TTV_OK != ttv_box_unpack(decoded, data, size)) ||
+      (TTV_OK != ttv_box_get_number(decoded, 1, UINT32_T, &value)) ||
+      (height != value) ||
+      (TTV_OK != ttv_box_get_number(decoded, 2, FLOAT_T, &ratio)) ||
+      (scale != ratio) ||
+      (TTV_OK != ttv_box_get_number(decoded, 3, BOOL_T, &decodedFlag)) ||
+      !decodedFlag ||
+      (TTV_OK == ttv_box_get_number(decoded, 2, UINT32_T, &value)) ||
+      (TTV_OK != ttv_box_get_type(decoded, 8, &type)) || (STRING_T != type) ||
+      (6 != ttv_box_get_tags(decoded, tags, 2)) || (START_TAG != tags[0]) ||
+      (1 != tags[1])) {
+    TTV_LOGE("Error: failed to get values through the C API.");
+    ret = -1;
+  }
+
+  // the string is borrowed from the packed buffer without copying
+  if ((0 == ret) &&
+      ((TTV_OK != ttv_box_get_packed_value(decoded, 8, &packedValue,
+                                           &length)) ||
+       (strlen(path) != length) || (0 != memcmp(packedValue, path, length)))) {
+    TTV_LOGE("Error: failed to borrow a value through the C API.");
+    ret = -1;
+  }
+
+  // round trip through a file
+  char file[256];
+  getTempFile("capi.bin", file, sizeof(file));
+  ttv_box_clear(decoded);
+  if ((0 == ret) &&
+      ((TTV_OK != ttv_box_write(box, file, 1)) ||
+       (TTV_OK != ttv_box_read(decoded, file)) ||
+       (TTV_OK != ttv_box_get_number(decoded, 1, UINT32_T, &value)) ||
+       (height != value))) {
+    TTV_LOGE("Error: failed to write and read through the C API.");
+    ret = -1;
+  }
+  remove(file);
+
+  ttv_box_destroy(decoded);
+  ttv_box_destroy(box);
+  if (0 == ret) {
+    TTV_LOGI("testPutAndGet() succeded.");
+  }
+  return ret;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testPutAndGet()) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,400 @@
+#include "include/TtvBox.h"
+#include "include/TtvChannel.h"
+#include "include/TtvView.h"
+#include "include/common.h"
+#include "test/testTtvCommon.h"
+#include <chrono>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv channel.
+*****************************************/
+
+static bool readAll(const int fd, uint8_t *buffer, size_t size) {
+  while (size > 0) {
+    const ssize_t bytes = ::read(fd, buffer, size);
+    if (bytes <= 0) {
+      return false;
+    }
+    buffer += bytes;
+    size -= bytes;
+  }
+  return true;
+}
+
+static int testSocket() {
+  int fds[2];
+  if (0 != ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+    TTV_LOGE("Error: failed to create the socketpair.");
+    return -1;
+  }
+
+  // many small frames, a large one sent without copying in the middle, both
+  // layouts
+  const uint32_t count = 20000;
+  const std::vector<uint8_t> large(100000, 0x5A);
+  std::thread writer([&fds, count, &large]() {
+    TtvChannel channel(fds[0], 4096);
+    TtvBox box;
+    TtvBox wrapper;
+    for (uint32_t ii = 0; ii < count; ii++) {
+      createMessage(box, ii);
+      box.setLayout((ii & 1) ? LAYOUT_ALIGNED : LAYOUT_COMPACT);
+      channel.write(box);
+      if (count / 2 == ii) {
+        wrapper.clear();
+        wrapper.putNonNumbericalValue(1, BYTES_T, large.size(), large.data());
+        wrapper.pack();
+        channel.write(wrapper.getPackedBuffer(), wrapper.getPackedBytes());
+      }
+    }
+    channel.flush();
+    ::shutdown(fds[0], SHUT_WR);
+  });
+
+  TtvChannel channel(fds[1]);
+  TtvView view;
+  uint32_t errors = 0;
+  for (uint32_t ii = 0; ii < count; ii++) {
+    uint32_t sequence = 0;
+    float scale = 0;
+    if (!channel.read(view) || !view.getNumbericalValue(1, sequence) ||
+        (ii != sequence) || !view.getNumbericalValue(2, scale) ||
+        (0.017f != scale) ||
+        (((ii & 1) ? LAYOUT_ALIGNED : LAYOUT_COMPACT) != view.getLayout())) {
+      errors++;
+    }
+    if (count / 2 == ii) {
+      TtvBox box;
+      const uint8_t *value = nullptr;
+      uint32_t length = 0;
+      if (!channel.read(box) || !box.getPackedValue(1, &value, length) ||
+          (large.size() != length) || (0 != memcmp(value, large.data(), length))) {
+        errors++;
+      }
+    }
+  }
+  const bool eof = !channel.read(view) && channel.isEof();
+  writer.join();
+  ::close(fds[0]);
+  ::close(fds[1]);
+
+  if ((0 != errors) || !eof) {
+    TTV_LOGE("Error: %d frames are received wrongly.", errors);
+    return -1;
+  }
+
+  TTV_LOGI("testSocket() succeded.");
+  return 0;
+}
+
+static int testPipe() {
+  int fds[2];
+  if (0 != ::pipe(fds)) {
+    TTV_LOGE("Error: failed to create the pipe.");
+    return -1;
+  }
+
+  TtvChannel writer(fds[1]);
+  TtvBox box;
+  for (uint32_t ii = 0; ii < 10; ii++) {
+    createMessage(box, ii);
+    writer.write(box);
+  }
+  // the frames are coalesced until flushing
+  const uint32_t pending = writer.getPendingBytes();
+  if ((0 == pending) || !writer.flush() || (0 != writer.getPendingBytes())) {
+    TTV_LOGE("Error: the frames are not coalesced.");
+    return -1;
+  }
+  ::close(fds[1]);
+
+  TtvChannel reader(fds[0]);
+  uint32_t sequence = 0;
+  for (uint32_t ii = 0; ii < 10; ii++) {
+    if (!reader.read(box) || !box.getNumbericalValue(1, sequence) ||
+        (ii != sequence)) {
+      TTV_LOGE("Error: failed to read the frames from the pipe.");
+      return -1;
+    }
+  }
+  if (reader.read(box) || !reader.isEof()) {
+    TTV_LOGE("Error: the end of the pipe is not detected.");
+    return -1;
+  }
+  ::close(fds[0]);
+
+  TTV_LOGI("testPipe() succeded.");
+  return 0;
+}
+
+static int testMalformed() {
+  // a truncated frame and a frame with a bad header are errors, not the end
+  const uint8_t truncated[] = {0, 0, 0, 16, LAYOUT_COMPACT, 0, 0, 0, 1, 2};
+  const uint8_t badHeader[] = {0, 0, 0, 0, 7, 0, 0, 0};
+  // a flag added by a newer writer
+  const uint8_t unknownFlag[] = {0, 0, 0, 0, LAYOUT_COMPACT, 0x80, 0, 0};
+  const std::vector<std::vector<uint8_t>> streams = {
+      std::vector<uint8_t>(truncated, truncated + sizeof(truncated)),
+      std::vector<uint8_t>(badHeader, badHeader + sizeof(badHeader)),
+      std::vector<uint8_t>(unknownFlag, unknownFlag + sizeof(unknownFlag))};
+  for (const std::vector<uint8_t> &stream : streams) {
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    ::write(fds[0], stream.data(), stream.size());
+    ::close(fds[0]);
+    TtvChannel channel(fds[1]);
+    TtvView view;
+    const bool ret = channel.read(view);
+    ::close(fds[1]);
+    if (ret || channel.isEof()) {
+      TTV_LOGE("Error: the malformed stream is not rejected.");
+      return -1;
+    }
+  }
+
+  TTV_LOGI("testMalformed() succeded.");
+  return 0;
+}
+
+static int testVarintFlag() {
+  int fds[2];
+  if (0 != ::pipe(fds)) {
+    TTV_LOGE("Error: failed to create the pipe.");
+    return -1;
+  }
+
+  // the boxes with varints are flagged, the flags of a packed buffer are
+  // given by the caller
+  TtvBox varint;
+  varint.putNumbericalValue<uint32_t>(1, VARUINT_T, 300);
+  varint.pack();
+  TtvBox plain;
+  plain.putNumbericalValue<uint32_t>(1, UINT32_T, 300);
+  plain.pack();
+  TtvChannel writer(fds[1]);
+  writer.write(varint);
+  writer.write(varint.getPackedBuffer(), varint.getPackedBytes(),
+               LAYOUT_COMPACT,
+               TtvBox::hasVarint(varint.getPackedBuffer(),
+                                 varint.getPackedBytes(), LAYOUT_COMPACT)
+                   ? CHANNEL_FLAG_VARINT
+                   : 0);
+  writer.write(plain);
+  if (writer.write(plain.getPackedBuffer(), plain.getPackedBytes(),
+                   LAYOUT_COMPACT, 0x80)) {
+    TTV_LOGE("Error: an unknown flag is written.");
+    return -1;
+  }
+  writer.flush();
+  ::close(fds[1]);
+
+  const uint8_t expected[3] = {CHANNEL_FLAG_VARINT, CHANNEL_FLAG_VARINT, 0};
+  std::vector<uint8_t> stream;
+  for (uint32_t ii = 0; ii < 3; ii++) {
+    const uint32_t bytes = CHANNEL_FRAME_HEADER_BYTES +
+                           ((ii < 2) ? varint : plain).getPackedBytes();
+    stream.resize(stream.size() + bytes);
+    uint8_t *frame = stream.data() + stream.size() - bytes;
+    if (!readAll(fds[0], frame, bytes) || (expected[ii] != frame[5])) {
+      TTV_LOGE("Error: the flags of the frame are wrong.");
+      return -1;
+    }
+  }
+  ::close(fds[0]);
+
+  // the flagged frames are read back, a frame forwarded keeps its flags
+  ::pipe(fds);
+  ::write(fds[1], stream.data(), stream.size());
+  ::close(fds[1]);
+  TtvChannel reader(fds[0]);
+  const uint8_t *frame = nullptr;
+  uint32_t length = 0;
+  uint8_t layout = LAYOUT_ALIGNED;
+  uint8_t flags = 0;
+  if (!reader.read(&frame, length, layout, flags) ||
+      (CHANNEL_FLAG_VARINT != flags)) {
+    TTV_LOGE("Error: the flags of the raw frame are wrong.");
+    return -1;
+  }
+  TtvBox box;
+  uint32_t value = 0;
+  for (uint32_t ii = 1; ii < 3; ii++) {
+    if (!reader.read(box) || !box.getNumbericalValue(1, value) ||
+        (300 != value) || (box.hasVarint() != (ii < 2))) {
+      TTV_LOGE("Error: failed to read the flagged frames.");
+      return -1;
+    }
+  }
+  ::close(fds[0]);
+
+  TTV_LOGI("testVarintFlag() succeded.");
+  return 0;
+}
+
+template <typename Send, typename Receive>
+static double measure(Send send, Receive receive) {
+  int fds[2];
+  ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  const auto start = std::chrono::steady_clock::now();
+  std::thread writer([&send, &fds]() {
+    send(fds[0]);
+    ::shutdown(fds[0], SHUT_WR);
+  });
+  receive(fds[1]);
+  writer.join();
+  const std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  ::close(fds[0]);
+  ::close(fds[1]);
+  return seconds.count();
+}
+
+static int testThroughput() {
+  const uint32_t count = 200000;
+  TtvBox box;
+  createMessage(box, 0);
+  box.pack();
+  const uint32_t messageBytes = box.getPackedBytes();
+  const double totalBytes = (double)count * messageBytes;
+
+  // the baseline, own length framing and one send per message
+  const double sendSeconds = measure(
+      [&box, count](const int fd) {
+        std::vector<uint8_t> frame(sizeof(uint32_t) + box.getPackedBytes());
+        for (uint32_t ii = 0; ii < count; ii++) {
+          const uint32_t length = htonl(box.getPackedBytes());
+          ::memcpy(frame.data(), &length, sizeof(uint32_t));
+          ::memcpy(frame.data() + sizeof(uint32_t), box.getPackedBuffer(),
+                   box.getPackedBytes());
+          ::send(fd, frame.data(), frame.size(), 0);
+        }
+      },
+      [count](const int fd) {
+        std::vector<uint8_t> payload;
+        for (uint32_t ii = 0; ii < count; ii++) {
+          uint32_t length = 0;
+          readAll(fd, reinterpret_cast<uint8_t *>(&length), sizeof(length));
+          payload.resize(ntohl(length));
+          readAll(fd, payload.data(), payload.size());
+        }
+      });
+
+  uint32_t received = 0;
+  const double channelSeconds = measure(
+      [&box, count](const int fd) {
+        TtvChannel channel(fd);
+        for (uint32_t ii = 0; ii < count; ii++) {
+          channel.write(box);
+        }
+        channel.flush();
+      },
+      [&received](const int fd) {
+        TtvChannel channel(fd);
+        TtvView view;
+        while (channel.read(view)) {
+          received++;
+        }
+      });
+
+  // the boxes packed once, e.g. forwarded, are framed by a copy only
+  const double packedSeconds = measure(
+      [&box, count](const int fd) {
+        TtvChannel channel(fd);
+        for (uint32_t ii = 0; ii < count; ii++) {
+          channel.write(box.getPackedBuffer(), box.getPackedBytes());
+        }
+        channel.flush();
+      },
+      [&received](const int fd) {
+        TtvChannel channel(fd);
+        TtvView view;
+        while (channel.read(view)) {
+          received++;
+        }
+      });
+
+  // the framing alone, the frames are received without walking their records
+  uint32_t framed = 0;
+  const double frameSeconds = measure(
+      [&box, count](const int fd) {
+        TtvChannel channel(fd);
+        for (uint32_t ii = 0; ii < count; ii++) {
+          channel.write(box.getPackedBuffer(), box.getPackedBytes());
+        }
+        channel.flush();
+      },
+      [&framed, messageBytes](const int fd) {
+        TtvChannel channel(fd);
+        const uint8_t *frame = nullptr;
+        uint32_t length = 0;
+        uint8_t layout = LAYOUT_ALIGNED;
+        uint8_t flags = 0;
+        while (channel.read(&frame, length, layout, flags)) {
+          if ((messageBytes == length) && (LAYOUT_COMPACT == layout)) {
+            framed++;
+          }
+        }
+      });
+
+  // the raw bandwidth of the socket with the same bytes in 64KB writes
+  const double rawSeconds = measure(
+      [totalBytes](const int fd) {
+        std::vector<uint8_t> chunk(CHANNEL_DEFAULT_BUFFER_BYTES);
+        for (double sent = 0; sent < totalBytes; sent += chunk.size()) {
+          ::send(fd, chunk.data(), chunk.size(), 0);
+        }
+      },
+      [](const int fd) {
+        std::vector<uint8_t> chunk(CHANNEL_DEFAULT_BUFFER_BYTES);
+        while (::read(fd, chunk.data(), chunk.size()) > 0) {
+        }
+      });
+
+  if ((2 * count != received) || (count != framed)) {
+    TTV_LOGE("Error: %d of %d frames are received.", received + framed,
+             3 * count);
+    return -1;
+  }
+  TTV_LOGI("%d frames of %d bytes: send per message %.1f MB/s, channel %.1f "
+           "MB/s, channel of packed boxes %.1f MB/s, framing alone %.1f MB/s, "
+           "raw socket %.1f MB/s",
+           count, messageBytes, totalBytes / sendSeconds / 1e6,
+           totalBytes / channelSeconds / 1e6, totalBytes / packedSeconds / 1e6,
+           totalBytes / frameSeconds / 1e6, totalBytes / rawSeconds / 1e6);
+
+  TTV_LOGI("testThroughput() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testSocket()) {
+    return -1;
+  }
+
+  if (0 != testPipe()) {
+    return -1;
+  }
+
+  if (0 != testMalformed()) {
+    return -1;
+  }
+
+  if (0 != testVarintFlag()) {
+    return -1;
+  }
+
+  if (0 != testThroughput()) {
+    return -1;
+  }
+
+  return 0;
+}
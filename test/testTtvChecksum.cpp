@@ -0,0 +1,138 @@
+#include "include/TtvBox.h"
+#include "include/TtvChecksum.h"
+#include "include/common.h"
+#include "test/testTtvCommon.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for crc32c checksum.
+*****************************************/
+
+static int testCrc32c() {
+  // check value of CRC-32C
+  const char *check = "123456789";
+  if ((0xE3069283 != crc32c(0, check, 9)) ||
+      (0xE3069283 != crc32cSoftware(0, check, 9))) {
+    TTV_LOGE("Error: wrong checksum of the check string.");
+    return -1;
+  }
+
+  std::vector<uint8_t> data(4096 + 7);
+  for (size_t ii = 0; ii < data.size(); ii++) {
+    data[ii] = static_cast<uint8_t>(ii * 131 + 17);
+  }
+  for (size_t length = 0; length < 300; length++) {
+    for (size_t start = 0; start < 8; start++) {
+      const uint32_t crc = crc32c(0, data.data() + start, length);
+      if (crc != crc32cSoftware(0, data.data() + start, length)) {
+        TTV_LOGE("Error: hardware and software checksums differ.");
+        return -1;
+      }
+      // streaming the data in two pieces gives the same checksum
+      const size_t half = length / 3;
+      if (crc != crc32c(crc32c(0, data.data() + start, half),
+                        data.data() + start + half, length - half)) {
+        TTV_LOGE("Error: incremental checksum differs.");
+        return -1;
+      }
+    }
+  }
+
+  std::vector<uint8_t> large(64 << 20, 0x5A);
+  const int rounds = 8;
+  uint32_t crc = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int ii = 0; ii < rounds; ii++) {
+    crc = crc32c(crc, large.data(), large.size());
+  }
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  TTV_LOGI("crc32c throughput: %.2f GB/s (crc = 0x%08X).",
+           rounds * large.size() / seconds.count() / 1e9, crc);
+
+  TTV_LOGI("testCrc32c() succeded.");
+  return 0;
+}
+
+static int testVerifiedRead() {
+  TtvBox box;
+  createConfig(box);
+  box.pack();
+
+  const std::string file = getTempFile("checksum.bin");
+  TtvBox decoded;
+  uint32_t value = 0;
+  if (!box.write(file, true) || !decoded.read(file) ||
+      !decoded.unpack(decoded.getPackedBuffer(), decoded.getPackedBytes()) ||
+      !decoded.getNumbericalValue(2, value) || (224 != value)) {
+    TTV_LOGE("Error: failed to read a checksummed ttv box.");
+    return -1;
+  }
+
+  // the legacy header written by older writers is still supported
+  {
+    const uint32_t length = htonl(box.getPackedBytes());
+    std::ofstream out(file, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+    out.write(reinterpret_cast<const char *>(box.getPackedBuffer()),
+              box.getPackedBytes());
+  }
+  if (!decoded.read(file) ||
+      (decoded.getPackedBytes() != box.getPackedBytes())) {
+    TTV_LOGE("Error: failed to read a ttv box with the legacy header.");
+    return -1;
+  }
+
+  // corrupt one byte of the payload
+  box.write(file, true);
+  std::vector<char> contents;
+  {
+    std::ifstream in(file, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  }
+  contents[EXTENDED_HEADER_BYTES + 3] ^= 0x10;
+  if (decoded.read(contents.data())) {
+    TTV_LOGE("Error: the corrupted ttv box is not detected.");
+    return -1;
+  }
+  contents[EXTENDED_HEADER_BYTES + 3] ^= 0x10;
+  if (!decoded.read(contents.data())) {
+    TTV_LOGE("Error: failed to read a checksummed buffer.");
+    return -1;
+  }
+
+  // truncate the file
+  {
+    std::ofstream out(file, std::ios::binary);
+    out.write(contents.data(), contents.size() - 5);
+  }
+  const bool truncated = decoded.read(file);
+  ::remove(file.c_str());
+  if (truncated) {
+    TTV_LOGE("Error: the truncated ttv box is not detected.");
+    return -1;
+  }
+
+  TTV_LOGI("testVerifiedRead() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testCrc32c()) {
+    return -1;
+  }
+
+  if (0 != testVerifiedRead()) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "include/TtvBox.h"
+#include "include/common.h"
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+/*****************************************
+   Helpers shared by the unit tests.
+*****************************************/
+
+// a path in the temporary directory unique to the process, so that the tests
+// leave no file in the working directory and can run concurrently
+inline std::string getTempFile(const std::string &name) {
+  const char *dir = ::getenv("TMPDIR");
+  return std::string((nullptr != dir) ? dir : "/tmp") + "/ttv-" +
+         std::to_string(::getpid()) + "-" + name;
+}
+
+// a config of demo/modelPreCfg.txt, the arguments replace the values of the
+// file: 1 channels, 2 height, 3 width, 4 mean type, 8 mean map, 9 scale
+inline void createConfig(ttv::TtvBox &box, const uint32_t channels = 3,
+                         const uint32_t height = 224,
+                         const uint32_t width = 224,
+                         const uint32_t meanType = 1,
+                         const std::string &meanMap = "./mean.txt",
+                         const float scale = 0.017f) {
+  box.clear();
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<uint32_t>(1, UINT32_T, channels);
+  box.putNumbericalValue<uint32_t>(2, UINT32_T, height);
+  box.putNumbericalValue<uint32_t>(3, UINT32_T, width);
+  box.putNumbericalValue<uint32_t>(4, UINT32_T, meanType);
+  box.putNumbericalValue<float>(5, FLOAT_T, 103.94f);
+  box.putNumbericalValue<float>(6, FLOAT_T, 116.78f);
+  box.putNumbericalValue<float>(7, FLOAT_T, 123.68f);
+  box.putNonNumbericalValue(8, STRING_T, meanMap.size(), meanMap.c_str());
+  box.putNumbericalValue<float>(9, FLOAT_T, scale);
+  box.putStartEndTag(END_TAG, END_TYPE);
+}
+
+// a message of a sequence passed between threads or processes: 1 the
+// sequence, 2 a scale, 3 three times the sequence as a varint, 8 a path
+inline void createMessage(ttv::TtvBox &box, const uint32_t sequence) {
+  box.clear();
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<uint32_t>(1, UINT32_T, sequence);
+  box.putNumbericalValue<float>(2, FLOAT_T, 0.017f);
+  box.putNumbericalValue<uint64_t>(3, VARUINT_T, sequence * 3ULL);
+  const std::string str = "./mean.txt";
+  box.putNonNumbericalValue(8, STRING_T, str.size(), str.c_str());
+  box.putStartEndTag(END_TAG, END_TYPE);
+}
@@ -0,0 +1,143 @@
+#include "include/TtvBox.h"
+#include "include/TtvHash.h"
+#include "include/common.h"
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv hash.
+*****************************************/
+
+static int testVectors() {
+  // the reference values of XXH64 with the seed 0
+  struct {
+    const char *data;
+    uint64_t hash;
+  } vectors[] = {
+      {"", 0xef46db3751d8e999ULL},
+      {"a", 0xd24ec4f1a98c6e5bULL},
+      {"abc", 0x44bc2cf5ad770999ULL},
+      {"Nobody inspects the spammish repetition", 0xfbcea83c8a378bf1ULL},
+  };
+  for (const auto &vector : vectors) {
+    if (vector.hash != hashBytes(vector.data, strlen(vector.data))) {
+      TTV_LOGE("Error: the hash of \"%s\" is wrong.", vector.data);
+      return -1;
+    }
+  }
+  if (hashBytes("abc", 3) == hashBytes("abc", 3, 1)) {
+    TTV_LOGE("Error: the seed doesn't change the hash.");
+    return -1;
+  }
+
+  TTV_LOGI("testVectors() succeded.");
+  return 0;
+}
+
+static int testStreaming() {
+  std::vector<uint8_t> data(1000);
+  srand(163);
+  for (uint8_t &byte : data) {
+    byte = static_cast<uint8_t>(rand());
+  }
+
+  // hashing the pieces of any size equals hashing the whole bytes
+  for (size_t size = 0; size <= data.size(); size += 37) {
+    const uint64_t expected = hashBytes(data.data(), size, 7);
+    for (int round = 0; round < 10; round++) {
+      TtvHasher hasher(7);
+      size_t offset = 0;
+      while (offset < size) {
+        const size_t piece =
+            std::min(size - offset, static_cast<size_t>(rand() % 70));
+        hasher.update(data.data() + offset, piece);
+        offset += piece;
+      }
+      if (expected != hasher.digest()) {
+        TTV_LOGE("Error: the streaming hash of %d bytes is wrong.", (int)size);
+        return -1;
+      }
+    }
+
+    // the halves of the 128-bit hash are the hashes of their seeds
+    TtvHasher128 hasher128(7, 11);
+    size_t offset = 0;
+    while (offset < size) {
+      const size_t piece =
+          std::min(size - offset, static_cast<size_t>(rand() % 70));
+      hasher128.update(data.data() + offset, piece);
+      offset += piece;
+    }
+    const TtvHash128 hash128 = hasher128.digest();
+    if ((expected != hash128.low) ||
+        (hashBytes(data.data(), size, 11) != hash128.high)) {
+      TTV_LOGE("Error: the 128-bit hash of %d bytes is wrong.", (int)size);
+      return -1;
+    }
+  }
+
+  TTV_LOGI("testStreaming() succeded.");
+  return 0;
+}
+
+static int testThroughput() {
+  std::vector<uint8_t> data(1 << 20, 0x5A);
+  std::vector<uint8_t> copied(data.size());
+  const int rounds = 200;
+  uint64_t hash = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int ii = 0; ii < rounds; ii++) {
+    hash ^= hashBytes(data.data(), data.size(), ii);
+  }
+  const std::chrono::duration<double> hashSeconds =
+      std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int ii = 0; ii < rounds; ii++) {
+    TtvHasher128 hasher(ii, ~static_cast<uint64_t>(ii));
+    hasher.update(data.data(), data.size());
+    hash ^= hasher.digest().high;
+  }
+  const std::chrono::duration<double> hash128Seconds =
+      std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int ii = 0; ii < rounds; ii++) {
+    data[0] = static_cast<uint8_t>(ii);
+    ::memcpy(copied.data(), data.data(), data.size());
+  }
+  const std::chrono::duration<double> copySeconds =
+      std::chrono::steady_clock::now() - start;
+
+  const double bytes = static_cast<double>(data.size()) * rounds;
+  TTV_LOGI("hash: %.2f GB/s, hash128: %.2f GB/s, memcpy: %.2f GB/s (%llx)",
+           bytes / hashSeconds.count() / 1e9,
+           bytes / hash128Seconds.count() / 1e9,
+           bytes / copySeconds.count() / 1e9,
+           (unsigned long long)(hash ^ copied[0]));
+
+  TTV_LOGI("testThroughput() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testVectors()) {
+    return -1;
+  }
+
+  if (0 != testStreaming()) {
+    return -1;
+  }
+
+  if (0 != testThroughput()) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,208 @@
+#include "include/TtvBox.h"
+#include "include/TtvHeader.h"
+#include "include/TtvRecord.h"
+#include "include/common.h"
+#include "test/testTtvCommon.h"
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv header.
+*****************************************/
+
+static std::vector<uint8_t> readFile(const std::string &file) {
+  std::ifstream in(file, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(in),
+                              std::istreambuf_iterator<char>());
+}
+
+static int testLocateHeader() {
+  TtvBox box;
+  createConfig(box);
+  box.pack();
+  const std::string file = getTempFile("header.bin");
+  box.write(file, true);
+  const std::vector<uint8_t> section = readFile(file);
+
+  // embed the ttv section in a larger model file, the leading bytes contain
+  // the first byte of the magic and a magic followed by a foreign header
+  std::vector<uint8_t> model(4096, TTV_HEADER_MAGIC[0]);
+  ::memcpy(model.data() + 100, TTV_HEADER_MAGIC, sizeof(TTV_HEADER_MAGIC));
+  const size_t sectionOffset = 3001;
+  model.insert(model.begin() + sectionOffset, section.begin(), section.end());
+
+  size_t offset = 0;
+  TtvHeader header;
+  if (!locateHeader(model.data(), model.size(), offset, header) ||
+      (sectionOffset != offset) ||
+      (header.payloadBytes != box.getPackedBytes())) {
+    TTV_LOGE("Error: failed to locate the ttv section.");
+    return -1;
+  }
+
+  TtvBox decoded;
+  uint32_t value = 0;
+  if (!decoded.read(model.data() + offset, model.size() - offset) ||
+      !decoded.unpack(decoded.getPackedBuffer(), decoded.getPackedBytes()) ||
+      !decoded.getNumbericalValue(2, value) || (224 != value)) {
+    TTV_LOGE("Error: failed to read the located ttv section.");
+    return -1;
+  }
+
+  // a box written without a checksum is located as well
+  box.write(file);
+  const std::vector<uint8_t> plain = readFile(file);
+  ::remove(file.c_str());
+  if (!locateHeader(plain.data(), plain.size(), offset, header) ||
+      (0 != offset) || (header.payloadBytes != box.getPackedBytes())) {
+    TTV_LOGE("Error: failed to locate a box written by default.");
+    return -1;
+  }
+
+  // the section is cut off by the end of the model file
+  if (locateHeader(model.data(), sectionOffset + section.size() - 1, offset,
+                   header)) {
+    TTV_LOGE("Error: a truncated ttv section is located.");
+    return -1;
+  }
+
+  TTV_LOGI("testLocateHeader() succeded.");
+  return 0;
+}
+
+static int testForeignData() {
+  TtvBox box;
+  createConfig(box);
+  box.pack();
+  const std::string file = getTempFile("header.bin");
+  box.write(file, true);
+  std::vector<uint8_t> contents = readFile(file);
+
+  TtvBox decoded;
+  // the flags unknown to the reader
+  contents[7] |= 0x80;
+  if (decoded.read(contents.data(), contents.size())) {
+    TTV_LOGE("Error: the unknown flags are not rejected.");
+    return -1;
+  }
+  contents[7] &= ~0x80;
+
+  // a newer version of the header
+  contents[4] = HEADER_VERSION + 1;
+  if (decoded.read(contents.data(), contents.size())) {
+    TTV_LOGE("Error: the unknown version is not rejected.");
+    return -1;
+  }
+  contents[4] = HEADER_VERSION;
+
+  // the fields appended to the header by a newer writer are skipped
+  const uint8_t extraBytes = 8;
+  contents[5] = EXTENDED_HEADER_BYTES + extraBytes;
+  contents.insert(contents.begin() + EXTENDED_HEADER_BYTES, extraBytes, 0xA5);
+  uint32_t value = 0;
+  if (!decoded.read(contents.data(), contents.size()) ||
+      !decoded.unpack(decoded.getPackedBuffer(), decoded.getPackedBytes()) ||
+      !decoded.getNumbericalValue(2, value) || (224 != value)) {
+    TTV_LOGE("Error: failed to read a header with appended fields.");
+    return -1;
+  }
+  {
+    std::ofstream out(file, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(contents.data()),
+              contents.size());
+  }
+  const bool ret = decoded.read(file);
+  ::remove(file.c_str());
+  if (!ret || (decoded.getPackedBytes() != box.getPackedBytes())) {
+    TTV_LOGE("Error: failed to read a file with appended header fields.");
+    return -1;
+  }
+
+  // foreign data read as a legacy header describes more bytes than available
+  const std::string text = "# this is not a ttv box\n";
+  if (decoded.read(text.data(), text.size())) {
+    TTV_LOGE("Error: the foreign data is not rejected.");
+    return -1;
+  }
+
+  TTV_LOGI("testForeignData() succeded.");
+  return 0;
+}
+
+static int testUnknownType() {
+  TtvBox box;
+  createConfig(box);
+  box.pack();
+
+  // a record of a type added by a newer writer, inserted after the start
+  const uint8_t unknownType = 0x40;
+  const uint8_t unknownValue[5] = {1, 2, 3, 4, 5};
+  TtvRecord record;
+  layoutRecord(2, 20, unknownType, sizeof(unknownValue), LAYOUT_COMPACT, record);
+  std::vector<uint8_t> buffer(box.getPackedBytes() + record.size);
+  ::memcpy(buffer.data(), box.getPackedBuffer(), 2);
+  writeRecord(buffer.data(), record, unknownValue, LAYOUT_COMPACT);
+  ::memcpy(buffer.data() + 2 + record.size, box.getPackedBuffer() + 2,
+           box.getPackedBytes() - 2);
+
+  TtvBox decoded;
+  uint32_t value = 0;
+  std::string str;
+  if (!decoded.unpack(buffer.data(), buffer.size()) ||
+      !decoded.getNumbericalValue(2, value) || (224 != value) ||
+      !decoded.getStringValue(8, str) || (str != "./mean.txt")) {
+    TTV_LOGE("Error: failed to skip the unknown type.");
+    return -1;
+  }
+  decoded.getValue();
+
+  // the unknown record is kept and packed again unchanged
+  decoded.putNumbericalValue<uint8_t>(10, UINT8_T, 7);
+  decoded.pack();
+  const uint8_t *packedValue = nullptr;
+  uint32_t length = 0;
+  if ((decoded.getPackedBytes() != buffer.size() + 3) ||
+      !decoded.getPackedValue(20, &packedValue, length) ||
+      (sizeof(unknownValue) != length) ||
+      (0 != ::memcmp(packedValue, unknownValue, length))) {
+    TTV_LOGE("Error: the unknown type is not kept.");
+    return -1;
+  }
+
+  // the values without a length cannot be skipped
+  buffer[2 + 1] = FIXED_TYPE_MAX;
+  if (decoded.unpack(buffer.data(), buffer.size())) {
+    TTV_LOGE("Error: an unknown type without a length is not rejected.");
+    return -1;
+  }
+  // the records before it are dropped rather than left as a clean box
+  if (!decoded.isDirty() || (0 != decoded.getPackedBytes()) ||
+      decoded.getNumbericalValue(2, value)) {
+    TTV_LOGE("Error: a rejected buffer leaves a partial box.");
+    return -1;
+  }
+
+  TTV_LOGI("testUnknownType() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testLocateHeader()) {
+    return -1;
+  }
+
+  if (0 != testForeignData()) {
+    return -1;
+  }
+
+  if (0 != testUnknownType()) {
+    return -1;
+  }
+
+  return 0;
+}
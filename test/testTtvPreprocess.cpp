@@ -0,0 +1,277 @@
+#include "include/TtvBox.h"
+#include "include/TtvPreprocess.h"
+#include "include/TtvThreadPool.h"
+#include "include/common.h"
+#include "test/testTtvCommon.h"
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv preprocessing.
+*****************************************/
+
+// the config of demo/modelPreCfg.txt with another shape and mean type
+static void createImages(std::vector<uint8_t> &images, const size_t bytes) {
+  images.resize(bytes);
+  for (size_t ii = 0; ii < bytes; ii++) {
+    images[ii] = static_cast<uint8_t>((ii * 131) ^ (ii >> 7));
+  }
+}
+
+// replace the path of the mean map of a config with a tensor of its floats
+static void putMeanTensor(TtvBox &config, const uint32_t *shape,
+                          const float *meanMap) {
+  config.pack();
+  TtvTagMask tags;
+  tags.set();
+  tags.reset(PREPROCESS_TAG_MEAN_MAP);
+  TtvBox box;
+  box.unpack(config.getPackedBuffer(), config.getPackedBytes(), tags);
+  box.putTensor(PREPROCESS_TAG_MEAN_MAP, FLOAT_T, 3, shape, meanMap);
+  config = std::move(box);
+}
+
+static int testRun(const std::string &meanFile) {
+  const uint32_t batch = 3;
+  const float means[] = {103.94f, 116.78f, 123.68f};
+  TtvThreadPool pool(2);
+
+  // the shapes whose widths leave a tail to the vector kernels
+  const uint32_t shapes[][3] = {{3, 7, 5}, {3, 4, 16}, {1, 9, 9}, {4, 3, 6}};
+  for (const uint32_t *shape : shapes) {
+    const uint32_t channels = shape[0];
+    const uint32_t pixels = shape[1] * shape[2];
+    std::vector<float> meanMap(channels * pixels);
+    std::ofstream out(meanFile, std::ios::trunc);
+    for (uint32_t ii = 0; ii < channels * pixels; ii++) {
+      meanMap[ii] = (ii % 256) * 0.5f;
+      out << meanMap[ii] << ((ii % 10) == 9 ? "\n" : " ");
+    }
+    out.close();
+
+    for (uint32_t meanType = MEAN_TYPE_NONE; meanType <= MEAN_TYPE_MAP;
+         meanType++) {
+      TtvBox config;
+      TtvPreprocessPlan plan;
+      createConfig(config, channels, shape[1], shape[2], meanType, meanFile);
+      if ((MEAN_TYPE_VALUE == meanType) && (channels > 3)) {
+        // there are mean values for 3 channels only
+        if (plan.build(config)) {
+          TTV_LOGE("Error: a plan of %d channels is built.", channels);
+          return -1;
+        }
+        continue;
+      }
+      if (!plan.build(config) || (channels != plan.getChannels()) ||
+          (meanType != plan.getMeanType()) ||
+          (channels * pixels != plan.getInputBytes())) {
+        TTV_LOGE("Error: failed to build a plan.");
+        return -1;
+      }
+
+      std::vector<uint8_t> images;
+      createImages(images, batch * plan.getInputBytes());
+      const size_t size = batch * plan.getOutputSize();
+      std::vector<float> output(size), threaded(size), scalar(size);
+      if (!plan.run(images.data(), batch, output.data()) ||
+          !plan.run(images.data(), batch, threaded.data(), pool) ||
+          !plan.runScalar(images.data(), batch, scalar.data())) {
+        TTV_LOGE("Error: failed to run a plan.");
+        return -1;
+      }
+
+      // the kernels agree bit by bit, and with the definition
+      for (size_t ii = 0; ii < size; ii++) {
+        const uint32_t image = ii / plan.getOutputSize();
+        const uint32_t cc = (ii % plan.getOutputSize()) / pixels;
+        const uint32_t pixel = ii % pixels;
+        float mean = 0.0f;
+        if (MEAN_TYPE_VALUE == meanType) {
+          mean = means[cc];
+        } else if (MEAN_TYPE_MAP == meanType) {
+          mean = ((cc * pixels + pixel) % 256) * 0.5f;
+        }
+        const uint8_t value =
+            images[image * plan.getInputBytes() + pixel * channels + cc];
+        const float expected = (static_cast<float>(value) - mean) * 0.017f;
+        if ((0 != ::memcmp(&output[ii], &scalar[ii], sizeof(float))) ||
+            (0 != ::memcmp(&threaded[ii], &scalar[ii], sizeof(float))) ||
+            (expected != scalar[ii])) {
+          TTV_LOGE("Error: the output of mean type %d differs at %d.",
+                   meanType, (int)ii);
+          return -1;
+        }
+      }
+
+      // the mean map given as a tensor converts the same as its file
+      if (MEAN_TYPE_MAP == meanType) {
+        TtvPreprocessPlan tensorPlan;
+        std::vector<float> tensorOutput(size);
+        putMeanTensor(config, shape, meanMap.data());
+        if (!tensorPlan.build(config) ||
+            !tensorPlan.run(images.data(), batch, tensorOutput.data()) ||
+            (0 != ::memcmp(tensorOutput.data(), output.data(),
+                           size * sizeof(float)))) {
+          TTV_LOGE("Error: the mean map tensor differs from its file.");
+          return -1;
+        }
+      }
+    }
+  }
+
+  TTV_LOGI("testRun() succeded.");
+  return 0;
+}
+
+static int testInvalid(const std::string &meanFile) {
+  TtvBox config;
+  TtvPreprocessPlan plan;
+
+  // an unknown mean type, a zero shape, a missing scale, a mean map of
+  // another size or a missing file
+  createConfig(config, 3, 4, 4, 3, meanFile);
+  if (plan.build(config) || plan.run(nullptr, 0, nullptr)) {
+    TTV_LOGE("Error: a plan of an unknown mean type is built.");
+    return -1;
+  }
+  createConfig(config, 3, 0, 4, MEAN_TYPE_NONE, meanFile);
+  if (plan.build(config)) {
+    TTV_LOGE("Error: a plan of an empty image is built.");
+    return -1;
+  }
+  TtvBox partial;
+  partial.putNumbericalValue<uint32_t>(1, UINT32_T, 3);
+  partial.putNumbericalValue<uint32_t>(2, UINT32_T, 4);
+  partial.putNumbericalValue<uint32_t>(3, UINT32_T, 4);
+  partial.putNumbericalValue<uint32_t>(4, UINT32_T, MEAN_TYPE_NONE);
+  if (plan.build(partial)) {
+    TTV_LOGE("Error: a plan without a scale is built.");
+    return -1;
+  }
+  std::ofstream out(meanFile, std::ios::trunc);
+  out << "1 2 3";
+  out.close();
+  createConfig(config, 1, 2, 2, MEAN_TYPE_MAP, meanFile);
+  if (plan.build(config)) {
+    TTV_LOGE("Error: a plan of a short mean map is built.");
+    return -1;
+  }
+  createConfig(config, 1, 2, 2, MEAN_TYPE_MAP, meanFile + ".missing");
+  if (plan.build(config)) {
+    TTV_LOGE("Error: a plan of a missing mean map is built.");
+    return -1;
+  }
+  const uint32_t shape[3] = {1, 2, 3};
+  const float means[6] = {1, 2, 3, 4, 5, 6};
+  putMeanTensor(config, shape, means);
+  if (plan.build(config)) {
+    TTV_LOGE("Error: a plan of a mean map tensor of another shape is built.");
+    return -1;
+  }
+
+  TTV_LOGI("testInvalid() succeded.");
+  return 0;
+}
+
+static int testCache() {
+  TtvPreprocessCache cache;
+  TtvBox config;
+  TtvBox same;
+  TtvBox other;
+  createConfig(config, 3, 224, 224, MEAN_TYPE_VALUE, "./mean.txt");
+  createConfig(same, 3, 224, 224, MEAN_TYPE_VALUE, "./mean.txt");
+  same.pack();
+  createConfig(other, 3, 112, 112, MEAN_TYPE_VALUE, "./mean.txt");
+  TtvBox aligned;
+  createConfig(aligned, 3, 224, 224, MEAN_TYPE_VALUE, "./mean.txt");
+  aligned.setLayout(LAYOUT_ALIGNED);
+
+  // equal configs share a plan, whether they are packed and whatever their
+  // layout, the configs being compared beyond their hash
+  std::shared_ptr<const TtvPreprocessPlan> plan = cache.get(config);
+  if ((nullptr == plan) || (plan != cache.get(same)) ||
+      (plan != cache.get(aligned)) || (plan == cache.get(other)) ||
+      (plan != cache.get(config)) || (2 != cache.size())) {
+    TTV_LOGE("Error: the plans are not cached by config.");
+    return -1;
+  }
+
+  // the invalid configs are not cached
+  TtvBox invalid;
+  createConfig(invalid, 3, 224, 224, 3, "./mean.txt");
+  if ((nullptr != cache.get(invalid)) || (2 != cache.size())) {
+    TTV_LOGE("Error: an invalid config is cached.");
+    return -1;
+  }
+
+  // a plan in use outlives the cache entry
+  cache.clear();
+  if ((0 != cache.size()) || (224 != plan->getWidth())) {
+    TTV_LOGE("Error: failed to clear the cache.");
+    return -1;
+  }
+
+  TTV_LOGI("testCache() succeded.");
+  return 0;
+}
+
+static int testThroughput() {
+  TtvBox config;
+  createConfig(config, 3, 224, 224, MEAN_TYPE_VALUE, "./mean.txt");
+  TtvPreprocessPlan plan;
+  if (!plan.build(config)) {
+    return -1;
+  }
+  const uint32_t batch = 16;
+  std::vector<uint8_t> images;
+  createImages(images, batch * plan.getInputBytes());
+  std::vector<float> output(batch * plan.getOutputSize());
+
+  TtvThreadPool pool;
+  auto start = std::chrono::steady_clock::now();
+  plan.runScalar(images.data(), batch, output.data());
+  auto end = std::chrono::steady_clock::now();
+  const double scalarMs =
+      std::chrono::duration<double, std::milli>(end - start).count();
+  start = std::chrono::steady_clock::now();
+  plan.run(images.data(), batch, output.data());
+  end = std::chrono::steady_clock::now();
+  const double simdMs =
+      std::chrono::duration<double, std::milli>(end - start).count();
+  start = std::chrono::steady_clock::now();
+  plan.run(images.data(), batch, output.data(), pool);
+  end = std::chrono::steady_clock::now();
+  const double threadedMs =
+      std::chrono::duration<double, std::milli>(end - start).count();
+  TTV_LOGI("preprocess %u x 224 x 224 x 3: scalar %.2f ms, simd %.2f ms, "
+           "simd on %u threads %.2f ms",
+           batch, scalarMs, simdMs, pool.getNumThreads(), threadedMs);
+
+  TTV_LOGI("testThroughput() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  const std::string meanFile = getTempFile("mean_map.txt");
+  const int ret = (0 != testRun(meanFile)) || (0 != testInvalid(meanFile));
+  ::remove(meanFile.c_str());
+  if (0 != ret) {
+    return -1;
+  }
+
+  if (0 != testCache()) {
+    return -1;
+  }
+
+  if (0 != testThroughput()) {
+    return -1;
+  }
+
+  return 0;
+}
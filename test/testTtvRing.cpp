@@ -0,0 +1,316 @@
+#include "include/TtvBox.h"
+#include "include/TtvRing.h"
+#include "include/TtvView.h"
+#include "include/common.h"
+#include "test/testTtvCommon.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv ring.
+*****************************************/
+
+static int testView() {
+  TtvBox box;
+  createMessage(box, 7);
+  for (uint8_t layout = LAYOUT_COMPACT; layout <= LAYOUT_ALIGNED; layout++) {
+    box.setLayout(layout);
+    // packing into an external buffer gives the same bytes as pack()
+    std::vector<uint8_t> buffer(box.computePackedBytes());
+    uint32_t bytes = 0;
+    if (!box.pack(buffer.data(), buffer.size(), bytes) ||
+        (bytes != buffer.size()) || !box.pack() ||
+        (bytes != box.getPackedBytes()) ||
+        (0 != memcmp(buffer.data(), box.getPackedBuffer(), bytes)) ||
+        box.pack(buffer.data(), bytes - 1, bytes)) {
+      TTV_LOGE("Error: failed to pack into an external buffer.");
+      return -1;
+    }
+    // a packed box is copied as it is
+    std::vector<uint8_t> copy(buffer.size());
+    if (!box.pack(copy.data(), copy.size(), bytes) || (bytes != copy.size()) ||
+        (copy != buffer)) {
+      TTV_LOGE("Error: failed to copy a packed box into an external buffer.");
+      return -1;
+    }
+
+    TtvView view;
+    uint32_t sequence = 0;
+    uint64_t wide = 0;
+    float scale = 0;
+    uint64_t varint = 0;
+    uint8_t narrow = 0;
+    std::string str;
+    uint8_t type = 0;
+    if (!view.reset(buffer.data(), buffer.size(), layout) ||
+        (6 != view.getCount()) || !view.getNumbericalValue(1, sequence) ||
+        (7 != sequence) || view.getNumbericalValue(1, wide) ||
+        view.getNumbericalValue(2, sequence) ||
+        !view.getNumbericalValue(2, scale) || (0.017f != scale) ||
+        !view.getNumbericalValue(3, varint) || (21 != varint) ||
+        !view.getNumbericalValue(3, narrow) || (21 != narrow) ||
+        !view.getStringValue(8, str) || ("./mean.txt" != str) ||
+        !view.getType(8, type) || (STRING_T != type) ||
+        view.getNumbericalValue(8, sequence) || view.hasTag(4)) {
+      TTV_LOGE("Error: failed to read the values in place.");
+      return -1;
+    }
+  }
+
+  // a truncated buffer leaves the view empty
+  TtvView view;
+  box.setLayout(LAYOUT_COMPACT);
+  box.pack();
+  if (view.reset(box.getPackedBuffer(), box.getPackedBytes() - 1) ||
+      (0 != view.getCount()) || view.hasTag(1)) {
+    TTV_LOGE("Error: the truncated buffer is not rejected.");
+    return -1;
+  }
+  // so does a tag read twice, and the view is reusable afterwards
+  const uint8_t duplicate[] = {1, UINT32_T, 0, 0, 0, 1,
+                               1, UINT32_T, 0, 0, 0, 2};
+  if (view.reset(duplicate, sizeof(duplicate)) || (0 != view.getCount()) ||
+      view.hasTag(1) ||
+      !view.reset(box.getPackedBuffer(), box.getPackedBytes()) ||
+      (6 != view.getCount())) {
+    TTV_LOGE("Error: the duplicated tag is not rejected.");
+    return -1;
+  }
+
+  TTV_LOGI("testView() succeded.");
+  return 0;
+}
+
+static int testSpsc() {
+  const uint32_t count = 100000;
+  TtvRing ring(64, 256, RING_SPSC);
+  std::thread producer([&ring, count]() {
+    TtvBox box;
+    box.setLayout(LAYOUT_ALIGNED);
+    for (uint32_t ii = 0; ii < count; ii++) {
+      createMessage(box, ii);
+      while (!ring.tryPush(box)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // the messages arrive in order and are read in the slots
+  TtvView view;
+  TtvRingSlot slot;
+  uint32_t errors = 0;
+  for (uint32_t ii = 0; ii < count;) {
+    if (!ring.tryPop(view, slot)) {
+      std::this_thread::yield();
+      continue;
+    }
+    uint32_t sequence = 0;
+    uint64_t varint = 0;
+    if (!view.getNumbericalValue(1, sequence) || (ii != sequence) ||
+        !view.getNumbericalValue(3, varint) || (ii * 3ULL != varint) ||
+        (LAYOUT_ALIGNED != slot.layout) ||
+        (0 != reinterpret_cast<uintptr_t>(slot.data) % RING_CACHE_LINE_BYTES)) {
+      errors++;
+    }
+    ring.release(slot);
+    ii++;
+  }
+  producer.join();
+
+  TtvBox box;
+  if ((0 != errors) || ring.tryPop(box)) {
+    TTV_LOGE("Error: %d messages are received wrongly.", errors);
+    return -1;
+  }
+
+  // a box larger than a slot is rejected before claiming a slot
+  TtvBox large;
+  const std::string str(1024, 'x');
+  large.putNonNumbericalValue(1, STRING_T, str.size(), str.c_str());
+  if (ring.tryPush(large) || !ring.tryPush(box) || !ring.tryPop(box)) {
+    TTV_LOGE("Error: the size of the slots is not checked.");
+    return -1;
+  }
+
+  TTV_LOGI("testSpsc() succeded.");
+  return 0;
+}
+
+static int testMpmc() {
+  const uint32_t numThreads = 4;
+  const uint32_t count = 20000;
+  TtvRing ring(64, 256, RING_MPMC);
+  std::atomic<uint64_t> sum(0);
+  std::atomic<uint32_t> received(0);
+  std::vector<std::thread> threads;
+  for (uint32_t tt = 0; tt < numThreads; tt++) {
+    threads.emplace_back([&ring, tt, count]() {
+      TtvBox box;
+      for (uint32_t ii = 0; ii < count; ii++) {
+        createMessage(box, tt * count + ii);
+        while (!ring.tryPush(box)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+    threads.emplace_back([&ring, &sum, &received, numThreads, count]() {
+      TtvView view;
+      TtvRingSlot slot;
+      while (received.load() < numThreads * count) {
+        if (!ring.tryPop(view, slot)) {
+          std::this_thread::yield();
+          continue;
+        }
+        uint32_t sequence = 0;
+        view.getNumbericalValue(1, sequence);
+        ring.release(slot);
+        sum += sequence;
+        received++;
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  const uint64_t total = numThreads * count;
+  if ((total != received.load()) || (total * (total - 1) / 2 != sum.load())) {
+    TTV_LOGE("Error: the messages are lost or duplicated.");
+    return -1;
+  }
+
+  TTV_LOGI("testMpmc() succeded.");
+  return 0;
+}
+
+// the baseline, heap allocated boxes moved through a mutex protected queue
+class MutexQueue {
+public:
+  void push(std::unique_ptr<TtvBox> box) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.push(std::move(box));
+  }
+
+  std::unique_ptr<TtvBox> pop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mQueue.empty()) {
+      return nullptr;
+    }
+    std::unique_ptr<TtvBox> box = std::move(mQueue.front());
+    mQueue.pop();
+    return box;
+  }
+
+private:
+  std::mutex mMutex;
+  std::queue<std::unique_ptr<TtvBox>> mQueue;
+};
+
+template <typename Push, typename Pop>
+static double measure(const uint32_t numThreads, const uint32_t count,
+                      Push push, Pop pop) {
+  std::atomic<uint32_t> received(0);
+  std::vector<std::thread> threads;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t tt = 0; tt < numThreads; tt++) {
+    threads.emplace_back([&push, count]() {
+      for (uint32_t ii = 0; ii < count; ii++) {
+        push(ii);
+      }
+    });
+    threads.emplace_back([&pop, &received, numThreads, count]() {
+      while (received.load() < numThreads * count) {
+        if (pop()) {
+          received++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  const std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  return numThreads * count / seconds.count();
+}
+
+static int testThroughput() {
+  const uint32_t count = 100000;
+  for (uint32_t numThreads = 1; numThreads <= 4; numThreads *= 4) {
+    MutexQueue queue;
+    const double mutexRate = measure(
+        numThreads, count,
+        [&queue](const uint32_t sequence) {
+          std::unique_ptr<TtvBox> box(new TtvBox());
+          createMessage(*box, sequence);
+          box->pack();
+          queue.push(std::move(box));
+        },
+        [&queue]() {
+          std::unique_ptr<TtvBox> box = queue.pop();
+          uint32_t sequence = 0;
+          return box && box->getNumbericalValue(1, sequence);
+        });
+
+    TtvRing ring(1024, 256, (1 == numThreads) ? RING_SPSC : RING_MPMC);
+    const double ringRate = measure(
+        numThreads, count,
+        [&ring](const uint32_t sequence) {
+          // each producer thread reuses its box
+          static thread_local TtvBox box;
+          createMessage(box, sequence);
+          while (!ring.tryPush(box)) {
+            std::this_thread::yield();
+          }
+        },
+        [&ring]() {
+          static thread_local TtvView view;
+          TtvRingSlot slot;
+          if (!ring.tryPop(view, slot)) {
+            return false;
+          }
+          uint32_t sequence = 0;
+          view.getNumbericalValue(1, sequence);
+          ring.release(slot);
+          return true;
+        });
+    TTV_LOGI("%d producers and %d consumers: mutex queue %.0f, %s ring %.0f "
+             "messages per second",
+             numThreads, numThreads, mutexRate,
+             (1 == numThreads) ? "spsc" : "mpmc", ringRate);
+  }
+
+  TTV_LOGI("testThroughput() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testView()) {
+    return -1;
+  }
+
+  if (0 != testSpsc()) {
+    return -1;
+  }
+
+  if (0 != testMpmc()) {
+    return -1;
+  }
+
+  if (0 != testThroughput()) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include "include/TtvBox.h"
+#include "include/TtvSchema.h"
+#include "include/common.h"
+#include <chrono>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for named fields.
+*****************************************/
+
+static int testSchema() {
+  TtvSchema schema;
+  for (uint32_t tag = 1; tag < SCHEMA_TAG; tag++) {
+    if (!schema.addName(tag, "field_" + std::to_string(tag))) {
+      TTV_LOGE("Error: failed to add a name.");
+      return -1;
+    }
+  }
+  if (schema.addName(1, "other") || schema.addName(2, "field_1") ||
+      schema.addName(SCHEMA_TAG, "schema") || !schema.build()) {
+    TTV_LOGE("Error: the duplicated names are not rejected.");
+    return -1;
+  }
+
+  for (uint32_t tag = 1; tag < SCHEMA_TAG; tag++) {
+    const std::string name = "field_" + std::to_string(tag);
+    uint8_t found = 0;
+    const std::string *foundName = schema.getName(tag);
+    if (!schema.findTag(name.c_str(), name.size(), found) || (tag != found) ||
+        (nullptr == foundName) || (name != *foundName)) {
+      TTV_LOGE("Error: failed to find the name %s.", name.c_str());
+      return -1;
+    }
+  }
+  uint8_t tag = 0;
+  if (schema.findTag("field_", 6, tag) || schema.findTag("field_1x", 8, tag) ||
+      schema.findTag("", 0, tag) || (nullptr != schema.getName(SCHEMA_TAG))) {
+    TTV_LOGE("Error: an unknown name is found.");
+    return -1;
+  }
+
+  std::vector<uint8_t> value;
+  schema.encode(value);
+  TtvSchema decoded;
+  if (!decoded.decode(value.data(), value.size()) ||
+      (schema.size() != decoded.size()) ||
+      !decoded.findTag("field_200", 9, tag) || (200 != tag) ||
+      decoded.decode(value.data(), value.size() - 1)) {
+    TTV_LOGE("Error: failed to encode and decode the schema.");
+    return -1;
+  }
+
+  TTV_LOGI("testSchema() succeded.");
+  return 0;
+}
+
+static int testNamedFields() {
+  TtvBox box;
+  uint32_t height = 0;
+  float scale = 0;
+  std::string path;
+  if (!box.parse("../demo/modelPreCfg.txt") || !box.get("input_h", height) ||
+      (224 != height) || !box.get("scale_value", scale) || (0.017f != scale) ||
+      !box.get("mean_map", path) || ("./mean.txt" != path) ||
+      box.get("input_d", height)) {
+    TTV_LOGE("Error: failed to get the values by name.");
+    return -1;
+  }
+
+  // the names travel with the packed buffer
+  TtvBox decoded;
+  if (!box.embedSchema() || !box.pack() ||
+      !decoded.unpack(box.getPackedBuffer(), box.getPackedBytes()) ||
+      !decoded.get("input_w", height) || (224 != height)) {
+    TTV_LOGE("Error: failed to get the values by the embedded names.");
+    return -1;
+  }
+  // the embedded names are decoded once for a stream of messages
+  const std::shared_ptr<const TtvSchema> schema = decoded.getSchema();
+  if (!decoded.unpack(box.getPackedBuffer(), box.getPackedBytes()) ||
+      (schema != decoded.getSchema())) {
+    TTV_LOGE("Error: the unchanged names are decoded again.");
+    return -1;
+  }
+
+  // the names of a box without an embedded schema are set by the reader
+  TtvBox plain;
+  plain.putNumbericalValue<uint32_t>(2, UINT32_T, 448);
+  plain.pack();
+  decoded.clear();
+  decoded.setSchema(schema);
+  if (!decoded.unpack(plain.getPackedBuffer(), plain.getPackedBytes()) ||
+      !decoded.get("input_h", height) || (448 != height)) {
+    TTV_LOGE("Error: failed to get the values by the names set by the reader.");
+    return -1;
+  }
+
+  // the bytes of an older writer at the tag of the schema are an ordinary
+  // value, while a schema with its magic must be well formed
+  const std::string legacy = "legacy bytes";
+  plain.putNonNumbericalValue(SCHEMA_TAG, BYTES_T, legacy.size(),
+                              legacy.c_str());
+  plain.pack();
+  const uint8_t *bytes = nullptr;
+  uint32_t length = 0;
+  std::vector<uint8_t> malformed(TTV_SCHEMA_MAGIC,
+                                 TTV_SCHEMA_MAGIC + SCHEMA_MAGIC_BYTES);
+  malformed.push_back(2);
+  TtvBox broken;
+  broken.putNonNumbericalValue(SCHEMA_TAG, BYTES_T, malformed.size(),
+                               malformed.data());
+  broken.pack();
+  if (!decoded.unpack(plain.getPackedBuffer(), plain.getPackedBytes()) ||
+      !decoded.getPackedValue(SCHEMA_TAG, &bytes, length) ||
+      (legacy != std::string(reinterpret_cast<const char *>(bytes), length)) ||
+      (schema != decoded.getSchema()) || decoded.embedSchema() ||
+      decoded.unpack(broken.getPackedBuffer(), broken.getPackedBytes())) {
+    TTV_LOGE("Error: an ordinary value at the tag of the schema is misread.");
+    return -1;
+  }
+
+  // the named lookup costs one hash more than the tag lookup
+  const int rounds = 1 << 20;
+  uint64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int ii = 0; ii < rounds; ii++) {
+    box.getNumbericalValue(2, height);
+    sum += height;
+  }
+  std::chrono::duration<double> tagSeconds =
+      std::chrono::steady_clock::now() - start;
+  start = std::chrono::steady_clock::now();
+  for (int ii = 0; ii < rounds; ii++) {
+    box.get("input_h", height);
+    sum -= height;
+  }
+  std::chrono::duration<double> nameSeconds =
+      std::chrono::steady_clock::now() - start;
+  if (0 != sum) {
+    TTV_LOGE("Error: the named lookup returns a different value.");
+    return -1;
+  }
+  TTV_LOGI("lookup: tag %.2f ns, name %.2f ns",
+           tagSeconds.count() * 1e9 / rounds,
+           nameSeconds.count() * 1e9 / rounds);
+
+  TTV_LOGI("testNamedFields() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testSchema()) {
+    return -1;
+  }
+
+  if (0 != testNamedFields()) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,236 @@
+#include "include/TtvBox.h"
+#include "include/TtvShm.h"
+#include "include/TtvView.h"
+#include "include/common.h"
+#include "test/testTtvCommon.h"
+#include <chrono>
+#include <iostream>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv shared memory.
+*****************************************/
+
+static int testPublish(const std::string &name) {
+  TtvShmReader reader;
+  TtvShmPublisher publisher;
+  if (reader.open(name) || !publisher.create(name, 1000) ||
+      !reader.open(name) || (0 != reader.getSequence())) {
+    TTV_LOGE("Error: failed to create and open the shared memory.");
+    return -1;
+  }
+
+  TtvView view;
+  TtvShmSnapshot snapshot;
+  TtvBox box;
+  createMessage(box, 1);
+  uint32_t value = 0;
+  std::string str;
+  if (reader.read(view, snapshot) || !publisher.publish(box, 100) ||
+      !reader.read(view, snapshot) || (1 != snapshot.sequence) ||
+      (100 != snapshot.version) || !view.getNumbericalValue(1, value) ||
+      (1 != value) || !view.getStringValue(8, str) || ("./mean.txt" != str) ||
+      !reader.validate(snapshot)) {
+    TTV_LOGE("Error: failed to read the published box.");
+    return -1;
+  }
+
+  // the box being read is overwritten by the second publication after it
+  createMessage(box, 2);
+  publisher.publish(box, 101);
+  if (!reader.validate(snapshot) || (2 != reader.getSequence())) {
+    TTV_LOGE("Error: the snapshot is invalidated by one publication.");
+    return -1;
+  }
+  publisher.publish(box, 102);
+  if (reader.validate(snapshot)) {
+    TTV_LOGE("Error: the overwritten snapshot is not invalidated.");
+    return -1;
+  }
+
+  // a copy is unpacked into a box of the reader
+  TtvBox copied;
+  box.setLayout(LAYOUT_ALIGNED);
+  createMessage(box, 3);
+  std::string large(2000, 'x');
+  TtvBox oversized;
+  oversized.putNonNumbericalValue(1, STRING_T, large.size(), large.c_str());
+  if (!publisher.publish(box, 103) || publisher.publish(oversized, 104) ||
+      !reader.copy(copied, snapshot) || (103 != snapshot.version) ||
+      (LAYOUT_ALIGNED != copied.getLayout()) ||
+      !copied.getNumbericalValue(1, value) || (3 != value)) {
+    TTV_LOGE("Error: failed to copy the published box.");
+    return -1;
+  }
+
+  // a second publisher reuses the segment, another capacity is rejected
+  TtvShmPublisher another;
+  if (another.create(name, 4000) || !another.create(name, 1000) ||
+      (4 != reader.getSequence())) {
+    TTV_LOGE("Error: the existing segment is not reused.");
+    return -1;
+  }
+
+  // a publisher crashed inside a write, i.e. the counter of the buffer which
+  // is not current, the first word of its state after the 64 bytes of the
+  // head of the control block, is left odd
+  const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+  void *address = ::mmap(nullptr, SHM_HEADER_BYTES, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (MAP_FAILED == address) {
+    TTV_LOGE("Error: failed to map the shared memory.");
+    return -1;
+  }
+  uint64_t *lock = reinterpret_cast<uint64_t *>(
+      static_cast<uint8_t *>(address) +
+      SHM_BUFFER_ALIGNMENT * (1 + (reader.getSequence() & 1)));
+  (*lock)++;
+  TtvShmPublisher restarted;
+  createMessage(box, 5);
+  const bool even = restarted.create(name, 1000) && (0 == (*lock & 1));
+  ::munmap(address, SHM_HEADER_BYTES);
+  if (!even || !restarted.publish(box, 105) || !reader.read(view, snapshot) ||
+      (105 != snapshot.version) || !view.getNumbericalValue(1, value) ||
+      (5 != value) || !reader.validate(snapshot)) {
+    TTV_LOGE("Error: the seqlock left by a crashed publisher is not reset.");
+    return -1;
+  }
+
+  // the varint of the messages flags the segment, the flags are the word
+  // after the magic, the format version and the capacity
+  const int rwfd = ::shm_open(name.c_str(), O_RDWR, 0);
+  address = ::mmap(nullptr, SHM_HEADER_BYTES, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, rwfd, 0);
+  ::close(rwfd);
+  if (MAP_FAILED == address) {
+    TTV_LOGE("Error: failed to map the shared memory.");
+    return -1;
+  }
+  uint32_t *flags = reinterpret_cast<uint32_t *>(
+      static_cast<uint8_t *>(address) + 3 * sizeof(uint32_t));
+  const bool flagged = box.hasVarint() && (SHM_FLAG_VARINT == *flags);
+  // a flag added by a newer publisher is rejected up front
+  *flags |= 0x80;
+  TtvShmReader newReader;
+  const bool rejected = !reader.read(view, snapshot) && !newReader.open(name);
+  *flags = SHM_FLAG_VARINT;
+  ::munmap(address, SHM_HEADER_BYTES);
+  if (!flagged || !rejected) {
+    TTV_LOGE("Error: the flags of the segment are wrong.");
+    return -1;
+  }
+
+  TTV_LOGI("testPublish() succeded.");
+  return 0;
+}
+
+static int testProcesses(const std::string &name) {
+  const uint32_t count = 20000;
+  TtvShmPublisher publisher;
+  TtvBox box;
+  createMessage(box, 0);
+  if (!publisher.create(name, 1000) || !publisher.publish(box, 0)) {
+    return -1;
+  }
+
+  // the child process checks that every snapshot it reads is consistent
+  fflush(stdout);
+  const pid_t pid = ::fork();
+  if (0 == pid) {
+    TtvShmReader reader;
+    if (!reader.open(name)) {
+      ::_exit(1);
+    }
+    TtvView view;
+    TtvShmSnapshot snapshot;
+    uint32_t reads = 0;
+    uint32_t retries = 0;
+    uint32_t value = 0;
+    uint64_t tripled = 0;
+    do {
+      if (!reader.read(view, snapshot)) {
+        ::_exit(2);
+      }
+      if (!view.getNumbericalValue(1, value) ||
+          !view.getNumbericalValue(3, tripled)) {
+        retries++;
+        continue;
+      }
+      if (!reader.validate(snapshot)) {
+        retries++;
+        continue;
+      }
+      if ((value * 3ULL != tripled) || (value != snapshot.version)) {
+        ::_exit(3);
+      }
+      reads++;
+    } while (value + 1 < count);
+    TTV_LOGI("the reader process reads %d consistent snapshots, %d retries",
+             reads, retries);
+    fflush(stdout);
+    ::_exit(0);
+  }
+
+  for (uint32_t ii = 1; ii < count; ii++) {
+    createMessage(box, ii);
+    publisher.publish(box, ii);
+  }
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || (0 != WEXITSTATUS(status))) {
+    TTV_LOGE("Error: the reader process fails with %d.", status);
+    return -1;
+  }
+
+  // the read path takes no system call
+  TtvShmReader reader;
+  reader.open(name);
+  TtvView view;
+  TtvShmSnapshot snapshot;
+  const int rounds = 1000000;
+  uint64_t sum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int ii = 0; ii < rounds; ii++) {
+    uint32_t value = 0;
+    do {
+      reader.read(view, snapshot);
+      view.getNumbericalValue(1, value);
+    } while (!reader.validate(snapshot));
+    sum += value;
+  }
+  const std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  if ((count - 1ULL) * rounds != sum) {
+    TTV_LOGE("Error: the values read are wrong.");
+    return -1;
+  }
+  TTV_LOGI("read a value from the shared memory: %.1f ns",
+           seconds.count() * 1e9 / rounds);
+
+  TTV_LOGI("testProcesses() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  const std::string name = "/ttv_test_" + std::to_string(::getpid());
+  int ret = testPublish(name);
+  TtvShmPublisher::unlink(name);
+  if (0 != ret) {
+    return -1;
+  }
+
+  ret = testProcesses(name);
+  TtvShmPublisher::unlink(name);
+  if (0 != ret) {
+    return -1;
+  }
+
+  return 0;
+}
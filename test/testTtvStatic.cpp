@@ -0,0 +1,147 @@
+#include "include/TtvBox.h"
+#include "include/TtvStatic.h"
+#include "include/TtvView.h"
+#include "include/common.h"
+#include <iostream>
+#include <limits>
+#include <string.h>
+#include <string>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv static boxes.
+*****************************************/
+
+// the default preprocessing parameters, packed by the compiler
+static constexpr auto kConfig = TtvStaticBox::pack(
+    TtvStaticBox::startEndTag(START_TAG, START_TYPE),
+    TtvStaticBox::numbericalValue<bool>(1, true),
+    TtvStaticBox::numbericalValue<int8_t>(2, -123),
+    TtvStaticBox::numbericalValue<uint16_t>(3, 224),
+    TtvStaticBox::numbericalValue<int32_t>(4, -123456),
+    TtvStaticBox::numbericalValue<uint64_t>(5, 1234567890123ULL),
+    TtvStaticBox::numbericalValue<float>(6, 0.017f),
+    TtvStaticBox::numbericalValue<double>(7, -103.94),
+    TtvStaticBox::stringValue(8, "./mean.txt"),
+    TtvStaticBox::varuintValue<300>(9),
+    TtvStaticBox::varintValue<-7>(10),
+    TtvStaticBox::startEndTag(END_TAG, END_TYPE));
+
+static_assert(2 + 3 + 3 + 4 + 6 + 10 + 6 + 10 + 16 + 4 + 3 + 2 ==
+                  kConfig.size(),
+              "the size of the static box is wrong");
+static_assert((START_TAG == kConfig[0]) && (END_TAG == kConfig.back()),
+              "the static box is not encoded at compile time");
+static_assert((1 == getVarintSize(0x7F)) && (2 == getVarintSize(0x80)) &&
+                  (VARINT_MAX_BYTES == getVarintSize(UINT64_MAX)),
+              "the size of a varint is wrong");
+
+static int testPack() {
+  TtvBox box;
+  box.putStartEndTag(START_TAG, START_TYPE);
+  box.putNumbericalValue<bool>(1, BOOL_T, true);
+  box.putNumbericalValue<int8_t>(2, INT8_T, -123);
+  box.putNumbericalValue<uint16_t>(3, UINT16_T, 224);
+  box.putNumbericalValue<int32_t>(4, INT32_T, -123456);
+  box.putNumbericalValue<uint64_t>(5, UINT64_T, 1234567890123ULL);
+  box.putNumbericalValue<float>(6, FLOAT_T, 0.017f);
+  box.putNumbericalValue<double>(7, DOUBLE_T, -103.94);
+  const std::string str = "./mean.txt";
+  box.putNonNumbericalValue(8, STRING_T, str.size(), str.c_str());
+  box.putNumbericalValue<uint32_t>(9, VARUINT_T, 300);
+  box.putNumbericalValue<int32_t>(10, VARINT_T, -7);
+  box.putStartEndTag(END_TAG, END_TYPE);
+  box.pack();
+  if ((kConfig.size() != box.getPackedBytes()) ||
+      (0 != ::memcmp(kConfig.data(), box.getPackedBuffer(), kConfig.size()))) {
+    TTV_LOGE("Error: the static box differs from the packed box.");
+    return -1;
+  }
+
+  // the view reads the static box in place
+  TtvView view;
+  float scale = 0;
+  int64_t offset = 0;
+  std::string path;
+  if (!view.reset(kConfig.data(), kConfig.size()) ||
+      !view.getNumbericalValue(6, scale) || (0.017f != scale) ||
+      !view.getNumbericalValue(10, offset) || (-7 != offset) ||
+      !view.getStringValue(8, path) || (str != path)) {
+    TTV_LOGE("Error: failed to view the static box.");
+    return -1;
+  }
+
+  TTV_LOGI("testPack() succeded.");
+  return 0;
+}
+
+template <typename F, typename U> static bool checkFloatingBits(const F value) {
+  U bits = 0;
+  ::memcpy(&bits, &value, sizeof(F));
+  U encoded = 0;
+  const auto record = TtvStaticBox::numbericalValue<F>(1, value);
+  for (size_t ii = 0; ii < sizeof(F); ii++) {
+    encoded = (encoded << 8) | record[2 + ii];
+  }
+  if (encoded != bits) {
+    TTV_LOGE("Error: %g is encoded as %llx.", (double)value,
+             (unsigned long long)encoded);
+    return false;
+  }
+  return true;
+}
+
+static int testFloatingBits() {
+  // the scaling is exact for the normal and the subnormal values
+  static constexpr auto kSubnormal =
+      TtvStaticBox::numbericalValue<double>(1, 4.9e-324);
+  static_assert(1 == kSubnormal.back(), "the smallest subnormal is wrong");
+
+  const float floats[] = {1.0f,
+                          -2.5f,
+                          0.017f,
+                          3.14159265f,
+                          1e-40f,
+                          std::numeric_limits<float>::min(),
+                          std::numeric_limits<float>::max(),
+                          std::numeric_limits<float>::denorm_min(),
+                          std::numeric_limits<float>::infinity(),
+                          -std::numeric_limits<float>::infinity(),
+                          std::numeric_limits<float>::quiet_NaN()};
+  for (const float value : floats) {
+    if (!checkFloatingBits<float, uint32_t>(value)) {
+      return -1;
+    }
+  }
+  const double doubles[] = {1.0,
+                            -103.94,
+                            0.1,
+                            1e300,
+                            -1e-310,
+                            std::numeric_limits<double>::min(),
+                            std::numeric_limits<double>::max(),
+                            std::numeric_limits<double>::denorm_min(),
+                            std::numeric_limits<double>::infinity(),
+                            std::numeric_limits<double>::quiet_NaN()};
+  for (const double value : doubles) {
+    if (!checkFloatingBits<double, uint64_t>(value)) {
+      return -1;
+    }
+  }
+
+  TTV_LOGI("testFloatingBits() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testPack()) {
+    return -1;
+  }
+
+  if (0 != testFloatingBits()) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include "include/TtvBox.h"
+#include "include/TtvStats.h"
+#include "include/common.h"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv stats.
+*****************************************/
+
+static void packAndUnpack(const uint32_t rounds) {
+  TtvBox box;
+  TtvBox decoded;
+  const std::string str = "a string longer than the inline storage";
+  for (uint32_t ii = 0; ii < rounds; ii++) {
+    box.clear();
+    box.putNumbericalValue<uint32_t>(1, UINT32_T, ii);
+    box.putNonNumbericalValue(2, STRING_T, str.size(), str.c_str());
+    box.pack();
+    decoded.unpack(box.getPackedBuffer(), box.getPackedBytes());
+  }
+}
+
+static uint64_t sumHistogram(const TtvOperationStats &stats) {
+  uint64_t calls = 0;
+  for (uint32_t ii = 0; ii < STATS_HISTOGRAM_BUCKETS; ii++) {
+    calls += stats.histogram[ii];
+  }
+  return calls;
+}
+
+static int testStats() {
+  resetStats();
+  TtvStats snapshot = stats();
+#ifndef TTV_ENABLE_STATS
+  packAndUnpack(10);
+  snapshot = stats();
+  if (snapshot.enabled ||
+      (0 != snapshot.operations[STATS_PACK].calls)) {
+    TTV_LOGE("Error: the stats are counted while compiled out.");
+    return -1;
+  }
+  TTV_LOGI("testStats() skipped, the stats are compiled out.");
+  return 0;
+#endif
+
+  if (!snapshot.enabled || (0 != snapshot.operations[STATS_PACK].calls)) {
+    TTV_LOGE("Error: the stats are not reset.");
+    return -1;
+  }
+
+  // the counters of the exited threads are merged into the snapshot
+  const uint32_t numThreads = 4;
+  const uint32_t rounds = 1000;
+  std::vector<std::thread> threads;
+  for (uint32_t ii = 0; ii < numThreads; ii++) {
+    threads.emplace_back(packAndUnpack, rounds);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  packAndUnpack(rounds);
+
+  snapshot = stats();
+  const TtvOperationStats &pack = snapshot.operations[STATS_PACK];
+  const TtvOperationStats &unpack = snapshot.operations[STATS_UNPACK];
+  const uint64_t calls = (numThreads + 1) * rounds;
+  if ((calls != pack.calls) || (calls != unpack.calls) ||
+      (2 * calls != pack.fields) || (pack.bytes != unpack.bytes) ||
+      (calls != sumHistogram(pack)) || (calls != sumHistogram(unpack))) {
+    TTV_LOGE("Error: the counters of the threads are not merged.");
+    return -1;
+  }
+  // each box allocates its ttv objects, the long string and the packed
+  // buffer once, the following rounds reuse them
+  if ((0 == pack.allocations) || (pack.allocations >= rounds) ||
+      (snapshot.allocations < pack.allocations + unpack.allocations)) {
+    TTV_LOGE("Error: the heap allocations are not counted correctly.");
+    return -1;
+  }
+
+  for (uint32_t op = 0; op < STATS_OPERATION_MAX; op++) {
+    const TtvOperationStats &stats = snapshot.operations[op];
+    TTV_LOGI("%s: %llu calls, %llu bytes, %llu fields, %llu allocations, "
+             "%.1f ns per call",
+             getStatsOperationName(op), (unsigned long long)stats.calls,
+             (unsigned long long)stats.bytes, (unsigned long long)stats.fields,
+             (unsigned long long)stats.allocations,
+             stats.calls ? (double)stats.nanoseconds / stats.calls : 0.0);
+  }
+
+  resetStats();
+  if (0 != stats().operations[STATS_UNPACK].calls) {
+    TTV_LOGE("Error: the stats are not reset.");
+    return -1;
+  }
+
+  TTV_LOGI("testStats() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testStats()) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,224 @@
+#include "include/TtvBox.h"
+#include "include/TtvStore.h"
+#include "include/TtvView.h"
+#include "include/common.h"
+#include "test/testTtvAlloc.h"
+#include "test/testTtvCommon.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv store.
+*****************************************/
+
+static std::string getKey(const uint32_t model) {
+  return "model-" + std::to_string(model);
+}
+
+static bool checkModel(TtvStore &store, const uint32_t model,
+                       TtvStoreView &view) {
+  uint32_t width = 0;
+  std::string str;
+  return store.get(getKey(model), view) &&
+         view.getView().getNumbericalValue<uint32_t>(3, width) &&
+         (model == width) && view.getView().getStringValue(8, str) &&
+         ("./mean.txt" == str);
+}
+
+static int testPutGet() {
+  TtvStore store(1 << 20);
+  TtvStoreView view;
+  TtvBox box;
+
+  // a dirty box, a packed box and a packed buffer of the aligned layout
+  createConfig(box, 3, 224, 1);
+  TtvBox packed;
+  createConfig(packed, 3, 224, 2);
+  packed.pack();
+  TtvBox aligned;
+  createConfig(aligned, 3, 224, 3);
+  aligned.setLayout(LAYOUT_ALIGNED);
+  aligned.pack();
+  if (!store.put(getKey(1), box) || !box.isDirty() ||
+      !store.put(getKey(2), packed) ||
+      !store.put(getKey(3), aligned.getPackedBuffer(),
+                 aligned.getPackedBytes(), LAYOUT_ALIGNED) ||
+      (3 != store.getCount())) {
+    TTV_LOGE("Error: failed to put the boxes.");
+    return -1;
+  }
+  for (uint32_t model = 1; model <= 3; model++) {
+    if (!checkModel(store, model, view)) {
+      TTV_LOGE("Error: failed to get model %d.", model);
+      return -1;
+    }
+  }
+  if ((LAYOUT_ALIGNED != view.getView().getLayout()) ||
+      (0 != reinterpret_cast<uintptr_t>(view.getView().getBuffer()) %
+                LARGE_VALUE_ALIGNMENT)) {
+    TTV_LOGE("Error: the aligned box is not aligned.");
+    return -1;
+  }
+
+  // a view outlives the replaced and the removed boxes
+  const uint64_t bytes = store.getBytes();
+  createConfig(box, 3, 224, 4);
+  TtvStoreView old;
+  uint32_t width = 0;
+  if (!store.get(getKey(1), old) || !store.put(getKey(1), box) ||
+      (bytes != store.getBytes()) || !store.remove(getKey(1)) ||
+      store.remove(getKey(1)) || store.get(getKey(1), view) ||
+      !old.getView().getNumbericalValue<uint32_t>(3, width) || (1 != width)) {
+    TTV_LOGE("Error: failed to replace or remove a box.");
+    return -1;
+  }
+
+  // the malformed buffers and the boxes beyond the budget of a shard
+  const uint8_t malformed[] = {1, UINT32_T, 0};
+  TtvStore small(512, 4);
+  if (store.put(getKey(5), malformed, sizeof(malformed)) ||
+      small.put(getKey(5), packed) || (0 != small.getCount())) {
+    TTV_LOGE("Error: an invalid box is put.");
+    return -1;
+  }
+
+  store.clear();
+  if ((0 != store.getCount()) || (0 != store.getBytes())) {
+    TTV_LOGE("Error: failed to clear the store.");
+    return -1;
+  }
+
+  TTV_LOGI("testPutGet() succeded.");
+  return 0;
+}
+
+static int testEviction() {
+  // one shard so that the order of the evictions is known
+  TtvBox box;
+  createConfig(box, 3, 224, 0);
+  box.pack();
+  const uint64_t entryBytes =
+      box.getPackedBytes() + getKey(0).size() + STORE_ENTRY_OVERHEAD_BYTES;
+  TtvStore store(entryBytes * 10 + 1, 1);
+  TtvStoreView view;
+  for (uint32_t model = 0; model < 10; model++) {
+    createConfig(box, 3, 224, model);
+    store.put(getKey(model), box);
+  }
+  // the model 0 is used recently, so the model 1 is the first evicted to
+  // make room for the longer key of the model 10
+  if (!checkModel(store, 0, view) || !store.put(getKey(10), box) ||
+      (10 != store.getCount()) || (1 != store.getEvictions()) ||
+      store.get(getKey(1), view) || !checkModel(store, 0, view) ||
+      !checkModel(store, 2, view)) {
+    TTV_LOGE("Error: the least recently used box is not evicted.");
+    return -1;
+  }
+
+  // the budget is never exceeded
+  TtvStore sharded(64 * 1024);
+  for (uint32_t model = 0; model < 10000; model++) {
+    createConfig(box, 3, 224, model);
+    sharded.put(getKey(model), box);
+    if (sharded.getBytes() > 64 * 1024) {
+      TTV_LOGE("Error: the budget is exceeded.");
+      return -1;
+    }
+  }
+  if ((0 == sharded.getEvictions()) || !checkModel(sharded, 9999, view)) {
+    TTV_LOGE("Error: the boxes are not evicted.");
+    return -1;
+  }
+
+  TTV_LOGI("testEviction() succeded.");
+  return 0;
+}
+
+static int testFootprint() {
+  // the heap of the decoded boxes against the one of the store
+  const uint32_t numModels = 10000;
+  uint64_t start = gAllocatedBytes.load();
+  std::vector<TtvBox> boxes(numModels);
+  for (uint32_t model = 0; model < numModels; model++) {
+    createConfig(boxes[model], 3, 224, model);
+  }
+  const uint64_t boxBytes = gAllocatedBytes.load() - start;
+
+  start = gAllocatedBytes.load();
+  TtvStore store(64 << 20);
+  for (uint32_t model = 0; model < numModels; model++) {
+    store.put(getKey(model), boxes[model]);
+  }
+  const uint64_t storeBytes = gAllocatedBytes.load() - start;
+  TTV_LOGI("%u configs: decoded boxes %llu KB, store %llu KB, charged %llu KB",
+           numModels, (unsigned long long)(boxBytes >> 10),
+           (unsigned long long)(storeBytes >> 10),
+           (unsigned long long)(store.getBytes() >> 10));
+  if ((numModels != store.getCount()) || (storeBytes * 2 > boxBytes)) {
+    TTV_LOGE("Error: the store is not smaller than the decoded boxes.");
+    return -1;
+  }
+
+  TTV_LOGI("testFootprint() succeded.");
+  return 0;
+}
+
+static int testConcurrent() {
+  // the readers and the writers of the shards run concurrently
+  TtvStore store(256 * 1024, 4);
+  std::atomic<uint32_t> errors(0);
+  std::vector<std::thread> threads;
+  for (uint32_t ii = 0; ii < 4; ii++) {
+    threads.emplace_back([&, ii] {
+      TtvBox box;
+      TtvStoreView view;
+      for (uint32_t round = 0; round < 2000; round++) {
+        const uint32_t model = (round * 7 + ii) % 500;
+        if (0 == (round + ii) % 3) {
+          createConfig(box, 3, 224, model);
+          store.put(getKey(model), box);
+        } else if (store.get(getKey(model), view)) {
+          uint32_t width = 0;
+          if (!view.getView().getNumbericalValue<uint32_t>(3, width) ||
+              (model != width)) {
+            errors++;
+          }
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  if ((0 != errors.load()) || (store.getBytes() > 256 * 1024)) {
+    TTV_LOGE("Error: the concurrent gets read a wrong box.");
+    return -1;
+  }
+
+  TTV_LOGI("testConcurrent() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testPutGet()) {
+    return -1;
+  }
+
+  if (0 != testEviction()) {
+    return -1;
+  }
+
+  if (0 != testFootprint()) {
+    return -1;
+  }
+
+  if (0 != testConcurrent()) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,239 @@
+#include "include/TtvBox.h"
+#include "include/TtvStream.h"
+#include "include/common.h"
+#include "test/testTtvCommon.h"
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv stream.
+*****************************************/
+
+// the byte at an offset of the large value, so that it is checked without
+// being held in memory
+static uint8_t getValueByte(const uint64_t offset) {
+  return static_cast<uint8_t>((offset * 131) ^ (offset >> 20));
+}
+
+static int testRoundTrip(const std::string &file) {
+  const uint64_t valueBytes = 64ULL << 20;
+  const uint32_t chunkBytes = 1 << 20;
+  std::vector<uint8_t> chunk(chunkBytes);
+
+  TtvBox config;
+  createConfig(config);
+  TtvBox trailer;
+  trailer.putNumbericalValue<uint64_t>(3, UINT64_T, valueBytes);
+
+  TtvStreamWriter writer;
+  auto start = std::chrono::steady_clock::now();
+  if (!writer.open(file) || !writer.write(config) || !writer.beginValue(20)) {
+    TTV_LOGE("Error: failed to start the stream.");
+    return -1;
+  }
+  for (uint64_t offset = 0; offset < valueBytes; offset += chunkBytes) {
+    for (uint32_t ii = 0; ii < chunkBytes; ii++) {
+      chunk[ii] = getValueByte(offset + ii);
+    }
+    if (!writer.writeChunk(chunk.data(), chunkBytes)) {
+      TTV_LOGE("Error: failed to write a chunk.");
+      return -1;
+    }
+  }
+  // no box can be written in the middle of a value
+  if (writer.write(trailer) || (valueBytes != writer.getValueBytes()) ||
+      !writer.endValue() || !writer.write(trailer) || !writer.close()) {
+    TTV_LOGE("Error: failed to end the stream.");
+    return -1;
+  }
+  auto end = std::chrono::steady_clock::now();
+  const double writeMs =
+      std::chrono::duration<double, std::milli>(end - start).count();
+
+  // the chunks are read into a buffer of another size
+  TtvStreamReader reader;
+  TtvBox box;
+  uint8_t tag = 0;
+  start = std::chrono::steady_clock::now();
+  if (!reader.open(file) || !reader.read(box) || !reader.beginValue(tag) ||
+      (20 != tag)) {
+    TTV_LOGE("Error: failed to read the head of the stream.");
+    return -1;
+  }
+  std::string str;
+  uint32_t width = 0;
+  if (!box.getNumbericalValue<uint32_t>(3, width) || (224 != width) ||
+      !box.getStringValue(8, str) || ("./mean.txt" != str)) {
+    TTV_LOGE("Error: the box read from the stream is wrong.");
+    return -1;
+  }
+  std::vector<uint8_t> buffer(300000);
+  uint64_t offset = 0;
+  uint32_t bytes = 0;
+  do {
+    if (!reader.readChunk(buffer.data(), buffer.size(), bytes)) {
+      TTV_LOGE("Error: failed to read a chunk.");
+      return -1;
+    }
+    for (uint32_t ii = 0; ii < bytes; ii++) {
+      if (getValueByte(offset + ii) != buffer[ii]) {
+        TTV_LOGE("Error: the value differs at %llu.",
+                 (unsigned long long)(offset + ii));
+        return -1;
+      }
+    }
+    offset += bytes;
+  } while (bytes > 0);
+  uint64_t length = 0;
+  if ((valueBytes != offset) || (valueBytes != reader.getValueBytes()) ||
+      !reader.read(box) || !box.getNumbericalValue<uint64_t>(3, length) ||
+      (valueBytes != length) || !reader.isEof()) {
+    TTV_LOGE("Error: the tail of the stream is wrong.");
+    return -1;
+  }
+  end = std::chrono::steady_clock::now();
+  const double readMs =
+      std::chrono::duration<double, std::milli>(end - start).count();
+  TTV_LOGI("stream %llu MB: write %.1f ms, read %.1f ms",
+           (unsigned long long)(valueBytes >> 20), writeMs, readMs);
+
+  TTV_LOGI("testRoundTrip() succeded.");
+  return 0;
+}
+
+static int testBoxes(const std::string &file) {
+  // the boxes written one after another are read back one by one
+  TtvBox first;
+  TtvBox second;
+  createMessage(first, 1);
+  createMessage(second, 2);
+  TtvStreamWriter writer;
+  if (!writer.open(file) || !writer.write(first) || !writer.write(second) ||
+      !writer.close()) {
+    TTV_LOGE("Error: failed to write the boxes.");
+    return -1;
+  }
+
+  TtvStreamReader reader;
+  TtvBox box;
+  uint32_t sequence = 0;
+  if (!reader.open(file) || !reader.read(box) ||
+      !box.getNumbericalValue(1, sequence) || (1 != sequence) ||
+      (first.hash() != box.hash()) || reader.isEof() || !reader.read(box) ||
+      !box.getNumbericalValue(1, sequence) || (2 != sequence) ||
+      (second.hash() != box.hash()) || !reader.isEof()) {
+    TTV_LOGE("Error: the boxes are not read one by one.");
+    return -1;
+  }
+
+  TTV_LOGI("testBoxes() succeded.");
+  return 0;
+}
+
+static int testMalformed(const std::string &file) {
+  // a stream is not a box
+  TtvBox box;
+  if (box.read(file)) {
+    TTV_LOGE("Error: a stream is read as a box.");
+    return -1;
+  }
+
+  // the truncated streams are reported, whether in a record or in a chunk
+  std::ifstream in(file, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+  const std::string truncated = file + ".truncated";
+  const size_t sizes[] = {20, 60, bytes.size() - 5};
+  for (const size_t size : sizes) {
+    std::ofstream out(truncated, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), size);
+    out.close();
+
+    TtvStreamReader reader;
+    uint8_t tag = 0;
+    uint32_t read = 0;
+    std::vector<uint8_t> buffer(1 << 20);
+    bool complete = reader.open(truncated) && reader.read(box) &&
+                    reader.beginValue(tag);
+    while (complete) {
+      complete = reader.readChunk(buffer.data(), buffer.size(), read);
+      if (0 == read) {
+        break;
+      }
+    }
+    if (complete && reader.read(box) && reader.isEof()) {
+      TTV_LOGE("Error: a stream truncated to %d bytes is read.", (int)size);
+      return -1;
+    }
+  }
+  ::remove(truncated.c_str());
+
+  // a box file is not a stream
+  const std::string boxFile = file + ".box";
+  createConfig(box);
+  box.pack();
+  TtvStreamReader reader;
+  if (!box.write(boxFile) || reader.open(boxFile)) {
+    TTV_LOGE("Error: a box is read as a stream.");
+    return -1;
+  }
+  ::remove(boxFile.c_str());
+
+  TTV_LOGI("testMalformed() succeded.");
+  return 0;
+}
+
+static int testLimits() {
+  // the values beyond 4GB are rejected before anything is allocated
+  TtvBox box;
+  const char value = 0;
+  if (box.putNonNumbericalValue(20, BYTES_T, UINT32_MAX, &value) ||
+      box.putNonNumbericalValue(20, CHUNKED_T, 1, &value)) {
+    TTV_LOGE("Error: a value beyond the box limits is put.");
+    return -1;
+  }
+
+  // the counters of a stream go beyond 4GB
+  TtvStreamWriter writer;
+  std::vector<uint8_t> chunk(64 << 20);
+  if (!writer.open("/dev/null") || !writer.beginValue(20)) {
+    TTV_LOGE("Error: failed to open /dev/null.");
+    return -1;
+  }
+  const uint64_t valueBytes = 5ULL << 30;
+  while (writer.getValueBytes() < valueBytes) {
+    if (!writer.writeChunk(chunk.data(), chunk.size())) {
+      TTV_LOGE("Error: failed to write a chunk.");
+      return -1;
+    }
+  }
+  if (!writer.endValue() || (valueBytes != writer.getValueBytes()) ||
+      (writer.getBytes() <= valueBytes) || !writer.close()) {
+    TTV_LOGE("Error: the counters of the stream are wrong.");
+    return -1;
+  }
+
+  TTV_LOGI("testLimits() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  const std::string file = getTempFile("stream.ttv");
+  const int ret = (0 != testRoundTrip(file)) || (0 != testMalformed(file)) ||
+                  (0 != testBoxes(file));
+  ::remove(file.c_str());
+  if (0 != ret) {
+    return -1;
+  }
+
+  if (0 != testLimits()) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include "include/TtvThreadPool.h"
+#include "include/common.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv thread pool.
+*****************************************/
+
+static int testRun() {
+  TtvThreadPool pool(4);
+  TtvThreadPool single(1);
+  if ((4 != pool.getNumThreads()) || (1 != single.getNumThreads()) ||
+      (0 == TtvThreadPool().getNumThreads())) {
+    TTV_LOGE("Error: the number of threads is wrong.");
+    return -1;
+  }
+
+  // every index is run exactly once, by any pool and for any count
+  const uint32_t counts[] = {0, 1, 3, 1000};
+  for (TtvThreadPool *runner : {&pool, &single}) {
+    for (const uint32_t count : counts) {
+      std::vector<std::atomic<uint32_t>> runs(count);
+      for (std::atomic<uint32_t> &run : runs) {
+        run.store(0);
+      }
+      runner->run(count, [&](const uint32_t index) { runs[index]++; });
+      for (const std::atomic<uint32_t> &run : runs) {
+        if (1 != run.load()) {
+          TTV_LOGE("Error: an index of %d is not run once.", count);
+          return -1;
+        }
+      }
+    }
+  }
+
+  TTV_LOGI("testRun() succeded.");
+  return 0;
+}
+
+static int testConcurrentCallers() {
+  // the jobs of the callers are run one after another on the same threads
+  TtvThreadPool pool(3);
+  const uint32_t jobs = 200;
+  std::atomic<uint64_t> sums[2];
+  std::vector<std::thread> callers;
+  for (uint32_t caller = 0; caller < 2; caller++) {
+    sums[caller].store(0);
+    callers.emplace_back([&, caller] {
+      for (uint32_t job = 0; job < jobs; job++) {
+        pool.run(64, [&](const uint32_t index) { sums[caller] += index; });
+      }
+    });
+  }
+  for (std::thread &caller : callers) {
+    caller.join();
+  }
+  if ((jobs * 2016 != sums[0].load()) || (jobs * 2016 != sums[1].load())) {
+    TTV_LOGE("Error: the jobs of the concurrent callers are mixed up.");
+    return -1;
+  }
+
+  TTV_LOGI("testConcurrentCallers() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testRun()) {
+    return -1;
+  }
+
+  if (0 != testConcurrentCallers()) {
+    return -1;
+  }
+
+  return 0;
+}
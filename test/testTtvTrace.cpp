@@ -0,0 +1,184 @@
+#include "include/TtvBox.h"
+#include "include/TtvTrace.h"
+#include "include/common.h"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for ttv trace.
+*****************************************/
+
+static void packAndUnpack(const uint32_t rounds) {
+  TtvBox box;
+  TtvBox decoded;
+  const std::string str = "./mean.txt";
+  for (uint32_t ii = 0; ii < rounds; ii++) {
+    box.clear();
+    box.putNumbericalValue<uint32_t>(1, UINT32_T, ii);
+    box.putNonNumbericalValue(8, STRING_T, str.size(), str.c_str());
+    box.pack();
+    decoded.unpack(box.getPackedBuffer(), box.getPackedBytes());
+  }
+}
+
+static uint32_t countEvents(const std::vector<TtvTraceEvent> &events,
+                            const char *name) {
+  uint32_t count = 0;
+  for (const TtvTraceEvent &event : events) {
+    count += (0 == ::strcmp(name, event.name)) ? 1 : 0;
+  }
+  return count;
+}
+
+static uint32_t countString(const std::string &json, const std::string &str) {
+  uint32_t count = 0;
+  for (size_t pos = json.find(str); std::string::npos != pos;
+       pos = json.find(str, pos + str.size())) {
+    count++;
+  }
+  return count;
+}
+
+static int testTrace(const std::string &file) {
+  clearTrace();
+#ifndef TTV_ENABLE_TRACE
+  packAndUnpack(10);
+  const std::string empty = exportTrace();
+  if (!traceEvents().empty() || (0 != countString(empty, "\"ph\":\"X\"")) ||
+      (0 != empty.find("{\"traceEvents\":["))) {
+    TTV_LOGE("Error: the spans are recorded while compiled out.");
+    return -1;
+  }
+  TTV_LOGI("testTrace() skipped, the trace is compiled out.");
+  return 0;
+#endif
+
+  // the spans of the exited threads are kept, each thread on its own track
+  const uint32_t numThreads = 3;
+  const uint32_t rounds = 100;
+  std::vector<std::thread> threads;
+  for (uint32_t ii = 0; ii < numThreads; ii++) {
+    threads.emplace_back(packAndUnpack, rounds);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  {
+    TTV_TRACE_SCOPE("application");
+    packAndUnpack(rounds);
+  }
+
+  std::vector<TtvTraceEvent> events = traceEvents();
+  std::set<uint32_t> tids;
+  const TtvTraceEvent *application = nullptr;
+  for (const TtvTraceEvent &event : events) {
+    tids.insert(event.tid);
+    if (0 == ::strcmp("application", event.name)) {
+      application = &event;
+    }
+  }
+  if (((numThreads + 1) * rounds != countEvents(events, "TtvBox::pack")) ||
+      ((numThreads + 1) * rounds != countEvents(events, "TtvBox::unpack")) ||
+      (numThreads + 1 != tids.size()) || (nullptr == application)) {
+    TTV_LOGE("Error: the spans of the threads are wrong.");
+    return -1;
+  }
+
+  // the spans of the application enclose the ones of ttv on its track
+  for (const TtvTraceEvent &event : events) {
+    if ((event.tid == application->tid) && (&event != application) &&
+        ((event.start < application->start) ||
+         (event.start + event.nanoseconds >
+          application->start + application->nanoseconds))) {
+      TTV_LOGE("Error: a span is outside of the application span.");
+      return -1;
+    }
+  }
+
+  // every span is exported as a complete event
+  if (!exportTrace(file)) {
+    return -1;
+  }
+  std::ifstream in(file);
+  const std::string json((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+  if ((0 != json.find("{\"traceEvents\":[")) ||
+      (events.size() != countString(json, "\"ph\":\"X\"")) ||
+      (rounds * (numThreads + 1) !=
+       countString(json, "\"name\":\"TtvBox::pack\""))) {
+    TTV_LOGE("Error: the exported trace is wrong.");
+    return -1;
+  }
+  ::remove(file.c_str());
+
+  // a thread keeps its latest spans only
+  clearTrace();
+  if (!traceEvents().empty()) {
+    TTV_LOGE("Error: the spans are not cleared.");
+    return -1;
+  }
+  for (uint32_t ii = 0; ii < TRACE_THREAD_EVENTS + 100; ii++) {
+    TTV_TRACE_SCOPE("span");
+  }
+  events = traceEvents();
+  if (TRACE_THREAD_EVENTS != countEvents(events, "span")) {
+    TTV_LOGE("Error: %d spans are kept.", countEvents(events, "span"));
+    return -1;
+  }
+
+  TTV_LOGI("testTrace() succeded.");
+  return 0;
+}
+
+static int testConcurrentExport() {
+  // export while the threads are recording and wrapping their buffers
+  std::atomic<bool> stopping(false);
+  std::vector<std::thread> threads;
+  for (uint32_t ii = 0; ii < 2; ii++) {
+    threads.emplace_back([&] {
+      while (!stopping.load()) {
+        packAndUnpack(10);
+      }
+    });
+  }
+  for (uint32_t ii = 0; ii < 20; ii++) {
+    for (const TtvTraceEvent &event : traceEvents()) {
+      if ((nullptr == event.name) || (event.nanoseconds < 0)) {
+        TTV_LOGE("Error: a torn span is exported.");
+        stopping.store(true);
+        for (std::thread &thread : threads) {
+          thread.join();
+        }
+        return -1;
+      }
+    }
+  }
+  stopping.store(true);
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  TTV_LOGI("testConcurrentExport() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testTrace("./trace.json")) {
+    return -1;
+  }
+
+  if (0 != testConcurrentExport()) {
+    return -1;
+  }
+
+  return 0;
+}
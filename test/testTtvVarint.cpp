@@ -0,0 +1,257 @@
+#include "include/TtvBox.h"
+#include "include/TtvVarint.h"
+#include "include/common.h"
+#include "test/testTtvCommon.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace ttv;
+
+/*****************************************
+   Unit Testing for varint values.
+*****************************************/
+
+static int testVarint() {
+  const uint64_t values[] = {0,
+                             1,
+                             127,
+                             128,
+                             300,
+                             16383,
+                             16384,
+                             (1ULL << 35) + 5,
+                             (1ULL << 56) - 1,
+                             1ULL << 56,
+                             (1ULL << 63) - 1,
+                             std::numeric_limits<uint64_t>::max()};
+  for (const uint64_t value : values) {
+    // decode at the end of a buffer and followed by other bytes, i.e. by the
+    // slow and the fast path
+    uint8_t buffer[VARINT_MAX_BYTES + 8];
+    ::memset(buffer, 0xFF, sizeof(buffer));
+    const uint32_t size = encodeVarint(value, buffer);
+    uint64_t decoded = 0;
+    uint64_t decodedFast = 0;
+    if ((size != decodeVarint(buffer, size, decoded)) || (value != decoded) ||
+        (size != decodeVarint(buffer, sizeof(buffer), decodedFast)) ||
+        (value != decodedFast) || (0 != decodeVarint(buffer, size - 1, decoded))) {
+      TTV_LOGE("Error: failed to decode the varint of %llu.",
+               (unsigned long long)value);
+      return -1;
+    }
+  }
+
+  const int64_t signedValues[] = {0, -1, 1, -64, 64, -65,
+                                  std::numeric_limits<int64_t>::min(),
+                                  std::numeric_limits<int64_t>::max()};
+  for (const int64_t value : signedValues) {
+    if (value != decodeZigzag(encodeZigzag(value))) {
+      TTV_LOGE("Error: failed to zigzag %lld.", (long long)value);
+      return -1;
+    }
+  }
+  if ((1 != encodeZigzag(-1)) || (2 != encodeZigzag(1))) {
+    TTV_LOGE("Error: wrong zigzag encoding.");
+    return -1;
+  }
+
+  // overlong varints are rejected
+  uint8_t overlong[VARINT_MAX_BYTES + 8];
+  ::memset(overlong, 0x80, sizeof(overlong));
+  overlong[VARINT_MAX_BYTES - 1] = 0x02;
+  uint64_t decoded = 0;
+  if (0 != decodeVarint(overlong, sizeof(overlong), decoded)) {
+    TTV_LOGE("Error: the overlong varint is not rejected.");
+    return -1;
+  }
+
+  TTV_LOGI("testVarint() succeded.");
+  return 0;
+}
+
+static int testVarintBox() {
+  TtvBox fixed;
+  TtvBox compact;
+  for (uint8_t tag = 1; tag <= 20; tag++) {
+    fixed.putNumbericalValue<uint64_t>(tag, UINT64_T, tag * 3);
+    compact.putNumbericalValue<uint64_t>(tag, VARUINT_T, tag * 3);
+  }
+  fixed.putNumbericalValue<int32_t>(21, INT32_T, -7);
+  compact.putNumbericalValue<int32_t>(21, VARINT_T, -7);
+  fixed.pack();
+  compact.pack();
+  TTV_LOGI("20 small counters take %d bytes, %d bytes as varints.",
+           fixed.getPackedBytes(), compact.getPackedBytes());
+  if (compact.getPackedBytes() * 3 > fixed.getPackedBytes()) {
+    TTV_LOGE("Error: the varints don't shrink the payload.");
+    return -1;
+  }
+
+  for (uint8_t layout = LAYOUT_COMPACT; layout <= LAYOUT_ALIGNED; layout++) {
+    compact.setLayout(layout);
+    compact.pack();
+    TtvBox decoded;
+    decoded.setLayout(layout);
+    uint64_t value = 0;
+    int32_t signedValue = 0;
+    uint8_t narrow = 0;
+    if (!decoded.unpack(compact.getPackedBuffer(), compact.getPackedBytes()) ||
+        !decoded.getNumbericalValue(20, value) || (60 != value) ||
+        !decoded.getNumbericalValue(21, signedValue) || (-7 != signedValue) ||
+        !decoded.getNumbericalValue(20, narrow) || (60 != narrow) ||
+        decoded.getNumbericalValue(21, narrow)) {
+      TTV_LOGE("Error: failed to get the varint values.");
+      return -1;
+    }
+  }
+  compact.setLayout(LAYOUT_COMPACT);
+
+  // a negative value cannot be stored as VARUINT_T, and a value which
+  // doesn't fit the requested type is rejected
+  // an unsigned value above INT64_MAX cannot be stored as VARINT_T
+  uint8_t narrow = 0;
+  uint8_t buffer[VARINT_MAX_BYTES];
+  const uint64_t int64Max = std::numeric_limits<int64_t>::max();
+  if (compact.putNumbericalValue<int32_t>(30, VARUINT_T, -1) ||
+      compact.putNumbericalValue<float>(30, VARINT_T, 1.0f) ||
+      compact.putNumbericalValue<uint64_t>(30, VARINT_T, int64Max + 1) ||
+      (0 != encodeVarintValue<uint64_t>(VARINT_T, int64Max + 1, buffer)) ||
+      (0 == encodeVarintValue<uint64_t>(VARINT_T, int64Max, buffer)) ||
+      !compact.putNumbericalValue<uint32_t>(30, VARUINT_T, 300) ||
+      compact.getNumbericalValue(30, narrow)) {
+    TTV_LOGE("Error: the varint range is not checked.");
+    return -1;
+  }
+
+  // updating a varint changes its length
+  compact.pack();
+  uint32_t value = 0;
+  if (!compact.setNumbericalValue<uint32_t>(30, 1) || !compact.isDirty() ||
+      !compact.pack() || !compact.getNumbericalValue(30, value) ||
+      (1 != value)) {
+    TTV_LOGE("Error: failed to update a varint.");
+    return -1;
+  }
+
+  // the header tells the readers that the payload contains varints
+  const std::string file = getTempFile("varint.bin");
+  auto hasVarintFlag = [&file](TtvBox &box) {
+    uint8_t header[EXTENDED_HEADER_BYTES];
+    TtvHeader fields;
+    box.write(file);
+    std::ifstream in(file, std::ios::binary);
+    in.read(reinterpret_cast<char *>(header), sizeof(header));
+    return decodeHeader(header, fields) && (fields.flags & HEADER_FLAG_VARINT);
+  };
+  TtvBox decoded;
+  if (!hasVarintFlag(compact) || !decoded.read(file) ||
+      !decoded.unpack(decoded.getPackedBuffer(), decoded.getPackedBytes()) ||
+      !decoded.getNumbericalValue(30, value) || (1 != value)) {
+    TTV_LOGE("Error: failed to write and read the varints.");
+    return -1;
+  }
+
+  // the varints of the nested boxes are flagged as well, whatever the layout
+  // of the nested box
+  TtvBox child;
+  child.putNumbericalValue<uint32_t>(1, VARUINT_T, 7);
+  child.setLayout(LAYOUT_ALIGNED);
+  child.pack();
+  TtvBox nested;
+  nested.putTtvValue(1, TTV_T, &child);
+  nested.pack();
+  TtvBox repeated;
+  repeated.putRepeatedTtvValue(1, &fixed, 1);
+  repeated.pack();
+  if (!hasVarintFlag(nested) || hasVarintFlag(repeated) ||
+      !repeated.putRepeatedTtvValue(2, &child, 1) || !repeated.pack() ||
+      !hasVarintFlag(repeated)) {
+    TTV_LOGE("Error: the nested varints are not flagged.");
+    return -1;
+  }
+  ::remove(file.c_str());
+
+  // a packed box is walked in its layout, e.g. to flag a forwarded frame
+  repeated.setLayout(LAYOUT_ALIGNED);
+  repeated.pack();
+  if (!TtvBox::hasVarint(repeated.getPackedBuffer(), repeated.getPackedBytes(),
+                         LAYOUT_ALIGNED) ||
+      TtvBox::hasVarint(fixed.getPackedBuffer(), fixed.getPackedBytes(),
+                        fixed.getLayout())) {
+    TTV_LOGE("Error: the varints of a packed box are not found.");
+    return -1;
+  }
+
+  TTV_LOGI("testVarintBox() succeded.");
+  return 0;
+}
+
+static int testThroughput() {
+  // small counters and ids, most of them fit in one or two bytes
+  const uint32_t count = 1 << 20;
+  std::vector<uint8_t> varints(count * VARINT_MAX_BYTES);
+  std::vector<uint64_t> fixed(count);
+  uint32_t size = 0;
+  for (uint32_t ii = 0; ii < count; ii++) {
+    const uint64_t value = (ii * 2654435761u) % ((ii & 7) ? 200 : 100000);
+    size += encodeVarint(value, varints.data() + size);
+    fixed[ii] = htobe64(value);
+  }
+
+  const int rounds = 8;
+  uint64_t sum = 0;
+  uint64_t expected = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (uint32_t ii = 0; ii < count; ii++) {
+      expected += be64toh(fixed[ii]);
+    }
+  }
+  std::chrono::duration<double> fixedSeconds =
+      std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (uint32_t offset = 0; offset < size;) {
+      uint64_t value = 0;
+      offset += decodeVarint(varints.data() + offset, size - offset, value);
+      sum += value;
+    }
+  }
+  std::chrono::duration<double> varintSeconds =
+      std::chrono::steady_clock::now() - start;
+
+  if (sum != expected) {
+    TTV_LOGE("Error: the varints are decoded wrongly.");
+    return -1;
+  }
+  TTV_LOGI("decode %u values: fixed %.2f ns, varint %.2f ns per value, "
+           "%.2f bytes per varint",
+           count, fixedSeconds.count() * 1e9 / rounds / count,
+           varintSeconds.count() * 1e9 / rounds / count, (double)size / count);
+
+  TTV_LOGI("testThroughput() succeded.");
+  return 0;
+}
+
+int main(int argc, char const *argv[]) {
+  if (0 != testVarint()) {
+    return -1;
+  }
+
+  if (0 != testVarintBox()) {
+    return -1;
+  }
+
+  if (0 != testThroughput()) {
+    return -1;
+  }
+
+  return 0;
+}